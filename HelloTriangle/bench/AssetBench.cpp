@@ -0,0 +1,479 @@
+// Micro-benchmarks for the CPU side of asset loading: reading SPIR-V, parsing the OBJ and
+// sharing identical vertices, std::hash<Vertex>, decoding the texture and building its mip
+// chain. Nothing here touches a device, so it runs on machines without a GPU.
+//
+// Every case is warmed up, then timed as a number of samples, each running the case enough times
+// to last about --sample-ms so the clock's resolution doesn't matter. Results are per iteration:
+// the median with the median absolute deviation, and the mean with its 95% confidence interval.
+// Samples further than three (scaled) MADs above the median are counted as outliers; many of them
+// mean the machine was busy and the run should be repeated.
+//
+// Files are read through the page cache, which the warm-up fills, so readFile and stbi_load are
+// measured without disk latency. Run from HelloTriangle/ so the default paths resolve.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <tiny_obj_loader.h>
+
+#include "../scene/Vertex.h"
+#include "../scene/ObjLoader.h"
+#include "../core/FileUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Options
+{
+	std::string filter;
+	uint32_t samples = 30;
+	double sampleMilliseconds = 20.0;
+	std::string model = "models/viking_room.obj";
+	std::string texture = "textures/viking_room.png";
+	std::vector<std::string> shaders;
+};
+
+struct Stats
+{
+	double median;
+	double mad;
+	double mean;
+	double confidence;	// half-width of the 95% interval of the mean
+	double min;
+	uint32_t outliers;
+};
+
+// Results of the timed code are folded into this so the optimizer can't drop the work.
+static volatile uint64_t sink;
+
+static Options parseOptions(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc)
+				throw std::runtime_error("missing value for " + arg + "!");
+			return argv[++i];
+		};
+
+		if (arg == "--filter")
+			options.filter = value();
+		else if (arg == "--samples")
+			options.samples = static_cast<uint32_t>(std::max(2, std::atoi(value().c_str())));
+		else if (arg == "--sample-ms")
+			options.sampleMilliseconds = std::max(0.1, std::atof(value().c_str()));
+		else if (arg == "--model")
+			options.model = value();
+		else if (arg == "--texture")
+			options.texture = value();
+		else if (arg == "--shader")
+			options.shaders.push_back(value());
+		else
+			throw std::runtime_error("unknown option " + arg + "!");
+	}
+
+	if (options.shaders.empty())
+		options.shaders = { "shaders/vert.spv", "shaders/frag.spv" };
+	return options;
+}
+
+// Two-sided 95% quantile of Student's t distribution.
+static double studentT95(size_t degreesOfFreedom)
+{
+	static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228 };
+	if (degreesOfFreedom == 0)
+		return 0.0;
+	if (degreesOfFreedom <= 10)
+		return table[degreesOfFreedom - 1];
+	if (degreesOfFreedom <= 20)
+		return 2.086;
+	if (degreesOfFreedom <= 30)
+		return 2.042;
+	return 1.960;
+}
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	size_t half = values.size() / 2;
+	return values.size() % 2 ? values[half] : 0.5 * (values[half - 1] + values[half]);
+}
+
+static Stats summarize(const std::vector<double>& samples)
+{
+	Stats stats{};
+	stats.median = median(samples);
+	stats.min = *std::min_element(samples.begin(), samples.end());
+
+	std::vector<double> deviations;
+	double sum = 0.0;
+	for (double sample : samples) {
+		deviations.push_back(std::abs(sample - stats.median));
+		sum += sample;
+	}
+	stats.mad = median(deviations);
+	stats.mean = sum / samples.size();
+
+	double squares = 0.0;
+	for (double sample : samples)
+		squares += (sample - stats.mean) * (sample - stats.mean);
+	double deviation = std::sqrt(squares / (samples.size() - 1));
+	stats.confidence = studentT95(samples.size() - 1) * deviation / std::sqrt(static_cast<double>(samples.size()));
+
+	// 1.4826 scales the MAD to a standard deviation for normally distributed samples.
+	for (double sample : samples) {
+		if (sample > stats.median + 3.0 * 1.4826 * stats.mad)
+			stats.outliers++;
+	}
+	return stats;
+}
+
+static std::string formatDuration(double nanoseconds)
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(nanoseconds < 10.0 ? 2 : 1);
+	if (nanoseconds < 1e3)
+		out << nanoseconds << " ns";
+	else if (nanoseconds < 1e6)
+		out << nanoseconds / 1e3 << " us";
+	else
+		out << nanoseconds / 1e6 << " ms";
+	return out.str();
+}
+
+static double elapsedNanoseconds(std::chrono::steady_clock::time_point begin)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Times body, which returns a value derived from its work, and prints one line of results.
+template<typename Body>
+static void run(const Options& options, const std::string& name, Body&& body)
+{
+	if (name.find(options.filter) == std::string::npos)
+		return;
+
+	// Warm up caches and the allocator, then size the batch from a second, warm run.
+	sink = sink + body();
+	auto begin = std::chrono::steady_clock::now();
+	sink = sink + body();
+	double once = std::max(1.0, elapsedNanoseconds(begin));
+	uint64_t iterations = std::max<uint64_t>(1, static_cast<uint64_t>(options.sampleMilliseconds * 1e6 / once));
+
+	std::vector<double> samples;
+	samples.reserve(options.samples);
+	for (uint32_t sample = 0; sample < options.samples; sample++) {
+		begin = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; i++)
+			sink = sink + body();
+		samples.push_back(elapsedNanoseconds(begin) / iterations);
+	}
+
+	Stats stats = summarize(samples);
+	std::cout << "  " << std::left << std::setw(34) << name << std::right
+		<< std::setw(10) << iterations
+		<< std::setw(12) << formatDuration(stats.median) << " +- " << std::left << std::setw(10) << formatDuration(stats.mad) << std::right
+		<< std::setw(12) << formatDuration(stats.mean) << " +- " << std::left << std::setw(10) << formatDuration(stats.confidence) << std::right
+		<< std::setw(12) << formatDuration(stats.min)
+		<< std::setw(6) << stats.outliers << std::endl;
+}
+
+// A reference hash for comparison: every component through std::hash<float>, which treats 0 and
+// -0 alike as operator== does, mixed with a multiply and shift per component.
+struct MixedVertexHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		const float values[] = { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.color.x, vertex.color.y, vertex.color.z, vertex.texCoord.x, vertex.texCoord.y };
+
+		uint64_t hash = 0x9e3779b97f4a7c15ull;
+		for (float value : values) {
+			hash ^= std::hash<float>()(value);
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 32;
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+// Shares identical vertices the way loadObj does: count, then operator[] to insert and again to
+// read the index back.
+template<typename Hash>
+static uint64_t dedupLikeLoader(const std::vector<Vertex>& corners)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::unordered_map<Vertex, uint32_t, Hash> uniqueVertices{};
+
+	for (const Vertex& vertex : corners) {
+		if (uniqueVertices.count(vertex) == 0) {
+			uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(vertex);
+		}
+		indices.push_back(uniqueVertices[vertex]);
+	}
+	return vertices.size() + indices.size();
+}
+
+// The same with a single lookup per corner and the map and outputs sized up front.
+template<typename Hash>
+static uint64_t dedupSingleLookup(const std::vector<Vertex>& corners)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::unordered_map<Vertex, uint32_t, Hash> uniqueVertices{};
+	uniqueVertices.reserve(corners.size());
+	indices.reserve(corners.size());
+
+	for (const Vertex& vertex : corners) {
+		auto inserted = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+		if (inserted.second)
+			vertices.push_back(vertex);
+		indices.push_back(inserted.first->second);
+	}
+	return vertices.size() + indices.size();
+}
+
+// How evenly hash spreads the distinct vertices, compared with what a uniformly random hash
+// would give for the same count: equal full-width hashes, equal low 16 bits, and in a map with
+// one bucket per vertex the occupied buckets and the mean chain length a successful lookup walks.
+template<typename Hash>
+static void reportHashQuality(const std::string& name, const std::vector<Vertex>& vertices)
+{
+	Hash hash;
+	double n = static_cast<double>(vertices.size());
+
+	std::vector<size_t> hashes;
+	hashes.reserve(vertices.size());
+	for (const Vertex& vertex : vertices)
+		hashes.push_back(hash(vertex));
+	std::sort(hashes.begin(), hashes.end());
+	size_t fullCollisions = vertices.size() - (std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+
+	std::vector<uint16_t> lowBits;
+	for (size_t value : hashes)
+		lowBits.push_back(static_cast<uint16_t>(value));
+	std::sort(lowBits.begin(), lowBits.end());
+	size_t lowDistinct = std::unique(lowBits.begin(), lowBits.end()) - lowBits.begin();
+	double lowExpected = 65536.0 * (1.0 - std::pow(1.0 - 1.0 / 65536.0, n));
+
+	std::unordered_map<Vertex, uint32_t, Hash> map;
+	map.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		map.emplace(vertices[i], static_cast<uint32_t>(i));
+
+	double buckets = static_cast<double>(map.bucket_count());
+	size_t occupied = 0, longest = 0;
+	double walked = 0.0;
+	for (size_t bucket = 0; bucket < map.bucket_count(); bucket++) {
+		size_t size = map.bucket_size(bucket);
+		occupied += size > 0;
+		longest = std::max(longest, size);
+		walked += size * (size + 1) / 2.0;
+	}
+	double occupiedExpected = buckets * (1.0 - std::pow(1.0 - 1.0 / buckets, n));
+	double load = n / buckets;
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "  " << name << ": " << vertices.size() << " distinct vertices\n"
+		<< "    equal hashes       " << fullCollisions << " (uniform: ~" << n * n / 2.0 / std::pow(2.0, 8.0 * sizeof(size_t)) << ")\n"
+		<< "    distinct low 16    " << lowDistinct << " (uniform: " << std::setprecision(0) << lowExpected << ")\n"
+		<< "    occupied buckets   " << occupied << " of " << map.bucket_count() << " (uniform: " << occupiedExpected << ")\n"
+		<< std::setprecision(3)
+		<< "    longest chain      " << longest << "\n"
+		<< "    lookup walks       " << walked / n << " (uniform: " << 1.0 + load / 2.0 << ")\n";
+	std::cout.unsetf(std::ios::fixed);
+	std::cout << std::setprecision(6);
+}
+
+// sRGB-correct 2x2 box filter, the CPU counterpart of the linear blits the engine records for
+// each mip level. Odd edges reuse the last row or column. Returns levels 1 and up, RGBA8.
+static std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* pixels, int width, int height)
+{
+	static float toLinear[256];
+	static uint8_t toSrgb[4096];
+	static bool tablesReady = false;
+	if (!tablesReady) {
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; i++) {
+			float c = i / 4095.0f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			toSrgb[i] = static_cast<uint8_t>(std::lround(std::min(1.0f, std::max(0.0f, s)) * 255.0f));
+		}
+		tablesReady = true;
+	}
+
+	std::vector<std::vector<uint8_t>> levels;
+	const uint8_t* src = pixels;
+	while (width > 1 || height > 1) {
+		int mipWidth = std::max(1, width / 2);
+		int mipHeight = std::max(1, height / 2);
+		std::vector<uint8_t> dst(static_cast<size_t>(mipWidth) * mipHeight * 4);
+
+		for (int y = 0; y < mipHeight; y++) {
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, height - 1)) * width * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width * 4;
+			uint8_t* out = dst.data() + static_cast<size_t>(y) * mipWidth * 4;
+
+			for (int x = 0; x < mipWidth; x++) {
+				int x0 = std::min(2 * x, width - 1) * 4;
+				int x1 = std::min(2 * x + 1, width - 1) * 4;
+				for (int c = 0; c < 3; c++) {
+					float sum = toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]];
+					out[4 * x + c] = toSrgb[static_cast<int>(sum * 0.25f * 4095.0f + 0.5f)];
+				}
+				out[4 * x + 3] = static_cast<uint8_t>((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+			}
+		}
+
+		levels.push_back(std::move(dst));
+		src = levels.back().data();
+		width = mipWidth;
+		height = mipHeight;
+	}
+	return levels;
+}
+
+static void printHeader(const std::string& title)
+{
+	std::cout << "\n" << title << "\n"
+		<< "  " << std::left << std::setw(34) << "case" << std::right << std::setw(10) << "iters"
+		<< std::setw(26) << "median +- MAD" << std::setw(26) << "mean +- 95% CI" << std::setw(12) << "min" << std::setw(6) << "out" << std::endl;
+}
+
+static void benchmarkFiles(const Options& options)
+{
+	printHeader("readFile");
+	for (const std::string& path : options.shaders) {
+		try {
+			readFile(path);
+		}
+		catch (const std::exception& e) {
+			std::cout << "  skipped " << path << ": " << e.what() << std::endl;
+			continue;
+		}
+		run(options, "readFile " + path, [&]() {
+			std::vector<char> code = readFile(path);
+			return static_cast<uint64_t>(code.size());
+		});
+	}
+}
+
+static void benchmarkModel(const Options& options)
+{
+	printHeader("model " + options.model);
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	try {
+		loadObj(options.model, vertices, indices);
+	}
+	catch (const std::exception& e) {
+		std::cout << "  skipped: " << e.what() << std::endl;
+		return;
+	}
+
+	run(options, "loadObj (parse + dedup)", [&]() {
+		std::vector<Vertex> loadedVertices;
+		std::vector<uint32_t> loadedIndices;
+		loadObj(options.model, loadedVertices, loadedIndices);
+		return static_cast<uint64_t>(loadedVertices.size() + loadedIndices.size());
+	});
+
+	run(options, "tinyobj::LoadObj (parse)", [&]() {
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn;
+		tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, options.model.c_str());
+		return static_cast<uint64_t>(attrib.vertices.size() + shapes.size());
+	});
+
+	// The vertex of every triangle corner, as the parser hands them to the dedup loop.
+	std::vector<Vertex> corners;
+	corners.reserve(indices.size());
+	for (uint32_t index : indices)
+		corners.push_back(vertices[index]);
+
+	run(options, "dedup std::hash, as loadObj", [&]() { return dedupLikeLoader<std::hash<Vertex>>(corners); });
+	run(options, "dedup std::hash, one lookup", [&]() { return dedupSingleLookup<std::hash<Vertex>>(corners); });
+	run(options, "dedup mixed hash, one lookup", [&]() { return dedupSingleLookup<MixedVertexHash>(corners); });
+
+	run(options, "std::hash<Vertex> per vertex", [&]() {
+		std::hash<Vertex> hash;
+		uint64_t sum = 0;
+		for (const Vertex& vertex : vertices)
+			sum += hash(vertex);
+		return sum;
+	});
+
+	std::cout << "  (" << corners.size() << " corners, " << vertices.size() << " vertices; the hash time is for all of them)" << std::endl;
+
+	if (std::string("hash quality").find(options.filter) == std::string::npos)
+		return;
+	std::cout << "\nhash quality" << std::endl;
+	reportHashQuality<std::hash<Vertex>>("std::hash<Vertex>", vertices);
+	reportHashQuality<MixedVertexHash>("mixed hash", vertices);
+}
+
+static void benchmarkTexture(const Options& options)
+{
+	printHeader("texture " + options.texture);
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(options.texture.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cout << "  skipped: " << stbi_failure_reason() << std::endl;
+		return;
+	}
+
+	run(options, "stbi_load", [&]() {
+		int w, h, c;
+		stbi_uc* decoded = stbi_load(options.texture.c_str(), &w, &h, &c, STBI_rgb_alpha);
+		uint64_t result = decoded ? decoded[0] + static_cast<uint64_t>(w) * h : 0;
+		stbi_image_free(decoded);
+		return result;
+	});
+
+	std::vector<std::vector<uint8_t>> levels = generateMipChain(pixels, width, height);
+	run(options, "mip chain (sRGB box filter)", [&]() {
+		std::vector<std::vector<uint8_t>> chain = generateMipChain(pixels, width, height);
+		return static_cast<uint64_t>(chain.size() + (chain.empty() ? 0 : chain.back()[0]));
+	});
+
+	std::cout << "  (" << width << "x" << height << ", " << levels.size() + 1 << " levels)" << std::endl;
+	stbi_image_free(pixels);
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		Options options = parseOptions(argc, argv);
+		std::cout << options.samples << " samples of ~" << options.sampleMilliseconds << " ms per case, times per iteration" << std::endl;
+
+		benchmarkFiles(options);
+		benchmarkModel(options);
+		benchmarkTexture(options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,10 @@
+@echo off
+rem Compares instanced draws with one draw per object for growing numbers of room copies.
+rem Run from this directory so the shaders, textures and models are found.
+set EXE=%1
+if "%EXE%"=="" set EXE=..\bin\Release-x64\HelloTriangle.exe
+
+for %%n in (1000 10000 100000 1000000) do (
+    %EXE% --copies %%n --frames 300
+    %EXE% --copies %%n --frames 300 --no-instancing
+)
@@ -0,0 +1,10 @@
+@echo off
+rem Compares frame time and rendered triangles with and without LOD selection.
+rem Run from this directory so the shaders, textures and models are found.
+set EXE=%1
+if "%EXE%"=="" set EXE=..\bin\Release-x64\HelloTriangle.exe
+
+for %%n in (10000 100000) do (
+    %EXE% --copies %%n --frames 300
+    %EXE% --copies %%n --frames 300 --no-lod
+)
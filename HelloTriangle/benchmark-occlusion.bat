@@ -0,0 +1,10 @@
+@echo off
+rem Compares frame time, draws and rendered triangles with and without Hi-Z occlusion culling.
+rem Run from this directory so the shaders, textures and models are found.
+set EXE=%1
+if "%EXE%"=="" set EXE=..\bin\Release-x64\HelloTriangle.exe
+
+for %%n in (10000 100000) do (
+    %EXE% --copies %%n --frames 300 --gpu-driven
+    %EXE% --copies %%n --frames 300 --occlusion
+)
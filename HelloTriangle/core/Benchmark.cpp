@@ -0,0 +1,166 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static int64_t nowNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string jsonString(const std::string& text)
+{
+	std::ostringstream out;
+	out << '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+		else
+			out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+// Nearest-rank percentile of sorted values.
+static double percentile(const std::vector<double>& sorted, double percent)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+	return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static void writeStats(std::ostream& out, const char* name, std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+
+	out << "  \"" << name << "\": { \"count\": " << values.size();
+	if (!values.empty()) {
+		out << ", \"mean\": " << sum / values.size()
+			<< ", \"min\": " << values.front()
+			<< ", \"p50\": " << percentile(values, 50.0)
+			<< ", \"p90\": " << percentile(values, 90.0)
+			<< ", \"p99\": " << percentile(values, 99.0)
+			<< ", \"max\": " << values.back();
+	}
+	out << " },\n";
+}
+
+void Benchmark::init(const Settings& settings)
+{
+	if (settings.measuredFrames == 0 || settings.timestep <= 0.0)
+		throw std::invalid_argument("Benchmark: needs measured frames and a positive timestep!");
+
+	m_settings = settings;
+	m_active = true;
+	m_frameMilliseconds.reserve(settings.measuredFrames);
+	m_cpuMilliseconds.reserve(settings.measuredFrames);
+	m_gpuMilliseconds.reserve(settings.measuredFrames);
+}
+
+void Benchmark::endFrame(double cpuMilliseconds)
+{
+	if (!m_active || finished())
+		return;
+
+	int64_t now = nowNanoseconds();
+
+	// The first measured frame's time runs from the end of the last warm-up frame.
+	if (measuring()) {
+		if (m_frame == m_settings.warmupFrames)
+			m_measureStart = m_lastFrameEnd != 0 ? m_lastFrameEnd : now;
+		if (m_lastFrameEnd != 0)
+			m_frameMilliseconds.push_back((now - m_lastFrameEnd) / 1e6);
+		m_cpuMilliseconds.push_back(cpuMilliseconds);
+		m_measureEnd = now;
+	}
+
+	m_lastFrameEnd = now;
+	m_frame++;
+}
+
+void Benchmark::addGpuTime(uint64_t frame, double gpuMilliseconds)
+{
+	if (m_active && frame >= m_settings.warmupFrames && frame < m_settings.warmupFrames + m_settings.measuredFrames)
+		m_gpuMilliseconds.push_back(gpuMilliseconds);
+}
+
+void Benchmark::setInfo(const std::string& key, const std::string& value)
+{
+	m_info.emplace_back(key, jsonString(value));
+}
+
+void Benchmark::setInfo(const std::string& key, double value)
+{
+	std::ostringstream out;
+	out << value;
+	m_info.emplace_back(key, out.str());
+}
+
+void Benchmark::writeSummary(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out)
+		throw std::runtime_error("failed to open " + path + " for writing!");
+
+	out << std::setprecision(6);
+	out << "{\n";
+	out << "  \"warmup_frames\": " << m_settings.warmupFrames << ",\n";
+	out << "  \"measured_frames\": " << m_cpuMilliseconds.size() << ",\n";
+	out << "  \"timestep\": " << m_settings.timestep << ",\n";
+	out << "  \"seconds\": " << (m_measureEnd - m_measureStart) / 1e9 << ",\n";
+
+	out << "  \"info\": {";
+	for (size_t i = 0; i < m_info.size(); i++)
+		out << (i > 0 ? ", " : " ") << jsonString(m_info[i].first) << ": " << m_info[i].second;
+	out << " },\n";
+
+	writeStats(out, "frame_ms", m_frameMilliseconds);
+	writeStats(out, "cpu_ms", m_cpuMilliseconds);
+	writeStats(out, "gpu_ms", m_gpuMilliseconds);
+
+	out << "  \"memory\": { \"host_peak_bytes\": " << peakHostMemoryBytes() << ", \"device_peak_bytes\": " << m_devicePeakBytes << " }\n";
+	out << "}\n";
+
+	if (!out)
+		throw std::runtime_error("failed to write " + path + "!");
+}
+
+uint64_t Benchmark::peakHostMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A benchmark run: a virtual clock that advances a fixed timestep per frame, so every run
+// animates through the same frames whatever the frame rate, and the timings of a window of
+// frames after a warm-up.
+//
+// Frame time is measured between endFrame() calls. CPU and GPU times are passed in by the
+// caller; GPU times arrive late, once each frame's fence has been waited on. writeSummary()
+// writes exact percentiles of all three, the peak host and device memory and caller-provided
+// info as JSON.
+class Benchmark
+{
+public:
+	struct Settings
+	{
+		uint32_t warmupFrames = 60;
+		uint32_t measuredFrames = 600;
+		double timestep = 1.0 / 60.0;	// virtual seconds per frame
+	};
+
+public:
+	Benchmark() = default;
+
+	void init(const Settings& settings);
+	bool active() const { return m_active; }
+
+	// Virtual time and number of the frame being recorded.
+	double time() const { return m_frame * m_settings.timestep; }
+	uint64_t frame() const { return m_frame; }
+
+	bool measuring() const { return m_frame >= m_settings.warmupFrames; }
+	bool finished() const { return m_frame >= m_settings.warmupFrames + m_settings.measuredFrames; }
+
+	// Ends the frame being recorded. cpuMilliseconds is the time the render thread spent on it.
+	void endFrame(double cpuMilliseconds);
+	void addGpuTime(uint64_t frame, double gpuMilliseconds);
+
+	// Extra fields for the summary's "info" object, e.g. the scene and device.
+	void setInfo(const std::string& key, const std::string& value);
+	void setInfo(const std::string& key, double value);
+
+	// Peak device memory allocated, which only the caller knows.
+	void setDevicePeakBytes(uint64_t bytes) { m_devicePeakBytes = bytes; }
+
+	// Throws if path can't be written.
+	void writeSummary(const std::string& path) const;
+
+	// Peak resident set of the process, 0 where unknown.
+	static uint64_t peakHostMemoryBytes();
+
+private:
+	Settings m_settings;
+	bool m_active = false;
+	uint64_t m_frame = 0;
+	int64_t m_lastFrameEnd = 0;
+	int64_t m_measureStart = 0;
+	int64_t m_measureEnd = 0;
+
+	std::vector<double> m_frameMilliseconds;
+	std::vector<double> m_cpuMilliseconds;
+	std::vector<double> m_gpuMilliseconds;
+
+	std::vector<std::pair<std::string, std::string>> m_info;	// values already as JSON
+	uint64_t m_devicePeakBytes = 0;
+};
@@ -0,0 +1,1360 @@
+#include "CallCapture.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+static CallCapture* s_active = nullptr;
+
+// Dispatchable handles are pointers; the others are too on 64-bit builds and uint64_t on 32-bit.
+template <typename T>
+static uint64_t handleBits(T handle)
+{
+	if constexpr (std::is_pointer<T>::value)
+		return reinterpret_cast<uintptr_t>(handle);
+	else
+		return handle;
+}
+
+// Each wrapper encodes its call in the order CallTrace's signature for it lists the values:
+// inputs, then the call is made, then its outputs and result.
+struct CallCapture::Wrappers
+{
+	// Holds the capture's lock from the call's first value to its last, so calls from several
+	// threads don't interleave.
+	struct Recording
+	{
+		CallCapture& capture;
+		std::lock_guard<std::mutex> lock;
+		CallWriter& writer;
+		const DeviceDispatch& next;
+
+		explicit Recording(ApiCall call)
+			: capture(*s_active), lock(capture.m_mutex), writer(capture.m_writer), next(capture.m_next)
+		{
+			writer.begin(call);
+		}
+
+		~Recording()
+		{
+			writer.end();
+		}
+
+		Recording(const Recording&) = delete;
+		Recording& operator=(const Recording&) = delete;
+
+		template <typename T>
+		void handle(T value) { writer.handle(handleBits(value)); }
+
+		// What a create call returned; undefined unless it succeeded.
+		template <typename T>
+		void created(VkResult result, T value) { writer.handle(result == VK_SUCCESS ? handleBits(value) : 0); }
+
+		void result(VkResult value) { writer.i32(value); }
+	};
+
+	// Queues and synchronization
+
+	static VKAPI_ATTR void VKAPI_CALL destroyDevice(VkDevice device, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyDevice);
+		call.handle(device);
+		call.next.destroyDevice(device, allocator);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL getDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue* queue)
+	{
+		Recording call(ApiCall::GetDeviceQueue);
+		call.handle(device);
+		call.writer.u32(queueFamilyIndex);
+		call.writer.u32(queueIndex);
+		call.next.getDeviceQueue(device, queueFamilyIndex, queueIndex, queue);
+		call.handle(*queue);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL deviceWaitIdle(VkDevice device)
+	{
+		Recording call(ApiCall::DeviceWaitIdle);
+		call.handle(device);
+		VkResult result = call.next.deviceWaitIdle(device);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+	{
+		Recording call(ApiCall::QueueSubmit);
+		call.handle(queue);
+		call.writer.count(submitCount);
+		for (uint32_t i = 0; i < submitCount; i++) {
+			const VkSubmitInfo& submit = submits[i];
+			call.writer.count(submit.waitSemaphoreCount);
+			for (uint32_t j = 0; j < submit.waitSemaphoreCount; j++) {
+				call.handle(submit.pWaitSemaphores[j]);
+				call.writer.u32(submit.pWaitDstStageMask[j]);
+			}
+			call.writer.count(submit.commandBufferCount);
+			for (uint32_t j = 0; j < submit.commandBufferCount; j++)
+				call.handle(submit.pCommandBuffers[j]);
+			call.writer.count(submit.signalSemaphoreCount);
+			for (uint32_t j = 0; j < submit.signalSemaphoreCount; j++)
+				call.handle(submit.pSignalSemaphores[j]);
+		}
+		call.handle(fence);
+		VkResult result = call.next.queueSubmit(queue, submitCount, submits, fence);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL queueWaitIdle(VkQueue queue)
+	{
+		Recording call(ApiCall::QueueWaitIdle);
+		call.handle(queue);
+		VkResult result = call.next.queueWaitIdle(queue);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createFence(VkDevice device, const VkFenceCreateInfo* info, const VkAllocationCallbacks* allocator, VkFence* fence)
+	{
+		Recording call(ApiCall::CreateFence);
+		call.handle(device);
+		call.writer.u32(info->flags);
+		VkResult result = call.next.createFence(device, info, allocator, fence);
+		call.created(result, *fence);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyFence);
+		call.handle(device);
+		call.handle(fence);
+		call.next.destroyFence(device, fence, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL waitForFences(VkDevice device, uint32_t fenceCount, const VkFence* fences, VkBool32 waitAll, uint64_t timeout)
+	{
+		Recording call(ApiCall::WaitForFences);
+		call.handle(device);
+		call.writer.count(fenceCount);
+		for (uint32_t i = 0; i < fenceCount; i++)
+			call.handle(fences[i]);
+		call.writer.u32(waitAll);
+		call.writer.u64(timeout);
+		VkResult result = call.next.waitForFences(device, fenceCount, fences, waitAll, timeout);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL resetFences(VkDevice device, uint32_t fenceCount, const VkFence* fences)
+	{
+		Recording call(ApiCall::ResetFences);
+		call.handle(device);
+		call.writer.count(fenceCount);
+		for (uint32_t i = 0; i < fenceCount; i++)
+			call.handle(fences[i]);
+		VkResult result = call.next.resetFences(device, fenceCount, fences);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createSemaphore(VkDevice device, const VkSemaphoreCreateInfo* info, const VkAllocationCallbacks* allocator, VkSemaphore* semaphore)
+	{
+		Recording call(ApiCall::CreateSemaphore);
+		call.handle(device);
+		VkResult result = call.next.createSemaphore(device, info, allocator, semaphore);
+		call.created(result, *semaphore);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroySemaphore);
+		call.handle(device);
+		call.handle(semaphore);
+		call.next.destroySemaphore(device, semaphore, allocator);
+	}
+
+	// Memory and resources
+
+	static VKAPI_ATTR VkResult VKAPI_CALL allocateMemory(VkDevice device, const VkMemoryAllocateInfo* info, const VkAllocationCallbacks* allocator, VkDeviceMemory* memory)
+	{
+		Recording call(ApiCall::AllocateMemory);
+		call.handle(device);
+		call.writer.u64(info->allocationSize);
+		call.writer.u32(info->memoryTypeIndex);
+		VkResult result = call.next.allocateMemory(device, info, allocator, memory);
+		call.created(result, *memory);
+		call.result(result);
+		if (result == VK_SUCCESS)
+			call.capture.m_allocationSizes[handleBits(*memory)] = info->allocationSize;
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL freeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::FreeMemory);
+		call.handle(device);
+		call.handle(memory);
+		call.capture.m_allocationSizes.erase(handleBits(memory));
+		call.capture.m_mappings.erase(handleBits(memory));
+		call.next.freeMemory(device, memory, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL mapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** data)
+	{
+		Recording call(ApiCall::MapMemory);
+		call.handle(device);
+		call.handle(memory);
+		call.writer.u64(offset);
+		call.writer.u64(size);
+		call.writer.u32(flags);
+		VkResult result = call.next.mapMemory(device, memory, offset, size, flags, data);
+		call.result(result);
+
+		if (result == VK_SUCCESS) {
+			if (size == VK_WHOLE_SIZE) {
+				auto allocation = call.capture.m_allocationSizes.find(handleBits(memory));
+				size = allocation != call.capture.m_allocationSizes.end() ? allocation->second - offset : 0;
+			}
+			call.capture.m_mappings[handleBits(memory)] = Mapping{ *data, size };
+		}
+		return result;
+	}
+
+	// Records what the host wrote while the memory was mapped: for staging buffers, the data the
+	// upload copies to the GPU.
+	static VKAPI_ATTR void VKAPI_CALL unmapMemory(VkDevice device, VkDeviceMemory memory)
+	{
+		Recording call(ApiCall::UnmapMemory);
+		call.handle(device);
+		call.handle(memory);
+		auto mapping = call.capture.m_mappings.find(handleBits(memory));
+		if (mapping != call.capture.m_mappings.end()) {
+			call.writer.bytes(mapping->second.data, static_cast<size_t>(mapping->second.size));
+			call.capture.m_mappings.erase(mapping);
+		}
+		else {
+			call.writer.bytes(nullptr, 0);
+		}
+		call.next.unmapMemory(device, memory);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createBuffer(VkDevice device, const VkBufferCreateInfo* info, const VkAllocationCallbacks* allocator, VkBuffer* buffer)
+	{
+		Recording call(ApiCall::CreateBuffer);
+		call.handle(device);
+		call.writer.u32(info->flags);
+		call.writer.u64(info->size);
+		call.writer.u32(info->usage);
+		call.writer.u32(info->sharingMode);
+		VkResult result = call.next.createBuffer(device, info, allocator, buffer);
+		call.created(result, *buffer);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyBuffer);
+		call.handle(device);
+		call.handle(buffer);
+		call.next.destroyBuffer(device, buffer, allocator);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL getBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements* requirements)
+	{
+		Recording call(ApiCall::GetBufferMemoryRequirements);
+		call.handle(device);
+		call.handle(buffer);
+		call.next.getBufferMemoryRequirements(device, buffer, requirements);
+		call.writer.u64(requirements->size);
+		call.writer.u64(requirements->alignment);
+		call.writer.u32(requirements->memoryTypeBits);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL bindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+	{
+		Recording call(ApiCall::BindBufferMemory);
+		call.handle(device);
+		call.handle(buffer);
+		call.handle(memory);
+		call.writer.u64(memoryOffset);
+		VkResult result = call.next.bindBufferMemory(device, buffer, memory, memoryOffset);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createImage(VkDevice device, const VkImageCreateInfo* info, const VkAllocationCallbacks* allocator, VkImage* image)
+	{
+		Recording call(ApiCall::CreateImage);
+		call.handle(device);
+		call.writer.u32(info->flags);
+		call.writer.u32(info->imageType);
+		call.writer.u32(info->format);
+		call.writer.u32(info->extent.width);
+		call.writer.u32(info->extent.height);
+		call.writer.u32(info->extent.depth);
+		call.writer.u32(info->mipLevels);
+		call.writer.u32(info->arrayLayers);
+		call.writer.u32(info->samples);
+		call.writer.u32(info->tiling);
+		call.writer.u32(info->usage);
+		call.writer.u32(info->initialLayout);
+		VkResult result = call.next.createImage(device, info, allocator, image);
+		call.created(result, *image);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyImage);
+		call.handle(device);
+		call.handle(image);
+		call.next.destroyImage(device, image, allocator);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL getImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements* requirements)
+	{
+		Recording call(ApiCall::GetImageMemoryRequirements);
+		call.handle(device);
+		call.handle(image);
+		call.next.getImageMemoryRequirements(device, image, requirements);
+		call.writer.u64(requirements->size);
+		call.writer.u64(requirements->alignment);
+		call.writer.u32(requirements->memoryTypeBits);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL bindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+	{
+		Recording call(ApiCall::BindImageMemory);
+		call.handle(device);
+		call.handle(image);
+		call.handle(memory);
+		call.writer.u64(memoryOffset);
+		VkResult result = call.next.bindImageMemory(device, image, memory, memoryOffset);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createImageView(VkDevice device, const VkImageViewCreateInfo* info, const VkAllocationCallbacks* allocator, VkImageView* view)
+	{
+		Recording call(ApiCall::CreateImageView);
+		call.handle(device);
+		call.handle(info->image);
+		call.writer.u32(info->viewType);
+		call.writer.u32(info->format);
+		call.writer.u32(info->subresourceRange.aspectMask);
+		call.writer.u32(info->subresourceRange.baseMipLevel);
+		call.writer.u32(info->subresourceRange.levelCount);
+		call.writer.u32(info->subresourceRange.baseArrayLayer);
+		call.writer.u32(info->subresourceRange.layerCount);
+		VkResult result = call.next.createImageView(device, info, allocator, view);
+		call.created(result, *view);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyImageView(VkDevice device, VkImageView view, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyImageView);
+		call.handle(device);
+		call.handle(view);
+		call.next.destroyImageView(device, view, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createSampler(VkDevice device, const VkSamplerCreateInfo* info, const VkAllocationCallbacks* allocator, VkSampler* sampler)
+	{
+		Recording call(ApiCall::CreateSampler);
+		call.handle(device);
+		call.writer.u32(info->magFilter);
+		call.writer.u32(info->minFilter);
+		call.writer.u32(info->mipmapMode);
+		call.writer.u32(info->addressModeU);
+		call.writer.u32(info->addressModeV);
+		call.writer.u32(info->addressModeW);
+		call.writer.u32(info->anisotropyEnable);
+		call.writer.f32(info->maxAnisotropy);
+		call.writer.u32(info->compareEnable);
+		call.writer.u32(info->compareOp);
+		call.writer.f32(info->minLod);
+		call.writer.f32(info->maxLod);
+		VkResult result = call.next.createSampler(device, info, allocator, sampler);
+		call.created(result, *sampler);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroySampler);
+		call.handle(device);
+		call.handle(sampler);
+		call.next.destroySampler(device, sampler, allocator);
+	}
+
+	// Pipelines and descriptors
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createShaderModule(VkDevice device, const VkShaderModuleCreateInfo* info, const VkAllocationCallbacks* allocator, VkShaderModule* module)
+	{
+		Recording call(ApiCall::CreateShaderModule);
+		call.handle(device);
+		call.writer.bytes(info->pCode, info->codeSize);
+		VkResult result = call.next.createShaderModule(device, info, allocator, module);
+		call.created(result, *module);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyShaderModule(VkDevice device, VkShaderModule module, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyShaderModule);
+		call.handle(device);
+		call.handle(module);
+		call.next.destroyShaderModule(device, module, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createRenderPass(VkDevice device, const VkRenderPassCreateInfo* info, const VkAllocationCallbacks* allocator, VkRenderPass* renderPass)
+	{
+		Recording call(ApiCall::CreateRenderPass);
+		call.handle(device);
+		call.writer.count(info->attachmentCount);
+		for (uint32_t i = 0; i < info->attachmentCount; i++) {
+			const VkAttachmentDescription& attachment = info->pAttachments[i];
+			call.writer.u32(attachment.format);
+			call.writer.u32(attachment.samples);
+			call.writer.u32(attachment.loadOp);
+			call.writer.u32(attachment.storeOp);
+			call.writer.u32(attachment.initialLayout);
+			call.writer.u32(attachment.finalLayout);
+		}
+		call.writer.count(info->subpassCount);
+		for (uint32_t i = 0; i < info->subpassCount; i++) {
+			const VkSubpassDescription& subpass = info->pSubpasses[i];
+			call.writer.count(subpass.colorAttachmentCount);
+			for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++)
+				call.writer.u32(subpass.pColorAttachments[j].attachment);
+			call.writer.i32(subpass.pDepthStencilAttachment ? static_cast<int32_t>(subpass.pDepthStencilAttachment->attachment) : -1);
+		}
+		call.writer.u32(info->dependencyCount);
+		VkResult result = call.next.createRenderPass(device, info, allocator, renderPass);
+		call.created(result, *renderPass);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyRenderPass);
+		call.handle(device);
+		call.handle(renderPass);
+		call.next.destroyRenderPass(device, renderPass, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createFramebuffer(VkDevice device, const VkFramebufferCreateInfo* info, const VkAllocationCallbacks* allocator, VkFramebuffer* framebuffer)
+	{
+		Recording call(ApiCall::CreateFramebuffer);
+		call.handle(device);
+		call.handle(info->renderPass);
+		call.writer.count(info->attachmentCount);
+		for (uint32_t i = 0; i < info->attachmentCount; i++)
+			call.handle(info->pAttachments[i]);
+		call.writer.u32(info->width);
+		call.writer.u32(info->height);
+		call.writer.u32(info->layers);
+		VkResult result = call.next.createFramebuffer(device, info, allocator, framebuffer);
+		call.created(result, *framebuffer);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyFramebuffer);
+		call.handle(device);
+		call.handle(framebuffer);
+		call.next.destroyFramebuffer(device, framebuffer, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* info, const VkAllocationCallbacks* allocator, VkPipelineLayout* layout)
+	{
+		Recording call(ApiCall::CreatePipelineLayout);
+		call.handle(device);
+		call.writer.count(info->setLayoutCount);
+		for (uint32_t i = 0; i < info->setLayoutCount; i++)
+			call.handle(info->pSetLayouts[i]);
+		call.writer.count(info->pushConstantRangeCount);
+		for (uint32_t i = 0; i < info->pushConstantRangeCount; i++) {
+			call.writer.u32(info->pPushConstantRanges[i].stageFlags);
+			call.writer.u32(info->pPushConstantRanges[i].offset);
+			call.writer.u32(info->pPushConstantRanges[i].size);
+		}
+		VkResult result = call.next.createPipelineLayout(device, info, allocator, layout);
+		call.created(result, *layout);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyPipelineLayout(VkDevice device, VkPipelineLayout layout, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyPipelineLayout);
+		call.handle(device);
+		call.handle(layout);
+		call.next.destroyPipelineLayout(device, layout, allocator);
+	}
+
+	// Only what identifies the pipeline is recorded: the shaders and where it's used. The fixed
+	// function state comes from one place in the renderer and is the same for every pipeline.
+	static VKAPI_ATTR VkResult VKAPI_CALL createGraphicsPipelines(VkDevice device, VkPipelineCache cache, uint32_t count, const VkGraphicsPipelineCreateInfo* infos,
+		const VkAllocationCallbacks* allocator, VkPipeline* pipelines)
+	{
+		Recording call(ApiCall::CreateGraphicsPipelines);
+		call.handle(device);
+		call.handle(cache);
+		VkResult result = call.next.createGraphicsPipelines(device, cache, count, infos, allocator, pipelines);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++) {
+			const VkGraphicsPipelineCreateInfo& info = infos[i];
+			call.writer.count(info.stageCount);
+			for (uint32_t j = 0; j < info.stageCount; j++) {
+				call.writer.u32(info.pStages[j].stage);
+				call.handle(info.pStages[j].module);
+				call.writer.string(info.pStages[j].pName);
+			}
+			call.handle(info.layout);
+			call.handle(info.renderPass);
+			call.writer.u32(info.subpass);
+			call.created(result, pipelines[i]);
+		}
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createComputePipelines(VkDevice device, VkPipelineCache cache, uint32_t count, const VkComputePipelineCreateInfo* infos,
+		const VkAllocationCallbacks* allocator, VkPipeline* pipelines)
+	{
+		Recording call(ApiCall::CreateComputePipelines);
+		call.handle(device);
+		call.handle(cache);
+		VkResult result = call.next.createComputePipelines(device, cache, count, infos, allocator, pipelines);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++) {
+			call.writer.u32(infos[i].stage.stage);
+			call.handle(infos[i].stage.module);
+			call.writer.string(infos[i].stage.pName);
+			call.handle(infos[i].layout);
+			call.created(result, pipelines[i]);
+		}
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyPipeline);
+		call.handle(device);
+		call.handle(pipeline);
+		call.next.destroyPipeline(device, pipeline, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* info, const VkAllocationCallbacks* allocator,
+		VkDescriptorSetLayout* layout)
+	{
+		Recording call(ApiCall::CreateDescriptorSetLayout);
+		call.handle(device);
+		call.writer.count(info->bindingCount);
+		for (uint32_t i = 0; i < info->bindingCount; i++) {
+			const VkDescriptorSetLayoutBinding& binding = info->pBindings[i];
+			call.writer.u32(binding.binding);
+			call.writer.u32(binding.descriptorType);
+			call.writer.u32(binding.descriptorCount);
+			call.writer.u32(binding.stageFlags);
+		}
+		VkResult result = call.next.createDescriptorSetLayout(device, info, allocator, layout);
+		call.created(result, *layout);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout layout, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyDescriptorSetLayout);
+		call.handle(device);
+		call.handle(layout);
+		call.next.destroyDescriptorSetLayout(device, layout, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* info, const VkAllocationCallbacks* allocator, VkDescriptorPool* pool)
+	{
+		Recording call(ApiCall::CreateDescriptorPool);
+		call.handle(device);
+		call.writer.u32(info->flags);
+		call.writer.u32(info->maxSets);
+		call.writer.count(info->poolSizeCount);
+		for (uint32_t i = 0; i < info->poolSizeCount; i++) {
+			call.writer.u32(info->pPoolSizes[i].type);
+			call.writer.u32(info->pPoolSizes[i].descriptorCount);
+		}
+		VkResult result = call.next.createDescriptorPool(device, info, allocator, pool);
+		call.created(result, *pool);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyDescriptorPool(VkDevice device, VkDescriptorPool pool, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyDescriptorPool);
+		call.handle(device);
+		call.handle(pool);
+		call.next.destroyDescriptorPool(device, pool, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL allocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* info, VkDescriptorSet* sets)
+	{
+		Recording call(ApiCall::AllocateDescriptorSets);
+		call.handle(device);
+		call.handle(info->descriptorPool);
+		call.writer.count(info->descriptorSetCount);
+		for (uint32_t i = 0; i < info->descriptorSetCount; i++)
+			call.handle(info->pSetLayouts[i]);
+		VkResult result = call.next.allocateDescriptorSets(device, info, sets);
+		call.writer.count(info->descriptorSetCount);
+		for (uint32_t i = 0; i < info->descriptorSetCount; i++)
+			call.created(result, sets[i]);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL updateDescriptorSets(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet* writes, uint32_t copyCount,
+		const VkCopyDescriptorSet* copies)
+	{
+		Recording call(ApiCall::UpdateDescriptorSets);
+		call.handle(device);
+		call.writer.count(writeCount);
+		for (uint32_t i = 0; i < writeCount; i++) {
+			const VkWriteDescriptorSet& write = writes[i];
+			call.handle(write.dstSet);
+			call.writer.u32(write.dstBinding);
+			call.writer.u32(write.dstArrayElement);
+			call.writer.u32(write.descriptorType);
+
+			uint32_t imageCount = write.pImageInfo ? write.descriptorCount : 0;
+			call.writer.count(imageCount);
+			for (uint32_t j = 0; j < imageCount; j++) {
+				call.handle(write.pImageInfo[j].sampler);
+				call.handle(write.pImageInfo[j].imageView);
+				call.writer.u32(write.pImageInfo[j].imageLayout);
+			}
+
+			uint32_t bufferCount = write.pBufferInfo ? write.descriptorCount : 0;
+			call.writer.count(bufferCount);
+			for (uint32_t j = 0; j < bufferCount; j++) {
+				call.handle(write.pBufferInfo[j].buffer);
+				call.writer.u64(write.pBufferInfo[j].offset);
+				call.writer.u64(write.pBufferInfo[j].range);
+			}
+		}
+		call.writer.count(copyCount);
+		for (uint32_t i = 0; i < copyCount; i++) {
+			call.handle(copies[i].srcSet);
+			call.writer.u32(copies[i].srcBinding);
+			call.handle(copies[i].dstSet);
+			call.writer.u32(copies[i].dstBinding);
+			call.writer.u32(copies[i].descriptorCount);
+		}
+		call.next.updateDescriptorSets(device, writeCount, writes, copyCount, copies);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createQueryPool(VkDevice device, const VkQueryPoolCreateInfo* info, const VkAllocationCallbacks* allocator, VkQueryPool* pool)
+	{
+		Recording call(ApiCall::CreateQueryPool);
+		call.handle(device);
+		call.writer.u32(info->queryType);
+		call.writer.u32(info->queryCount);
+		call.writer.u32(info->pipelineStatistics);
+		VkResult result = call.next.createQueryPool(device, info, allocator, pool);
+		call.created(result, *pool);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyQueryPool(VkDevice device, VkQueryPool pool, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyQueryPool);
+		call.handle(device);
+		call.handle(pool);
+		call.next.destroyQueryPool(device, pool, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL getQueryPoolResults(VkDevice device, VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount, size_t dataSize, void* data,
+		VkDeviceSize stride, VkQueryResultFlags flags)
+	{
+		Recording call(ApiCall::GetQueryPoolResults);
+		call.handle(device);
+		call.handle(pool);
+		call.writer.u32(firstQuery);
+		call.writer.u32(queryCount);
+		call.writer.u64(dataSize);
+		call.writer.u64(stride);
+		call.writer.u32(flags);
+		VkResult result = call.next.getQueryPoolResults(device, pool, firstQuery, queryCount, dataSize, data, stride, flags);
+		call.result(result);
+		return result;
+	}
+
+	// Command buffers
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createCommandPool(VkDevice device, const VkCommandPoolCreateInfo* info, const VkAllocationCallbacks* allocator, VkCommandPool* pool)
+	{
+		Recording call(ApiCall::CreateCommandPool);
+		call.handle(device);
+		call.writer.u32(info->flags);
+		call.writer.u32(info->queueFamilyIndex);
+		VkResult result = call.next.createCommandPool(device, info, allocator, pool);
+		call.created(result, *pool);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroyCommandPool(VkDevice device, VkCommandPool pool, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroyCommandPool);
+		call.handle(device);
+		call.handle(pool);
+		call.next.destroyCommandPool(device, pool, allocator);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL resetCommandPool(VkDevice device, VkCommandPool pool, VkCommandPoolResetFlags flags)
+	{
+		Recording call(ApiCall::ResetCommandPool);
+		call.handle(device);
+		call.handle(pool);
+		call.writer.u32(flags);
+		VkResult result = call.next.resetCommandPool(device, pool, flags);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL allocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* info, VkCommandBuffer* commandBuffers)
+	{
+		Recording call(ApiCall::AllocateCommandBuffers);
+		call.handle(device);
+		call.handle(info->commandPool);
+		call.writer.u32(info->level);
+		VkResult result = call.next.allocateCommandBuffers(device, info, commandBuffers);
+		call.writer.count(info->commandBufferCount);
+		for (uint32_t i = 0; i < info->commandBufferCount; i++)
+			call.created(result, commandBuffers[i]);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL freeCommandBuffers(VkDevice device, VkCommandPool pool, uint32_t count, const VkCommandBuffer* commandBuffers)
+	{
+		Recording call(ApiCall::FreeCommandBuffers);
+		call.handle(device);
+		call.handle(pool);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++)
+			call.handle(commandBuffers[i]);
+		call.next.freeCommandBuffers(device, pool, count, commandBuffers);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL beginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* info)
+	{
+		Recording call(ApiCall::BeginCommandBuffer);
+		call.handle(commandBuffer);
+		call.writer.u32(info->flags);
+		VkResult result = call.next.beginCommandBuffer(commandBuffer, info);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL endCommandBuffer(VkCommandBuffer commandBuffer)
+	{
+		Recording call(ApiCall::EndCommandBuffer);
+		call.handle(commandBuffer);
+		VkResult result = call.next.endCommandBuffer(commandBuffer);
+		call.result(result);
+		return result;
+	}
+
+	// Clear values are recorded as four floats; for depth and stencil that is the depth and the
+	// stencil value's bits.
+	static VKAPI_ATTR void VKAPI_CALL cmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* info, VkSubpassContents contents)
+	{
+		Recording call(ApiCall::CmdBeginRenderPass);
+		call.handle(commandBuffer);
+		call.handle(info->renderPass);
+		call.handle(info->framebuffer);
+		call.writer.i32(info->renderArea.offset.x);
+		call.writer.i32(info->renderArea.offset.y);
+		call.writer.u32(info->renderArea.extent.width);
+		call.writer.u32(info->renderArea.extent.height);
+		call.writer.count(info->clearValueCount);
+		for (uint32_t i = 0; i < info->clearValueCount; i++) {
+			for (float value : info->pClearValues[i].color.float32)
+				call.writer.f32(value);
+		}
+		call.writer.u32(contents);
+		call.next.cmdBeginRenderPass(commandBuffer, info, contents);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdEndRenderPass(VkCommandBuffer commandBuffer)
+	{
+		Recording call(ApiCall::CmdEndRenderPass);
+		call.handle(commandBuffer);
+		call.next.cmdEndRenderPass(commandBuffer);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+	{
+		Recording call(ApiCall::CmdBindPipeline);
+		call.handle(commandBuffer);
+		call.writer.u32(bindPoint);
+		call.handle(pipeline);
+		call.next.cmdBindPipeline(commandBuffer, bindPoint, pipeline);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdSetViewport(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, const VkViewport* viewports)
+	{
+		Recording call(ApiCall::CmdSetViewport);
+		call.handle(commandBuffer);
+		call.writer.u32(first);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++) {
+			call.writer.f32(viewports[i].x);
+			call.writer.f32(viewports[i].y);
+			call.writer.f32(viewports[i].width);
+			call.writer.f32(viewports[i].height);
+			call.writer.f32(viewports[i].minDepth);
+			call.writer.f32(viewports[i].maxDepth);
+		}
+		call.next.cmdSetViewport(commandBuffer, first, count, viewports);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdSetScissor(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, const VkRect2D* scissors)
+	{
+		Recording call(ApiCall::CmdSetScissor);
+		call.handle(commandBuffer);
+		call.writer.u32(first);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++) {
+			call.writer.i32(scissors[i].offset.x);
+			call.writer.i32(scissors[i].offset.y);
+			call.writer.u32(scissors[i].extent.width);
+			call.writer.u32(scissors[i].extent.height);
+		}
+		call.next.cmdSetScissor(commandBuffer, first, count, scissors);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+		uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+	{
+		Recording call(ApiCall::CmdBindDescriptorSets);
+		call.handle(commandBuffer);
+		call.writer.u32(bindPoint);
+		call.handle(layout);
+		call.writer.u32(firstSet);
+		call.writer.count(setCount);
+		for (uint32_t i = 0; i < setCount; i++)
+			call.handle(sets[i]);
+		call.writer.count(dynamicOffsetCount);
+		for (uint32_t i = 0; i < dynamicOffsetCount; i++)
+			call.writer.u32(dynamicOffsets[i]);
+		call.next.cmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, const VkBuffer* buffers, const VkDeviceSize* offsets)
+	{
+		Recording call(ApiCall::CmdBindVertexBuffers);
+		call.handle(commandBuffer);
+		call.writer.u32(first);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++) {
+			call.handle(buffers[i]);
+			call.writer.u64(offsets[i]);
+		}
+		call.next.cmdBindVertexBuffers(commandBuffer, first, count, buffers, offsets);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+	{
+		Recording call(ApiCall::CmdBindIndexBuffer);
+		call.handle(commandBuffer);
+		call.handle(buffer);
+		call.writer.u64(offset);
+		call.writer.u32(indexType);
+		call.next.cmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size,
+		const void* values)
+	{
+		Recording call(ApiCall::CmdPushConstants);
+		call.handle(commandBuffer);
+		call.handle(layout);
+		call.writer.u32(stageFlags);
+		call.writer.u32(offset);
+		call.writer.bytes(values, size);
+		call.next.cmdPushConstants(commandBuffer, layout, stageFlags, offset, size, values);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+		uint32_t firstInstance)
+	{
+		Recording call(ApiCall::CmdDrawIndexed);
+		call.handle(commandBuffer);
+		call.writer.u32(indexCount);
+		call.writer.u32(instanceCount);
+		call.writer.u32(firstIndex);
+		call.writer.i32(vertexOffset);
+		call.writer.u32(firstInstance);
+		call.next.cmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+	{
+		Recording call(ApiCall::CmdDrawIndexedIndirect);
+		call.handle(commandBuffer);
+		call.handle(buffer);
+		call.writer.u64(offset);
+		call.writer.u32(drawCount);
+		call.writer.u32(stride);
+		call.next.cmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+	{
+		Recording call(ApiCall::CmdDispatch);
+		call.handle(commandBuffer);
+		call.writer.u32(groupCountX);
+		call.writer.u32(groupCountY);
+		call.writer.u32(groupCountZ);
+		call.next.cmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+		VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers, uint32_t bufferBarrierCount,
+		const VkBufferMemoryBarrier* bufferBarriers, uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers)
+	{
+		Recording call(ApiCall::CmdPipelineBarrier);
+		call.handle(commandBuffer);
+		call.writer.u32(srcStageMask);
+		call.writer.u32(dstStageMask);
+		call.writer.u32(dependencyFlags);
+		call.writer.count(memoryBarrierCount);
+		for (uint32_t i = 0; i < memoryBarrierCount; i++) {
+			call.writer.u32(memoryBarriers[i].srcAccessMask);
+			call.writer.u32(memoryBarriers[i].dstAccessMask);
+		}
+		call.writer.count(bufferBarrierCount);
+		for (uint32_t i = 0; i < bufferBarrierCount; i++) {
+			const VkBufferMemoryBarrier& barrier = bufferBarriers[i];
+			call.writer.u32(barrier.srcAccessMask);
+			call.writer.u32(barrier.dstAccessMask);
+			call.handle(barrier.buffer);
+			call.writer.u64(barrier.offset);
+			call.writer.u64(barrier.size);
+		}
+		call.writer.count(imageBarrierCount);
+		for (uint32_t i = 0; i < imageBarrierCount; i++) {
+			const VkImageMemoryBarrier& barrier = imageBarriers[i];
+			call.writer.u32(barrier.srcAccessMask);
+			call.writer.u32(barrier.dstAccessMask);
+			call.writer.u32(barrier.oldLayout);
+			call.writer.u32(barrier.newLayout);
+			call.handle(barrier.image);
+			call.writer.u32(barrier.subresourceRange.aspectMask);
+			call.writer.u32(barrier.subresourceRange.baseMipLevel);
+			call.writer.u32(barrier.subresourceRange.levelCount);
+			call.writer.u32(barrier.subresourceRange.baseArrayLayer);
+			call.writer.u32(barrier.subresourceRange.layerCount);
+		}
+		call.next.cmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, memoryBarriers, bufferBarrierCount, bufferBarriers,
+			imageBarrierCount, imageBarriers);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data)
+	{
+		Recording call(ApiCall::CmdFillBuffer);
+		call.handle(commandBuffer);
+		call.handle(buffer);
+		call.writer.u64(offset);
+		call.writer.u64(size);
+		call.writer.u32(data);
+		call.next.cmdFillBuffer(commandBuffer, buffer, offset, size, data);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* regions)
+	{
+		Recording call(ApiCall::CmdCopyBuffer);
+		call.handle(commandBuffer);
+		call.handle(srcBuffer);
+		call.handle(dstBuffer);
+		call.writer.count(regionCount);
+		for (uint32_t i = 0; i < regionCount; i++) {
+			call.writer.u64(regions[i].srcOffset);
+			call.writer.u64(regions[i].dstOffset);
+			call.writer.u64(regions[i].size);
+		}
+		call.next.cmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, regions);
+	}
+
+	static void writeBufferImageCopies(Recording& call, uint32_t regionCount, const VkBufferImageCopy* regions)
+	{
+		call.writer.count(regionCount);
+		for (uint32_t i = 0; i < regionCount; i++) {
+			const VkBufferImageCopy& region = regions[i];
+			call.writer.u64(region.bufferOffset);
+			call.writer.u32(region.bufferRowLength);
+			call.writer.u32(region.bufferImageHeight);
+			call.writer.u32(region.imageSubresource.aspectMask);
+			call.writer.u32(region.imageSubresource.mipLevel);
+			call.writer.u32(region.imageSubresource.baseArrayLayer);
+			call.writer.u32(region.imageSubresource.layerCount);
+			call.writer.i32(region.imageOffset.x);
+			call.writer.i32(region.imageOffset.y);
+			call.writer.i32(region.imageOffset.z);
+			call.writer.u32(region.imageExtent.width);
+			call.writer.u32(region.imageExtent.height);
+			call.writer.u32(region.imageExtent.depth);
+		}
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout,
+		uint32_t regionCount, const VkBufferImageCopy* regions)
+	{
+		Recording call(ApiCall::CmdCopyBufferToImage);
+		call.handle(commandBuffer);
+		call.handle(srcBuffer);
+		call.handle(dstImage);
+		call.writer.u32(dstImageLayout);
+		writeBufferImageCopies(call, regionCount, regions);
+		call.next.cmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, regions);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer,
+		uint32_t regionCount, const VkBufferImageCopy* regions)
+	{
+		Recording call(ApiCall::CmdCopyImageToBuffer);
+		call.handle(commandBuffer);
+		call.handle(srcImage);
+		call.writer.u32(srcImageLayout);
+		call.handle(dstBuffer);
+		writeBufferImageCopies(call, regionCount, regions);
+		call.next.cmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, regions);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage,
+		VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageBlit* regions, VkFilter filter)
+	{
+		Recording call(ApiCall::CmdBlitImage);
+		call.handle(commandBuffer);
+		call.handle(srcImage);
+		call.writer.u32(srcImageLayout);
+		call.handle(dstImage);
+		call.writer.u32(dstImageLayout);
+		call.writer.count(regionCount);
+		for (uint32_t i = 0; i < regionCount; i++) {
+			const VkImageBlit& region = regions[i];
+			call.writer.u32(region.srcSubresource.aspectMask);
+			call.writer.u32(region.srcSubresource.mipLevel);
+			call.writer.i32(region.srcOffsets[0].x);
+			call.writer.i32(region.srcOffsets[0].y);
+			call.writer.i32(region.srcOffsets[1].x);
+			call.writer.i32(region.srcOffsets[1].y);
+			call.writer.u32(region.dstSubresource.aspectMask);
+			call.writer.u32(region.dstSubresource.mipLevel);
+			call.writer.i32(region.dstOffsets[0].x);
+			call.writer.i32(region.dstOffsets[0].y);
+			call.writer.i32(region.dstOffsets[1].x);
+			call.writer.i32(region.dstOffsets[1].y);
+		}
+		call.writer.u32(filter);
+		call.next.cmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount, regions, filter);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount)
+	{
+		Recording call(ApiCall::CmdResetQueryPool);
+		call.handle(commandBuffer);
+		call.handle(pool);
+		call.writer.u32(firstQuery);
+		call.writer.u32(queryCount);
+		call.next.cmdResetQueryPool(commandBuffer, pool, firstQuery, queryCount);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, VkQueryPool pool, uint32_t query)
+	{
+		Recording call(ApiCall::CmdWriteTimestamp);
+		call.handle(commandBuffer);
+		call.writer.u32(stage);
+		call.handle(pool);
+		call.writer.u32(query);
+		call.next.cmdWriteTimestamp(commandBuffer, stage, pool, query);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdBeginQuery(VkCommandBuffer commandBuffer, VkQueryPool pool, uint32_t query, VkQueryControlFlags flags)
+	{
+		Recording call(ApiCall::CmdBeginQuery);
+		call.handle(commandBuffer);
+		call.handle(pool);
+		call.writer.u32(query);
+		call.writer.u32(flags);
+		call.next.cmdBeginQuery(commandBuffer, pool, query, flags);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdEndQuery(VkCommandBuffer commandBuffer, VkQueryPool pool, uint32_t query)
+	{
+		Recording call(ApiCall::CmdEndQuery);
+		call.handle(commandBuffer);
+		call.handle(pool);
+		call.writer.u32(query);
+		call.next.cmdEndQuery(commandBuffer, pool, query);
+	}
+
+	// Extensions
+
+	static VKAPI_ATTR VkResult VKAPI_CALL createSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR* info, const VkAllocationCallbacks* allocator,
+		VkSwapchainKHR* swapchain)
+	{
+		Recording call(ApiCall::CreateSwapchainKHR);
+		call.handle(device);
+		call.handle(info->surface);
+		call.writer.u32(info->minImageCount);
+		call.writer.u32(info->imageFormat);
+		call.writer.u32(info->imageColorSpace);
+		call.writer.u32(info->imageExtent.width);
+		call.writer.u32(info->imageExtent.height);
+		call.writer.u32(info->imageUsage);
+		call.writer.u32(info->presentMode);
+		call.handle(info->oldSwapchain);
+		VkResult result = call.next.createSwapchainKHR(device, info, allocator, swapchain);
+		call.created(result, *swapchain);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL destroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* allocator)
+	{
+		Recording call(ApiCall::DestroySwapchainKHR);
+		call.handle(device);
+		call.handle(swapchain);
+		call.next.destroySwapchainKHR(device, swapchain, allocator);
+	}
+
+	// Called once for the count with images null, then for the images.
+	static VKAPI_ATTR VkResult VKAPI_CALL getSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t* imageCount, VkImage* images)
+	{
+		Recording call(ApiCall::GetSwapchainImagesKHR);
+		call.handle(device);
+		call.handle(swapchain);
+		VkResult result = call.next.getSwapchainImagesKHR(device, swapchain, imageCount, images);
+		call.writer.u32(*imageCount);
+		uint32_t written = images && result >= 0 ? *imageCount : 0;
+		call.writer.count(written);
+		for (uint32_t i = 0; i < written; i++)
+			call.handle(images[i]);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL acquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence,
+		uint32_t* imageIndex)
+	{
+		Recording call(ApiCall::AcquireNextImageKHR);
+		call.handle(device);
+		call.handle(swapchain);
+		call.writer.u64(timeout);
+		call.handle(semaphore);
+		call.handle(fence);
+		VkResult result = call.next.acquireNextImageKHR(device, swapchain, timeout, semaphore, fence, imageIndex);
+		call.writer.u32(result >= 0 ? *imageIndex : UINT32_MAX);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL queuePresentKHR(VkQueue queue, const VkPresentInfoKHR* info)
+	{
+		Recording call(ApiCall::QueuePresentKHR);
+		call.handle(queue);
+		call.writer.count(info->waitSemaphoreCount);
+		for (uint32_t i = 0; i < info->waitSemaphoreCount; i++)
+			call.handle(info->pWaitSemaphores[i]);
+		call.writer.count(info->swapchainCount);
+		for (uint32_t i = 0; i < info->swapchainCount; i++) {
+			call.handle(info->pSwapchains[i]);
+			call.writer.u32(info->pImageIndices[i]);
+		}
+		VkResult result = call.next.queuePresentKHR(queue, info);
+		call.result(result);
+		return result;
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer,
+		VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
+	{
+		Recording call(ApiCall::CmdDrawIndexedIndirectCount);
+		call.handle(commandBuffer);
+		call.handle(buffer);
+		call.writer.u64(offset);
+		call.handle(countBuffer);
+		call.writer.u64(countBufferOffset);
+		call.writer.u32(maxDrawCount);
+		call.writer.u32(stride);
+		call.next.cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+	}
+
+	static VKAPI_ATTR VkResult VKAPI_CALL setDebugUtilsObjectNameEXT(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* info)
+	{
+		Recording call(ApiCall::SetDebugUtilsObjectNameEXT);
+		call.handle(device);
+		call.writer.u32(info->objectType);
+		call.writer.handle(info->objectHandle);
+		call.writer.string(info->pObjectName);
+		VkResult result = call.next.setDebugUtilsObjectNameEXT(device, info);
+		call.result(result);
+		return result;
+	}
+
+	// The timestamps themselves are measurements, not part of the call stream.
+	static VKAPI_ATTR VkResult VKAPI_CALL getCalibratedTimestampsEXT(VkDevice device, uint32_t count, const VkCalibratedTimestampInfoEXT* infos, uint64_t* timestamps,
+		uint64_t* maxDeviation)
+	{
+		Recording call(ApiCall::GetCalibratedTimestampsEXT);
+		call.handle(device);
+		call.writer.count(count);
+		for (uint32_t i = 0; i < count; i++)
+			call.writer.u32(infos[i].timeDomain);
+		VkResult result = call.next.getCalibratedTimestampsEXT(device, count, infos, timestamps, maxDeviation);
+		call.result(result);
+		return result;
+	}
+};
+
+CallCapture::~CallCapture()
+{
+	if (s_active == this)
+		s_active = nullptr;
+}
+
+#define WRAP_COMMAND(member) \
+	if (dispatch.member) \
+		dispatch.member = &Wrappers::member
+
+void CallCapture::install(DeviceDispatch& dispatch)
+{
+	if (s_active && s_active != this)
+		throw std::logic_error("CallCapture: another capture is installed!");
+
+	m_next = dispatch;
+	s_active = this;
+
+	WRAP_COMMAND(destroyDevice);
+	WRAP_COMMAND(getDeviceQueue);
+	WRAP_COMMAND(deviceWaitIdle);
+	WRAP_COMMAND(queueSubmit);
+	WRAP_COMMAND(queueWaitIdle);
+	WRAP_COMMAND(createFence);
+	WRAP_COMMAND(destroyFence);
+	WRAP_COMMAND(waitForFences);
+	WRAP_COMMAND(resetFences);
+	WRAP_COMMAND(createSemaphore);
+	WRAP_COMMAND(destroySemaphore);
+
+	WRAP_COMMAND(allocateMemory);
+	WRAP_COMMAND(freeMemory);
+	WRAP_COMMAND(mapMemory);
+	WRAP_COMMAND(unmapMemory);
+	WRAP_COMMAND(createBuffer);
+	WRAP_COMMAND(destroyBuffer);
+	WRAP_COMMAND(getBufferMemoryRequirements);
+	WRAP_COMMAND(bindBufferMemory);
+	WRAP_COMMAND(createImage);
+	WRAP_COMMAND(destroyImage);
+	WRAP_COMMAND(getImageMemoryRequirements);
+	WRAP_COMMAND(bindImageMemory);
+	WRAP_COMMAND(createImageView);
+	WRAP_COMMAND(destroyImageView);
+	WRAP_COMMAND(createSampler);
+	WRAP_COMMAND(destroySampler);
+
+	WRAP_COMMAND(createShaderModule);
+	WRAP_COMMAND(destroyShaderModule);
+	WRAP_COMMAND(createRenderPass);
+	WRAP_COMMAND(destroyRenderPass);
+	WRAP_COMMAND(createFramebuffer);
+	WRAP_COMMAND(destroyFramebuffer);
+	WRAP_COMMAND(createPipelineLayout);
+	WRAP_COMMAND(destroyPipelineLayout);
+	WRAP_COMMAND(createGraphicsPipelines);
+	WRAP_COMMAND(createComputePipelines);
+	WRAP_COMMAND(destroyPipeline);
+	WRAP_COMMAND(createDescriptorSetLayout);
+	WRAP_COMMAND(destroyDescriptorSetLayout);
+	WRAP_COMMAND(createDescriptorPool);
+	WRAP_COMMAND(destroyDescriptorPool);
+	WRAP_COMMAND(allocateDescriptorSets);
+	WRAP_COMMAND(updateDescriptorSets);
+	WRAP_COMMAND(createQueryPool);
+	WRAP_COMMAND(destroyQueryPool);
+	WRAP_COMMAND(getQueryPoolResults);
+
+	WRAP_COMMAND(createCommandPool);
+	WRAP_COMMAND(destroyCommandPool);
+	WRAP_COMMAND(resetCommandPool);
+	WRAP_COMMAND(allocateCommandBuffers);
+	WRAP_COMMAND(freeCommandBuffers);
+	WRAP_COMMAND(beginCommandBuffer);
+	WRAP_COMMAND(endCommandBuffer);
+	WRAP_COMMAND(cmdBeginRenderPass);
+	WRAP_COMMAND(cmdEndRenderPass);
+	WRAP_COMMAND(cmdBindPipeline);
+	WRAP_COMMAND(cmdSetViewport);
+	WRAP_COMMAND(cmdSetScissor);
+	WRAP_COMMAND(cmdBindDescriptorSets);
+	WRAP_COMMAND(cmdBindVertexBuffers);
+	WRAP_COMMAND(cmdBindIndexBuffer);
+	WRAP_COMMAND(cmdPushConstants);
+	WRAP_COMMAND(cmdDrawIndexed);
+	WRAP_COMMAND(cmdDrawIndexedIndirect);
+	WRAP_COMMAND(cmdDispatch);
+	WRAP_COMMAND(cmdPipelineBarrier);
+	WRAP_COMMAND(cmdFillBuffer);
+	WRAP_COMMAND(cmdCopyBuffer);
+	WRAP_COMMAND(cmdCopyBufferToImage);
+	WRAP_COMMAND(cmdCopyImageToBuffer);
+	WRAP_COMMAND(cmdBlitImage);
+	WRAP_COMMAND(cmdResetQueryPool);
+	WRAP_COMMAND(cmdWriteTimestamp);
+	WRAP_COMMAND(cmdBeginQuery);
+	WRAP_COMMAND(cmdEndQuery);
+
+	WRAP_COMMAND(createSwapchainKHR);
+	WRAP_COMMAND(destroySwapchainKHR);
+	WRAP_COMMAND(getSwapchainImagesKHR);
+	WRAP_COMMAND(acquireNextImageKHR);
+	WRAP_COMMAND(queuePresentKHR);
+	WRAP_COMMAND(cmdDrawIndexedIndirectCount);
+	WRAP_COMMAND(setDebugUtilsObjectNameEXT);
+	WRAP_COMMAND(getCalibratedTimestampsEXT);
+}
+
+bool CallCapture::isInstalled() const
+{
+	return s_active == this;
+}
+
+uint32_t CallCapture::take(std::vector<char>& stream)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32_t count = m_writer.callCount();
+	stream.assign(m_writer.data().begin(), m_writer.data().end());
+	m_writer.clear();
+	return count;
+}
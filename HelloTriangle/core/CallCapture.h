@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CallTrace.h"
+#include "DeviceDispatch.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Records every call made through a DeviceDispatch as a CallTrace stream: handles, the create
+// infos and command parameters the renderer sets, shader code, and what staging uploads wrote
+// into mapped memory, which is read back when the memory is unmapped. Memory that stays mapped,
+// like the per-frame uniforms, isn't recorded, nor is what the GPU writes back.
+//
+// install() keeps a copy of the table to call through and points its entries at wrappers that
+// encode each call, then make it. The wrappers find the capture through a static, so there can
+// be one installed at a time, and it has to outlive every call through the table. Calls from
+// several threads are recorded in the order they take the capture's lock.
+class CallCapture
+{
+public:
+	CallCapture() = default;
+	~CallCapture();
+
+	CallCapture(const CallCapture&) = delete;
+	CallCapture& operator=(const CallCapture&) = delete;
+
+	// Throws if another capture is installed. Entries that are null stay null.
+	void install(DeviceDispatch& dispatch);
+	bool isInstalled() const;
+
+	// Moves what was recorded since the last take() into stream and returns the number of calls.
+	uint32_t take(std::vector<char>& stream);
+
+private:
+	struct Wrappers;
+
+	struct Mapping
+	{
+		const void* data;
+		uint64_t size;
+	};
+
+private:
+	DeviceDispatch m_next;
+	std::mutex m_mutex;
+	CallWriter m_writer;
+	std::unordered_map<uint64_t, uint64_t> m_allocationSizes;
+	std::unordered_map<uint64_t, Mapping> m_mappings;
+};
@@ -0,0 +1,458 @@
+#include "CallTrace.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static const ApiCallInfo s_calls[] = {
+	{ "vkDestroyDevice", "device:h" },
+	{ "vkGetDeviceQueue", "device:h queueFamilyIndex:u queueIndex:u queue:h" },
+	{ "vkDeviceWaitIdle", "device:h result:r" },
+	{ "vkQueueSubmit", "queue:h submits:[{waitSemaphores:[{semaphore:h dstStageMask:x}] commandBuffers:[h] signalSemaphores:[h]}] fence:h result:r" },
+	{ "vkQueueWaitIdle", "queue:h result:r" },
+	{ "vkCreateFence", "device:h flags:x fence:h result:r" },
+	{ "vkDestroyFence", "device:h fence:h" },
+	{ "vkWaitForFences", "device:h fences:[h] waitAll:u timeout:U ~result:r" },
+	{ "vkResetFences", "device:h fences:[h] result:r" },
+	{ "vkCreateSemaphore", "device:h semaphore:h result:r" },
+	{ "vkDestroySemaphore", "device:h semaphore:h" },
+
+	{ "vkAllocateMemory", "device:h allocationSize:U memoryTypeIndex:u memory:h result:r" },
+	{ "vkFreeMemory", "device:h memory:h" },
+	{ "vkMapMemory", "device:h memory:h offset:U size:U flags:x result:r" },
+	{ "vkUnmapMemory", "device:h memory:h contents:b" },
+	{ "vkCreateBuffer", "device:h flags:x size:U usage:x sharingMode:u buffer:h result:r" },
+	{ "vkDestroyBuffer", "device:h buffer:h" },
+	{ "vkGetBufferMemoryRequirements", "device:h buffer:h size:U alignment:U memoryTypeBits:x" },
+	{ "vkBindBufferMemory", "device:h buffer:h memory:h memoryOffset:U result:r" },
+	{ "vkCreateImage", "device:h flags:x imageType:u format:u width:u height:u depth:u mipLevels:u arrayLayers:u samples:x tiling:u usage:x initialLayout:u image:h result:r" },
+	{ "vkDestroyImage", "device:h image:h" },
+	{ "vkGetImageMemoryRequirements", "device:h image:h size:U alignment:U memoryTypeBits:x" },
+	{ "vkBindImageMemory", "device:h image:h memory:h memoryOffset:U result:r" },
+	{ "vkCreateImageView", "device:h image:h viewType:u format:u aspectMask:x baseMipLevel:u levelCount:u baseArrayLayer:u layerCount:u view:h result:r" },
+	{ "vkDestroyImageView", "device:h imageView:h" },
+	{ "vkCreateSampler", "device:h magFilter:u minFilter:u mipmapMode:u addressModeU:u addressModeV:u addressModeW:u anisotropyEnable:u maxAnisotropy:f compareEnable:u compareOp:u minLod:f maxLod:f sampler:h result:r" },
+	{ "vkDestroySampler", "device:h sampler:h" },
+
+	{ "vkCreateShaderModule", "device:h code:b shaderModule:h result:r" },
+	{ "vkDestroyShaderModule", "device:h shaderModule:h" },
+	{ "vkCreateRenderPass", "device:h attachments:[{format:u samples:x loadOp:u storeOp:u initialLayout:u finalLayout:u}] subpasses:[{colorAttachments:[u] depthStencilAttachment:i}] dependencyCount:u renderPass:h result:r" },
+	{ "vkDestroyRenderPass", "device:h renderPass:h" },
+	{ "vkCreateFramebuffer", "device:h renderPass:h attachments:[h] width:u height:u layers:u framebuffer:h result:r" },
+	{ "vkDestroyFramebuffer", "device:h framebuffer:h" },
+	{ "vkCreatePipelineLayout", "device:h setLayouts:[h] pushConstantRanges:[{stageFlags:x offset:u size:u}] pipelineLayout:h result:r" },
+	{ "vkDestroyPipelineLayout", "device:h pipelineLayout:h" },
+	{ "vkCreateGraphicsPipelines", "device:h pipelineCache:h pipelines:[{stages:[{stage:x module:h entryPoint:s}] layout:h renderPass:h subpass:u pipeline:h}] result:r" },
+	{ "vkCreateComputePipelines", "device:h pipelineCache:h pipelines:[{stage:x module:h entryPoint:s layout:h pipeline:h}] result:r" },
+	{ "vkDestroyPipeline", "device:h pipeline:h" },
+	{ "vkCreateDescriptorSetLayout", "device:h bindings:[{binding:u descriptorType:u descriptorCount:u stageFlags:x}] setLayout:h result:r" },
+	{ "vkDestroyDescriptorSetLayout", "device:h descriptorSetLayout:h" },
+	{ "vkCreateDescriptorPool", "device:h flags:x maxSets:u poolSizes:[{type:u descriptorCount:u}] descriptorPool:h result:r" },
+	{ "vkDestroyDescriptorPool", "device:h descriptorPool:h" },
+	{ "vkAllocateDescriptorSets", "device:h descriptorPool:h setLayouts:[h] descriptorSets:[h] result:r" },
+	{ "vkUpdateDescriptorSets", "device:h writes:[{dstSet:h dstBinding:u dstArrayElement:u descriptorType:u images:[{sampler:h imageView:h imageLayout:u}] buffers:[{buffer:h offset:U range:U}]}] copies:[{srcSet:h srcBinding:u dstSet:h dstBinding:u descriptorCount:u}]" },
+	{ "vkCreateQueryPool", "device:h queryType:u queryCount:u pipelineStatistics:x queryPool:h result:r" },
+	{ "vkDestroyQueryPool", "device:h queryPool:h" },
+	{ "vkGetQueryPoolResults", "device:h queryPool:h firstQuery:u queryCount:u dataSize:U stride:U flags:x ~result:r" },
+
+	{ "vkCreateCommandPool", "device:h flags:x queueFamilyIndex:u commandPool:h result:r" },
+	{ "vkDestroyCommandPool", "device:h commandPool:h" },
+	{ "vkResetCommandPool", "device:h commandPool:h flags:x result:r" },
+	{ "vkAllocateCommandBuffers", "device:h commandPool:h level:u commandBuffers:[h] result:r" },
+	{ "vkFreeCommandBuffers", "device:h commandPool:h commandBuffers:[h]" },
+	{ "vkBeginCommandBuffer", "commandBuffer:h flags:x result:r" },
+	{ "vkEndCommandBuffer", "commandBuffer:h result:r" },
+	{ "vkCmdBeginRenderPass", "commandBuffer:h renderPass:h framebuffer:h x:i y:i width:u height:u clearValues:[{v0:f v1:f v2:f v3:f}] contents:u" },
+	{ "vkCmdEndRenderPass", "commandBuffer:h" },
+	{ "vkCmdBindPipeline", "commandBuffer:h pipelineBindPoint:u pipeline:h" },
+	{ "vkCmdSetViewport", "commandBuffer:h firstViewport:u viewports:[{x:f y:f width:f height:f minDepth:f maxDepth:f}]" },
+	{ "vkCmdSetScissor", "commandBuffer:h firstScissor:u scissors:[{x:i y:i width:u height:u}]" },
+	{ "vkCmdBindDescriptorSets", "commandBuffer:h pipelineBindPoint:u layout:h firstSet:u descriptorSets:[h] dynamicOffsets:[u]" },
+	{ "vkCmdBindVertexBuffers", "commandBuffer:h firstBinding:u bindings:[{buffer:h offset:U}]" },
+	{ "vkCmdBindIndexBuffer", "commandBuffer:h buffer:h offset:U indexType:u" },
+	{ "vkCmdPushConstants", "commandBuffer:h layout:h stageFlags:x offset:u values:b" },
+	{ "vkCmdDrawIndexed", "commandBuffer:h indexCount:u instanceCount:u firstIndex:u vertexOffset:i firstInstance:u" },
+	{ "vkCmdDrawIndexedIndirect", "commandBuffer:h buffer:h offset:U drawCount:u stride:u" },
+	{ "vkCmdDispatch", "commandBuffer:h groupCountX:u groupCountY:u groupCountZ:u" },
+	{ "vkCmdPipelineBarrier", "commandBuffer:h srcStageMask:x dstStageMask:x dependencyFlags:x memoryBarriers:[{srcAccessMask:x dstAccessMask:x}] bufferMemoryBarriers:[{srcAccessMask:x dstAccessMask:x buffer:h offset:U size:U}] imageMemoryBarriers:[{srcAccessMask:x dstAccessMask:x oldLayout:u newLayout:u image:h aspectMask:x baseMipLevel:u levelCount:u baseArrayLayer:u layerCount:u}]" },
+	{ "vkCmdFillBuffer", "commandBuffer:h dstBuffer:h dstOffset:U size:U data:x" },
+	{ "vkCmdCopyBuffer", "commandBuffer:h srcBuffer:h dstBuffer:h regions:[{srcOffset:U dstOffset:U size:U}]" },
+	{ "vkCmdCopyBufferToImage", "commandBuffer:h srcBuffer:h dstImage:h dstImageLayout:u regions:[{bufferOffset:U bufferRowLength:u bufferImageHeight:u aspectMask:x mipLevel:u baseArrayLayer:u layerCount:u x:i y:i z:i width:u height:u depth:u}]" },
+	{ "vkCmdCopyImageToBuffer", "commandBuffer:h srcImage:h srcImageLayout:u dstBuffer:h regions:[{bufferOffset:U bufferRowLength:u bufferImageHeight:u aspectMask:x mipLevel:u baseArrayLayer:u layerCount:u x:i y:i z:i width:u height:u depth:u}]" },
+	{ "vkCmdBlitImage", "commandBuffer:h srcImage:h srcImageLayout:u dstImage:h dstImageLayout:u regions:[{srcAspectMask:x srcMipLevel:u srcX0:i srcY0:i srcX1:i srcY1:i dstAspectMask:x dstMipLevel:u dstX0:i dstY0:i dstX1:i dstY1:i}] filter:u" },
+	{ "vkCmdResetQueryPool", "commandBuffer:h queryPool:h firstQuery:u queryCount:u" },
+	{ "vkCmdWriteTimestamp", "commandBuffer:h pipelineStage:x queryPool:h query:u" },
+	{ "vkCmdBeginQuery", "commandBuffer:h queryPool:h query:u flags:x" },
+	{ "vkCmdEndQuery", "commandBuffer:h queryPool:h query:u" },
+
+	{ "vkCreateSwapchainKHR", "device:h surface:h minImageCount:u imageFormat:u imageColorSpace:u width:u height:u imageUsage:x presentMode:u oldSwapchain:h swapchain:h result:r" },
+	{ "vkDestroySwapchainKHR", "device:h swapchain:h" },
+	{ "vkGetSwapchainImagesKHR", "device:h swapchain:h imageCount:u images:[h] result:r" },
+	{ "vkAcquireNextImageKHR", "device:h swapchain:h timeout:U semaphore:h fence:h ~imageIndex:u ~result:r" },
+	{ "vkQueuePresentKHR", "queue:h waitSemaphores:[h] swapchains:[{swapchain:h ~imageIndex:u}] ~result:r" },
+	{ "vkCmdDrawIndexedIndirectCountKHR", "commandBuffer:h buffer:h offset:U countBuffer:h countBufferOffset:U maxDrawCount:u stride:u" },
+	{ "vkSetDebugUtilsObjectNameEXT", "device:h objectType:u objectHandle:h objectName:s result:r" },
+	{ "vkGetCalibratedTimestampsEXT", "device:h timeDomains:[u] ~result:r" },
+};
+
+static_assert(sizeof(s_calls) / sizeof(s_calls[0]) == static_cast<size_t>(ApiCall::Count), "every ApiCall needs a signature");
+
+const ApiCallInfo& apiCallInfo(ApiCall call)
+{
+	if (call >= ApiCall::Count)
+		throw std::runtime_error("unknown call id " + std::to_string(static_cast<uint32_t>(call)) + "!");
+	return s_calls[static_cast<size_t>(call)];
+}
+
+void CallWriter::begin(ApiCall call)
+{
+	m_callStart = m_data.size();
+	put(static_cast<uint16_t>(call));
+	put(uint32_t(0));
+}
+
+void CallWriter::end()
+{
+	uint32_t size = static_cast<uint32_t>(m_data.size() - m_callStart - sizeof(uint16_t) - sizeof(uint32_t));
+	std::memcpy(m_data.data() + m_callStart + sizeof(uint16_t), &size, sizeof(size));
+	m_calls++;
+}
+
+void CallWriter::bytes(const void* data, size_t size)
+{
+	count(size);
+	const char* begin = static_cast<const char*>(data);
+	if (size)
+		m_data.insert(m_data.end(), begin, begin + size);
+}
+
+void CallWriter::string(const char* value)
+{
+	bytes(value, value ? std::strlen(value) : 0);
+}
+
+void CallWriter::clear()
+{
+	m_data.clear();
+	m_calls = 0;
+}
+
+namespace
+{
+	// A signature parsed into a tree: an array has its element as the one child, a struct its
+	// members.
+	struct Field
+	{
+		std::string name;
+		char type = 0;
+		bool compared = true;
+		std::vector<Field> children;
+	};
+
+	Field parseType(const char*& cursor);
+
+	void parseMembers(const char*& cursor, char close, std::vector<Field>& members)
+	{
+		while (true) {
+			while (*cursor == ' ')
+				cursor++;
+			if (*cursor == close) {
+				if (close)
+					cursor++;
+				return;
+			}
+			if (!*cursor)
+				throw std::logic_error("CallTrace: unterminated signature!");
+
+			Field field;
+			if (*cursor == '~') {
+				field.compared = false;
+				cursor++;
+			}
+			while (*cursor && *cursor != ':')
+				field.name += *cursor++;
+			if (*cursor != ':')
+				throw std::logic_error("CallTrace: signature member without a type!");
+			cursor++;
+
+			Field type = parseType(cursor);
+			field.type = type.type;
+			field.children = std::move(type.children);
+			members.push_back(std::move(field));
+		}
+	}
+
+	Field parseType(const char*& cursor)
+	{
+		Field field;
+		field.type = *cursor++;
+		if (field.type == '[') {
+			field.children.push_back(parseType(cursor));
+			if (*cursor++ != ']')
+				throw std::logic_error("CallTrace: unterminated array in signature!");
+		}
+		else if (field.type == '{') {
+			parseMembers(cursor, '}', field.children);
+		}
+		else if (!std::strchr("huixUfrsb", field.type)) {
+			throw std::logic_error(std::string("CallTrace: unknown signature type '") + field.type + "'!");
+		}
+		return field;
+	}
+
+	const std::vector<Field>& callFields(ApiCall call)
+	{
+		static const std::vector<std::vector<Field>> fields = []() {
+			std::vector<std::vector<Field>> parsed(static_cast<size_t>(ApiCall::Count));
+			for (size_t i = 0; i < parsed.size(); i++) {
+				const char* cursor = s_calls[i].signature;
+				parseMembers(cursor, '\0', parsed[i]);
+			}
+			return parsed;
+		}();
+		return fields[static_cast<size_t>(call)];
+	}
+
+	class PayloadDecoder
+	{
+	public:
+		PayloadDecoder(const char* data, size_t size)
+			: m_data(data), m_size(size)
+		{
+		}
+
+		void decode(const Field& field, std::vector<DecodedCall::Value>& values)
+		{
+			switch (field.type) {
+			case '{':
+				for (const Field& member : field.children)
+					decode(member, values);
+				return;
+			case '[': {
+				uint32_t count = read<uint32_t>();
+				values.push_back({ '[', count, {} });
+				for (uint32_t i = 0; i < count; i++)
+					decode(field.children[0], values);
+				return;
+			}
+			case 's':
+			case 'b': {
+				uint32_t size = read<uint32_t>();
+				if (size > m_size - m_offset)
+					throw std::runtime_error("call payload is truncated!");
+				values.push_back({ field.type, size, std::string(m_data + m_offset, size) });
+				m_offset += size;
+				return;
+			}
+			case 'h':
+			case 'U':
+				values.push_back({ field.type, read<uint64_t>(), {} });
+				return;
+			default:
+				values.push_back({ field.type, read<uint32_t>(), {} });
+				return;
+			}
+		}
+
+		bool finished() const { return m_offset == m_size; }
+
+	private:
+		template <typename T>
+		T read()
+		{
+			if (sizeof(T) > m_size - m_offset)
+				throw std::runtime_error("call payload is truncated!");
+			T value;
+			std::memcpy(&value, m_data + m_offset, sizeof(T));
+			m_offset += sizeof(T);
+			return value;
+		}
+
+	private:
+		const char* m_data;
+		size_t m_size;
+		size_t m_offset = 0;
+	};
+
+	void printValue(std::ostream& out, const Field& field, const std::vector<DecodedCall::Value>& values, size_t& index);
+
+	void printMembers(std::ostream& out, const std::vector<Field>& members, const std::vector<DecodedCall::Value>& values, size_t& index)
+	{
+		for (size_t i = 0; i < members.size(); i++) {
+			if (i)
+				out << ", ";
+			out << members[i].name << "=";
+			printValue(out, members[i], values, index);
+		}
+	}
+
+	void printValue(std::ostream& out, const Field& field, const std::vector<DecodedCall::Value>& values, size_t& index)
+	{
+		if (field.type == '{') {
+			out << "{";
+			printMembers(out, field.children, values, index);
+			out << "}";
+			return;
+		}
+
+		const DecodedCall::Value& value = values[index++];
+		switch (field.type) {
+		case '[':
+			out << "[";
+			for (uint64_t i = 0; i < value.bits; i++) {
+				if (i)
+					out << ", ";
+				printValue(out, field.children[0], values, index);
+			}
+			out << "]";
+			break;
+		case 'h':
+		case 'x':
+			out << "0x" << std::hex << value.bits << std::dec;
+			break;
+		case 'i':
+		case 'r':
+			out << static_cast<int32_t>(static_cast<uint32_t>(value.bits));
+			break;
+		case 'f': {
+			uint32_t bits = static_cast<uint32_t>(value.bits);
+			float f;
+			std::memcpy(&f, &bits, sizeof(f));
+			out << f;
+			break;
+		}
+		case 's':
+			out << '"' << value.data << '"';
+			break;
+		case 'b':
+			out << "<" << value.bits << " bytes>";
+			break;
+		default:
+			out << value.bits;
+			break;
+		}
+	}
+
+	// Walks both calls' values together. Equal calls have equal array counts, so the values line
+	// up until the first difference.
+	bool compareValues(const Field& field, const std::vector<DecodedCall::Value>& expected, const std::vector<DecodedCall::Value>& actual,
+		size_t& index, bool compared, std::string& difference)
+	{
+		compared = compared && field.compared;
+
+		if (field.type == '{') {
+			for (const Field& member : field.children) {
+				if (!compareValues(member, expected, actual, index, compared, difference))
+					return false;
+			}
+			return true;
+		}
+
+		const DecodedCall::Value& a = expected[index];
+		const DecodedCall::Value& b = actual[index];
+		index++;
+
+		bool equal;
+		switch (field.type) {
+		case '[':
+			// Counts are compared even under ~, since the values that follow depend on them.
+			if (a.bits != b.bits) {
+				difference = field.name + " has " + std::to_string(b.bits) + " elements instead of " + std::to_string(a.bits);
+				return false;
+			}
+			for (uint64_t i = 0; i < a.bits; i++) {
+				if (!compareValues(field.children[0], expected, actual, index, compared, difference))
+					return false;
+			}
+			return true;
+		case 'h':
+			equal = (a.bits == 0) == (b.bits == 0);
+			break;
+		case 's':
+		case 'b':
+			equal = a.data == b.data;
+			break;
+		default:
+			equal = a.bits == b.bits;
+			break;
+		}
+
+		if (equal || !compared)
+			return true;
+
+		if (field.type == 'h')
+			difference = field.name + (b.bits ? " is set" : " is null") + " instead of " + (a.bits ? "set" : "null");
+		else if (field.type == 's' || field.type == 'b')
+			difference = field.name + " differs";
+		else
+			difference = field.name + " is " + std::to_string(b.bits) + " instead of " + std::to_string(a.bits);
+		return false;
+	}
+}
+
+std::vector<DecodedCall> decodeCalls(const std::vector<char>& stream)
+{
+	std::vector<DecodedCall> calls;
+	size_t offset = 0;
+	while (offset < stream.size()) {
+		uint16_t id;
+		uint32_t size;
+		if (stream.size() - offset < sizeof(id) + sizeof(size))
+			throw std::runtime_error("call stream is truncated!");
+		std::memcpy(&id, stream.data() + offset, sizeof(id));
+		std::memcpy(&size, stream.data() + offset + sizeof(id), sizeof(size));
+		offset += sizeof(id) + sizeof(size);
+		if (size > stream.size() - offset)
+			throw std::runtime_error("call stream is truncated!");
+
+		if (id < static_cast<uint16_t>(ApiCall::Count)) {
+			DecodedCall call;
+			call.call = static_cast<ApiCall>(id);
+
+			PayloadDecoder decoder(stream.data() + offset, size);
+			for (const Field& field : callFields(call.call))
+				decoder.decode(field, call.values);
+			if (!decoder.finished())
+				throw std::runtime_error(std::string(apiCallInfo(call.call).name) + " doesn't match its signature!");
+
+			calls.push_back(std::move(call));
+		}
+		offset += size;
+	}
+	return calls;
+}
+
+void printCall(std::ostream& out, const DecodedCall& call)
+{
+	size_t index = 0;
+	out << apiCallInfo(call.call).name << "(";
+	printMembers(out, callFields(call.call), call.values, index);
+	out << ")";
+}
+
+bool compareCalls(const std::vector<DecodedCall>& expected, const std::vector<DecodedCall>& actual, std::string& difference)
+{
+	for (size_t i = 0; i < expected.size() && i < actual.size(); i++) {
+		const DecodedCall& a = expected[i];
+		const DecodedCall& b = actual[i];
+		std::string prefix = "call " + std::to_string(i) + " ";
+		if (a.call != b.call) {
+			difference = prefix + "is " + apiCallInfo(b.call).name + " instead of " + apiCallInfo(a.call).name;
+			return false;
+		}
+
+		size_t index = 0;
+		for (const Field& field : callFields(a.call)) {
+			std::string fieldDifference;
+			if (!compareValues(field, a.values, b.values, index, true, fieldDifference)) {
+				difference = prefix + "(" + apiCallInfo(a.call).name + "): " + fieldDifference;
+				return false;
+			}
+		}
+	}
+
+	if (expected.size() != actual.size()) {
+		difference = std::to_string(actual.size()) + " calls instead of " + std::to_string(expected.size());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Device calls as captured through DeviceDispatch by CallCapture, in a form that can be read
+// without the Vulkan headers: by the trace-replay tool, and by a replay checking that it issued
+// what the capture did.
+//
+// A stream is a sequence of calls, each its ApiCall id (uint16), its payload size (uint32) and
+// the payload: the parameters in the order the call's signature lists them, with outputs and the
+// VkResult last. A signature is a space-separated list of name:type, where type is one of
+//
+//   h handle (uint64)   u uint32   i int32   x uint32 flags   U uint64   f float   r VkResult
+//   s string   b bytes   [type] array of type   {name:type ...} struct
+//
+// Strings, bytes and arrays start with a uint32 count. A name starting with ~ marks a value that
+// may legitimately differ between runs, such as the swap chain image acquired.
+enum class ApiCall : uint16_t
+{
+	DestroyDevice,
+	GetDeviceQueue,
+	DeviceWaitIdle,
+	QueueSubmit,
+	QueueWaitIdle,
+	CreateFence,
+	DestroyFence,
+	WaitForFences,
+	ResetFences,
+	CreateSemaphore,
+	DestroySemaphore,
+
+	AllocateMemory,
+	FreeMemory,
+	MapMemory,
+	UnmapMemory,
+	CreateBuffer,
+	DestroyBuffer,
+	GetBufferMemoryRequirements,
+	BindBufferMemory,
+	CreateImage,
+	DestroyImage,
+	GetImageMemoryRequirements,
+	BindImageMemory,
+	CreateImageView,
+	DestroyImageView,
+	CreateSampler,
+	DestroySampler,
+
+	CreateShaderModule,
+	DestroyShaderModule,
+	CreateRenderPass,
+	DestroyRenderPass,
+	CreateFramebuffer,
+	DestroyFramebuffer,
+	CreatePipelineLayout,
+	DestroyPipelineLayout,
+	CreateGraphicsPipelines,
+	CreateComputePipelines,
+	DestroyPipeline,
+	CreateDescriptorSetLayout,
+	DestroyDescriptorSetLayout,
+	CreateDescriptorPool,
+	DestroyDescriptorPool,
+	AllocateDescriptorSets,
+	UpdateDescriptorSets,
+	CreateQueryPool,
+	DestroyQueryPool,
+	GetQueryPoolResults,
+
+	CreateCommandPool,
+	DestroyCommandPool,
+	ResetCommandPool,
+	AllocateCommandBuffers,
+	FreeCommandBuffers,
+	BeginCommandBuffer,
+	EndCommandBuffer,
+	CmdBeginRenderPass,
+	CmdEndRenderPass,
+	CmdBindPipeline,
+	CmdSetViewport,
+	CmdSetScissor,
+	CmdBindDescriptorSets,
+	CmdBindVertexBuffers,
+	CmdBindIndexBuffer,
+	CmdPushConstants,
+	CmdDrawIndexed,
+	CmdDrawIndexedIndirect,
+	CmdDispatch,
+	CmdPipelineBarrier,
+	CmdFillBuffer,
+	CmdCopyBuffer,
+	CmdCopyBufferToImage,
+	CmdCopyImageToBuffer,
+	CmdBlitImage,
+	CmdResetQueryPool,
+	CmdWriteTimestamp,
+	CmdBeginQuery,
+	CmdEndQuery,
+
+	CreateSwapchainKHR,
+	DestroySwapchainKHR,
+	GetSwapchainImagesKHR,
+	AcquireNextImageKHR,
+	QueuePresentKHR,
+	CmdDrawIndexedIndirectCount,
+	SetDebugUtilsObjectNameEXT,
+	GetCalibratedTimestampsEXT,
+
+	Count
+};
+
+struct ApiCallInfo
+{
+	const char* name;
+	const char* signature;
+};
+
+// Throws for an id this build doesn't know.
+const ApiCallInfo& apiCallInfo(ApiCall call);
+
+// Appends calls to a stream. Each call is begin(), its values in signature order, then end().
+class CallWriter
+{
+public:
+	void begin(ApiCall call);
+	void end();
+
+	void handle(uint64_t value) { put(value); }
+	void u32(uint32_t value) { put(value); }
+	void i32(int32_t value) { put(value); }
+	void u64(uint64_t value) { put(value); }
+	void f32(float value) { put(value); }
+	void count(size_t value) { put(static_cast<uint32_t>(value)); }
+	void bytes(const void* data, size_t size);
+	void string(const char* value);
+
+	uint32_t callCount() const { return m_calls; }
+	const std::vector<char>& data() const { return m_data; }
+	void clear();
+
+private:
+	template <typename T>
+	void put(const T& value)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+	}
+
+private:
+	std::vector<char> m_data;
+	size_t m_callStart = 0;
+	uint32_t m_calls = 0;
+};
+
+// A call read back from a stream, its values flattened in signature order with array counts
+// included. Strings and bytes keep their contents in data.
+struct DecodedCall
+{
+	struct Value
+	{
+		char type;
+		uint64_t bits;
+		std::string data;
+	};
+
+	ApiCall call;
+	std::vector<Value> values;
+};
+
+// Throws if a call doesn't match its signature. Calls with ids this build doesn't know are
+// skipped, so newer streams still read.
+std::vector<DecodedCall> decodeCalls(const std::vector<char>& stream);
+
+// Writes the call as name(parameter=value, ...) without a newline.
+void printCall(std::ostream& out, const DecodedCall& call);
+
+// Returns true if the two streams make the same calls with the same values. Handles differ from
+// run to run and swap chain images come back in whatever order presentation allows, so handles
+// are only compared as null or not, and values marked ~ not at all. Otherwise describes the first
+// difference.
+bool compareCalls(const std::vector<DecodedCall>& expected, const std::vector<DecodedCall>& actual, std::string& difference);
@@ -0,0 +1,124 @@
+#include "DeletionQueue.h"
+#include "DeviceMemoryTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void DeletionQueue::init(VkDevice device, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, DeviceMemoryTracker* memoryTracker)
+{
+	m_device = device;
+	m_dispatch = &dispatch;
+	m_allocator = allocator;
+	m_memoryTracker = memoryTracker;
+}
+
+void DeletionQueue::collect(uint64_t completedFrame)
+{
+	m_collects++;
+	while (!m_pending.empty() && m_pending.front().lastFrame <= completedFrame) {
+		m_maxLatency = std::max(m_maxLatency, completedFrame - m_pending.front().lastFrame);
+		destroy(m_pending.front());
+		m_pending.pop_front();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	for (const Entry& entry : m_pending)
+		destroy(entry);
+	m_pending.clear();
+}
+
+void DeletionQueue::destroy(const Entry& entry)
+{
+	if (m_device == VK_NULL_HANDLE)
+		throw std::logic_error("DeletionQueue: used before init!");
+
+	switch (entry.kind) {
+	case Kind::Buffer:
+		m_dispatch->destroyBuffer(m_device, (VkBuffer)entry.handle, m_allocator);
+		break;
+	case Kind::Image:
+		m_dispatch->destroyImage(m_device, (VkImage)entry.handle, m_allocator);
+		break;
+	case Kind::ImageView:
+		m_dispatch->destroyImageView(m_device, (VkImageView)entry.handle, m_allocator);
+		break;
+	case Kind::Sampler:
+		m_dispatch->destroySampler(m_device, (VkSampler)entry.handle, m_allocator);
+		break;
+	case Kind::Framebuffer:
+		m_dispatch->destroyFramebuffer(m_device, (VkFramebuffer)entry.handle, m_allocator);
+		break;
+	case Kind::RenderPass:
+		m_dispatch->destroyRenderPass(m_device, (VkRenderPass)entry.handle, m_allocator);
+		break;
+	case Kind::Pipeline:
+		m_dispatch->destroyPipeline(m_device, (VkPipeline)entry.handle, m_allocator);
+		break;
+	case Kind::PipelineLayout:
+		m_dispatch->destroyPipelineLayout(m_device, (VkPipelineLayout)entry.handle, m_allocator);
+		break;
+	case Kind::DescriptorSetLayout:
+		m_dispatch->destroyDescriptorSetLayout(m_device, (VkDescriptorSetLayout)entry.handle, m_allocator);
+		break;
+	case Kind::DescriptorPool:
+		m_dispatch->destroyDescriptorPool(m_device, (VkDescriptorPool)entry.handle, m_allocator);
+		break;
+	case Kind::Swapchain:
+		m_dispatch->destroySwapchainKHR(m_device, (VkSwapchainKHR)entry.handle, m_allocator);
+		break;
+	case Kind::Memory:
+		m_dispatch->freeMemory(m_device, (VkDeviceMemory)entry.handle, m_allocator);
+		if (m_memoryTracker)
+			m_memoryTracker->freed((VkDeviceMemory)entry.handle);
+		break;
+	default:
+		throw std::logic_error("DeletionQueue: unknown object kind!");
+	}
+
+	m_destroyed[static_cast<uint32_t>(entry.kind)]++;
+}
+
+bool DeletionQueue::report(std::ostream& out) const
+{
+	bool clean = m_pending.empty();
+
+	out << "deletion queue: peak backlog " << m_peakPending << " objects, max latency " << m_maxLatency << " frames, " << m_collects << " collects" << std::endl;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(Kind::Count); i++) {
+		if (m_created[i] == 0 && m_destroyed[i] == 0)
+			continue;
+
+		out << "  " << kindName(static_cast<Kind>(i)) << ": " << m_created[i] << " created, " << m_destroyed[i] << " destroyed";
+		if (m_created[i] != m_destroyed[i]) {
+			out << " (" << (m_created[i] > m_destroyed[i] ? "leaked " : "over-released ")
+				<< (m_created[i] > m_destroyed[i] ? m_created[i] - m_destroyed[i] : m_destroyed[i] - m_created[i]) << ")";
+			clean = false;
+		}
+		out << std::endl;
+	}
+
+	if (!m_pending.empty())
+		out << "  " << m_pending.size() << " objects still queued" << std::endl;
+
+	return clean;
+}
+
+const char* DeletionQueue::kindName(Kind kind)
+{
+	switch (kind) {
+	case Kind::Buffer: return "buffers";
+	case Kind::Image: return "images";
+	case Kind::ImageView: return "image views";
+	case Kind::Sampler: return "samplers";
+	case Kind::Framebuffer: return "framebuffers";
+	case Kind::RenderPass: return "render passes";
+	case Kind::Pipeline: return "pipelines";
+	case Kind::PipelineLayout: return "pipeline layouts";
+	case Kind::DescriptorSetLayout: return "descriptor set layouts";
+	case Kind::DescriptorPool: return "descriptor pools";
+	case Kind::Swapchain: return "swap chains";
+	case Kind::Memory: return "memory allocations";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "DeviceDispatch.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <ostream>
+
+class DeviceMemoryTracker;
+
+// Defers destroying Vulkan objects until the GPU has finished the last frame that used them.
+//
+// Frames are numbered by the caller in submission order. Objects are pushed with the number of
+// the last frame that may reference them, and collect() destroys everything at or before the most
+// recent completed frame. Numbers normally grow from push to push; an object that has to outlive
+// frames not yet submitted, such as a swap chain still being presented from, may be pushed with a
+// later number and is kept in order. Every object the
+// queue will destroy should also be passed to track() when it is created, so objects that are
+// never released show up in report(). Objects still queued when the queue goes away are not
+// destroyed, since the GPU may still be using them; report() lists them instead. Freed memory is
+// reported to the memory tracker, if there is one.
+class DeletionQueue
+{
+public:
+	enum class Kind : uint32_t
+	{
+		Buffer,
+		Image,
+		ImageView,
+		Sampler,
+		Framebuffer,
+		RenderPass,
+		Pipeline,
+		PipelineLayout,
+		DescriptorSetLayout,
+		DescriptorPool,
+		Swapchain,
+		Memory,
+		Count
+	};
+
+public:
+	DeletionQueue() = default;
+
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	// Objects are destroyed through dispatch, which must outlive the queue, with allocator, which
+	// must be the one they were created with.
+	void init(VkDevice device, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, DeviceMemoryTracker* memoryTracker = nullptr);
+	const VkAllocationCallbacks* allocator() const { return m_allocator; }
+	DeviceMemoryTracker* memoryTracker() const { return m_memoryTracker; }
+
+	void track(Kind kind) { m_created[static_cast<uint32_t>(kind)]++; }
+
+	template <typename Handle>
+	void push(Kind kind, Handle handle, uint64_t lastFrame);
+
+	// Destroys every object whose last frame is at or before completedFrame.
+	void collect(uint64_t completedFrame);
+
+	// Destroys everything still queued. The device must be idle.
+	void flush();
+
+	size_t pendingCount() const { return m_pending.size(); }
+
+	// Writes per-kind created/destroyed counts and the largest backlog seen. Returns false, and
+	// lists the kinds concerned, if anything tracked was never destroyed.
+	bool report(std::ostream& out) const;
+
+	static const char* kindName(Kind kind);
+
+private:
+	struct Entry
+	{
+		Kind kind;
+		uint64_t handle;
+		uint64_t lastFrame;
+	};
+
+	void destroy(const Entry& entry);
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	const DeviceDispatch* m_dispatch = nullptr;
+	const VkAllocationCallbacks* m_allocator = nullptr;
+	DeviceMemoryTracker* m_memoryTracker = nullptr;
+	std::deque<Entry> m_pending;
+
+	uint64_t m_created[static_cast<uint32_t>(Kind::Count)] = {};
+	uint64_t m_destroyed[static_cast<uint32_t>(Kind::Count)] = {};
+	size_t m_peakPending = 0;
+	uint64_t m_collects = 0;
+	uint64_t m_maxLatency = 0;	// largest gap, in frames, between an object's last use and its collection
+};
+
+template <typename Handle>
+void DeletionQueue::push(Kind kind, Handle handle, uint64_t lastFrame)
+{
+	// Null handles are valid to destroy, so they're simply not queued.
+	if (handle == VK_NULL_HANDLE)
+		return;
+
+	// Kept sorted by frame so collect() can stop at the first entry that isn't due. Pushes are
+	// nearly always in order, so the search starts from the back.
+	auto position = m_pending.end();
+	while (position != m_pending.begin() && std::prev(position)->lastFrame > lastFrame)
+		--position;
+
+	// Non-dispatchable handles are pointers on 64-bit targets and uint64_t elsewhere.
+	m_pending.insert(position, { kind, (uint64_t)handle, lastFrame });
+	if (m_pending.size() > m_peakPending)
+		m_peakPending = m_pending.size();
+}
@@ -0,0 +1,141 @@
+#include "DeviceDispatch.h"
+
+#include <stdexcept>
+#include <string>
+
+template <typename T>
+static void loadCommand(T& command, VkDevice device, const char* name, T loaderExport, bool direct)
+{
+	command = direct ? reinterpret_cast<T>(vkGetDeviceProcAddr(device, name)) : loaderExport;
+	if (!command)
+		throw std::runtime_error(std::string("failed to load ") + name + "!");
+}
+
+template <typename T>
+static void loadExtensionCommand(T& command, VkDevice device, const char* name)
+{
+	command = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+	if (!command)
+		throw std::runtime_error(std::string("failed to load ") + name + "!");
+}
+
+#define LOAD_COMMAND(member, name) loadCommand(member, device, #name, &name, direct)
+
+void DeviceDispatch::load(VkDevice device, bool direct, const Extensions& extensions)
+{
+	this->direct = direct;
+
+	LOAD_COMMAND(destroyDevice, vkDestroyDevice);
+	LOAD_COMMAND(getDeviceQueue, vkGetDeviceQueue);
+	LOAD_COMMAND(deviceWaitIdle, vkDeviceWaitIdle);
+	LOAD_COMMAND(queueSubmit, vkQueueSubmit);
+	LOAD_COMMAND(queueWaitIdle, vkQueueWaitIdle);
+	LOAD_COMMAND(createFence, vkCreateFence);
+	LOAD_COMMAND(destroyFence, vkDestroyFence);
+	LOAD_COMMAND(waitForFences, vkWaitForFences);
+	LOAD_COMMAND(resetFences, vkResetFences);
+	LOAD_COMMAND(createSemaphore, vkCreateSemaphore);
+	LOAD_COMMAND(destroySemaphore, vkDestroySemaphore);
+
+	LOAD_COMMAND(allocateMemory, vkAllocateMemory);
+	LOAD_COMMAND(freeMemory, vkFreeMemory);
+	LOAD_COMMAND(mapMemory, vkMapMemory);
+	LOAD_COMMAND(unmapMemory, vkUnmapMemory);
+	LOAD_COMMAND(createBuffer, vkCreateBuffer);
+	LOAD_COMMAND(destroyBuffer, vkDestroyBuffer);
+	LOAD_COMMAND(getBufferMemoryRequirements, vkGetBufferMemoryRequirements);
+	LOAD_COMMAND(bindBufferMemory, vkBindBufferMemory);
+	LOAD_COMMAND(createImage, vkCreateImage);
+	LOAD_COMMAND(destroyImage, vkDestroyImage);
+	LOAD_COMMAND(getImageMemoryRequirements, vkGetImageMemoryRequirements);
+	LOAD_COMMAND(bindImageMemory, vkBindImageMemory);
+	LOAD_COMMAND(createImageView, vkCreateImageView);
+	LOAD_COMMAND(destroyImageView, vkDestroyImageView);
+	LOAD_COMMAND(createSampler, vkCreateSampler);
+	LOAD_COMMAND(destroySampler, vkDestroySampler);
+
+	LOAD_COMMAND(createShaderModule, vkCreateShaderModule);
+	LOAD_COMMAND(destroyShaderModule, vkDestroyShaderModule);
+	LOAD_COMMAND(createRenderPass, vkCreateRenderPass);
+	LOAD_COMMAND(destroyRenderPass, vkDestroyRenderPass);
+	LOAD_COMMAND(createFramebuffer, vkCreateFramebuffer);
+	LOAD_COMMAND(destroyFramebuffer, vkDestroyFramebuffer);
+	LOAD_COMMAND(createPipelineLayout, vkCreatePipelineLayout);
+	LOAD_COMMAND(destroyPipelineLayout, vkDestroyPipelineLayout);
+	LOAD_COMMAND(createGraphicsPipelines, vkCreateGraphicsPipelines);
+	LOAD_COMMAND(createComputePipelines, vkCreateComputePipelines);
+	LOAD_COMMAND(destroyPipeline, vkDestroyPipeline);
+	LOAD_COMMAND(createDescriptorSetLayout, vkCreateDescriptorSetLayout);
+	LOAD_COMMAND(destroyDescriptorSetLayout, vkDestroyDescriptorSetLayout);
+	LOAD_COMMAND(createDescriptorPool, vkCreateDescriptorPool);
+	LOAD_COMMAND(destroyDescriptorPool, vkDestroyDescriptorPool);
+	LOAD_COMMAND(allocateDescriptorSets, vkAllocateDescriptorSets);
+	LOAD_COMMAND(updateDescriptorSets, vkUpdateDescriptorSets);
+	LOAD_COMMAND(createQueryPool, vkCreateQueryPool);
+	LOAD_COMMAND(destroyQueryPool, vkDestroyQueryPool);
+	LOAD_COMMAND(getQueryPoolResults, vkGetQueryPoolResults);
+
+	LOAD_COMMAND(createCommandPool, vkCreateCommandPool);
+	LOAD_COMMAND(destroyCommandPool, vkDestroyCommandPool);
+	LOAD_COMMAND(resetCommandPool, vkResetCommandPool);
+	LOAD_COMMAND(allocateCommandBuffers, vkAllocateCommandBuffers);
+	LOAD_COMMAND(freeCommandBuffers, vkFreeCommandBuffers);
+	LOAD_COMMAND(beginCommandBuffer, vkBeginCommandBuffer);
+	LOAD_COMMAND(endCommandBuffer, vkEndCommandBuffer);
+	LOAD_COMMAND(cmdBeginRenderPass, vkCmdBeginRenderPass);
+	LOAD_COMMAND(cmdEndRenderPass, vkCmdEndRenderPass);
+	LOAD_COMMAND(cmdBindPipeline, vkCmdBindPipeline);
+	LOAD_COMMAND(cmdSetViewport, vkCmdSetViewport);
+	LOAD_COMMAND(cmdSetScissor, vkCmdSetScissor);
+	LOAD_COMMAND(cmdBindDescriptorSets, vkCmdBindDescriptorSets);
+	LOAD_COMMAND(cmdBindVertexBuffers, vkCmdBindVertexBuffers);
+	LOAD_COMMAND(cmdBindIndexBuffer, vkCmdBindIndexBuffer);
+	LOAD_COMMAND(cmdPushConstants, vkCmdPushConstants);
+	LOAD_COMMAND(cmdDrawIndexed, vkCmdDrawIndexed);
+	LOAD_COMMAND(cmdDrawIndexedIndirect, vkCmdDrawIndexedIndirect);
+	LOAD_COMMAND(cmdDispatch, vkCmdDispatch);
+	LOAD_COMMAND(cmdPipelineBarrier, vkCmdPipelineBarrier);
+	LOAD_COMMAND(cmdFillBuffer, vkCmdFillBuffer);
+	LOAD_COMMAND(cmdCopyBuffer, vkCmdCopyBuffer);
+	LOAD_COMMAND(cmdCopyBufferToImage, vkCmdCopyBufferToImage);
+	LOAD_COMMAND(cmdCopyImageToBuffer, vkCmdCopyImageToBuffer);
+	LOAD_COMMAND(cmdBlitImage, vkCmdBlitImage);
+	LOAD_COMMAND(cmdResetQueryPool, vkCmdResetQueryPool);
+	LOAD_COMMAND(cmdWriteTimestamp, vkCmdWriteTimestamp);
+	LOAD_COMMAND(cmdBeginQuery, vkCmdBeginQuery);
+	LOAD_COMMAND(cmdEndQuery, vkCmdEndQuery);
+
+	createSwapchainKHR = nullptr;
+	destroySwapchainKHR = nullptr;
+	getSwapchainImagesKHR = nullptr;
+	acquireNextImageKHR = nullptr;
+	queuePresentKHR = nullptr;
+	if (extensions.swapchain)
+	{
+		LOAD_COMMAND(createSwapchainKHR, vkCreateSwapchainKHR);
+		LOAD_COMMAND(destroySwapchainKHR, vkDestroySwapchainKHR);
+		LOAD_COMMAND(getSwapchainImagesKHR, vkGetSwapchainImagesKHR);
+		LOAD_COMMAND(acquireNextImageKHR, vkAcquireNextImageKHR);
+		LOAD_COMMAND(queuePresentKHR, vkQueuePresentKHR);
+	}
+
+	cmdDrawIndexedIndirectCount = nullptr;
+	if (extensions.drawIndirectCount)
+		loadExtensionCommand(cmdDrawIndexedIndirectCount, device, "vkCmdDrawIndexedIndirectCountKHR");
+
+	setDebugUtilsObjectNameEXT = nullptr;
+	if (extensions.debugUtils)
+		loadExtensionCommand(setDebugUtilsObjectNameEXT, device, "vkSetDebugUtilsObjectNameEXT");
+
+	getCalibratedTimestampsEXT = nullptr;
+	if (extensions.calibratedTimestamps)
+		loadExtensionCommand(getCalibratedTimestampsEXT, device, "vkGetCalibratedTimestampsEXT");
+}
+
+void InstanceDispatch::load(VkInstance instance)
+{
+	createDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT"));
+	destroyDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT"));
+	getPhysicalDeviceCalibrateableTimeDomainsEXT = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+		vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+}
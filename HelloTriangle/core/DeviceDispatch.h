@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Every device-level command the renderer calls, loaded once per device. The vk* functions the
+// loader exports are trampolines that find the device's dispatch table on every call;
+// vkGetDeviceProcAddr returns the first layer's or the driver's entry point, so going through
+// this table skips that hop. It counts most on draw-heavy frames, with thousands of binds and
+// draws per command buffer, but creation, upload and teardown use the table too so there is one
+// way to reach the device.
+//
+// load() with direct off fills the core commands with the loader's exports instead, so the
+// overhead can be compared on one build. Extension commands always come from the device.
+struct DeviceDispatch
+{
+	// Which device extensions load() should expect. debugUtils is the instance extension
+	// VK_EXT_debug_utils, whose object naming command is device-level.
+	struct Extensions
+	{
+		bool swapchain = false;
+		bool drawIndirectCount = false;
+		bool debugUtils = false;
+		bool calibratedTimestamps = false;
+	};
+
+	// Queues and synchronization
+	PFN_vkDestroyDevice destroyDevice = nullptr;
+	PFN_vkGetDeviceQueue getDeviceQueue = nullptr;
+	PFN_vkDeviceWaitIdle deviceWaitIdle = nullptr;
+	PFN_vkQueueSubmit queueSubmit = nullptr;
+	PFN_vkQueueWaitIdle queueWaitIdle = nullptr;
+	PFN_vkCreateFence createFence = nullptr;
+	PFN_vkDestroyFence destroyFence = nullptr;
+	PFN_vkWaitForFences waitForFences = nullptr;
+	PFN_vkResetFences resetFences = nullptr;
+	PFN_vkCreateSemaphore createSemaphore = nullptr;
+	PFN_vkDestroySemaphore destroySemaphore = nullptr;
+
+	// Memory and resources
+	PFN_vkAllocateMemory allocateMemory = nullptr;
+	PFN_vkFreeMemory freeMemory = nullptr;
+	PFN_vkMapMemory mapMemory = nullptr;
+	PFN_vkUnmapMemory unmapMemory = nullptr;
+	PFN_vkCreateBuffer createBuffer = nullptr;
+	PFN_vkDestroyBuffer destroyBuffer = nullptr;
+	PFN_vkGetBufferMemoryRequirements getBufferMemoryRequirements = nullptr;
+	PFN_vkBindBufferMemory bindBufferMemory = nullptr;
+	PFN_vkCreateImage createImage = nullptr;
+	PFN_vkDestroyImage destroyImage = nullptr;
+	PFN_vkGetImageMemoryRequirements getImageMemoryRequirements = nullptr;
+	PFN_vkBindImageMemory bindImageMemory = nullptr;
+	PFN_vkCreateImageView createImageView = nullptr;
+	PFN_vkDestroyImageView destroyImageView = nullptr;
+	PFN_vkCreateSampler createSampler = nullptr;
+	PFN_vkDestroySampler destroySampler = nullptr;
+
+	// Pipelines and descriptors
+	PFN_vkCreateShaderModule createShaderModule = nullptr;
+	PFN_vkDestroyShaderModule destroyShaderModule = nullptr;
+	PFN_vkCreateRenderPass createRenderPass = nullptr;
+	PFN_vkDestroyRenderPass destroyRenderPass = nullptr;
+	PFN_vkCreateFramebuffer createFramebuffer = nullptr;
+	PFN_vkDestroyFramebuffer destroyFramebuffer = nullptr;
+	PFN_vkCreatePipelineLayout createPipelineLayout = nullptr;
+	PFN_vkDestroyPipelineLayout destroyPipelineLayout = nullptr;
+	PFN_vkCreateGraphicsPipelines createGraphicsPipelines = nullptr;
+	PFN_vkCreateComputePipelines createComputePipelines = nullptr;
+	PFN_vkDestroyPipeline destroyPipeline = nullptr;
+	PFN_vkCreateDescriptorSetLayout createDescriptorSetLayout = nullptr;
+	PFN_vkDestroyDescriptorSetLayout destroyDescriptorSetLayout = nullptr;
+	PFN_vkCreateDescriptorPool createDescriptorPool = nullptr;
+	PFN_vkDestroyDescriptorPool destroyDescriptorPool = nullptr;
+	PFN_vkAllocateDescriptorSets allocateDescriptorSets = nullptr;
+	PFN_vkUpdateDescriptorSets updateDescriptorSets = nullptr;
+	PFN_vkCreateQueryPool createQueryPool = nullptr;
+	PFN_vkDestroyQueryPool destroyQueryPool = nullptr;
+	PFN_vkGetQueryPoolResults getQueryPoolResults = nullptr;
+
+	// Command buffers
+	PFN_vkCreateCommandPool createCommandPool = nullptr;
+	PFN_vkDestroyCommandPool destroyCommandPool = nullptr;
+	PFN_vkResetCommandPool resetCommandPool = nullptr;
+	PFN_vkAllocateCommandBuffers allocateCommandBuffers = nullptr;
+	PFN_vkFreeCommandBuffers freeCommandBuffers = nullptr;
+	PFN_vkBeginCommandBuffer beginCommandBuffer = nullptr;
+	PFN_vkEndCommandBuffer endCommandBuffer = nullptr;
+	PFN_vkCmdBeginRenderPass cmdBeginRenderPass = nullptr;
+	PFN_vkCmdEndRenderPass cmdEndRenderPass = nullptr;
+	PFN_vkCmdBindPipeline cmdBindPipeline = nullptr;
+	PFN_vkCmdSetViewport cmdSetViewport = nullptr;
+	PFN_vkCmdSetScissor cmdSetScissor = nullptr;
+	PFN_vkCmdBindDescriptorSets cmdBindDescriptorSets = nullptr;
+	PFN_vkCmdBindVertexBuffers cmdBindVertexBuffers = nullptr;
+	PFN_vkCmdBindIndexBuffer cmdBindIndexBuffer = nullptr;
+	PFN_vkCmdPushConstants cmdPushConstants = nullptr;
+	PFN_vkCmdDrawIndexed cmdDrawIndexed = nullptr;
+	PFN_vkCmdDrawIndexedIndirect cmdDrawIndexedIndirect = nullptr;
+	PFN_vkCmdDispatch cmdDispatch = nullptr;
+	PFN_vkCmdPipelineBarrier cmdPipelineBarrier = nullptr;
+	PFN_vkCmdFillBuffer cmdFillBuffer = nullptr;
+	PFN_vkCmdCopyBuffer cmdCopyBuffer = nullptr;
+	PFN_vkCmdCopyBufferToImage cmdCopyBufferToImage = nullptr;
+	PFN_vkCmdCopyImageToBuffer cmdCopyImageToBuffer = nullptr;
+	PFN_vkCmdBlitImage cmdBlitImage = nullptr;
+	PFN_vkCmdResetQueryPool cmdResetQueryPool = nullptr;
+	PFN_vkCmdWriteTimestamp cmdWriteTimestamp = nullptr;
+	PFN_vkCmdBeginQuery cmdBeginQuery = nullptr;
+	PFN_vkCmdEndQuery cmdEndQuery = nullptr;
+
+	// Null unless load() was told the extension is enabled.
+	PFN_vkCreateSwapchainKHR createSwapchainKHR = nullptr;
+	PFN_vkDestroySwapchainKHR destroySwapchainKHR = nullptr;
+	PFN_vkGetSwapchainImagesKHR getSwapchainImagesKHR = nullptr;
+	PFN_vkAcquireNextImageKHR acquireNextImageKHR = nullptr;
+	PFN_vkQueuePresentKHR queuePresentKHR = nullptr;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+	PFN_vkSetDebugUtilsObjectNameEXT setDebugUtilsObjectNameEXT = nullptr;
+	PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestampsEXT = nullptr;
+
+	bool direct = false;
+
+	// Throws if a command that should be there isn't.
+	void load(VkDevice device, bool direct, const Extensions& extensions);
+};
+
+// The instance-level extension commands, loaded once through vkGetInstanceProcAddr. Each is null
+// when its extension isn't available.
+struct InstanceDispatch
+{
+	PFN_vkCreateDebugUtilsMessengerEXT createDebugUtilsMessengerEXT = nullptr;
+	PFN_vkDestroyDebugUtilsMessengerEXT destroyDebugUtilsMessengerEXT = nullptr;
+	PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getPhysicalDeviceCalibrateableTimeDomainsEXT = nullptr;
+
+	void load(VkInstance instance);
+};
@@ -0,0 +1,176 @@
+#include "DeviceMemoryTracker.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+static double megabytes(VkDeviceSize bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+static void writeUsage(std::ostream& out, const std::string& label, const DeviceMemoryTracker::Usage& usage)
+{
+	out << "  " << std::left << std::setw(28) << label << std::right
+		<< std::setw(11) << megabytes(usage.liveBytes)
+		<< std::setw(11) << megabytes(usage.peakBytes)
+		<< std::setw(7) << usage.liveCount
+		<< std::setw(9) << usage.allocations << std::endl;
+}
+
+void DeviceMemoryTracker::init(VkPhysicalDevice physicalDevice, VkDevice device, const DeviceDispatch& dispatch)
+{
+	if (m_device != VK_NULL_HANDLE)
+		throw std::logic_error("DeviceMemoryTracker: initialized twice!");
+
+	m_device = device;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_properties);
+	m_setObjectName = dispatch.setDebugUtilsObjectNameEXT;
+}
+
+void DeviceMemoryTracker::allocated(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, Category category, const std::string& name)
+{
+	if (memoryType >= m_properties.memoryTypeCount || category >= Category::Count)
+		throw std::invalid_argument("DeviceMemoryTracker: bad memory type or category for " + name + "!");
+
+	if (!m_live.emplace(memory, Allocation{ memory, size, memoryType, category, name }).second)
+		throw std::logic_error("DeviceMemoryTracker: " + name + " tracked twice!");
+
+	counted(m_total, size);
+	counted(m_categories[static_cast<uint32_t>(category)], size);
+	counted(m_types[memoryType], size);
+	counted(m_heaps[m_properties.memoryTypes[memoryType].heapIndex], size);
+
+	nameObject(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)memory, name);
+}
+
+void DeviceMemoryTracker::freed(VkDeviceMemory memory)
+{
+	auto it = m_live.find(memory);
+	if (it == m_live.end()) {
+		m_unknownFrees++;
+		return;
+	}
+
+	const Allocation& allocation = it->second;
+	released(m_total, allocation.size);
+	released(m_categories[static_cast<uint32_t>(allocation.category)], allocation.size);
+	released(m_types[allocation.memoryType], allocation.size);
+	released(m_heaps[m_properties.memoryTypes[allocation.memoryType].heapIndex], allocation.size);
+	m_live.erase(it);
+}
+
+void DeviceMemoryTracker::nameObject(VkObjectType type, uint64_t handle, const std::string& name) const
+{
+	if (!m_setObjectName || handle == 0)
+		return;
+
+	VkDebugUtilsObjectNameInfoEXT nameInfo{};
+	nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+	nameInfo.objectType = type;
+	nameInfo.objectHandle = handle;
+	nameInfo.pObjectName = name.c_str();
+	m_setObjectName(m_device, &nameInfo);
+}
+
+std::vector<DeviceMemoryTracker::Allocation> DeviceMemoryTracker::largest(size_t count) const
+{
+	std::vector<Allocation> allocations;
+	allocations.reserve(m_live.size());
+	for (const auto& entry : m_live)
+		allocations.push_back(entry.second);
+
+	// Ties go by name, so reports of the same scene compare line by line.
+	count = std::min(count, allocations.size());
+	std::partial_sort(allocations.begin(), allocations.begin() + count, allocations.end(), [](const Allocation& a, const Allocation& b) {
+		return a.size != b.size ? a.size > b.size : a.name < b.name;
+	});
+	allocations.resize(count);
+	return allocations;
+}
+
+void DeviceMemoryTracker::report(std::ostream& out, size_t largestCount) const
+{
+	if (m_device == VK_NULL_HANDLE)
+		return;
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "device memory:" << std::endl;
+	out << "  " << std::left << std::setw(28) << "" << std::right
+		<< std::setw(11) << "live MB" << std::setw(11) << "peak MB" << std::setw(7) << "live" << std::setw(9) << "allocs" << std::endl;
+	out << std::fixed << std::setprecision(2);
+
+	writeUsage(out, "total", m_total);
+	for (uint32_t category = 0; category < static_cast<uint32_t>(Category::Count); category++) {
+		if (m_categories[category].allocations > 0)
+			writeUsage(out, categoryName(static_cast<Category>(category)), m_categories[category]);
+	}
+
+	for (uint32_t heap = 0; heap < m_properties.memoryHeapCount; heap++) {
+		if (m_heaps[heap].allocations == 0)
+			continue;
+		const VkMemoryHeap& memoryHeap = m_properties.memoryHeaps[heap];
+		std::string label = "heap " + std::to_string(heap) + ((memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device)" : " (host)");
+		writeUsage(out, label, m_heaps[heap]);
+		out << "    " << 100.0 * m_heaps[heap].peakBytes / memoryHeap.size << "% of " << megabytes(memoryHeap.size) << " MB at peak" << std::endl;
+	}
+
+	for (uint32_t type = 0; type < m_properties.memoryTypeCount; type++) {
+		if (m_types[type].allocations == 0)
+			continue;
+		VkMemoryPropertyFlags properties = m_properties.memoryTypes[type].propertyFlags;
+		std::string label = "type " + std::to_string(type) + " ";
+		label += (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "D" : "-";
+		label += (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? "V" : "-";
+		label += (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) ? "C" : "-";
+		label += (properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? "H" : "-";
+		writeUsage(out, label, m_types[type]);
+	}
+
+	std::vector<Allocation> allocations = largest(largestCount);
+	if (!allocations.empty()) {
+		out << "  largest live allocations:" << std::endl;
+		for (const Allocation& allocation : allocations) {
+			out << "    " << std::setw(9) << megabytes(allocation.size) << " MB  " << std::left << std::setw(11) << categoryName(allocation.category)
+				<< std::right << allocation.name << " (type " << allocation.memoryType << ")" << std::endl;
+		}
+	}
+
+	if (m_unknownFrees > 0)
+		out << "  " << m_unknownFrees << " frees of memory that was never tracked" << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+const char* DeviceMemoryTracker::categoryName(Category category)
+{
+	switch (category) {
+	case Category::Vertex: return "vertex";
+	case Category::Index: return "index";
+	case Category::Uniform: return "uniform";
+	case Category::Storage: return "storage";
+	case Category::Indirect: return "indirect";
+	case Category::Staging: return "staging";
+	case Category::Readback: return "readback";
+	case Category::Texture: return "texture";
+	case Category::Attachment: return "attachment";
+	default: return "unknown";
+	}
+}
+
+void DeviceMemoryTracker::counted(Usage& usage, VkDeviceSize size)
+{
+	usage.liveBytes += size;
+	usage.peakBytes = std::max(usage.peakBytes, usage.liveBytes);
+	usage.liveCount++;
+	usage.allocations++;
+}
+
+void DeviceMemoryTracker::released(Usage& usage, VkDeviceSize size)
+{
+	usage.liveBytes -= size;
+	usage.liveCount--;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "DeviceDispatch.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every VkDeviceMemory allocation with what it's for: a category and a debug name, its size and
+// the memory type and heap it came from. Live and peak bytes and allocation counts are kept per
+// category, per memory type, per heap and in total, and can be queried at any time; report()
+// prints them along with the largest live allocations.
+//
+// Names also go to the driver through VK_EXT_debug_utils when the instance has it enabled, so
+// validation messages and capture tools show them: allocated() names the memory object, and
+// nameObject() is there for the buffer or image bound to it.
+//
+// Allocations are one per resource here, so a record per VkDeviceMemory is all it takes; the
+// DeletionQueue calls freed() as it frees them.
+//
+// Not thread safe; everything is expected on the render thread.
+class DeviceMemoryTracker
+{
+public:
+	enum class Category : uint32_t
+	{
+		Vertex,
+		Index,
+		Uniform,
+		Storage,
+		Indirect,
+		Staging,
+		Readback,
+		Texture,
+		Attachment,
+		Count
+	};
+
+	struct Usage
+	{
+		VkDeviceSize liveBytes = 0;
+		VkDeviceSize peakBytes = 0;
+		uint64_t liveCount = 0;
+		uint64_t allocations = 0;
+	};
+
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryType = 0;
+		Category category = Category::Count;
+		std::string name;
+	};
+
+public:
+	DeviceMemoryTracker() = default;
+
+	DeviceMemoryTracker(const DeviceMemoryTracker&) = delete;
+	DeviceMemoryTracker& operator=(const DeviceMemoryTracker&) = delete;
+
+	// Objects are named through dispatch's vkSetDebugUtilsObjectNameEXT, so naming is off unless
+	// it was loaded with VK_EXT_debug_utils.
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const DeviceDispatch& dispatch);
+
+	void allocated(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, Category category, const std::string& name);
+	void freed(VkDeviceMemory memory);
+
+	// Does nothing without debug names.
+	void nameObject(VkObjectType type, uint64_t handle, const std::string& name) const;
+
+	const Usage& total() const { return m_total; }
+	const Usage& category(Category category) const { return m_categories[static_cast<uint32_t>(category)]; }
+	const Usage& memoryType(uint32_t memoryType) const { return m_types[memoryType]; }
+	const Usage& heap(uint32_t heap) const { return m_heaps[heap]; }
+	uint32_t memoryTypeCount() const { return m_properties.memoryTypeCount; }
+	uint32_t heapCount() const { return m_properties.memoryHeapCount; }
+
+	// Live allocations, largest first.
+	std::vector<Allocation> largest(size_t count) const;
+
+	// Usage per category, heap and memory type, then the largest live allocations.
+	void report(std::ostream& out, size_t largestCount = 10) const;
+
+	static const char* categoryName(Category category);
+
+private:
+	static void counted(Usage& usage, VkDeviceSize size);
+	static void released(Usage& usage, VkDeviceSize size);
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_properties{};
+	PFN_vkSetDebugUtilsObjectNameEXT m_setObjectName = nullptr;
+
+	std::unordered_map<VkDeviceMemory, Allocation> m_live;
+	Usage m_total;
+	Usage m_categories[static_cast<uint32_t>(Category::Count)];
+	Usage m_types[VK_MAX_MEMORY_TYPES];
+	Usage m_heaps[VK_MAX_MEMORY_HEAPS];
+	uint64_t m_unknownFrees = 0;
+};
@@ -0,0 +1,241 @@
+#include "DeviceProfile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+static std::string formatUuid(const uint8_t* uuid)
+{
+	static const char* digits = "0123456789abcdef";
+
+	std::string result;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+			result += '-';
+		result += digits[uuid[i] >> 4];
+		result += digits[uuid[i] & 0xf];
+	}
+	return result;
+}
+
+static std::string lowercase(std::string text, bool dropDashes)
+{
+	if (dropDashes)
+		text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return text;
+}
+
+DeviceProfile DeviceProfile::query(VkPhysicalDevice device)
+{
+	DeviceProfile profile;
+	profile.device = device;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	profile.name = properties.deviceName;
+	profile.type = properties.deviceType;
+	profile.apiVersion = properties.apiVersion;
+	profile.driverVersion = properties.driverVersion;
+	profile.vendorId = properties.vendorID;
+	profile.deviceId = properties.deviceID;
+	profile.timestampPeriod = properties.limits.timestampPeriod;
+	profile.maxImageDimension2D = properties.limits.maxImageDimension2D;
+
+	if (properties.apiVersion >= VK_API_VERSION_1_1) {
+		VkPhysicalDeviceIDProperties idProperties{};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &idProperties;
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+
+		profile.uuid = formatUuid(idProperties.deviceUUID);
+	}
+
+	VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	for (VkSampleCountFlags samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+		if (counts & samples) {
+			profile.maxSamples = static_cast<VkSampleCountFlagBits>(samples);
+			break;
+		}
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+		if (!(memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+			continue;
+
+		VkDeviceSize size = memoryProperties.memoryHeaps[heap].size;
+		profile.deviceLocalBytes = std::max(profile.deviceLocalBytes, size);
+
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			const VkMemoryType& memoryType = memoryProperties.memoryTypes[i];
+			if (memoryType.heapIndex == heap && (memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+				profile.hostVisibleDeviceLocalBytes = std::max(profile.hostVisibleDeviceLocalBytes, size);
+		}
+	}
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	profile.queueFamilyCount = queueFamilyCount;
+	bool graphicsSeen = false;
+	for (const VkQueueFamilyProperties& family : queueFamilies) {
+		bool graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		bool compute = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		bool transfer = (family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+		if (transfer && !graphics && !compute)
+			profile.dedicatedTransferQueue = true;
+		if (compute && !graphics)
+			profile.asyncComputeQueue = true;
+		if (graphics && !graphicsSeen) {
+			profile.timestampValidBits = family.timestampValidBits;
+			graphicsSeen = true;
+		}
+	}
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(device, &features);
+
+	profile.multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+	profile.drawIndirectFirstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+	profile.pipelineStatisticsQuery = features.pipelineStatisticsQuery == VK_TRUE;
+	profile.samplerAnisotropy = features.samplerAnisotropy == VK_TRUE;
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	for (const VkExtensionProperties& extension : extensions) {
+		if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+			profile.drawIndirectCount = true;
+	}
+
+	return profile;
+}
+
+int64_t DeviceProfile::score() const
+{
+	int64_t score = 0;
+
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 100000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 50000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 20000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 1000; break;
+	default: break;
+	}
+
+	// 100 per GiB of VRAM, so memory only separates devices of the same type.
+	score += static_cast<int64_t>(deviceLocalBytes / (1024 * 1024 * 1024 / 100));
+
+	if (dedicatedTransferQueue)
+		score += 500;
+	if (asyncComputeQueue)
+		score += 500;
+
+	// The GPU-driven path draws everything with one indirect call when these are there.
+	if (multiDrawIndirect)
+		score += 1000;
+	if (drawIndirectFirstInstance)
+		score += 500;
+	if (drawIndirectCount)
+		score += 500;
+	if (timestampValidBits > 0)
+		score += 200;
+	if (pipelineStatisticsQuery)
+		score += 100;
+
+	for (uint32_t samples = maxSamples; samples > 1; samples >>= 1)
+		score += 100;
+
+	return score;
+}
+
+VkSampleCountFlagBits DeviceProfile::suggestedSamples() const
+{
+	uint32_t limit = maxSamples;
+	if (type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || type == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU)
+		limit = std::min<uint32_t>(limit, VK_SAMPLE_COUNT_4_BIT);
+	else if (type == VK_PHYSICAL_DEVICE_TYPE_CPU)
+		limit = std::min<uint32_t>(limit, VK_SAMPLE_COUNT_2_BIT);
+
+	return static_cast<VkSampleCountFlagBits>(limit);
+}
+
+bool DeviceProfile::matches(const std::string& selector) const
+{
+	if (!uuid.empty() && lowercase(selector, true) == lowercase(uuid, true))
+		return true;
+
+	return lowercase(name, false).find(lowercase(selector, false)) != std::string::npos;
+}
+
+void DeviceProfile::write(std::ostream& out) const
+{
+	out << "device: " << name << " (" << typeName(type) << "), Vulkan "
+		<< VK_VERSION_MAJOR(apiVersion) << "." << VK_VERSION_MINOR(apiVersion) << "." << VK_VERSION_PATCH(apiVersion)
+		<< ", vendor 0x" << std::hex << vendorId << ", device 0x" << deviceId << ", driver 0x" << driverVersion << std::dec << std::endl;
+	if (!uuid.empty())
+		out << "  uuid " << uuid << std::endl;
+
+	out << "  memory: " << deviceLocalBytes / (1024 * 1024) << " MB device local, "
+		<< hostVisibleDeviceLocalBytes / (1024 * 1024) << " MB of it host visible" << std::endl;
+	out << "  queues: " << queueFamilyCount << " families"
+		<< (dedicatedTransferQueue ? ", dedicated transfer" : "")
+		<< (asyncComputeQueue ? ", async compute" : "")
+		<< ", " << timestampValidBits << "-bit timestamps at " << timestampPeriod << " ns" << std::endl;
+	out << "  features: " << maxSamples << "x MSAA, " << maxImageDimension2D << " max image size"
+		<< ", multiDrawIndirect " << (multiDrawIndirect ? "yes" : "no")
+		<< ", drawIndirectFirstInstance " << (drawIndirectFirstInstance ? "yes" : "no")
+		<< ", drawIndirectCount " << (drawIndirectCount ? "yes" : "no")
+		<< ", pipeline statistics " << (pipelineStatisticsQuery ? "yes" : "no") << std::endl;
+	out << "  score " << score() << ", suggested " << suggestedSamples() << "x MSAA" << std::endl;
+}
+
+const char* DeviceProfile::typeName(VkPhysicalDeviceType type)
+{
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+	default: return "other";
+	}
+}
+
+size_t chooseDevice(const std::vector<DeviceProfile>& profiles, const std::string& selector)
+{
+	size_t chosen = profiles.size();
+
+	for (size_t i = 0; i < profiles.size(); i++) {
+		if (!profiles[i].suitable)
+			continue;
+
+		if (!selector.empty()) {
+			if (profiles[i].matches(selector))
+				return i;
+		}
+		else if (chosen == profiles.size() || profiles[i].score() > profiles[chosen].score()) {
+			chosen = i;
+		}
+	}
+
+	if (chosen == profiles.size()) {
+		if (!selector.empty())
+			throw std::runtime_error("failed to find a suitable GPU matching \"" + selector + "\"!");
+		throw std::runtime_error("failed to find a suitable GPU!");
+	}
+
+	return chosen;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The capabilities of a physical device that matter for choosing it and for picking performance
+// settings on it, gathered in one place.
+//
+// score() ranks devices: device type first, so a discrete GPU beats an integrated one beats a
+// software rasterizer, then VRAM, queue topology and the optional features the renderer uses.
+struct DeviceProfile
+{
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	std::string name;
+	std::string uuid;	// as printed by vulkaninfo, empty for Vulkan 1.0 devices
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	uint32_t apiVersion = 0;
+	uint32_t driverVersion = 0;
+	uint32_t vendorId = 0;
+	uint32_t deviceId = 0;
+
+	VkDeviceSize deviceLocalBytes = 0;		// largest device-local heap
+	VkDeviceSize hostVisibleDeviceLocalBytes = 0;	// largest device-local heap the host can map
+
+	uint32_t queueFamilyCount = 0;
+	bool dedicatedTransferQueue = false;	// transfer without graphics or compute
+	bool asyncComputeQueue = false;			// compute without graphics
+	uint32_t timestampValidBits = 0;		// on the first graphics family
+	float timestampPeriod = 0.0f;
+
+	VkSampleCountFlagBits maxSamples = VK_SAMPLE_COUNT_1_BIT;
+	uint32_t maxImageDimension2D = 0;
+	bool multiDrawIndirect = false;
+	bool drawIndirectFirstInstance = false;
+	bool drawIndirectCount = false;
+	bool pipelineStatisticsQuery = false;
+	bool samplerAnisotropy = false;
+
+	bool suitable = false;	// set by the caller, which knows what the renderer requires
+
+	static DeviceProfile query(VkPhysicalDevice device);
+
+	int64_t score() const;
+
+	// MSAA worth paying for on this class of device: everything on discrete GPUs, at most 4x on
+	// integrated and virtual ones and 2x on the CPU.
+	VkSampleCountFlagBits suggestedSamples() const;
+
+	// A UUID (dashes optional) or a case-insensitive part of the name.
+	bool matches(const std::string& selector) const;
+
+	void write(std::ostream& out) const;
+
+	static const char* typeName(VkPhysicalDeviceType type);
+};
+
+// Index of the suitable profile with the highest score, or of the first suitable one matching a
+// non-empty selector. Throws if there is none.
+size_t chooseDevice(const std::vector<DeviceProfile>& profiles, const std::string& selector);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reads a whole file, e.g. SPIR-V, into memory. Throws if it can't be opened.
+std::vector<char> readFile(const std::string& filename);
@@ -0,0 +1,230 @@
+#include "FrameWriter.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_MODE "wb"
+#else
+#define PIPE_MODE "w"
+#endif
+
+FrameWriter::~FrameWriter()
+{
+	// Errors can't be reported from here; call finish() to see them.
+	if (isActive()) {
+		try {
+			finish();
+		}
+		catch (...) {
+		}
+	}
+}
+
+FrameWriter::Format FrameWriter::formatForPath(const std::string& path)
+{
+	auto endsWith = [&](const char* suffix) {
+		size_t length = std::char_traits<char>::length(suffix);
+		return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+	};
+
+	if (endsWith(".png"))
+		return Format::Png;
+	if (endsWith(".ppm"))
+		return Format::Ppm;
+	return Format::Raw;
+}
+
+void FrameWriter::start(const std::string& target, Format format, uint32_t width, uint32_t height, bool bgra, uint32_t slotCount)
+{
+	if (isActive())
+		throw std::logic_error("FrameWriter: already started!");
+
+	m_target = target;
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_bgra = bgra;
+	m_slotCount = slotCount;
+
+	m_freeSlots.clear();
+	for (uint32_t i = 0; i < slotCount; i++)
+		m_freeSlots.push_back(i);
+
+	if (m_format == Format::Pipe) {
+		m_pipe = popen(m_target.c_str(), PIPE_MODE);
+		if (!m_pipe)
+			throw std::runtime_error("failed to start output command!");
+	}
+
+	m_converted.resize(static_cast<size_t>(width) * height * 4);
+	m_stopping = false;
+	m_thread = std::thread(&FrameWriter::writerLoop, this);
+}
+
+void FrameWriter::rethrowError()
+{
+	// Called with m_mutex held.
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+uint32_t FrameWriter::acquireSlot()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	rethrowError();
+
+	if (m_freeSlots.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		m_wake.wait(lock, [&]() { return !m_freeSlots.empty() || m_error; });
+		m_stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		rethrowError();
+	}
+
+	uint32_t slot = m_freeSlots.front();
+	m_freeSlots.pop_front();
+	return slot;
+}
+
+void FrameWriter::submit(uint32_t slot, const void* pixels, uint64_t frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	rethrowError();
+
+	if (m_framesSubmitted++ == 0)
+		m_firstSubmit = std::chrono::steady_clock::now();
+
+	m_jobs.push_back({ slot, static_cast<const uint8_t*>(pixels), frame });
+	m_peakQueued = std::max(m_peakQueued, m_jobs.size());
+	m_wake.notify_all();
+}
+
+void FrameWriter::finish()
+{
+	if (!isActive())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		m_wake.notify_all();
+	}
+	m_thread.join();
+
+	if (m_framesWritten > 0)
+		m_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_firstSubmit).count();
+
+	if (m_pipe) {
+		pclose(m_pipe);
+		m_pipe = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	rethrowError();
+}
+
+void FrameWriter::writerLoop()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return !m_jobs.empty() || m_stopping; });
+
+			if (m_jobs.empty())
+				return;
+
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		std::exception_ptr error;
+		size_t size = 0;
+		try {
+			size = writeFrame(job);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_freeSlots.push_back(job.slot);
+		m_wake.notify_all();
+
+		if (!error) {
+			m_framesWritten++;
+			m_bytesWritten += size;
+		}
+
+		if (error) {
+			m_error = error;
+			m_jobs.clear();
+			return;
+		}
+	}
+}
+
+size_t FrameWriter::writeFrame(const Job& job)
+{
+	size_t pixelCount = static_cast<size_t>(m_width) * m_height;
+	uint32_t channels = m_format == Format::Ppm ? 3 : 4;
+
+	// The source is uncached device-visible memory in the worst case, so it's read exactly once.
+	const uint8_t* src = job.pixels;
+	uint8_t* dst = m_converted.data();
+	uint32_t r = m_bgra ? 2 : 0;
+	uint32_t b = m_bgra ? 0 : 2;
+	for (size_t i = 0; i < pixelCount; i++, src += 4, dst += channels) {
+		dst[0] = src[r];
+		dst[1] = src[1];
+		dst[2] = src[b];
+		if (channels == 4)
+			dst[3] = src[3];
+	}
+
+	size_t size = pixelCount * channels;
+
+	if (m_format == Format::Pipe) {
+		if (fwrite(m_converted.data(), 1, size, m_pipe) != size)
+			throw std::runtime_error("failed to write frame to output command!");
+	}
+	else {
+		std::vector<char> path(m_target.size() + 32);
+		snprintf(path.data(), path.size(), m_target.c_str(), static_cast<int>(job.frame));
+
+		if (m_format == Format::Png) {
+			if (!stbi_write_png(path.data(), m_width, m_height, 4, m_converted.data(), m_width * 4))
+				throw std::runtime_error("failed to write " + std::string(path.data()) + "!");
+		}
+		else {
+			FILE* file = fopen(path.data(), "wb");
+			if (!file)
+				throw std::runtime_error("failed to open " + std::string(path.data()) + "!");
+
+			if (m_format == Format::Ppm)
+				fprintf(file, "P6\n%u %u\n255\n", m_width, m_height);
+
+			size_t written = fwrite(m_converted.data(), 1, size, file);
+			fclose(file);
+			if (written != size)
+				throw std::runtime_error("failed to write " + std::string(path.data()) + "!");
+		}
+	}
+
+	return size;
+}
+
+void FrameWriter::report(std::ostream& out) const
+{
+	double fps = m_elapsed > 0.0 ? m_framesWritten / m_elapsed : 0.0;
+	double megabytesPerSecond = m_elapsed > 0.0 ? m_bytesWritten / m_elapsed / 1e6 : 0.0;
+
+	out << "readback: " << m_framesWritten << " frames, " << m_bytesWritten / 1e6 << " MB in " << m_elapsed << " s ("
+		<< fps << " fps, " << megabytesPerSecond << " MB/s), " << m_slotCount << " slots, peak queue " << m_peakQueued
+		<< ", render thread stalled " << m_stallMilliseconds << " ms" << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams rendered frames to disk, or to another process, from a background thread.
+//
+// Frames are read straight out of the caller's persistently mapped readback buffers, called slots.
+// The caller takes a free slot with acquireSlot() before recording a frame's copy. Once the frame's
+// fence has signaled, it hands the slot over with submit(). The slot becomes free again after the
+// writer is done with it, so the render loop only waits when the writer falls behind by every
+// slot. Errors on the writer thread are rethrown from the next call on the render thread.
+class FrameWriter
+{
+public:
+	enum class Format { Raw, Ppm, Png, Pipe };
+
+public:
+	FrameWriter() = default;
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	// For files, target is a printf pattern with one integer conversion for the frame number,
+	// e.g. "frames/%05d.png". For Pipe it is a shell command that reads raw RGBA8 frames from
+	// stdin. Source pixels are 8-bit RGBA, or BGRA when bgra is set; every output is RGB(A).
+	void start(const std::string& target, Format format, uint32_t width, uint32_t height, bool bgra, uint32_t slotCount);
+
+	uint32_t acquireSlot();
+	void submit(uint32_t slot, const void* pixels, uint64_t frame);
+
+	// Writes everything submitted so far and stops the writer thread.
+	void finish();
+
+	bool isActive() const { return m_thread.joinable(); }
+	void report(std::ostream& out) const;
+
+	// Png and Ppm by extension, Raw for anything else.
+	static Format formatForPath(const std::string& path);
+
+private:
+	struct Job
+	{
+		uint32_t slot;
+		const uint8_t* pixels;
+		uint64_t frame;
+	};
+
+	void writerLoop();
+	size_t writeFrame(const Job& job);	// returns the number of bytes written
+	void rethrowError();
+
+private:
+	std::string m_target;
+	Format m_format = Format::Raw;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	bool m_bgra = false;
+	uint32_t m_slotCount = 0;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<uint32_t> m_freeSlots;
+	std::deque<Job> m_jobs;
+	bool m_stopping = false;
+	std::exception_ptr m_error;
+
+	FILE* m_pipe = nullptr;
+	std::vector<uint8_t> m_converted;
+
+	uint64_t m_framesSubmitted = 0;
+	uint64_t m_framesWritten = 0;
+	uint64_t m_bytesWritten = 0;
+	size_t m_peakQueued = 0;
+	double m_stallMilliseconds = 0.0;	// render thread time spent waiting for a free slot
+	std::chrono::steady_clock::time_point m_firstSubmit;
+	double m_elapsed = 0.0;
+};
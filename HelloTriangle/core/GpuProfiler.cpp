@@ -0,0 +1,366 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// steady_clock counts QueryPerformanceCounter ticks on Windows and CLOCK_MONOTONIC elsewhere.
+#ifdef _WIN32
+static const VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+static const VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+static const int64_t CALIBRATION_INTERVAL = 1000000000;	// nanoseconds
+
+static void writeJsonString(std::ostream& out, const std::string& text)
+{
+	out << '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+GpuProfiler::Scope::Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name)
+	: m_profiler(profiler), m_commandBuffer(commandBuffer), m_query(profiler.beginScope(commandBuffer, name))
+{
+}
+
+GpuProfiler::Scope::~Scope()
+{
+	m_profiler.endScope(m_commandBuffer, m_query);
+}
+
+GpuProfiler::CpuScope::CpuScope(GpuProfiler& profiler, const std::string& name)
+	: m_profiler(profiler), m_name(UINT32_MAX), m_begin(0)
+{
+	if (profiler.tracing()) {
+		m_name = profiler.nameId(name);
+		m_begin = nowNanoseconds();
+	}
+}
+
+GpuProfiler::CpuScope::~CpuScope()
+{
+	if (m_name != UINT32_MAX)
+		m_profiler.recordCpuScope(m_name, m_begin, nowNanoseconds());
+}
+
+void GpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device, const InstanceDispatch& instanceDispatch, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, uint32_t queueFamily, const Settings& settings)
+{
+	if (enabled())
+		throw std::logic_error("GpuProfiler: initialized twice!");
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamily < queueFamilyCount ? queueFamilies[queueFamily].timestampValidBits : 0;
+	if (validBits == 0)
+		throw std::runtime_error("failed to create GPU profiler, the queue has no timestamps!");
+
+	m_period = properties.limits.timestampPeriod;
+	m_mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	m_settings = settings;
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = 2 + 2 * settings.maxScopesPerFrame;
+
+	m_slots.resize(settings.slotCount);
+	for (Slot& slot : m_slots) {
+		if (dispatch.createQueryPool(device, &poolInfo, allocator, &slot.pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create timestamp query pool!");
+		slot.scopeNames.reserve(settings.maxScopesPerFrame);
+	}
+	m_results.resize(poolInfo.queryCount);
+	m_device = device;
+	m_dispatch = &dispatch;
+	m_allocator = allocator;
+
+	auto getTimeDomains = instanceDispatch.getPhysicalDeviceCalibrateableTimeDomainsEXT;
+	auto getTimestamps = dispatch.getCalibratedTimestampsEXT;
+	if (getTimestamps != nullptr) {
+		std::vector<VkTimeDomainEXT> domains;
+		if (getTimeDomains != nullptr) {
+			uint32_t domainCount = 0;
+			getTimeDomains(physicalDevice, &domainCount, nullptr);
+			domains.resize(domainCount);
+			getTimeDomains(physicalDevice, &domainCount, domains.data());
+		}
+
+		bool hasDevice = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+		bool hasHost = std::find(domains.begin(), domains.end(), HOST_TIME_DOMAIN) != domains.end();
+		if (hasDevice && hasHost) {
+			m_getCalibratedTimestamps = getTimestamps;
+			m_hostDomain = HOST_TIME_DOMAIN;
+#ifdef _WIN32
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			m_hostTicksPerNanosecond = static_cast<double>(frequency.QuadPart) / 1e9;
+#endif
+		}
+	}
+
+	m_sessionStart = nowNanoseconds();
+	if (this->calibrated())
+		calibrate();
+}
+
+void GpuProfiler::destroy()
+{
+	if (!enabled())
+		return;
+
+	for (Slot& slot : m_slots)
+		m_dispatch->destroyQueryPool(m_device, slot.pool, m_allocator);
+	m_slots.clear();
+	m_device = VK_NULL_HANDLE;
+	m_dispatch = nullptr;
+	m_allocator = nullptr;
+	m_recording = UINT32_MAX;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frame, const std::string& name)
+{
+	if (!enabled())
+		return;
+	if (slot >= m_slots.size())
+		throw std::out_of_range("GpuProfiler: no such slot!");
+	if (m_recording != UINT32_MAX)
+		throw std::logic_error("GpuProfiler: beginFrame() without endFrame()!");
+
+	Slot& target = m_slots[slot];
+	target.scopeNames.clear();
+	target.name = nameId(name);
+	target.frame = frame;
+	target.recordedAt = nowNanoseconds();
+	target.pending = false;
+
+	m_dispatch->cmdResetQueryPool(commandBuffer, target.pool, 0, static_cast<uint32_t>(m_results.size()));
+	m_dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, target.pool, 0);
+	m_recording = slot;
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+	if (m_recording == UINT32_MAX)
+		return;
+
+	Slot& target = m_slots[m_recording];
+	m_dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, target.pool, 1);
+	target.pending = true;
+	m_recording = UINT32_MAX;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+	if (m_recording == UINT32_MAX)
+		return UINT32_MAX;
+
+	Slot& target = m_slots[m_recording];
+	if (target.scopeNames.size() >= m_settings.maxScopesPerFrame) {
+		m_droppedScopes++;
+		return UINT32_MAX;
+	}
+
+	uint32_t query = 2 + 2 * static_cast<uint32_t>(target.scopeNames.size());
+	target.scopeNames.push_back(nameId(name));
+	m_dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, target.pool, query);
+	return query;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t query)
+{
+	if (query == UINT32_MAX || m_recording == UINT32_MAX)
+		return;
+
+	m_dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_slots[m_recording].pool, query + 1);
+}
+
+bool GpuProfiler::collect(uint32_t slot, FrameTiming& timing)
+{
+	if (!enabled() || slot >= m_slots.size() || !m_slots[slot].pending)
+		return false;
+
+	Slot& source = m_slots[slot];
+	source.pending = false;
+
+	uint32_t queryCount = 2 + 2 * static_cast<uint32_t>(source.scopeNames.size());
+	if (m_dispatch->getQueryPoolResults(m_device, source.pool, 0, queryCount, queryCount * sizeof(uint64_t), m_results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	if (calibrated() && nowNanoseconds() - m_lastCalibration >= CALIBRATION_INTERVAL)
+		calibrate();
+
+	if (!calibrated() && (!m_offsetKnown || toHostNanoseconds(m_results[0]) < source.recordedAt)) {
+		// The GPU can't have started before recording did, so push the offset up to that bound.
+		m_calibrationTicks = m_results[0];
+		m_calibrationHost = source.recordedAt;
+		m_offsetKnown = true;
+	}
+
+	m_framesCollected++;
+
+	for (uint32_t scope = 0; scope <= source.scopeNames.size(); scope++) {
+		uint64_t begin = m_results[2 * scope];
+		uint64_t end = m_results[2 * scope + 1];
+		double milliseconds = ((end - begin) & m_mask) * m_period / 1e6;
+		uint32_t name = scope == 0 ? source.name : source.scopeNames[scope - 1];
+
+		ScopeStats& stats = m_stats[name];
+		stats.count++;
+		stats.totalMilliseconds += milliseconds;
+		stats.maxMilliseconds = std::max(stats.maxMilliseconds, milliseconds);
+
+		if (scope == 0) {
+			timing.frame = source.frame;
+			timing.gpuMilliseconds = milliseconds;
+		}
+
+		if (m_settings.trace) {
+			int64_t hostBegin = toHostNanoseconds(begin);
+			addEvent({ hostBegin, hostBegin + static_cast<int64_t>(milliseconds * 1e6), source.frame, name, Track::Gpu });
+		}
+	}
+
+	return true;
+}
+
+void GpuProfiler::recordCpuScope(uint32_t name, int64_t beginNanoseconds, int64_t endNanoseconds)
+{
+	if (tracing())
+		addEvent({ beginNanoseconds, endNanoseconds, 0, name, Track::Cpu });
+}
+
+uint32_t GpuProfiler::nameId(const std::string& name)
+{
+	auto it = m_nameIds.find(name);
+	if (it != m_nameIds.end())
+		return it->second;
+
+	uint32_t id = static_cast<uint32_t>(m_names.size());
+	m_nameIds.emplace(name, id);
+	m_names.push_back(name);
+	m_stats.emplace_back();
+	return id;
+}
+
+void GpuProfiler::writeTrace(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out)
+		throw std::runtime_error("failed to open " + path + " for writing!");
+
+	int64_t origin = m_sessionStart;
+	for (const Event& event : m_events)
+		origin = std::min(origin, event.begin);
+
+	// Timestamps and durations are in microseconds.
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+	for (const Event& event : m_events) {
+		out << ",\n{\"name\":";
+		writeJsonString(out, m_names[event.name]);
+		out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.track == Track::Gpu ? 2 : 1)
+			<< ",\"ts\":" << (event.begin - origin) / 1e3
+			<< ",\"dur\":" << (event.end - event.begin) / 1e3;
+		if (event.track == Track::Gpu)
+			out << ",\"args\":{\"frame\":" << event.frame << "}";
+		out << "}";
+	}
+
+	out << "\n]}\n";
+	if (!out)
+		throw std::runtime_error("failed to write " + path + "!");
+}
+
+void GpuProfiler::report(std::ostream& out) const
+{
+	out << "gpu profiler: " << m_framesCollected << " command buffers timed, ";
+	if (calibrated())
+		out << "calibrated timestamps (max deviation " << m_maxDeviation << " ns)";
+	else
+		out << "estimated clock offset";
+	out << std::endl;
+
+	for (size_t i = 0; i < m_names.size(); i++) {
+		const ScopeStats& stats = m_stats[i];
+		if (stats.count == 0)
+			continue;
+		out << "  " << m_names[i] << ": average " << stats.totalMilliseconds / stats.count << " ms, max "
+			<< stats.maxMilliseconds << " ms over " << stats.count << std::endl;
+	}
+
+	if (m_droppedScopes > 0)
+		out << "  " << m_droppedScopes << " scopes dropped, raise maxScopesPerFrame" << std::endl;
+	if (m_droppedEvents > 0)
+		out << "  " << m_droppedEvents << " trace events dropped past the limit of " << m_settings.maxTraceEvents << std::endl;
+}
+
+int64_t GpuProfiler::nowNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void GpuProfiler::calibrate()
+{
+	VkCalibratedTimestampInfoEXT infos[2]{};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = m_hostDomain;
+
+	uint64_t timestamps[2];
+	uint64_t deviation = 0;
+	if (m_getCalibratedTimestamps(m_device, 2, infos, timestamps, &deviation) != VK_SUCCESS)
+		return;
+
+	m_calibrationTicks = timestamps[0];
+	m_calibrationHost = static_cast<int64_t>(std::llround(timestamps[1] / m_hostTicksPerNanosecond));
+	m_lastCalibration = nowNanoseconds();
+	m_offsetKnown = true;
+	m_maxDeviation = std::max(m_maxDeviation, deviation);
+}
+
+int64_t GpuProfiler::toHostNanoseconds(uint64_t ticks) const
+{
+	// Timestamps wrap at the queue's valid bits, so take the shorter way around.
+	uint64_t delta = (ticks - m_calibrationTicks) & m_mask;
+	int64_t signedDelta = static_cast<int64_t>(delta);
+	if (m_mask != ~0ull && delta > m_mask / 2)
+		signedDelta -= static_cast<int64_t>(m_mask) + 1;
+
+	return m_calibrationHost + static_cast<int64_t>(std::llround(signedDelta * m_period));
+}
+
+void GpuProfiler::addEvent(const Event& event)
+{
+	if (m_events.size() >= m_settings.maxTraceEvents) {
+		m_droppedEvents++;
+		return;
+	}
+	m_events.push_back(event);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceDispatch.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Named GPU scopes timed with timestamp queries, plus CPU scopes on the same clock, recorded for
+// the whole session and exported as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//
+// Each command buffer in flight gets a slot with its own query pool. beginFrame() resets the
+// slot's pool from the command buffer itself and collect() reads it back once the caller has
+// waited for that command buffer's fence, so reading never stalls. One-shot submissions use a
+// spare slot and are collected right after the queue wait that already follows them.
+//
+// GPU ticks are mapped onto std::chrono::steady_clock. With VK_EXT_calibrated_timestamps the
+// mapping comes from paired device and host timestamps, refreshed every second against drift.
+// Without it, the offset is the tightest one that never has a command buffer start on the GPU
+// before the CPU began recording it, which puts GPU scopes up to a queue latency too early.
+//
+// Overhead budget: while disabled (init() never called) every call returns after one branch, with
+// no queries, allocations or locks, so the scopes can stay in release builds. Enabled, a scope
+// costs two vkCmdWriteTimestamp and a name lookup, a frame one vkCmdResetQueryPool and one
+// non-blocking vkGetQueryPoolResults; the trace holds 32 bytes per scope, about 1 MB per minute
+// at ten scopes and 60 fps, and stops growing at Settings::maxTraceEvents. Begin and end
+// timestamps are written at the bottom of the pipe, so scopes measure serialized time and
+// neighboring scopes don't overlap.
+//
+// Not thread safe; everything is expected on the render thread.
+class GpuProfiler
+{
+public:
+	struct Settings
+	{
+		uint32_t slotCount = 3;
+		uint32_t maxScopesPerFrame = 64;
+		bool trace = false;				// keep every scope for writeTrace()
+		size_t maxTraceEvents = 1 << 20;
+	};
+
+	struct FrameTiming
+	{
+		uint64_t frame = 0;
+		double gpuMilliseconds = 0.0;	// from the start to the end of the command buffer
+	};
+
+	// Ends a GPU scope when it goes out of scope.
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		VkCommandBuffer m_commandBuffer;
+		uint32_t m_query;
+	};
+
+	// Records a CPU scope in the trace when it goes out of scope.
+	class CpuScope
+	{
+	public:
+		CpuScope(GpuProfiler& profiler, const std::string& name);
+		~CpuScope();
+
+		CpuScope(const CpuScope&) = delete;
+		CpuScope& operator=(const CpuScope&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		uint32_t m_name;
+		int64_t m_begin;
+	};
+
+public:
+	GpuProfiler() = default;
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// queueFamily must support timestamps. Timestamps are calibrated when dispatch was loaded with
+	// VK_EXT_calibrated_timestamps and the device can sample the host clock. Queries are recorded
+	// and read through dispatch, which must outlive the profiler. Call destroy() before the
+	// device goes.
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const InstanceDispatch& instanceDispatch, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, uint32_t queueFamily, const Settings& settings);
+	void destroy();
+
+	bool enabled() const { return m_device != VK_NULL_HANDLE; }
+	bool calibrated() const { return m_getCalibratedTimestamps != nullptr; }
+
+	// Starts timing a command buffer in slot as one scope called name. Scopes recorded until
+	// endFrame() nest inside it and belong to frame.
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frame, const std::string& name);
+	void endFrame(VkCommandBuffer commandBuffer);
+
+	// Returns the query of the scope's begin timestamp for endScope(), or UINT32_MAX when the
+	// profiler is disabled, outside a frame or out of queries.
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+	void endScope(VkCommandBuffer commandBuffer, uint32_t query);
+
+	// Reads back what the slot last recorded; its fence must have signaled. Returns false if
+	// there is nothing new in it.
+	bool collect(uint32_t slot, FrameTiming& timing);
+
+	void recordCpuScope(uint32_t name, int64_t beginNanoseconds, int64_t endNanoseconds);
+	uint32_t nameId(const std::string& name);
+
+	// Writes the session as Chrome trace event JSON. Throws if path can't be written.
+	void writeTrace(const std::string& path) const;
+
+	// Average and worst GPU time of every scope name.
+	void report(std::ostream& out) const;
+
+	static int64_t nowNanoseconds();
+
+private:
+	enum class Track : uint32_t { Cpu, Gpu };
+
+	struct Event
+	{
+		int64_t begin;		// steady_clock nanoseconds
+		int64_t end;
+		uint64_t frame;
+		uint32_t name;
+		Track track;
+	};
+
+	struct Slot
+	{
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<uint32_t> scopeNames;	// one per begin/end pair after the frame's own
+		uint32_t name = 0;
+		uint64_t frame = 0;
+		int64_t recordedAt = 0;		// CPU time beginFrame() was called
+		bool pending = false;
+	};
+
+	struct ScopeStats
+	{
+		uint64_t count = 0;
+		double totalMilliseconds = 0.0;
+		double maxMilliseconds = 0.0;
+	};
+
+	void calibrate();
+	int64_t toHostNanoseconds(uint64_t ticks) const;
+	void addEvent(const Event& event);
+	bool tracing() const { return enabled() && m_settings.trace; }
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	const DeviceDispatch* m_dispatch = nullptr;
+	const VkAllocationCallbacks* m_allocator = nullptr;
+	Settings m_settings;
+	double m_period = 1.0;			// nanoseconds per tick
+	uint64_t m_mask = ~0ull;
+
+	std::vector<Slot> m_slots;
+	std::vector<uint64_t> m_results;
+	uint32_t m_recording = UINT32_MAX;	// slot between beginFrame() and endFrame()
+
+	PFN_vkGetCalibratedTimestampsEXT m_getCalibratedTimestamps = nullptr;
+	VkTimeDomainEXT m_hostDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	double m_hostTicksPerNanosecond = 1.0;
+	uint64_t m_calibrationTicks = 0;		// device timestamp of the last calibration
+	int64_t m_calibrationHost = 0;		// and the host time it was taken at
+	int64_t m_lastCalibration = 0;
+	bool m_offsetKnown = false;
+	uint64_t m_maxDeviation = 0;
+
+	std::unordered_map<std::string, uint32_t> m_nameIds;
+	std::vector<std::string> m_names;
+	std::vector<ScopeStats> m_stats;
+
+	int64_t m_sessionStart = 0;
+	std::vector<Event> m_events;
+	uint64_t m_droppedEvents = 0;
+	uint64_t m_droppedScopes = 0;
+	uint64_t m_framesCollected = 0;
+};
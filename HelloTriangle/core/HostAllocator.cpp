@@ -0,0 +1,277 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+static const uint64_t ARENA_LIVE_ONE = 1ull << 32;
+static const uint64_t ARENA_USED_MASK = ARENA_LIVE_ONE - 1;
+
+static uintptr_t alignUp(uintptr_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+}
+
+static void raiseTo(std::atomic<uint64_t>& peak, uint64_t value)
+{
+	uint64_t current = peak.load(std::memory_order_relaxed);
+	while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+HostAllocator::HostAllocator()
+{
+	m_callbacks.pUserData = this;
+	m_callbacks.pfnAllocation = &HostAllocator::allocationCallback;
+	m_callbacks.pfnReallocation = &HostAllocator::reallocationCallback;
+	m_callbacks.pfnFree = &HostAllocator::freeCallback;
+	m_callbacks.pfnInternalAllocation = &HostAllocator::internalAllocationCallback;
+	m_callbacks.pfnInternalFree = &HostAllocator::internalFreeCallback;
+}
+
+void HostAllocator::init(const Settings& settings)
+{
+	if (enabled())
+		throw std::logic_error("HostAllocator: initialized twice!");
+	if (settings.arenaCount == 0 || settings.arenaCount >= HEAP || settings.arenaBytes == 0 || settings.arenaBytes > ARENA_USED_MASK)
+		throw std::invalid_argument("HostAllocator: needs 1 to 254 arenas of up to 4 GB!");
+
+	m_settings = settings;
+
+	// Arenas start on a cache line; larger alignments are handled per allocation.
+	for (uint32_t i = 0; i < settings.arenaCount; i++) {
+		auto arena = std::make_unique<Arena>();
+		arena->memory.reset(new unsigned char[settings.arenaBytes + 64]);
+		arena->base = reinterpret_cast<unsigned char*>(alignUp(reinterpret_cast<uintptr_t>(arena->memory.get()), 64));
+		m_arenas.push_back(std::move(arena));
+	}
+}
+
+void HostAllocator::beginFrame()
+{
+	if (!enabled())
+		return;
+
+	uint32_t next = (m_currentArena.load(std::memory_order_relaxed) + 1) % m_settings.arenaCount;
+	Arena& arena = *m_arenas[next];
+
+	uint64_t state = arena.state.load(std::memory_order_acquire);
+	arena.peakUsed = std::max(arena.peakUsed, state & ARENA_USED_MASK);
+	if (state >> 32 == 0)
+		arena.state.compare_exchange_strong(state, 0, std::memory_order_acq_rel);
+	if (arena.state.load(std::memory_order_relaxed) >> 32 != 0)
+		m_deferredResets++;
+	m_currentArena.store(next, std::memory_order_release);
+
+	FrameCounts totals;
+	uint64_t frameAllocations = 0;
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++) {
+		totals.allocations[scope] = m_scopes[scope].allocations.load(std::memory_order_relaxed);
+		frameAllocations += totals.allocations[scope] - m_lastTotals.allocations[scope];
+	}
+
+	// Frame 0 is everything up to the first frame, which is startup rather than churn.
+	if (m_frames > m_settings.warmupFrames) {
+		for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+			m_steadyTotals.allocations[scope] += totals.allocations[scope] - m_lastTotals.allocations[scope];
+		m_steadyFrames++;
+		m_maxFrameAllocations = std::max(m_maxFrameAllocations, frameAllocations);
+	}
+
+	m_lastTotals = totals;
+	m_frames++;
+}
+
+void HostAllocator::report(std::ostream& out) const
+{
+	if (!enabled())
+		return;
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "Vulkan host allocations:" << std::endl;
+	out << "  " << std::left << std::setw(10) << "scope" << std::right
+		<< std::setw(12) << "live KB" << std::setw(12) << "peak KB" << std::setw(8) << "live"
+		<< std::setw(12) << "allocs" << std::setw(12) << "frees" << std::setw(14) << "allocs/frame" << std::endl;
+
+	out << std::fixed << std::setprecision(1);
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++) {
+		const Counters& counters = m_scopes[scope];
+		out << "  " << std::left << std::setw(10) << scopeName(scope) << std::right
+			<< std::setw(12) << counters.liveBytes.load() / 1024.0
+			<< std::setw(12) << counters.peakBytes.load() / 1024.0
+			<< std::setw(8) << counters.liveCount.load()
+			<< std::setw(12) << counters.allocations.load()
+			<< std::setw(12) << counters.frees.load()
+			<< std::setw(14) << std::setprecision(2) << (m_steadyFrames > 0 ? static_cast<double>(m_steadyTotals.allocations[scope]) / m_steadyFrames : 0.0)
+			<< std::setprecision(1) << std::endl;
+	}
+
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++) {
+		const Counters& counters = m_internal[scope];
+		if (counters.allocations.load() == 0)
+			continue;
+		out << "  driver-internal " << scopeName(scope) << ": " << counters.liveBytes.load() / 1024.0 << " KB live, "
+			<< counters.peakBytes.load() / 1024.0 << " KB peak, " << counters.allocations.load() << " allocations" << std::endl;
+	}
+
+	uint64_t peakUsed = 0;
+	for (const auto& arena : m_arenas)
+		peakUsed = std::max(peakUsed, std::max(arena->peakUsed, arena->state.load() & ARENA_USED_MASK));
+	out << "  command arenas: " << m_settings.arenaCount << " x " << m_settings.arenaBytes / 1024 << " KB, peak use "
+		<< peakUsed / 1024.0 << " KB, " << m_arenaOverflows.load() << " allocations overflowed to the heap, "
+		<< m_deferredResets << " resets deferred" << std::endl;
+
+	if (m_steadyFrames > 0) {
+		out << "  steady state: " << m_steadyFrames << " frames after " << m_settings.warmupFrames << " warm-up, at most "
+			<< m_maxFrameAllocations << " allocations in a frame" << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void* HostAllocator::allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+void* HostAllocator::reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+	if (!original)
+		return allocator->allocate(size, alignment, scope);
+	if (size == 0) {
+		allocator->free(original);
+		return nullptr;
+	}
+
+	// On failure the original must stay valid, so it is only freed once the copy exists.
+	void* memory = allocator->allocate(size, alignment, scope);
+	if (!memory)
+		return nullptr;
+
+	const Header* header = reinterpret_cast<const Header*>(static_cast<unsigned char*>(original) - sizeof(Header));
+	std::memcpy(memory, original, static_cast<size_t>(std::min<uint64_t>(header->size, size)));
+	allocator->free(original);
+	return memory;
+}
+
+void HostAllocator::freeCallback(void* userData, void* memory)
+{
+	static_cast<HostAllocator*>(userData)->free(memory);
+}
+
+void HostAllocator::internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+	allocator->counted(allocator->m_internal[scopeIndex(scope)], size);
+}
+
+void HostAllocator::internalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+	allocator->released(allocator->m_internal[scopeIndex(scope)], size);
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	// Headers hold a uint64_t, so every allocation is at least 8-byte aligned.
+	alignment = std::max(alignment, alignof(Header));
+
+	uint32_t index = scopeIndex(scope);
+	unsigned char* memory = nullptr;
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+		memory = static_cast<unsigned char*>(allocateFromArena(size, alignment));
+
+	if (!memory) {
+		unsigned char* block = static_cast<unsigned char*>(std::malloc(size + alignment + sizeof(Header)));
+		if (!block)
+			return nullptr;
+		memory = reinterpret_cast<unsigned char*>(alignUp(reinterpret_cast<uintptr_t>(block) + sizeof(Header), alignment));
+
+		Header* header = reinterpret_cast<Header*>(memory - sizeof(Header));
+		header->offset = static_cast<uint32_t>(memory - block);
+		header->arena = HEAP;
+	}
+
+	Header* header = reinterpret_cast<Header*>(memory - sizeof(Header));
+	header->size = size;
+	header->scope = static_cast<uint8_t>(index);
+
+	counted(m_scopes[index], size);
+	return memory;
+}
+
+void* HostAllocator::allocateFromArena(size_t size, size_t alignment)
+{
+	uint32_t index = m_currentArena.load(std::memory_order_acquire);
+	Arena& arena = *m_arenas[index];
+	uintptr_t base = reinterpret_cast<uintptr_t>(arena.base);
+
+	uint64_t state = arena.state.load(std::memory_order_relaxed);
+	uint64_t end;
+	uintptr_t memory;
+	do {
+		memory = alignUp(base + (state & ARENA_USED_MASK) + sizeof(Header), alignment);
+		end = memory + size - base;
+		if (end > m_settings.arenaBytes) {
+			m_arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	} while (!arena.state.compare_exchange_weak(state, (state & ~ARENA_USED_MASK) + ARENA_LIVE_ONE + end, std::memory_order_acq_rel));
+
+	Header* header = reinterpret_cast<Header*>(memory - sizeof(Header));
+	header->offset = 0;
+	header->arena = static_cast<uint8_t>(index);
+	return reinterpret_cast<void*>(memory);
+}
+
+void HostAllocator::free(void* memory)
+{
+	if (!memory)
+		return;
+
+	unsigned char* bytes = static_cast<unsigned char*>(memory);
+	const Header* header = reinterpret_cast<const Header*>(bytes - sizeof(Header));
+	released(m_scopes[header->scope], header->size);
+
+	// Arena memory comes back when the whole arena is reset.
+	if (header->arena != HEAP)
+		m_arenas[header->arena]->state.fetch_sub(ARENA_LIVE_ONE, std::memory_order_acq_rel);
+	else
+		std::free(bytes - header->offset);
+}
+
+void HostAllocator::counted(Counters& counters, uint64_t size)
+{
+	uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	raiseTo(counters.peakBytes, live);
+	counters.liveCount.fetch_add(1, std::memory_order_relaxed);
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HostAllocator::released(Counters& counters, uint64_t size)
+{
+	counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+	counters.liveCount.fetch_sub(1, std::memory_order_relaxed);
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t HostAllocator::scopeIndex(VkSystemAllocationScope scope)
+{
+	uint32_t index = static_cast<uint32_t>(scope);
+	return index < SCOPE_COUNT ? index : static_cast<uint32_t>(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+}
+
+const char* HostAllocator::scopeName(uint32_t scope)
+{
+	static const char* names[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+	return scope < SCOPE_COUNT ? names[scope] : "unknown";
+}
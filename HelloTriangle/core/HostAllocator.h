@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Host memory for the Vulkan driver, through VkAllocationCallbacks, counted per allocation
+// scope (command, object, cache, device, instance) so the driver's allocations show up next to
+// the engine's own.
+//
+// Every allocation carries a small header with its size and scope, since pfnFree gets neither.
+// Command-scope allocations only live for the duration of the Vulkan call that made them, so
+// they come from the current frame's arena: a bump pointer, where frees only count down the live
+// allocations. beginFrame() moves to the next arena and resets it in bulk, or leaves it to grow
+// on if something in it is somehow still live. What doesn't fit an arena goes to the heap.
+//
+// Allocations the driver makes itself are only reported through the notification callbacks, so
+// they are counted but not served.
+//
+// beginFrame() also closes the counts of the frame before, so report() can show the live and
+// peak bytes of each scope along with the steady-state allocations per frame, averaged over the
+// frames after the warm-up. Any allocation there is churn in the frame loop.
+//
+// callbacks() is null until init(), so it can be passed to every create and destroy call at no
+// cost while tracking is off. It must be the same for the whole life of each object. The
+// callbacks are thread-safe: counters are atomic and an arena allocation is one compare-exchange.
+class HostAllocator
+{
+public:
+	struct Settings
+	{
+		uint32_t arenaCount = 2;
+		size_t arenaBytes = 256 * 1024;
+		uint32_t warmupFrames = 60;	// frames left out of the per-frame averages
+	};
+
+public:
+	HostAllocator();
+
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	void init(const Settings& settings);
+	bool enabled() const { return !m_arenas.empty(); }
+
+	const VkAllocationCallbacks* callbacks() const { return enabled() ? &m_callbacks : nullptr; }
+
+	// Called once per frame, from one thread, at the start of the frame.
+	void beginFrame();
+
+	// Best called once the instance is destroyed, when anything still live was never freed.
+	void report(std::ostream& out) const;
+
+private:
+	static const uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+	static const uint8_t HEAP = UINT8_MAX;
+
+	// In front of every allocation. offset is the distance back to the start of the block.
+	struct Header
+	{
+		uint64_t size;
+		uint32_t offset;
+		uint8_t scope;
+		uint8_t arena;	// HEAP for heap blocks
+	};
+
+	struct Counters
+	{
+		std::atomic<uint64_t> liveBytes{ 0 };
+		std::atomic<uint64_t> peakBytes{ 0 };
+		std::atomic<uint64_t> liveCount{ 0 };
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+	};
+
+	// state packs the live allocation count (high 32 bits) with the bytes used (low 32 bits), so
+	// a reset can check that nothing is live and rewind in one step.
+	struct Arena
+	{
+		std::unique_ptr<unsigned char[]> memory;
+		unsigned char* base = nullptr;
+		std::atomic<uint64_t> state{ 0 };
+		uint64_t peakUsed = 0;
+	};
+
+	struct FrameCounts
+	{
+		uint64_t allocations[SCOPE_COUNT] = {};
+	};
+
+	static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL freeCallback(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* allocateFromArena(size_t size, size_t alignment);
+	void free(void* memory);
+
+	void counted(Counters& counters, uint64_t size);
+	void released(Counters& counters, uint64_t size);
+
+	static uint32_t scopeIndex(VkSystemAllocationScope scope);
+	static const char* scopeName(uint32_t scope);
+
+private:
+	VkAllocationCallbacks m_callbacks;
+	Settings m_settings;
+
+	Counters m_scopes[SCOPE_COUNT];
+	Counters m_internal[SCOPE_COUNT];
+
+	std::vector<std::unique_ptr<Arena>> m_arenas;
+	std::atomic<uint32_t> m_currentArena{ 0 };
+	std::atomic<uint64_t> m_arenaOverflows{ 0 };
+	uint64_t m_deferredResets = 0;
+
+	// Per-frame counts, only touched by beginFrame().
+	uint64_t m_frames = 0;
+	FrameCounts m_lastTotals;
+	FrameCounts m_steadyTotals;
+	uint64_t m_steadyFrames = 0;
+	uint64_t m_maxFrameAllocations = 0;
+};
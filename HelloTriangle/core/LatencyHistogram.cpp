@@ -0,0 +1,88 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t SUB_BUCKET_BITS = 5;
+static const uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+static uint32_t highestBit(uint64_t value)
+{
+	uint32_t bit = 0;
+	for (uint32_t step = 32; step > 0; step >>= 1) {
+		if (value >> (bit + step))
+			bit += step;
+	}
+	return bit;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	uint32_t bucket = bucketFor(nanoseconds);
+	if (bucket >= m_buckets.size())
+		m_buckets.resize(bucket + 1, 0);
+
+	m_buckets[bucket]++;
+	m_count++;
+	m_total += nanoseconds;
+	m_max = std::max(m_max, nanoseconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	if (other.m_buckets.size() > m_buckets.size())
+		m_buckets.resize(other.m_buckets.size(), 0);
+
+	for (size_t i = 0; i < other.m_buckets.size(); i++)
+		m_buckets[i] += other.m_buckets[i];
+	m_count += other.m_count;
+	m_total += other.m_total;
+	m_max = std::max(m_max, other.m_max);
+}
+
+void LatencyHistogram::reset()
+{
+	m_buckets.clear();
+	m_count = 0;
+	m_total = 0;
+	m_max = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+	if (m_count == 0)
+		return 0;
+
+	double clamped = std::min(100.0, std::max(0.0, percent));
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * m_count)));
+
+	uint64_t seen = 0;
+	for (uint32_t bucket = 0; bucket < m_buckets.size(); bucket++) {
+		seen += m_buckets[bucket];
+		if (seen >= rank)
+			return std::min(bucketHigh(bucket), m_max);
+	}
+	return m_max;
+}
+
+// Values below 2 * SUB_BUCKETS get a bucket each. Above that, the top SUB_BUCKET_BITS + 1 bits
+// pick the bucket within each power of two.
+uint32_t LatencyHistogram::bucketFor(uint64_t value)
+{
+	if (value < 2 * SUB_BUCKETS)
+		return static_cast<uint32_t>(value);
+
+	uint32_t shift = highestBit(value) - SUB_BUCKET_BITS;
+	uint32_t subBucket = static_cast<uint32_t>(value >> shift) - SUB_BUCKETS;
+	return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketHigh(uint32_t bucket)
+{
+	if (bucket < 2 * SUB_BUCKETS)
+		return bucket;
+
+	uint32_t shift = bucket / SUB_BUCKETS - 1;
+	uint64_t subBucket = bucket % SUB_BUCKETS + SUB_BUCKETS;
+	return ((subBucket + 1) << shift) - 1;
+}
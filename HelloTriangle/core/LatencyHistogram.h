@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Counts durations in log-linear buckets, HdrHistogram style: every power of two is split into 32
+// buckets, so any recorded value is known to within about 3% however long it is, and percentiles
+// cost a walk over the buckets rather than a sort of every sample.
+//
+// Values are nanoseconds. The maximum is kept exactly.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() = default;
+
+	void record(uint64_t nanoseconds);
+	void merge(const LatencyHistogram& other);
+	void reset();
+
+	uint64_t count() const { return m_count; }
+	uint64_t max() const { return m_max; }
+	uint64_t total() const { return m_total; }
+	double mean() const { return m_count > 0 ? static_cast<double>(m_total) / m_count : 0.0; }
+
+	// Highest value of the bucket that holds the given percentile (0-100), capped at max().
+	uint64_t percentile(double percent) const;
+
+private:
+	static uint32_t bucketFor(uint64_t value);
+	static uint64_t bucketHigh(uint32_t bucket);
+
+	std::vector<uint64_t> m_buckets;	// sized on demand up to the highest bucket used
+	uint64_t m_count = 0;
+	uint64_t m_total = 0;
+	uint64_t m_max = 0;
+};
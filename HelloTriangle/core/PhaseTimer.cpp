@@ -0,0 +1,154 @@
+#include "PhaseTimer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+static std::atomic<uint64_t> nextTimerId{ 1 };
+
+PhaseTimer::Scope::Scope(PhaseTimer& timer, uint32_t phase)
+	: m_timer(timer), m_phase(timer.enabled() ? phase : UINT32_MAX), m_begin(0)
+{
+	if (m_phase != UINT32_MAX)
+		m_begin = nowNanoseconds();
+}
+
+PhaseTimer::Scope::~Scope()
+{
+	if (m_phase != UINT32_MAX)
+		m_timer.record(m_phase, m_begin, nowNanoseconds());
+}
+
+void PhaseTimer::init(uint32_t ringCapacity)
+{
+	if (enabled())
+		throw std::logic_error("PhaseTimer: initialized twice!");
+	if (ringCapacity == 0)
+		throw std::invalid_argument("PhaseTimer: ring capacity must not be zero!");
+
+	m_ringCapacity = ringCapacity;
+	m_id = nextTimerId++;
+}
+
+uint32_t PhaseTimer::addPhase(const std::string& name)
+{
+	m_phases.push_back({ name, LatencyHistogram() });
+	return static_cast<uint32_t>(m_phases.size() - 1);
+}
+
+void PhaseTimer::record(uint32_t phase, int64_t beginNanoseconds, int64_t endNanoseconds)
+{
+	if (!enabled())
+		return;
+
+	Ring& ring = threadRing();
+	uint64_t head = ring.head.load(std::memory_order_relaxed);
+	if (head - ring.tail.load(std::memory_order_acquire) >= ring.samples.size()) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring.samples[head % ring.samples.size()] = { beginNanoseconds, endNanoseconds, phase };
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+void PhaseTimer::aggregate()
+{
+	if (!enabled())
+		return;
+
+	// Rings are only ever added, so the ones seen here stay valid after the lock is dropped.
+	std::vector<Ring*> rings;
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		for (const auto& ring : m_rings)
+			rings.push_back(ring.get());
+	}
+
+	for (Ring* ring : rings) {
+		uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+
+		for (; tail < head; tail++) {
+			const Sample& sample = ring->samples[tail % ring->samples.size()];
+			if (sample.phase < m_phases.size()) {
+				m_phases[sample.phase].histogram.record(static_cast<uint64_t>(std::max<int64_t>(0, sample.end - sample.begin)));
+				if (m_listener)
+					m_listener(sample.phase, sample.begin, sample.end);
+			}
+		}
+
+		ring->tail.store(tail, std::memory_order_release);
+		m_dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+	}
+}
+
+void PhaseTimer::report(std::ostream& out)
+{
+	aggregate();
+
+	uint64_t total = 0;
+	for (const Phase& phase : m_phases)
+		total += phase.histogram.total();
+
+	auto milliseconds = [](uint64_t nanoseconds) { return nanoseconds / 1e6; };
+
+	out << "frame phases (ms):" << std::endl;
+	out << "  " << std::left << std::setw(14) << "phase" << std::right
+		<< std::setw(9) << "count" << std::setw(9) << "mean" << std::setw(9) << "p50" << std::setw(9) << "p90"
+		<< std::setw(9) << "p99" << std::setw(9) << "max" << std::setw(8) << "share" << std::endl;
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	for (const Phase& phase : m_phases) {
+		const LatencyHistogram& histogram = phase.histogram;
+		out << "  " << std::left << std::setw(14) << phase.name << std::right
+			<< std::setw(9) << histogram.count()
+			<< std::setw(9) << histogram.mean() / 1e6
+			<< std::setw(9) << milliseconds(histogram.percentile(50.0))
+			<< std::setw(9) << milliseconds(histogram.percentile(90.0))
+			<< std::setw(9) << milliseconds(histogram.percentile(99.0))
+			<< std::setw(9) << milliseconds(histogram.max())
+			<< std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 * histogram.total() / total : 0.0) << "%"
+			<< std::setprecision(3) << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+
+	if (m_dropped > 0)
+		out << "  " << m_dropped << " samples dropped, aggregate more often or grow the rings" << std::endl;
+}
+
+int64_t PhaseTimer::nowNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PhaseTimer::Ring& PhaseTimer::threadRing()
+{
+	struct CachedRing
+	{
+		uint64_t timer;
+		Ring* ring;
+	};
+	thread_local std::vector<CachedRing> cache;
+
+	for (const CachedRing& cached : cache) {
+		if (cached.timer == m_id)
+			return *cached.ring;
+	}
+
+	auto ring = std::make_unique<Ring>();
+	ring->samples.resize(m_ringCapacity);
+	Ring* result = ring.get();
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		m_rings.push_back(std::move(ring));
+	}
+	cache.push_back({ m_id, result });
+	return *result;
+}
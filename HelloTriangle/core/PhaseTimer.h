@@ -0,0 +1,106 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Times named phases of the frame on any thread and keeps a latency histogram per phase.
+//
+// Each recording thread writes its samples into its own single-producer ring buffer, so recording
+// takes two clock reads and a store, without locks or allocation; only a thread's first sample
+// takes a mutex to register its ring. aggregate() drains every ring into the histograms from one
+// thread, usually once per frame. A full ring drops samples and counts them rather than block.
+//
+// Disabled (init() never called), a Scope is one branch.
+class PhaseTimer
+{
+public:
+	// Called by aggregate() for every sample, e.g. to forward phases to a trace.
+	using Listener = std::function<void(uint32_t phase, int64_t beginNanoseconds, int64_t endNanoseconds)>;
+
+	// Records the time from its construction to its destruction as one sample of phase.
+	class Scope
+	{
+	public:
+		Scope(PhaseTimer& timer, uint32_t phase);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		PhaseTimer& m_timer;
+		uint32_t m_phase;
+		int64_t m_begin;
+	};
+
+public:
+	PhaseTimer() = default;
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	// ringCapacity is in samples per thread and must cover what one thread records between two
+	// aggregate() calls.
+	void init(uint32_t ringCapacity);
+	bool enabled() const { return m_ringCapacity > 0; }
+
+	// Phases are added before anything is recorded.
+	uint32_t addPhase(const std::string& name);
+	const std::string& phaseName(uint32_t phase) const { return m_phases[phase].name; }
+
+	void setListener(Listener listener) { m_listener = std::move(listener); }
+
+	// Safe from any thread.
+	void record(uint32_t phase, int64_t beginNanoseconds, int64_t endNanoseconds);
+
+	// Moves samples from every thread's ring into the histograms. One thread at a time.
+	void aggregate();
+
+	// Aggregates, then prints count, mean, p50, p90, p99 and max per phase, and the share of
+	// the time spent in all phases that each phase took.
+	void report(std::ostream& out);
+
+	static int64_t nowNanoseconds();
+
+private:
+	struct Sample
+	{
+		int64_t begin;
+		int64_t end;
+		uint32_t phase;
+	};
+
+	struct Ring
+	{
+		std::vector<Sample> samples;
+		std::atomic<uint64_t> head{ 0 };	// next sample to write, owned by the recording thread
+		std::atomic<uint64_t> tail{ 0 };	// next sample to read, owned by aggregate()
+		std::atomic<uint64_t> dropped{ 0 };
+	};
+
+	struct Phase
+	{
+		std::string name;
+		LatencyHistogram histogram;
+	};
+
+	Ring& threadRing();
+
+	uint32_t m_ringCapacity = 0;
+	uint64_t m_id = 0;		// tells the rings of this timer apart in the thread-local cache
+
+	std::vector<Phase> m_phases;
+	Listener m_listener;
+
+	std::mutex m_ringsMutex;
+	std::vector<std::unique_ptr<Ring>> m_rings;
+	uint64_t m_dropped = 0;
+};
@@ -0,0 +1,209 @@
+#include "PipelineStatistics.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+// In the order results are written, which is that of the flag bits.
+static const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+static double ratio(uint64_t numerator, uint64_t denominator)
+{
+	return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+PipelineStatistics::Scope::Scope(PipelineStatistics& statistics, VkCommandBuffer commandBuffer, const std::string& name)
+	: m_statistics(statistics), m_commandBuffer(commandBuffer), m_query(statistics.beginScope(commandBuffer, name))
+{
+}
+
+PipelineStatistics::Scope::~Scope()
+{
+	m_statistics.endScope(m_commandBuffer, m_query);
+}
+
+void PipelineStatistics::init(VkDevice device, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, const Settings& settings)
+{
+	if (enabled())
+		throw std::logic_error("PipelineStatistics: initialized twice!");
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	poolInfo.queryCount = settings.maxScopesPerFrame;
+	poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+
+	m_slots.resize(settings.slotCount);
+	for (Slot& slot : m_slots) {
+		if (dispatch.createQueryPool(device, &poolInfo, allocator, &slot.pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create pipeline statistics query pool!");
+		slot.scopePasses.reserve(settings.maxScopesPerFrame);
+	}
+
+	m_results.resize(static_cast<size_t>(settings.maxScopesPerFrame) * CounterCount);
+	m_settings = settings;
+	m_device = device;
+	m_dispatch = &dispatch;
+	m_allocator = allocator;
+}
+
+void PipelineStatistics::destroy()
+{
+	if (!enabled())
+		return;
+
+	for (Slot& slot : m_slots)
+		m_dispatch->destroyQueryPool(m_device, slot.pool, m_allocator);
+	m_slots.clear();
+	m_device = VK_NULL_HANDLE;
+	m_dispatch = nullptr;
+	m_allocator = nullptr;
+	m_recording = UINT32_MAX;
+}
+
+void PipelineStatistics::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t pixelCount)
+{
+	if (!enabled() || slot >= m_slots.size())
+		return;
+
+	Slot& target = m_slots[slot];
+	m_dispatch->cmdResetQueryPool(commandBuffer, target.pool, 0, m_settings.maxScopesPerFrame);
+	target.scopePasses.clear();
+	target.pixelCount = pixelCount;
+	target.pending = true;
+
+	m_recording = slot;
+	m_activeQuery = UINT32_MAX;
+}
+
+void PipelineStatistics::endFrame()
+{
+	m_recording = UINT32_MAX;
+	m_activeQuery = UINT32_MAX;
+}
+
+uint32_t PipelineStatistics::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+	if (m_recording == UINT32_MAX || m_activeQuery != UINT32_MAX)
+		return UINT32_MAX;
+
+	Slot& target = m_slots[m_recording];
+	if (target.scopePasses.size() >= m_settings.maxScopesPerFrame)
+		return UINT32_MAX;
+
+	auto it = m_passIndices.find(name);
+	if (it == m_passIndices.end()) {
+		it = m_passIndices.emplace(name, static_cast<uint32_t>(m_passes.size())).first;
+		m_passes.push_back({ name });
+	}
+
+	uint32_t query = static_cast<uint32_t>(target.scopePasses.size());
+	target.scopePasses.push_back(it->second);
+	m_dispatch->cmdBeginQuery(commandBuffer, target.pool, query, 0);
+	m_activeQuery = query;
+	return query;
+}
+
+void PipelineStatistics::endScope(VkCommandBuffer commandBuffer, uint32_t query)
+{
+	if (query == UINT32_MAX || m_recording == UINT32_MAX)
+		return;
+
+	m_dispatch->cmdEndQuery(commandBuffer, m_slots[m_recording].pool, query);
+	m_activeQuery = UINT32_MAX;
+}
+
+bool PipelineStatistics::collect(uint32_t slot)
+{
+	if (!enabled() || slot >= m_slots.size() || !m_slots[slot].pending)
+		return false;
+
+	Slot& source = m_slots[slot];
+	source.pending = false;
+	if (source.scopePasses.empty())
+		return false;
+
+	uint32_t queryCount = static_cast<uint32_t>(source.scopePasses.size());
+	VkDeviceSize stride = CounterCount * sizeof(uint64_t);
+	if (m_dispatch->getQueryPoolResults(m_device, source.pool, 0, queryCount, queryCount * stride, m_results.data(), stride, VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		m_notReady++;
+		return false;
+	}
+
+	for (uint32_t query = 0; query < queryCount; query++) {
+		Pass& pass = m_passes[source.scopePasses[query]];
+		pass.frames++;
+		pass.pixels += source.pixelCount;
+		for (uint32_t counter = 0; counter < CounterCount; counter++)
+			pass.counters[counter] += m_results[query * CounterCount + counter];
+	}
+	return true;
+}
+
+double PipelineStatistics::invocationsPerTriangle(const Pass& pass)
+{
+	return ratio(pass.counters[VertexShaderInvocations], pass.counters[InputAssemblyPrimitives]);
+}
+
+double PipelineStatistics::vertexReuse(const Pass& pass)
+{
+	return ratio(pass.counters[InputAssemblyVertices], pass.counters[VertexShaderInvocations]);
+}
+
+double PipelineStatistics::clippingKept(const Pass& pass)
+{
+	return ratio(pass.counters[ClippingPrimitives], pass.counters[ClippingInvocations]);
+}
+
+double PipelineStatistics::overdraw(const Pass& pass)
+{
+	return ratio(pass.counters[FragmentShaderInvocations], pass.pixels);
+}
+
+void PipelineStatistics::report(std::ostream& out) const
+{
+	if (!enabled() || m_passes.empty())
+		return;
+
+	static const char* counterNames[CounterCount] = { "ia verts", "ia prims", "vs inv", "clip in", "clip out", "fs inv", "cs inv" };
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "pipeline statistics (per frame):" << std::endl;
+	out << "  " << std::left << std::setw(16) << "pass" << std::right;
+	for (const char* name : counterNames)
+		out << std::setw(11) << name;
+	out << std::setw(9) << "vs/tri" << std::setw(8) << "reuse" << std::setw(8) << "kept" << std::setw(10) << "overdraw" << std::endl;
+
+	out << std::fixed;
+	for (const Pass& pass : m_passes) {
+		// Transfer passes count nothing.
+		uint64_t total = 0;
+		for (uint64_t counter : pass.counters)
+			total += counter;
+		if (total == 0)
+			continue;
+
+		out << "  " << std::left << std::setw(16) << pass.name << std::right << std::setprecision(0);
+		for (uint32_t counter = 0; counter < CounterCount; counter++)
+			out << std::setw(11) << ratio(pass.counters[counter], pass.frames);
+		out << std::setprecision(2)
+			<< std::setw(9) << invocationsPerTriangle(pass)
+			<< std::setw(8) << vertexReuse(pass)
+			<< std::setw(7) << 100.0 * clippingKept(pass) << "%"
+			<< std::setw(10) << overdraw(pass) << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+
+	if (m_notReady > 0)
+		out << "  " << m_notReady << " frames had no results yet and were skipped" << std::endl;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceDispatch.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Pipeline statistics queries around named scopes, usually the frame graph's passes, summed per
+// name over the session: vertices and primitives fed to input assembly, vertex shader
+// invocations, primitives in and out of clipping, and fragment and compute shader invocations.
+// From them come the metrics that show what index optimization, LOD and culling did on a real
+// workload: vertex shader invocations per triangle, how often each shaded vertex was reused,
+// the share of primitives clipping kept and fragments shaded per pixel.
+//
+// Works like GpuProfiler: each command buffer in flight gets a slot with its own query pool,
+// reset by beginFrame() from the command buffer, and collect() reads it once the caller has
+// waited on the frame's fence. It needs only the pipelineStatisticsQuery feature, not timestamps,
+// so it runs on software implementations such as lavapipe as well.
+//
+// Queries of one type can't nest, so a scope that opens inside another is not counted, and
+// scopes must begin and end outside render passes. Counts are what the implementation reports;
+// the spec allows them to be approximate, e.g. vertex shader invocations with or without
+// post-transform cache hits, so compare them on one device only.
+//
+// Not thread safe; everything is expected on the render thread.
+class PipelineStatistics
+{
+public:
+	struct Settings
+	{
+		uint32_t slotCount = 2;
+		uint32_t maxScopesPerFrame = 32;
+	};
+
+	enum Counter : uint32_t
+	{
+		InputAssemblyVertices,
+		InputAssemblyPrimitives,
+		VertexShaderInvocations,
+		ClippingInvocations,
+		ClippingPrimitives,
+		FragmentShaderInvocations,
+		ComputeShaderInvocations,
+		CounterCount
+	};
+
+	// Sums over every frame the scope was collected in.
+	struct Pass
+	{
+		std::string name;
+		uint64_t frames = 0;
+		uint64_t pixels = 0;	// render area of those frames
+		uint64_t counters[CounterCount] = {};
+	};
+
+	// Counts the commands recorded while it's alive.
+	class Scope
+	{
+	public:
+		Scope(PipelineStatistics& statistics, VkCommandBuffer commandBuffer, const std::string& name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		PipelineStatistics& m_statistics;
+		VkCommandBuffer m_commandBuffer;
+		uint32_t m_query;
+	};
+
+public:
+	PipelineStatistics() = default;
+
+	PipelineStatistics(const PipelineStatistics&) = delete;
+	PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+	// The device must have the pipelineStatisticsQuery feature enabled. Queries are recorded and
+	// read through dispatch, which must outlive this. Call destroy() before the device goes.
+	void init(VkDevice device, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocator, const Settings& settings);
+	void destroy();
+	bool enabled() const { return m_device != VK_NULL_HANDLE; }
+
+	// pixelCount is the frame's render area, the denominator of overdraw.
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t pixelCount);
+	void endFrame();
+
+	// UINT32_MAX when the scope isn't counted.
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+	void endScope(VkCommandBuffer commandBuffer, uint32_t query);
+
+	// Adds the slot's last frame to the sums. Returns false if there was nothing to read.
+	bool collect(uint32_t slot);
+
+	const std::vector<Pass>& passes() const { return m_passes; }
+
+	// 0 where the denominator is.
+	static double invocationsPerTriangle(const Pass& pass);
+	static double vertexReuse(const Pass& pass);
+	static double clippingKept(const Pass& pass);
+	static double overdraw(const Pass& pass);
+
+	// Per-frame averages of every counter and the derived metrics, one line per pass.
+	void report(std::ostream& out) const;
+
+private:
+	struct Slot
+	{
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<uint32_t> scopePasses;	// pass of each query
+		uint64_t pixelCount = 0;
+		bool pending = false;
+	};
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	const DeviceDispatch* m_dispatch = nullptr;
+	const VkAllocationCallbacks* m_allocator = nullptr;
+	Settings m_settings;
+
+	std::vector<Slot> m_slots;
+	uint32_t m_recording = UINT32_MAX;
+	uint32_t m_activeQuery = UINT32_MAX;
+
+	std::vector<Pass> m_passes;
+	std::unordered_map<std::string, uint32_t> m_passIndices;
+	std::vector<uint64_t> m_results;
+	uint64_t m_notReady = 0;
+};
@@ -0,0 +1,521 @@
+#include "RenderGraph.h"
+#include "DeviceMemoryTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+struct AccessInfo
+{
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	bool write;
+};
+
+static AccessInfo accessInfo(RenderGraph::Access access, RenderGraph::PassType type)
+{
+	VkPipelineStageFlags shaderStages = type == RenderGraph::PassType::Compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		: VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	switch (access) {
+	case RenderGraph::Access::ColorAttachment:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+	case RenderGraph::Access::DepthAttachment:
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+	case RenderGraph::Access::ShaderSampled:
+		return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case RenderGraph::Access::ShaderRead:
+		return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case RenderGraph::Access::ShaderWrite:
+		return { shaderStages, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+	case RenderGraph::Access::ShaderReadWrite:
+		return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+	case RenderGraph::Access::IndirectRead:
+		return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case RenderGraph::Access::TransferRead:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+	case RenderGraph::Access::TransferWrite:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+	case RenderGraph::Access::HostRead:
+		return { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case RenderGraph::Access::Present:
+		return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+	}
+
+	throw std::invalid_argument("RenderGraph: unknown access!");
+}
+
+void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue, const DeviceDispatch& dispatch)
+{
+	m_device = device;
+	m_physicalDevice = physicalDevice;
+	m_deletionQueue = &deletionQueue;
+	m_dispatch = &dispatch;
+}
+
+void RenderGraph::reset()
+{
+	if (!m_blocks.empty())
+		throw std::logic_error("RenderGraph: reset before releasing transients!");
+
+	m_resources.clear();
+	m_passes.clear();
+	m_passBarriers.clear();
+	m_finalBarriers = {};
+	m_compiled = false;
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.kind = ResourceKind::TransientImage;
+	resource.desc = desc;
+	m_resources.push_back(resource);
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const std::string& name, VkImageAspectFlags aspect, bool discardOnEntry)
+{
+	Resource resource;
+	resource.name = name;
+	resource.kind = ResourceKind::ImportedImage;
+	resource.desc.aspect = aspect;
+	resource.discardOnEntry = discardOnEntry;
+	m_resources.push_back(resource);
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importBuffer(const std::string& name)
+{
+	Resource resource;
+	resource.name = name;
+	resource.kind = ResourceKind::ImportedBuffer;
+	m_resources.push_back(resource);
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+void RenderGraph::setFinalAccess(ResourceId resource, Access access)
+{
+	m_resources[resource].hasFinalAccess = true;
+	m_resources[resource].finalAccess = access;
+}
+
+void RenderGraph::addPass(const std::string& name, PassType type, const std::vector<ResourceAccess>& accesses, std::function<void(VkCommandBuffer)> record)
+{
+	for (const ResourceAccess& access : accesses) {
+		if (access.resource >= m_resources.size())
+			throw std::invalid_argument("RenderGraph: pass " + name + " uses an unknown resource!");
+	}
+
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	pass.accesses = accesses;
+	pass.record = std::move(record);
+	m_passes.push_back(std::move(pass));
+}
+
+void RenderGraph::compile()
+{
+	if (m_device == VK_NULL_HANDLE)
+		throw std::logic_error("RenderGraph: compiled before init!");
+
+	cullPasses();
+	createTransients();
+
+	// What a resource's first use in a frame waits on depends on the previous frame's end state,
+	// which only depends on the entry state for resources the frame never writes. Two rounds
+	// settle it.
+	std::vector<State> endStates(m_resources.size());
+	std::vector<State> states(m_resources.size());
+	for (ResourceId r = 0; r < m_resources.size(); r++)
+		states[r] = entryState(r, endStates);
+	simulate(states, false);
+
+	endStates = states;
+	for (ResourceId r = 0; r < m_resources.size(); r++)
+		states[r] = entryState(r, endStates);
+	simulate(states, true);
+
+	m_compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+	// Imported resources are visible outside the graph, so every write to one counts. A write
+	// to a transient image only counts if a live pass reads it later.
+	std::vector<bool> needed(m_resources.size());
+	for (ResourceId r = 0; r < m_resources.size(); r++)
+		needed[r] = m_resources[r].kind != ResourceKind::TransientImage;
+
+	for (size_t p = m_passes.size(); p-- > 0;) {
+		Pass& pass = m_passes[p];
+
+		pass.live = false;
+		for (const ResourceAccess& access : pass.accesses) {
+			if (accessInfo(access.access, pass.type).write && needed[access.resource])
+				pass.live = true;
+		}
+
+		if (!pass.live)
+			continue;
+
+		for (const ResourceAccess& access : pass.accesses) {
+			if (access.access != Access::ShaderWrite && access.access != Access::TransferWrite)
+				needed[access.resource] = true;
+		}
+	}
+}
+
+void RenderGraph::createTransients()
+{
+	for (uint32_t p = 0; p < m_passes.size(); p++) {
+		if (!m_passes[p].live)
+			continue;
+
+		for (const ResourceAccess& access : m_passes[p].accesses) {
+			Resource& resource = m_resources[access.resource];
+			resource.firstPass = std::min(resource.firstPass, p);
+			resource.lastPass = std::max(resource.lastPass, p);
+		}
+	}
+
+	std::vector<ResourceId> transients;
+	std::vector<uint32_t> memoryTypeBits(m_resources.size());
+
+	for (ResourceId r = 0; r < m_resources.size(); r++) {
+		Resource& resource = m_resources[r];
+		if (resource.kind != ResourceKind::TransientImage || resource.firstPass == UINT32_MAX)
+			continue;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+		imageInfo.mipLevels = resource.desc.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.desc.usage;
+		imageInfo.samples = resource.desc.samples;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (m_dispatch->createImage(m_device, &imageInfo, m_deletionQueue->allocator(), &resource.image) != VK_SUCCESS)
+			throw std::runtime_error("failed to create " + resource.name + " image!");
+		m_deletionQueue->track(DeletionQueue::Kind::Image);
+		if (DeviceMemoryTracker* tracker = m_deletionQueue->memoryTracker())
+			tracker->nameObject(VK_OBJECT_TYPE_IMAGE, (uint64_t)resource.image, resource.name);
+
+		VkMemoryRequirements requirements;
+		m_dispatch->getImageMemoryRequirements(m_device, resource.image, &requirements);
+		resource.size = requirements.size;
+		memoryTypeBits[r] = requirements.memoryTypeBits;
+
+		transients.push_back(r);
+	}
+
+	// Largest first, each into the first block whose images are all dead while it is alive.
+	std::stable_sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) {
+		return m_resources[a].size > m_resources[b].size;
+	});
+
+	for (ResourceId r : transients) {
+		Resource& resource = m_resources[r];
+
+		for (uint32_t b = 0; b < m_blocks.size() && resource.memoryBlock == UINT32_MAX; b++) {
+			MemoryBlock& block = m_blocks[b];
+			if ((block.memoryTypeBits & memoryTypeBits[r]) == 0)
+				continue;
+
+			bool overlaps = std::any_of(block.resources.begin(), block.resources.end(), [&](ResourceId other) {
+				return resource.firstPass <= m_resources[other].lastPass && m_resources[other].firstPass <= resource.lastPass;
+			});
+			if (overlaps)
+				continue;
+
+			block.size = std::max(block.size, resource.size);
+			block.memoryTypeBits &= memoryTypeBits[r];
+			block.resources.push_back(r);
+			resource.memoryBlock = b;
+		}
+
+		if (resource.memoryBlock == UINT32_MAX) {
+			MemoryBlock block;
+			block.size = resource.size;
+			block.memoryTypeBits = memoryTypeBits[r];
+			block.resources.push_back(r);
+			resource.memoryBlock = static_cast<uint32_t>(m_blocks.size());
+			m_blocks.push_back(block);
+		}
+	}
+
+	for (MemoryBlock& block : m_blocks) {
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (m_dispatch->allocateMemory(m_device, &allocInfo, m_deletionQueue->allocator(), &block.memory) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate transient image memory!");
+		m_deletionQueue->track(DeletionQueue::Kind::Memory);
+
+		std::sort(block.resources.begin(), block.resources.end(), [&](ResourceId a, ResourceId b) {
+			return m_resources[a].firstPass < m_resources[b].firstPass;
+		});
+
+		for (size_t i = 0; i < block.resources.size(); i++) {
+			Resource& resource = m_resources[block.resources[i]];
+			m_dispatch->bindImageMemory(m_device, resource.image, block.memory, 0);
+			resource.previousAlias = block.resources[(i + block.resources.size() - 1) % block.resources.size()];
+		}
+
+		// Named after every image aliased into it.
+		if (DeviceMemoryTracker* tracker = m_deletionQueue->memoryTracker()) {
+			std::string name;
+			for (ResourceId r : block.resources)
+				name += (name.empty() ? "" : "/") + m_resources[r].name;
+			tracker->allocated(block.memory, block.size, allocInfo.memoryTypeIndex, DeviceMemoryTracker::Category::Attachment, name);
+		}
+	}
+}
+
+RenderGraph::State RenderGraph::entryState(ResourceId r, const std::vector<State>& endStates) const
+{
+	const Resource& resource = m_resources[r];
+	State state;
+
+	if (resource.kind == ResourceKind::TransientImage) {
+		// Contents are discarded, but the memory's previous user has to be done with it.
+		if (resource.memoryBlock != UINT32_MAX) {
+			const State& previous = endStates[resource.previousAlias];
+			state.writeStages = previous.writeStages | previous.readStages;
+			state.writeAccess = previous.writeAccess;
+		}
+	}
+	else if (resource.discardOnEntry) {
+		// Waiting on the first use's own stages chains the barrier to a semaphore wait there.
+		for (uint32_t p = 0; p < m_passes.size() && state.writeStages == 0; p++) {
+			if (!m_passes[p].live)
+				continue;
+			for (const ResourceAccess& access : m_passes[p].accesses) {
+				if (access.resource == r)
+					state.writeStages = accessInfo(access.access, m_passes[p].type).stages;
+			}
+		}
+	}
+	else {
+		state = endStates[r];
+	}
+
+	return state;
+}
+
+void RenderGraph::simulate(std::vector<State>& states, bool record)
+{
+	if (record) {
+		m_passBarriers.assign(m_passes.size(), {});
+		m_finalBarriers = {};
+	}
+
+	for (size_t p = 0; p < m_passes.size(); p++) {
+		if (!m_passes[p].live)
+			continue;
+
+		BarrierBatch batch;
+		for (const ResourceAccess& access : m_passes[p].accesses)
+			transition(states[access.resource], access.resource, access.access, m_passes[p].type, batch);
+
+		if (record)
+			m_passBarriers[p] = batch;
+	}
+
+	BarrierBatch finalBatch;
+	for (ResourceId r = 0; r < m_resources.size(); r++) {
+		if (m_resources[r].hasFinalAccess)
+			transition(states[r], r, m_resources[r].finalAccess, PassType::Transfer, finalBatch);
+	}
+
+	if (record)
+		m_finalBarriers = finalBatch;
+}
+
+void RenderGraph::transition(State& state, ResourceId r, Access access, PassType type, BarrierBatch& batch) const
+{
+	AccessInfo info = accessInfo(access, type);
+	bool isImage = m_resources[r].isImage();
+
+	VkImageLayout layout = isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+	bool layoutChange = isImage && state.layout != layout;
+
+	// Writes wait for everything before them; reads only for a write they can't see yet.
+	bool hazard = info.write ? (state.writeStages | state.readStages) != 0
+		: state.writeStages != 0 && ((info.stages & ~state.visibleStages) != 0 || (info.access & ~state.visibleAccess) != 0);
+
+	if (layoutChange || hazard) {
+		VkPipelineStageFlags srcStages = state.writeStages;
+		if (info.write || layoutChange)
+			srcStages |= state.readStages;
+
+		batch.srcStages |= srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		batch.dstStages |= info.stages;
+		batch.barriers.push_back({ r, state.writeAccess, info.access, state.layout, layout });
+	}
+
+	if (info.write) {
+		state.writeStages = info.stages;
+		state.writeAccess = info.access & WRITE_ACCESS;
+		state.readStages = 0;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+	}
+	else if (layoutChange) {
+		// The transition is a write that later readers in other stages still have to wait on;
+		// it is already visible to this one.
+		state.writeStages = info.stages;
+		state.writeAccess = 0;
+		state.readStages = info.stages;
+		state.visibleStages = info.stages;
+		state.visibleAccess = info.access;
+	}
+	else {
+		state.readStages |= info.stages;
+		if (hazard) {
+			state.visibleStages |= info.stages;
+			state.visibleAccess |= info.access;
+		}
+	}
+
+	state.layout = layout;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) const
+{
+	if (!m_compiled)
+		throw std::logic_error("RenderGraph: executed before compile!");
+
+	for (size_t p = 0; p < m_passes.size(); p++) {
+		if (!m_passes[p].live)
+			continue;
+
+		emit(commandBuffer, m_passBarriers[p]);
+		m_passes[p].record(commandBuffer);
+	}
+
+	emit(commandBuffer, m_finalBarriers);
+}
+
+void RenderGraph::emit(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const
+{
+	if (batch.barriers.empty())
+		return;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+
+	for (const Barrier& barrier : batch.barriers) {
+		const Resource& resource = m_resources[barrier.resource];
+
+		if (resource.isImage()) {
+			VkImageMemoryBarrier imageBarrier{};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			imageBarriers.push_back(imageBarrier);
+		}
+		else {
+			VkBufferMemoryBarrier bufferBarrier{};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarrier.srcAccessMask = barrier.srcAccess;
+			bufferBarrier.dstAccessMask = barrier.dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	m_dispatch->cmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0,
+		0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::releaseTransients(uint64_t lastFrame)
+{
+	for (Resource& resource : m_resources) {
+		if (resource.kind == ResourceKind::TransientImage) {
+			m_deletionQueue->push(DeletionQueue::Kind::Image, resource.image, lastFrame);
+			resource.image = VK_NULL_HANDLE;
+		}
+	}
+
+	for (const MemoryBlock& block : m_blocks)
+		m_deletionQueue->push(DeletionQueue::Kind::Memory, block.memory, lastFrame);
+	m_blocks.clear();
+}
+
+uint32_t RenderGraph::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeBits & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+
+	throw std::runtime_error("failed to find suitable memory type for transient images!");
+}
+
+void RenderGraph::report(std::ostream& out) const
+{
+	uint32_t livePasses = 0;
+	std::string culled;
+	for (const Pass& pass : m_passes) {
+		if (pass.live)
+			livePasses++;
+		else
+			culled += (culled.empty() ? "" : ", ") + pass.name;
+	}
+
+	uint32_t batches = 0, barriers = 0;
+	for (const BarrierBatch& batch : m_passBarriers) {
+		batches += batch.barriers.empty() ? 0 : 1;
+		barriers += static_cast<uint32_t>(batch.barriers.size());
+	}
+	batches += m_finalBarriers.barriers.empty() ? 0 : 1;
+	barriers += static_cast<uint32_t>(m_finalBarriers.barriers.size());
+
+	VkDeviceSize requested = 0, allocated = 0;
+	uint32_t transientCount = 0;
+	for (const Resource& resource : m_resources) {
+		if (resource.kind == ResourceKind::TransientImage && resource.memoryBlock != UINT32_MAX) {
+			requested += resource.size;
+			transientCount++;
+		}
+	}
+	for (const MemoryBlock& block : m_blocks)
+		allocated += block.size;
+
+	out << "render graph: " << livePasses << "/" << m_passes.size() << " passes live";
+	if (!culled.empty())
+		out << " (culled " << culled << ")";
+	out << ", " << barriers << " barriers in " << batches << " batches per frame" << std::endl;
+
+	out << "  transients: " << transientCount << " images, " << requested / (1024.0 * 1024.0) << " MB requested, "
+		<< allocated / (1024.0 * 1024.0) << " MB allocated in " << m_blocks.size() << " blocks, "
+		<< (requested - allocated) / (1024.0 * 1024.0) << " MB saved by aliasing" << std::endl;
+}
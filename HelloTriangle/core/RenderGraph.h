@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+#include "DeviceDispatch.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A frame described as passes that declare how they access images and buffers. compile() drops
+// passes whose results nobody reads, works out every layout transition and memory dependency
+// between passes (batched into one vkCmdPipelineBarrier per pass), and places transient images
+// whose lifetimes don't overlap in shared memory.
+//
+// The graph is compiled once and executed every frame. Imported resources may be rebound to
+// different handles between executions, e.g. the acquired swap chain image or per-frame buffers.
+// Hazards between consecutive frames are covered too: the first use of a resource waits on its
+// last use in the previous frame (or on the previous user of its memory, for aliased images).
+// Render passes executed by the graph must keep their attachments in the attachment layouts;
+// the graph does all transitions.
+class RenderGraph
+{
+public:
+	using ResourceId = uint32_t;
+
+	enum class PassType { Graphics, Compute, Transfer };
+
+	enum class Access
+	{
+		ColorAttachment,
+		DepthAttachment,
+		ShaderSampled,		// images in SHADER_READ_ONLY_OPTIMAL
+		ShaderRead,			// buffers, or images in GENERAL
+		ShaderWrite,
+		ShaderReadWrite,
+		IndirectRead,
+		TransferRead,
+		TransferWrite,
+		HostRead,			// final state only
+		Present				// final state only
+	};
+
+	struct ImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = {};
+		uint32_t mipLevels = 1;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkImageUsageFlags usage = 0;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	};
+
+	struct ResourceAccess
+	{
+		ResourceId resource;
+		Access access;
+	};
+
+public:
+	RenderGraph() = default;
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Transient images are created and barriers recorded through dispatch, which must outlive
+	// the graph.
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue, const DeviceDispatch& dispatch);
+
+	// Forgets all passes and resources. Transient images must have been released first.
+	void reset();
+
+	// Transient images are created by compile() and don't keep their contents between frames.
+	ResourceId createImage(const std::string& name, const ImageDesc& desc);
+
+	// With discardOnEntry the image's contents are undefined at the start of each frame, as for
+	// swap chain images; the first barrier then only waits for the first pass's own stage, which
+	// is where the acquire semaphore wait should be.
+	ResourceId importImage(const std::string& name, VkImageAspectFlags aspect, bool discardOnEntry);
+	ResourceId importBuffer(const std::string& name);
+
+	// The state an imported resource is left in at the end of every frame, e.g. Present.
+	void setFinalAccess(ResourceId resource, Access access);
+
+	void addPass(const std::string& name, PassType type, const std::vector<ResourceAccess>& accesses, std::function<void(VkCommandBuffer)> record);
+
+	void compile();
+
+	// Queues the transient images and their memory for destruction after lastFrame.
+	void releaseTransients(uint64_t lastFrame);
+
+	VkImage image(ResourceId resource) const { return m_resources[resource].image; }
+	void setImage(ResourceId resource, VkImage image) { m_resources[resource].image = image; }
+	void setBuffer(ResourceId resource, VkBuffer buffer) { m_resources[resource].buffer = buffer; }
+
+	void execute(VkCommandBuffer commandBuffer) const;
+
+	// Pass culling, barriers per frame and transient memory with and without aliasing.
+	void report(std::ostream& out) const;
+
+private:
+	enum class ResourceKind { TransientImage, ImportedImage, ImportedBuffer };
+
+	struct Resource
+	{
+		std::string name;
+		ResourceKind kind;
+		ImageDesc desc;
+		bool discardOnEntry = false;
+		bool hasFinalAccess = false;
+		Access finalAccess = Access::ShaderRead;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+
+		// Transient images only.
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryBlock = UINT32_MAX;
+		ResourceId previousAlias;	// last user of the same memory before this one, cyclically
+
+		bool isImage() const { return kind != ResourceKind::ImportedBuffer; }
+	};
+
+	struct Pass
+	{
+		std::string name;
+		PassType type;
+		std::vector<ResourceAccess> accesses;
+		std::function<void(VkCommandBuffer)> record;
+		bool live = true;
+	};
+
+	// Where a resource stands between passes: the writes not yet waited on by everyone, and the
+	// reads since the last write, which a later write or layout change has to wait for.
+	struct State
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;
+		VkPipelineStageFlags visibleStages = 0;	// stages the last write has already been made visible to
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	struct Barrier
+	{
+		ResourceId resource;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+	};
+
+	struct BarrierBatch
+	{
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<Barrier> barriers;
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeBits = ~0u;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		std::vector<ResourceId> resources;	// in order of first use
+	};
+
+	void cullPasses();
+	void createTransients();
+	void simulate(std::vector<State>& states, bool record);
+	void transition(State& state, ResourceId resource, Access access, PassType type, BarrierBatch& batch) const;
+	State entryState(ResourceId resource, const std::vector<State>& endStates) const;
+	void emit(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+	uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+	DeletionQueue* m_deletionQueue = nullptr;
+	const DeviceDispatch* m_dispatch = nullptr;
+
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<MemoryBlock> m_blocks;
+
+	std::vector<BarrierBatch> m_passBarriers;	// one per pass, before it runs
+	BarrierBatch m_finalBarriers;
+	bool m_compiled = false;
+};
@@ -0,0 +1,108 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Scales are kept on a grid so tiny corrections don't change the resolution every few frames.
+static const float SCALE_QUANTUM = 1.0f / 64.0f;
+
+static float quantize(float scale)
+{
+	return std::floor(scale / SCALE_QUANTUM + 0.5f) * SCALE_QUANTUM;
+}
+
+void ResolutionController::init(const Settings& settings)
+{
+	if (settings.minScale <= 0.0f || settings.minScale > settings.maxScale)
+		throw std::invalid_argument("ResolutionController: scale bounds must satisfy 0 < min <= max!");
+
+	m_settings = settings;
+	m_scale = settings.maxScale;
+	m_lowestScale = settings.maxScale;
+}
+
+void ResolutionController::openLog(const std::string& path)
+{
+	m_log.open(path);
+	if (!m_log)
+		throw std::runtime_error("failed to open " + path + " for writing!");
+
+	m_log << "frame,gpu_ms,average_ms,target_ms,scale,decision\n";
+}
+
+float ResolutionController::update(uint64_t frame, double gpuMilliseconds)
+{
+	m_average = m_samples == 0 ? gpuMilliseconds : m_average + m_settings.smoothing * (gpuMilliseconds - m_average);
+	m_samples++;
+
+	double target = m_settings.targetMilliseconds;
+	Decision decision = Decision::Hold;
+
+	if (m_settling > 0) {
+		m_settling--;
+		decision = Decision::Settle;
+	}
+	else if (m_average > target && m_scale > m_settings.minScale) {
+		// GPU time goes roughly with pixel count, i.e. with the square of the scale.
+		float scale = quantize(m_scale * static_cast<float>(std::sqrt(target / m_average)));
+		m_scale = std::max(m_settings.minScale, std::min(scale, m_scale - SCALE_QUANTUM));
+		decision = Decision::Down;
+	}
+	else if (m_average < target * (1.0 - m_settings.headroom) && m_scale < m_settings.maxScale) {
+		// Aim for the middle of the band, but never more than one step at a time.
+		float scale = quantize(m_scale * static_cast<float>(std::sqrt(target * (1.0 - 0.5 * m_settings.headroom) / m_average)));
+		scale = quantize(std::min(m_scale + m_settings.maxStepUp, std::max(scale, m_scale + SCALE_QUANTUM)));
+		m_scale = std::min(m_settings.maxScale, scale);
+		decision = Decision::Up;
+	}
+
+	if (decision == Decision::Down || decision == Decision::Up) {
+		m_settling = m_settings.settleFrames;
+		(decision == Decision::Down ? m_downCount : m_upCount)++;
+	}
+
+	if (gpuMilliseconds > target)
+		m_overBudget++;
+	m_scaleSum += m_scale;
+	m_lowestScale = std::min(m_lowestScale, m_scale);
+
+	if (m_log.is_open()) {
+		m_log << frame << ',' << gpuMilliseconds << ',' << m_average << ',' << target << ','
+			<< m_scale << ',' << decisionName(decision) << '\n';
+	}
+
+	return m_scale;
+}
+
+void ResolutionController::scaledExtent(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight) const
+{
+	scaledWidth = std::max(1u, static_cast<uint32_t>(width * m_scale) & ~1u);
+	scaledHeight = std::max(1u, static_cast<uint32_t>(height * m_scale) & ~1u);
+	scaledWidth = std::min(scaledWidth, width);
+	scaledHeight = std::min(scaledHeight, height);
+}
+
+void ResolutionController::report(std::ostream& out) const
+{
+	out << "dynamic resolution: target " << m_settings.targetMilliseconds << " ms, scale " << m_settings.minScale << "-" << m_settings.maxScale;
+	if (m_samples == 0) {
+		out << ", no frames timed" << std::endl;
+		return;
+	}
+
+	out << ", " << m_samples << " frames timed" << std::endl;
+	out << "  " << m_overBudget << " over budget, " << m_downCount << " steps down, " << m_upCount << " steps up" << std::endl;
+	out << "  scale: average " << m_scaleSum / m_samples << ", lowest " << m_lowestScale << ", final " << m_scale << std::endl;
+}
+
+const char* ResolutionController::decisionName(Decision decision)
+{
+	switch (decision) {
+	case Decision::Hold: return "hold";
+	case Decision::Settle: return "settle";
+	case Decision::Down: return "down";
+	case Decision::Up: return "up";
+	}
+	return "unknown";
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+// Picks the fraction of the output resolution to render at from measured GPU frame times.
+//
+// Frame times are smoothed with an exponential moving average. Above the target budget the scale
+// drops straight to what the budget should allow; below the budget minus a headroom band it
+// creeps back up in small steps. Inside the band it holds, and after every change it holds for a
+// few frames so the new resolution's timings can come in. The scale applies to both axes and is
+// clamped to [minScale, maxScale].
+class ResolutionController
+{
+public:
+	struct Settings
+	{
+		double targetMilliseconds = 16.0;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		double headroom = 0.15;		// fraction of the budget that must be spare before scaling up
+		float maxStepUp = 0.05f;
+		uint32_t settleFrames = 8;	// frames to hold after a change
+		double smoothing = 0.2;		// weight of the newest sample in the average
+	};
+
+	enum class Decision { Hold, Settle, Down, Up };
+
+public:
+	ResolutionController() = default;
+
+	void init(const Settings& settings);
+
+	// Writes one CSV line per update() to path.
+	void openLog(const std::string& path);
+
+	// Feeds the GPU time of a completed frame and returns the scale for the next frame recorded.
+	float update(uint64_t frame, double gpuMilliseconds);
+
+	float scale() const { return m_scale; }
+
+	// Scaled extent, rounded down to even sizes and at least 1x1.
+	void scaledExtent(uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight) const;
+
+	void report(std::ostream& out) const;
+
+	static const char* decisionName(Decision decision);
+
+private:
+	Settings m_settings;
+	float m_scale = 1.0f;
+	double m_average = 0.0;
+	uint64_t m_samples = 0;
+	uint32_t m_settling = 0;
+
+	std::ofstream m_log;
+
+	uint64_t m_downCount = 0;
+	uint64_t m_upCount = 0;
+	uint64_t m_overBudget = 0;
+	double m_scaleSum = 0.0;
+	float m_lowestScale = 1.0f;
+};
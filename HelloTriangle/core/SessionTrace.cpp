@@ -0,0 +1,282 @@
+#include "SessionTrace.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+const char SessionTrace::MAGIC[8] = { 'H', 'T', 'T', 'R', 'A', 'C', 'E', '\0' };
+
+static const size_t CHUNK_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+template <typename T>
+static void put(std::vector<char>& payload, const T& value)
+{
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+static void putString(std::vector<char>& payload, const std::string& value)
+{
+	put(payload, static_cast<uint32_t>(value.size()));
+	payload.insert(payload.end(), value.begin(), value.end());
+}
+
+// Reads a chunk's payload, throwing if it runs past the end.
+class PayloadReader
+{
+public:
+	PayloadReader(const std::vector<char>& payload) : m_payload(payload) {}
+
+	template <typename T>
+	T get()
+	{
+		T value;
+		std::memcpy(&value, take(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	std::string getString()
+	{
+		uint32_t size = get<uint32_t>();
+		const char* bytes = take(size);
+		return std::string(bytes, bytes + size);
+	}
+
+	void getBytes(std::vector<char>& bytes)
+	{
+		uint32_t size = get<uint32_t>();
+		const char* data = take(size);
+		bytes.assign(data, data + size);
+	}
+
+private:
+	const char* take(size_t size)
+	{
+		if (size > m_payload.size() - m_offset)
+			throw std::runtime_error("SessionTrace: chunk is shorter than its contents!");
+		const char* bytes = m_payload.data() + m_offset;
+		m_offset += size;
+		return bytes;
+	}
+
+private:
+	const std::vector<char>& m_payload;
+	size_t m_offset = 0;
+};
+
+void SessionTrace::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open trace " + path + "!");
+
+	char magic[sizeof(MAGIC)];
+	uint32_t version = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if (!file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error(path + " is not a session trace!");
+	if (version != VERSION)
+		throw std::runtime_error(path + " is a version " + std::to_string(version) + " trace, this build reads version " + std::to_string(VERSION) + "!");
+
+	m_arguments.clear();
+	m_device = Device{};
+	m_blobs.clear();
+	m_frames.clear();
+	m_setupCalls = Calls{};
+	m_frameCalls.clear();
+
+	std::vector<char> payload;
+	for (;;) {
+		uint32_t header[2];
+		if (!file.read(reinterpret_cast<char*>(header), CHUNK_HEADER_SIZE))
+			break;
+		payload.resize(header[1]);
+		if (!file.read(payload.data(), payload.size()))
+			break;
+
+		PayloadReader reader(payload);
+		switch (header[0]) {
+		case Tag::Arguments: {
+			uint32_t count = reader.get<uint32_t>();
+			for (uint32_t i = 0; i < count; i++)
+				m_arguments.push_back(reader.getString());
+			break;
+		}
+		case Tag::DeviceInfo:
+			m_device.name = reader.getString();
+			m_device.apiVersion = reader.get<uint32_t>();
+			m_device.driverVersion = reader.get<uint32_t>();
+			m_device.vendorId = reader.get<uint32_t>();
+			m_device.deviceId = reader.get<uint32_t>();
+			break;
+		case Tag::Blob: {
+			std::string name = reader.getString();
+			reader.getBytes(m_blobs[name]);
+			break;
+		}
+		case Tag::FrameInfo: {
+			Frame frame;
+			frame.startNanoseconds = reader.get<int64_t>();
+			frame.animationTime = reader.get<double>();
+			frame.width = reader.get<uint32_t>();
+			frame.height = reader.get<uint32_t>();
+			frame.drawCalls = reader.get<uint32_t>();
+			frame.triangles = reader.get<uint64_t>();
+			frame.cpuMilliseconds = reader.get<float>();
+			m_frames.push_back(frame);
+			break;
+		}
+		case Tag::CallStream: {
+			uint32_t frame = reader.get<uint32_t>();
+			Calls* calls = &m_setupCalls;
+			if (frame != SETUP_CALLS) {
+				if (frame >= m_frameCalls.size())
+					m_frameCalls.resize(static_cast<size_t>(frame) + 1);
+				calls = &m_frameCalls[frame];
+			}
+			calls->count = reader.get<uint32_t>();
+			reader.getBytes(calls->stream);
+			break;
+		}
+		case Tag::End:
+			return;
+		default:
+			break;
+		}
+	}
+}
+
+const std::vector<char>* SessionTrace::findBlob(const std::string& name) const
+{
+	auto it = m_blobs.find(name);
+	return it != m_blobs.end() ? &it->second : nullptr;
+}
+
+const SessionTrace::Calls* SessionTrace::frameCalls(size_t frame) const
+{
+	if (frame >= m_frameCalls.size() || m_frameCalls[frame].stream.empty())
+		return nullptr;
+	return &m_frameCalls[frame];
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	// Unwinding from an error is when a trace matters most; a failed write can't be reported
+	// from here, and what was written still loads.
+	try {
+		close();
+	}
+	catch (const std::exception&) {
+	}
+}
+
+void SessionRecorder::open(const std::string& path, const std::vector<std::string>& arguments)
+{
+	if (isOpen())
+		throw std::logic_error("SessionRecorder: opened twice!");
+
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("failed to create trace " + path + "!");
+	m_path = path;
+
+	uint32_t version = SessionTrace::VERSION;
+	m_file.write(SessionTrace::MAGIC, sizeof(SessionTrace::MAGIC));
+	m_file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	m_bytes = sizeof(SessionTrace::MAGIC) + sizeof(version);
+
+	m_payload.clear();
+	put(m_payload, static_cast<uint32_t>(arguments.size()));
+	for (const std::string& argument : arguments)
+		putString(m_payload, argument);
+	writeChunk(SessionTrace::Tag::Arguments, m_payload);
+}
+
+void SessionRecorder::addBlob(const std::string& name, const std::vector<char>& data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isOpen() || !m_blobNames.insert(name).second)
+		return;
+
+	// Built on the side, as blobs can arrive while a frame is being recorded.
+	std::vector<char> payload;
+	payload.reserve(2 * sizeof(uint32_t) + name.size() + data.size());
+	putString(payload, name);
+	put(payload, static_cast<uint32_t>(data.size()));
+	payload.insert(payload.end(), data.begin(), data.end());
+	writeChunk(SessionTrace::Tag::Blob, payload);
+}
+
+void SessionRecorder::setDevice(const SessionTrace::Device& device)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isOpen())
+		return;
+
+	m_payload.clear();
+	putString(m_payload, device.name);
+	put(m_payload, device.apiVersion);
+	put(m_payload, device.driverVersion);
+	put(m_payload, device.vendorId);
+	put(m_payload, device.deviceId);
+	writeChunk(SessionTrace::Tag::DeviceInfo, m_payload);
+}
+
+void SessionRecorder::addFrame(const SessionTrace::Frame& frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isOpen())
+		return;
+
+	m_payload.clear();
+	put(m_payload, frame.startNanoseconds);
+	put(m_payload, frame.animationTime);
+	put(m_payload, frame.width);
+	put(m_payload, frame.height);
+	put(m_payload, frame.drawCalls);
+	put(m_payload, frame.triangles);
+	put(m_payload, frame.cpuMilliseconds);
+	writeChunk(SessionTrace::Tag::FrameInfo, m_payload);
+	m_frames++;
+}
+
+void SessionRecorder::addCalls(uint32_t frame, uint32_t count, const std::vector<char>& stream)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isOpen())
+		return;
+
+	m_payload.clear();
+	m_payload.reserve(3 * sizeof(uint32_t) + stream.size());
+	put(m_payload, frame);
+	put(m_payload, count);
+	put(m_payload, static_cast<uint32_t>(stream.size()));
+	m_payload.insert(m_payload.end(), stream.begin(), stream.end());
+	writeChunk(SessionTrace::Tag::CallStream, m_payload);
+}
+
+void SessionRecorder::close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!isOpen())
+		return;
+
+	m_payload.clear();
+	put(m_payload, m_frames);
+	writeChunk(SessionTrace::Tag::End, m_payload);
+	m_file.close();
+	if (m_file.fail())
+		throw std::runtime_error("failed to write trace " + m_path + "!");
+}
+
+void SessionRecorder::writeChunk(uint32_t tag, const std::vector<char>& payload)
+{
+	if (payload.size() > std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error("SessionRecorder: chunk too large for a trace!");
+
+	uint32_t header[2] = { tag, static_cast<uint32_t>(payload.size()) };
+	m_file.write(reinterpret_cast<const char*>(header), CHUNK_HEADER_SIZE);
+	m_file.write(payload.data(), payload.size());
+	m_bytes += CHUNK_HEADER_SIZE + payload.size();
+}
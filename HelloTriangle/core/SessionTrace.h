@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// A recorded session: what a replay needs to put the same work in front of the GPU again, on
+// another machine, driver or engine build, and what the session measured to compare against.
+//
+// That is the command line it ran with, every file it read (model, texture, shaders, camera
+// path) as a data blob, the device it ran on, and per frame the inputs that drive it (animation
+// time, swap chain size) with the work it submitted (draw calls, triangles) and its timing. The
+// renderer is deterministic given these, so a replay re-records and submits the same command
+// stream, and can check it did by the draw and triangle counts.
+//
+// A session captured with its device calls (see CallCapture) also holds the call stream of
+// device setup and of every frame, so a replay can check call by call and trace-replay can
+// read them back without a GPU.
+//
+// The file is a header followed by chunks, each a tag, a size and a payload, in the host's byte
+// order. Readers skip tags they don't know. SessionRecorder writes it as the session runs;
+// SessionTrace::load() reads it whole.
+class SessionTrace
+{
+public:
+	struct Device
+	{
+		std::string name;
+		uint32_t apiVersion = 0;
+		uint32_t driverVersion = 0;
+		uint32_t vendorId = 0;
+		uint32_t deviceId = 0;
+	};
+
+	struct Frame
+	{
+		int64_t startNanoseconds = 0;	// since rendering started
+		double animationTime = 0.0;		// seconds
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t drawCalls = 0;
+		uint64_t triangles = 0;
+		float cpuMilliseconds = 0.0f;
+	};
+
+	// A CallTrace stream.
+	struct Calls
+	{
+		uint32_t count = 0;
+		std::vector<char> stream;
+	};
+
+	// The frame index under which the calls made before the first frame are stored.
+	static const uint32_t SETUP_CALLS = 0xffffffffu;
+
+public:
+	// Throws if the file can't be read or isn't a trace. One that was never closed, e.g. after a
+	// crash, loads up to its last whole chunk.
+	void load(const std::string& path);
+
+	const std::vector<std::string>& arguments() const { return m_arguments; }
+	const Device& device() const { return m_device; }
+	const std::vector<Frame>& frames() const { return m_frames; }
+
+	// Empty if the session wasn't captured with its calls.
+	const Calls& setupCalls() const { return m_setupCalls; }
+	// Null if the frame has no calls recorded.
+	const Calls* frameCalls(size_t frame) const;
+
+	// Null if the session never read the file.
+	const std::vector<char>* findBlob(const std::string& name) const;
+
+private:
+	friend class SessionRecorder;
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 1;
+
+	enum Tag : uint32_t
+	{
+		Arguments = 0x53475241,	// "ARGS"
+		DeviceInfo = 0x43564544,	// "DEVC"
+		Blob = 0x424f4c42,		// "BLOB"
+		FrameInfo = 0x4d415246,	// "FRAM"
+		CallStream = 0x4c4c4143,	// "CALL"
+		End = 0x20444e45		// "END "
+	};
+
+private:
+	std::vector<std::string> m_arguments;
+	Device m_device;
+	std::map<std::string, std::vector<char>> m_blobs;
+	std::vector<Frame> m_frames;
+	Calls m_setupCalls;
+	std::vector<Calls> m_frameCalls;
+};
+
+// Writes a SessionTrace as the session runs. Blobs may be added from any thread; frames and the
+// rest from one.
+class SessionRecorder
+{
+public:
+	SessionRecorder() = default;
+	~SessionRecorder();
+
+	SessionRecorder(const SessionRecorder&) = delete;
+	SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+	// Throws if path can't be written.
+	void open(const std::string& path, const std::vector<std::string>& arguments);
+	bool isOpen() const { return m_file.is_open(); }
+
+	// Each name is written once; later blobs of the same name are dropped.
+	void addBlob(const std::string& name, const std::vector<char>& data);
+	void setDevice(const SessionTrace::Device& device);
+	void addFrame(const SessionTrace::Frame& frame);
+	// frame is the frame's index, or SessionTrace::SETUP_CALLS.
+	void addCalls(uint32_t frame, uint32_t count, const std::vector<char>& stream);
+
+	// Marks the trace complete.
+	void close();
+
+	uint64_t frameCount() const { return m_frames; }
+	uint64_t bytesWritten() const { return m_bytes; }
+
+private:
+	void writeChunk(uint32_t tag, const std::vector<char>& payload);
+
+private:
+	std::ofstream m_file;
+	std::string m_path;
+	std::mutex m_mutex;
+	std::set<std::string> m_blobNames;
+	std::vector<char> m_payload;
+	uint64_t m_frames = 0;
+	uint64_t m_bytes = 0;
+};
@@ -0,0 +1,150 @@
+#include "TaskGraph.h"
+
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<void()> work, const std::vector<TaskId>& dependencies, bool onMainThread)
+{
+	TaskId id = static_cast<TaskId>(m_tasks.size());
+
+	for (TaskId dependency : dependencies) {
+		if (dependency >= id)
+			throw std::invalid_argument("TaskGraph: dependency on a task that doesn't exist yet!");
+		m_tasks[dependency].dependents.push_back(id);
+	}
+
+	Task task;
+	task.name = name;
+	task.work = std::move(work);
+	task.pendingDependencies = static_cast<uint32_t>(dependencies.size());
+	task.onMainThread = onMainThread;
+	m_tasks.push_back(std::move(task));
+	return id;
+}
+
+bool TaskGraph::takeTask(bool mainThread, bool acceptWorkerTasks, TaskId& task)
+{
+	// Called with m_mutex held.
+	std::deque<TaskId>* queue = nullptr;
+	if (mainThread && !m_mainReady.empty())
+		queue = &m_mainReady;
+	else if (acceptWorkerTasks && !m_workerReady.empty())
+		queue = &m_workerReady;
+
+	if (queue == nullptr)
+		return false;
+
+	task = queue->front();
+	queue->pop_front();
+	m_running++;
+	return true;
+}
+
+void TaskGraph::execute(TaskId id, uint32_t thread)
+{
+	Task& task = m_tasks[id];
+	task.thread = thread;
+	task.start = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+	std::exception_ptr error;
+	try {
+		task.work();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	task.end = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_running--;
+	m_remaining--;
+
+	if (error) {
+		if (!m_error)
+			m_error = error;
+	}
+	else {
+		for (TaskId dependent : task.dependents) {
+			Task& next = m_tasks[dependent];
+			if (--next.pendingDependencies == 0)
+				(next.onMainThread ? m_mainReady : m_workerReady).push_back(dependent);
+		}
+	}
+
+	m_wake.notify_all();
+}
+
+void TaskGraph::workerLoop(uint32_t thread)
+{
+	while (true) {
+		TaskId task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_remaining == 0 || m_error || !m_workerReady.empty(); });
+
+			if (m_remaining == 0 || m_error || !takeTask(false, true, task))
+				return;
+		}
+		execute(task, thread);
+	}
+}
+
+void TaskGraph::run(uint32_t workerCount)
+{
+	m_start = std::chrono::steady_clock::now();
+	m_remaining = static_cast<uint32_t>(m_tasks.size());
+	m_running = 0;
+	m_error = nullptr;
+
+	for (TaskId id = 0; id < m_tasks.size(); id++) {
+		if (m_tasks[id].pendingDependencies == 0)
+			(m_tasks[id].onMainThread ? m_mainReady : m_workerReady).push_back(id);
+	}
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < workerCount; i++)
+		workers.emplace_back(&TaskGraph::workerLoop, this, i + 1);
+
+	while (true) {
+		TaskId task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() {
+				return m_remaining == 0 || (m_error && m_running == 0) ||
+					(!m_error && (!m_mainReady.empty() || (workerCount == 0 && !m_workerReady.empty())));
+			});
+
+			if (m_remaining == 0 || m_error || !takeTask(true, workerCount == 0, task))
+				break;
+		}
+		execute(task, 0);
+	}
+
+	{
+		// Wake idle workers so they can see the graph is finished or failed.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wake.notify_all();
+	}
+	for (auto& worker : workers)
+		worker.join();
+
+	m_elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+void TaskGraph::report(std::ostream& out) const
+{
+	out << std::fixed << std::setprecision(1);
+	for (const Task& task : m_tasks) {
+		out << "  " << std::left << std::setw(24) << task.name << std::right
+			<< (task.thread == 0 ? "  main    " : "  worker " + std::to_string(task.thread))
+			<< std::setw(9) << task.start << " -" << std::setw(8) << task.end << " ms"
+			<< std::setw(9) << task.end - task.start << " ms" << std::endl;
+	}
+	out << "  total " << m_elapsed << " ms" << std::endl;
+	out << std::defaultfloat;
+}
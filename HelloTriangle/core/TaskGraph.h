@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A one-shot dependency graph of startup work. Tasks may only depend on tasks added before them,
+// so the graph can't contain cycles. Main-thread tasks run on the thread that calls run() (for
+// APIs such as GLFW that require it); all others run on worker threads as soon as their
+// dependencies have finished.
+class TaskGraph
+{
+public:
+	using TaskId = uint32_t;
+
+public:
+	TaskId add(const std::string& name, std::function<void()> work, const std::vector<TaskId>& dependencies = {}, bool onMainThread = false);
+
+	// Returns once every task has finished. If a task throws, no further tasks are started and
+	// the first exception is rethrown after the running ones complete. With no workers, worker
+	// tasks run on the calling thread too.
+	void run(uint32_t workerCount);
+
+	// One line per task: the thread it ran on and its start and end relative to run().
+	void report(std::ostream& out) const;
+
+	double elapsedMilliseconds() const { return m_elapsed; }
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<void()> work;
+		std::vector<TaskId> dependents;
+		uint32_t pendingDependencies = 0;
+		bool onMainThread = false;
+
+		uint32_t thread = 0;	// 0 is the main thread
+		double start = 0.0;
+		double end = 0.0;
+	};
+
+	bool takeTask(bool mainThread, bool acceptWorkerTasks, TaskId& task);
+	void execute(TaskId task, uint32_t thread);
+	void workerLoop(uint32_t thread);
+
+private:
+	std::vector<Task> m_tasks;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<TaskId> m_mainReady;
+	std::deque<TaskId> m_workerReady;
+	uint32_t m_remaining = 0;
+	uint32_t m_running = 0;
+	std::exception_ptr m_error;
+
+	std::chrono::steady_clock::time_point m_start;
+	double m_elapsed = 0.0;
+};
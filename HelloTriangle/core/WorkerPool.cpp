@@ -0,0 +1,107 @@
+#include "WorkerPool.h"
+
+#include <stdexcept>
+
+WorkerPool::~WorkerPool()
+{
+	destroy();
+}
+
+void WorkerPool::init(uint32_t workerCount)
+{
+	if (!m_workers.empty())
+		throw std::logic_error("WorkerPool: initialized twice!");
+
+	m_stopping = false;
+	for (uint32_t i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&WorkerPool::workerLoop, this, m_generation);
+}
+
+void WorkerPool::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void WorkerPool::run(uint32_t jobCount, const std::function<void(uint32_t)>& work)
+{
+	if (jobCount == 0)
+		return;
+
+	if (m_workers.empty() || jobCount == 1) {
+		for (uint32_t job = 0; job < jobCount; job++)
+			work(job);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_work = &work;
+		m_jobCount = jobCount;
+		m_nextJob.store(0, std::memory_order_relaxed);
+		m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+		m_error = nullptr;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	runJobs();
+
+	// Every worker has to check in, not just the jobs finish, so none of them can still be
+	// reading m_work once this returns.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&]() { return m_busyWorkers == 0; });
+	m_work = nullptr;
+
+	if (m_error) {
+		std::exception_ptr error = m_error;
+		m_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void WorkerPool::runJobs()
+{
+	while (true) {
+		uint32_t job = m_nextJob.fetch_add(1, std::memory_order_relaxed);
+		if (job >= m_jobCount)
+			return;
+
+		try {
+			(*m_work)(job);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error)
+				m_error = std::current_exception();
+			// Skip what's left rather than run it against a failed frame.
+			m_nextJob.store(m_jobCount, std::memory_order_relaxed);
+		}
+	}
+}
+
+void WorkerPool::workerLoop(uint64_t seen)
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_stopping || m_generation != seen; });
+			if (m_stopping)
+				return;
+			seen = m_generation;
+		}
+
+		runJobs();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+			m_done.notify_one();
+	}
+}
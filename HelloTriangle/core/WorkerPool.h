@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Long-lived worker threads for the data-parallel loops that run every frame. Unlike TaskGraph,
+// which starts its threads for one run, the workers here are started once and sleep between
+// jobs, so splitting a loop costs a wake-up rather than a thread creation.
+//
+// run() may only be called from one thread at a time.
+class WorkerPool
+{
+public:
+	WorkerPool() = default;
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void init(uint32_t workerCount);
+	void destroy();
+
+	// The workers plus the thread calling run().
+	uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	// Calls work(job) for every job in [0, jobCount) on the workers and the calling thread and
+	// returns once all have finished. If a job throws, the first exception is rethrown.
+	void run(uint32_t jobCount, const std::function<void(uint32_t)>& work);
+
+private:
+	void workerLoop(uint64_t seen);
+	void runJobs();
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation = 0;
+	uint32_t m_busyWorkers = 0;
+	bool m_stopping = false;
+	std::exception_ptr m_error;
+
+	const std::function<void(uint32_t)>* m_work = nullptr;
+	uint32_t m_jobCount = 0;
+	std::atomic<uint32_t> m_nextJob{ 0 };
+};
@@ -6,16 +6,15 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/hash.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <algorithm>
 #include <chrono>
@@ -23,11 +22,41 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
 #include <limits>
 #include <array>
 #include <optional>
 #include <set>
 #include <unordered_map>
+#include <thread>
+#include <functional>
+
+#include "scene/SceneTransforms.h"
+#include "scene/SceneBvh.h"
+#include "scene/InstanceBatcher.h"
+#include "scene/DrawList.h"
+#include "core/DeletionQueue.h"
+#include "core/TaskGraph.h"
+#include "core/WorkerPool.h"
+#include "core/FrameWriter.h"
+#include "core/RenderGraph.h"
+#include "core/ResolutionController.h"
+#include "core/DeviceProfile.h"
+#include "core/DeviceDispatch.h"
+#include "core/GpuProfiler.h"
+#include "core/PhaseTimer.h"
+#include "core/Benchmark.h"
+#include "core/HostAllocator.h"
+#include "core/PipelineStatistics.h"
+#include "core/DeviceMemoryTracker.h"
+#include "core/SessionTrace.h"
+#include "core/CallCapture.h"
+#include "scene/MeshSimplifier.h"
+#include "scene/CameraPath.h"
+#include "scene/Vertex.h"
+#include "scene/ObjLoader.h"
+#include "scene/StressScene.h"
+#include "core/FileUtils.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -37,6 +66,14 @@ const std::string TEXTURE_PATH = "textures/viking_room.png";
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+const uint32_t MAX_LODS = 4;
+
+// Readback buffers: one per frame in flight, plus two so the writer thread can lag behind.
+const uint32_t READBACK_SLOTS = MAX_FRAMES_IN_FLIGHT + 2;
+
+// GPU profiler slots: one per frame in flight, then one for one-shot command buffers.
+const uint32_t ONE_SHOT_PROFILER_SLOT = MAX_FRAMES_IN_FLIGHT;
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -45,35 +82,23 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+const std::vector<const char*> optionalDeviceExtensions = {
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+};
+
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
 const bool enableValidationLayers = true;
 #endif
 
-VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
-    auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
-    }
-    else {
-        return VK_ERROR_EXTENSION_NOT_PRESENT;
-    }
-}
-
-void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        func(instance, debugMessenger, pAllocator);
-    }
-}
-
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    bool presentRequired = true;
 
     bool isComplete() {
-        return graphicsFamily.has_value() && presentFamily.has_value();
+        return graphicsFamily.has_value() && (presentFamily.has_value() || !presentRequired);
     }
 };
 
@@ -83,85 +108,195 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
+// Per-instance vertex data: which world matrix to use and an RGBA8 tint.
+struct InstanceData {
+    uint32_t worldIndex;
+    uint32_t tint;
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
         return bindingDescription;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
+        attributeDescriptions[0].binding = 1;
+        attributeDescriptions[0].location = 3;
+        attributeDescriptions[0].format = VK_FORMAT_R32_UINT;
+        attributeDescriptions[0].offset = offsetof(InstanceData, worldIndex);
 
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 4;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = offsetof(InstanceData, tint);
 
         return attributeDescriptions;
     }
-
-    bool operator==(const Vertex& other) const {
-        return pos == other.pos && color == other.color && texCoord == other.texCoord;
-    }
 };
 
-namespace std {
-    template<> struct hash<Vertex> {
-        size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
-
 struct UniformBufferObject {
-    alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
 };
 
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // largest object-space deviation from the full-resolution surface
+};
+
+// All LODs of a mesh share its vertices and differ only in their index range.
+struct Mesh {
+    std::array<MeshLod, MAX_LODS> lods;
+    uint32_t lodCount;
+    int32_t vertexOffset;
+    Aabb bounds;
+};
+
+struct SceneObject {
+    uint32_t node;
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t tint;
+    uint32_t bvhProxy;
+};
+
+struct GpuObjectRecord {
+    alignas(16) glm::vec4 boundsCenter;
+    alignas(16) glm::vec4 boundsExtent;
+    alignas(16) glm::uvec4 lodFirstIndex;
+    alignas(16) glm::uvec4 lodIndexCount;
+    alignas(16) glm::vec4 lodError;
+    int32_t vertexOffset;
+    uint32_t worldIndex;
+    uint32_t lodCount;
+};
+
+struct CullPushConstants {
+    glm::vec4 planes[6];
+    glm::vec4 cameraLod; // camera position, w = LOD distance scale
+    uint32_t objectCount;
+    uint32_t compact;
+};
+
+// Filled by the cull shaders. With occlusion culling, drawCount covers the early phase and
+// lateDrawCount the objects that became visible in the late phase.
+struct DrawCounts {
+    uint32_t drawCount;
+    uint32_t lateDrawCount;
+    uint32_t triangleCount;
+    uint32_t occludedCount;
+};
+
+struct HiZPushConstants {
+    glm::ivec2 sourceSize;
+    glm::ivec2 destinationSize;
+};
+
+struct AppOptions {
+    bool gpuDriven = false;
+    bool occlusionCulling = false;
+    bool instancing = true;
+    uint32_t copies = 1;
+    uint32_t benchmarkFrames = 0;
+    bool lod = true;
+    float lodThreshold = 1.0f;
+    bool blockingResize = false;
+    bool headless = false;
+    float fixedTimestep = 0.0f;
+    std::string outputTarget;
+    bool outputPipe = false;
+    float dynamicResolution = 0.0f; // target GPU milliseconds per frame, 0 for fixed resolution
+    float minRenderScale = 0.5f;
+    std::string resolutionLog = "resolution.csv";
+    std::string gpuTrace; // Chrome trace of GPU and CPU scopes, written at exit
+    bool phaseStats = false;
+    bool benchmark = false; // --frames measured frames after warmupFrames, on the fixed timestep
+    uint32_t warmupFrames = 60;
+    std::string cameraPath;
+    std::string benchmarkOutput = "benchmark.json";
+    bool hostAllocations = false; // count the driver's host allocations, reported at exit
+    bool pipelineStats = false; // pipeline statistics per pass, reported at exit
+    bool memoryReport = false; // device memory per category, heap and type, reported at exit
+    bool loaderDispatch = false; // core device commands through the loader's trampolines, for comparison
+    bool stressScene = false; // generated content from stress in place of the model and texture
+    StressScene::Settings stress;
+    std::string capturePath; // session trace to record
+    std::string replayPath; // session trace to replay, whose arguments come before these
+    bool replayCapturedTiming = false; // start replayed frames when they started, not as fast as possible
+    std::vector<std::string> arguments; // the command line without the capture and replay options
+};
+
 class HelloTriangleApplication {
 public:
+    // A replay takes its options from the trace, and must outlive the application.
+    explicit HelloTriangleApplication(const AppOptions& options, const SessionTrace* replayTrace = nullptr) : options(options), replayTrace(replayTrace) {}
+
     void run() {
-        initWindow();
+        startupStart = std::chrono::steady_clock::now();
+        if (!options.capturePath.empty()) {
+            sessionRecorder.open(options.capturePath, options.arguments);
+        }
+        if (options.phaseStats || !options.gpuTrace.empty()) {
+            createPhaseTimer();
+        }
+        if (!options.cameraPath.empty()) {
+            std::vector<char> data = readAsset(options.cameraPath);
+            std::istringstream stream(std::string(data.begin(), data.end()));
+            cameraPath.load(stream, options.cameraPath);
+        }
+        if (options.benchmark) {
+            createBenchmark();
+        }
+        if (options.hostAllocations) {
+            createHostAllocator();
+        }
+        if (!options.headless) {
+            initWindow();
+        }
         initVulkan();
+        traceCalls(SessionTrace::SETUP_CALLS);
+        animationStart = std::chrono::steady_clock::now();
         mainLoop();
         cleanup();
     }
 
 private:
-    GLFWwindow* window;
+    AppOptions options;
+
+    GLFWwindow* window = nullptr;
+
+    // Passed to every create and destroy call; null unless --host-allocations is given.
+    HostAllocator hostAllocator;
+    const VkAllocationCallbacks* allocator = nullptr;
 
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    DeviceProfile deviceProfile;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
     VkDevice device;
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
 
-    VkSwapchainKHR swapChain;
+    // Every device command goes through here, and the instance's extension commands through
+    // instanceDispatch; see DeviceDispatch.
+    DeviceDispatch dispatch;
+    InstanceDispatch instanceDispatch;
+
+    // Headless runs render into offscreen images in place of the swap chain's, one per frame in
+    // flight, and leave swapChain null.
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
+    std::vector<VkDeviceMemory> offscreenImagesMemory;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
@@ -172,16 +307,71 @@ private:
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
 
+    // One-shot command buffers come from commandPool. Each frame in flight records into a buffer
+    // from its own pool, which is reset whole once the frame's fence has signaled, so the driver
+    // can recycle the pool's memory instead of tracking every buffer's on its own.
     VkCommandPool commandPool;
+    std::vector<VkCommandPool> frameCommandPools;
+
+    // The frame's passes, the barriers between them and the size-dependent attachments, which
+    // are the graph's transient images. Rebuilt with the swap chain.
+    RenderGraph frameGraph;
+    RenderGraph::ResourceId colorTarget;
+    RenderGraph::ResourceId depthTarget;
+    RenderGraph::ResourceId hizTarget;
+    RenderGraph::ResourceId swapChainTarget;
+    RenderGraph::ResourceId drawCommandTarget;
+    RenderGraph::ResourceId drawCountTarget;
+    RenderGraph::ResourceId visibilityTarget;
+    RenderGraph::ResourceId readbackTarget;
+    uint32_t recordingImageIndex = 0;
+
+    // With dynamic resolution the scene renders into the top-left renderExtent of attachments
+    // sized for the swap chain, resolves into sceneImage and is stretched over the swap chain
+    // image. The attachments are never resized for a scale change.
+    ResolutionController resolutionController;
+    VkExtent2D renderExtent;
+    RenderGraph::ResourceId sceneTarget;
+    VkImage sceneImage;
+    VkImageView sceneImageView;
+    VkFilter upscaleFilter = VK_FILTER_LINEAR;
+
+    // Times every pass of the graph and every one-shot command buffer. Enabled by --gpu-trace,
+    // and by dynamic resolution, which feeds on the frame's GPU time.
+    GpuProfiler gpuProfiler;
+    bool calibratedTimestampsEnabled = false;
+
+    // Vertex, primitive and shader invocation counts per pass, with --pipeline-stats.
+    PipelineStatistics pipelineStatistics;
+
+    // Every device allocation by category and name. M prints the report, as does exit with
+    // --memory-report.
+    DeviceMemoryTracker memoryTracker;
+    bool memoryReportRequested = false;
+
+    // CPU time of drawFrame's phases, to tell GPU backpressure (the fence wait) from acquire
+    // stalls and CPU-bound work. With --phase-stats, P prints the histograms so far.
+    struct FramePhases {
+        uint32_t fenceWait;
+        uint32_t acquire;
+        uint32_t update;
+        uint32_t record;
+        uint32_t submit;
+        uint32_t present;
+    };
+    PhaseTimer phaseTimer;
+    FramePhases framePhases{};
+    bool phaseReportRequested = false;
 
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
     VkImageView colorImageView;
 
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
     VkImageView depthImageView;
 
+    stbi_uc* texturePixels = nullptr;
+    int textureWidth = 0;
+    int textureHeight = 0;
     uint32_t mipLevels;
     VkImage textureImage;
     VkDeviceMemory textureImageMemory;
@@ -190,6 +380,7 @@ private:
 
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<Mesh> meshes;
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
     VkBuffer indexBuffer;
@@ -199,6 +390,119 @@ private:
     std::vector<VkDeviceMemory> uniformBuffersMemory;
     std::vector<void*> uniformBuffersMapped;
 
+    // Splits the per-frame transform update and draw sort; started once for the whole session.
+    WorkerPool workerPool;
+
+    SceneTransforms sceneTransforms;
+    SceneBvh sceneBvh;
+    std::vector<SceneObject> sceneObjects;
+    uint32_t roomNode;
+
+    // With --stress, roomNode is a static root holding the generated objects, and only the
+    // spinning ones are animated.
+    struct SpinningObject {
+        uint32_t node;
+        float angle;
+        float spin;
+    };
+    StressScene stressScene;
+    std::vector<SpinningObject> spinningObjects;
+
+    std::vector<uint32_t> visibleObjects;
+    CullStats cullStats;
+    Frustum frameFrustum;
+    float sceneRadius = 1.0f;
+
+    bool multiDrawIndirectSupported = false;
+
+    VkDescriptorSetLayout cullDescriptorSetLayout;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+    VkPipeline cullEarlyPipeline;
+    VkPipeline cullLatePipeline;
+    std::vector<VkDescriptorSet> cullDescriptorSets;
+
+    VkRenderPass earlyRenderPass;
+    VkRenderPass lateRenderPass;
+
+    VkDescriptorSetLayout hizDescriptorSetLayout;
+    VkPipelineLayout hizPipelineLayout;
+    VkPipeline hizDepthPipeline;
+    VkPipeline hizReducePipeline;
+    VkSampler hizSampler;
+
+    VkImage hizImage;
+    VkImageView hizImageView;
+    std::vector<VkImageView> hizMipViews;
+    std::vector<VkExtent2D> hizMipExtents;
+    VkDescriptorPool hizDescriptorPool;
+    std::vector<VkDescriptorSet> hizDescriptorSets;
+    std::vector<bool> cullHiZDescriptorsStale;
+
+    VkBuffer visibilityBuffer;
+    VkDeviceMemory visibilityBufferMemory;
+    uint32_t occludedCount = 0;
+
+    VkBuffer objectRecordBuffer;
+    VkDeviceMemory objectRecordBufferMemory;
+    std::vector<VkBuffer> drawCommandBuffers;
+    std::vector<VkDeviceMemory> drawCommandBuffersMemory;
+    std::vector<VkBuffer> drawCountBuffers;
+    std::vector<VkDeviceMemory> drawCountBuffersMemory;
+    std::vector<void*> drawCountBuffersMapped;
+
+    InstanceBatcher instanceBatcher;
+    std::vector<InstanceBatcher::Batch> drawBatches;
+    std::vector<uint32_t> drawBatchDepths;
+    std::vector<uint32_t> objectDepths;
+    DrawList drawList;
+    DrawStateChanges stateChanges;
+    uint32_t materialCount = 1;
+    uint32_t drawCallCount = 0;
+    uint64_t triangleCount = 0;
+
+    glm::vec3 cameraPosition;
+    float lodScale = 1.0f;
+
+    std::chrono::steady_clock::time_point startupStart;
+    std::unordered_map<std::string, std::vector<char>> shaderCode;
+
+    std::chrono::steady_clock::time_point lastStatsReport;
+    uint32_t totalFrames = 0;
+    std::chrono::steady_clock::time_point firstTimedFrame;
+
+    // Animation runs on wall time from animationStart, or on the benchmark's virtual clock.
+    std::chrono::steady_clock::time_point animationStart;
+    Benchmark benchmark;
+    CameraPath cameraPath;
+
+    // Capture records every frame's inputs and work; replay feeds the inputs back and counts the
+    // frames whose work came out different.
+    SessionRecorder sessionRecorder;
+    const SessionTrace* replayTrace = nullptr;
+    std::chrono::steady_clock::time_point frameStart;
+    float frameAnimationTime = 0.0f;
+    VkExtent2D replayWindowExtent{};
+    double capturedCpuMilliseconds = 0.0;
+    double replayCpuMilliseconds = 0.0;
+    uint32_t replayMismatches = 0;
+    uint32_t firstMismatchedFrame = 0;
+
+    // A capture also records the device calls of setup and of every frame through callCapture; a
+    // replay of a trace that has them records its own and compares.
+    CallCapture callCapture;
+    std::vector<char> tracedCalls;
+    uint32_t callMismatches = 0;
+    std::string firstCallMismatch;
+
+    std::vector<VkBuffer> objectBuffers;
+    std::vector<VkDeviceMemory> objectBuffersMemory;
+    std::vector<void*> objectBuffersMapped;
+
+    std::vector<VkBuffer> instanceBuffers;
+    std::vector<VkDeviceMemory> instanceBuffersMemory;
+    std::vector<void*> instanceBuffersMapped;
+
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
 
@@ -209,6 +513,20 @@ private:
     std::vector<VkFence> inFlightFences;
     uint32_t currentFrame = 0;
 
+    // Frames are numbered from 1 in submission order. The queue completes them in order, so a
+    // signaled fence means every frame up to the one it guarded has finished.
+    uint64_t submittedFrameCount = 0;
+    uint64_t completedFrameCount = 0;
+    std::vector<uint64_t> frameNumbers;
+
+    DeletionQueue deletionQueue;
+
+    FrameWriter frameWriter;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<VkDeviceMemory> readbackBuffersMemory;
+    std::vector<void*> readbackBuffersMapped;
+    std::vector<std::optional<uint32_t>> frameReadbackSlots;
+
     bool framebufferResized = false;
 
     void initWindow() {
@@ -219,6 +537,7 @@ private:
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwSetKeyCallback(window, keyCallback);
     }
 
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -226,111 +545,403 @@ private:
         app->framebufferResized = true;
     }
 
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+            app->phaseReportRequested = true;
+        }
+        if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+            app->memoryReportRequested = true;
+        }
+    }
+
+    void createHostAllocator() {
+        HostAllocator::Settings settings{};
+        settings.warmupFrames = options.benchmark ? options.warmupFrames : 60;
+        hostAllocator.init(settings);
+        allocator = hostAllocator.callbacks();
+    }
+
+    void createPhaseTimer() {
+        // Only the render thread records, and it drains its ring every frame.
+        phaseTimer.init(256);
+        framePhases.fenceWait = phaseTimer.addPhase("fence wait");
+        framePhases.acquire = phaseTimer.addPhase("acquire");
+        framePhases.update = phaseTimer.addPhase("update");
+        framePhases.record = phaseTimer.addPhase("record");
+        framePhases.submit = phaseTimer.addPhase("submit");
+        framePhases.present = phaseTimer.addPhase("present");
+
+        if (!options.gpuTrace.empty()) {
+            phaseTimer.setListener([this](uint32_t phase, int64_t begin, int64_t end) {
+                gpuProfiler.recordCpuScope(gpuProfiler.nameId(phaseTimer.phaseName(phase)), begin, end);
+            });
+        }
+    }
+
     void initVulkan() {
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createDescriptorSetLayout();
-        createGraphicsPipeline();
-        createCommandPool();
-        createColorResources();
-        createDepthResources();
-        createFramebuffers();
-        createTextureImage();
-        createTextureImageView();
-        createTextureSampler();
-        loadModel();
-        createVertexBuffer();
-        createIndexBuffer();
-        createUniformBuffers();
-        createDescriptorPool();
-        createDescriptorSets();
-        createCommandBuffers();
-        createSyncObjects();
+        // Decoding, OBJ parsing and shader reads don't touch Vulkan, so they run on worker threads
+        // while the device, swap chain and pipelines are created on this thread in the usual order.
+        TaskGraph graph;
+
+        workerPool.init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+
+        if (options.stressScene) {
+            stressScene.init(options.stress);
+        }
+
+        std::vector<std::string> shaderPaths = { "shaders/vert.spv", "shaders/frag.spv" };
+        if (options.occlusionCulling) {
+            shaderPaths.insert(shaderPaths.end(), { "shaders/cull_occlusion.spv", "shaders/hiz_depth.spv", "shaders/hiz_depth_ms.spv", "shaders/hiz_reduce.spv" });
+        }
+        else if (options.gpuDriven) {
+            shaderPaths.push_back("shaders/cull.spv");
+        }
+
+        auto shaders = graph.add("read shaders", [this, shaderPaths]() { preloadShaders(shaderPaths); });
+        auto texture = graph.add("decode texture", [this]() { decodeTexture(); });
+        auto model = graph.add("load model", [this]() { loadModel(); });
+        auto scene = graph.add("build scene", [this]() { createScene(); }, { model });
+
+        std::vector<TaskGraph::TaskId> mainChain;
+        auto step = [&](const std::string& name, std::function<void()> work, std::vector<TaskGraph::TaskId> dependencies = {}) {
+            if (!mainChain.empty()) {
+                dependencies.push_back(mainChain.back());
+            }
+            mainChain.push_back(graph.add(name, std::move(work), dependencies, true));
+        };
+
+        step("instance", [this]() {
+            createInstance();
+            setupDebugMessenger();
+            if (!options.headless) {
+                createSurface();
+            }
+        });
+        step("device", [this]() {
+            pickPhysicalDevice();
+            sessionRecorder.setDevice({ deviceProfile.name, deviceProfile.apiVersion, deviceProfile.driverVersion, deviceProfile.vendorId, deviceProfile.deviceId });
+            createLogicalDevice();
+            memoryTracker.init(physicalDevice, device, dispatch);
+            deletionQueue.init(device, dispatch, allocator, &memoryTracker);
+            frameGraph.init(device, physicalDevice, deletionQueue, dispatch);
+            checkOcclusionCullingSupport();
+            if (options.dynamicResolution > 0.0f || !options.gpuTrace.empty() || options.benchmark) {
+                createProfiler();
+            }
+            if (options.pipelineStats) {
+                PipelineStatistics::Settings settings;
+                settings.slotCount = MAX_FRAMES_IN_FLIGHT;
+                pipelineStatistics.init(device, dispatch, allocator, settings);
+            }
+        });
+        step("swap chain", [this]() {
+            if (options.headless) {
+                createOffscreenTargets();
+            }
+            else {
+                createSwapChain();
+            }
+            createImageViews();
+            createRenderPass();
+            createDescriptorSetLayout();
+        });
+        step("pipelines", [this]() {
+            createGraphicsPipeline();
+            if (options.gpuDriven) {
+                createCullPipeline();
+            }
+            if (options.occlusionCulling) {
+                createHiZPipelines();
+            }
+        }, { shaders });
+        step("attachments", [this]() {
+            createCommandPool();
+            createFrameGraph();
+            frameGraph.report(std::cout);
+            if (options.occlusionCulling) {
+                createHiZResources();
+            }
+            createFramebuffers();
+            if (!options.outputTarget.empty()) {
+                createReadbackBuffers();
+            }
+        });
+        step("texture upload", [this]() {
+            createTextureImage();
+            createTextureImageView();
+            createTextureSampler();
+        }, { texture });
+        step("geometry upload", [this]() {
+            createVertexBuffer();
+            createIndexBuffer();
+        }, { model });
+        step("scene buffers", [this]() {
+            createUniformBuffers();
+            createObjectBuffers();
+            createInstanceBuffers();
+            if (options.gpuDriven) {
+                createCullBuffers();
+            }
+        }, { scene });
+        step("descriptors", [this]() {
+            createDescriptorPool();
+            createDescriptorSets();
+            if (options.gpuDriven) {
+                createCullDescriptorSets();
+            }
+            createCommandBuffers();
+            createSyncObjects();
+        });
+
+        graph.run(std::min(3u, std::max(1u, std::thread::hardware_concurrency() - 1)));
+        shaderCode.clear();
+
+        double windowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count() - graph.elapsedMilliseconds();
+        std::cout << "startup stages (window " << windowMs << " ms):" << std::endl;
+        graph.report(std::cout);
     }
 
     void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+        // Headless runs have no window to close; parseOptions makes sure they have a frame count.
+        while (options.headless || !glfwWindowShouldClose(window)) {
+            if (!options.headless) {
+                glfwPollEvents();
+            }
+            if (replayTrace) {
+                paceReplay();
+            }
             drawFrame();
+            reportFrameStats();
+
+            phaseTimer.aggregate();
+            if (phaseReportRequested && options.phaseStats) {
+                phaseTimer.report(std::cout);
+            }
+            phaseReportRequested = false;
+
+            if (memoryReportRequested) {
+                memoryTracker.report(std::cout);
+            }
+            memoryReportRequested = false;
+
+            bool done = benchmark.active() ? benchmark.finished() : options.benchmarkFrames > 0 && totalFrames >= options.benchmarkFrames;
+            if (replayTrace && totalFrames >= replayTrace->frames().size()) {
+                done = true;
+            }
+            if (done) {
+                printBenchmarkSummary();
+                break;
+            }
+        }
+
+        dispatch.deviceWaitIdle(device);
+
+        if (frameWriter.isActive()) {
+            // Hand over the frames still in flight, oldest first.
+            for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                submitReadback((currentFrame + i) % MAX_FRAMES_IN_FLIGHT);
+            }
+            frameWriter.finish();
+            frameWriter.report(std::cout);
+        }
+
+        if (options.dynamicResolution > 0.0f) {
+            resolutionController.report(std::cout);
+        }
+
+        if (replayTrace) {
+            reportReplay();
+        }
+        if (sessionRecorder.isOpen()) {
+            sessionRecorder.close();
+            std::cout << "session trace written to " << options.capturePath << ": " << sessionRecorder.frameCount() << " frames, "
+                << sessionRecorder.bytesWritten() << " bytes" << std::endl;
+        }
+
+        // Before the trace is written, which the phases also go to.
+        phaseTimer.aggregate();
+        if (options.phaseStats) {
+            phaseTimer.report(std::cout);
+        }
+
+        if (gpuProfiler.enabled()) {
+            // Pick up the frames that were still in flight, oldest first.
+            GpuProfiler::FrameTiming gpuTiming;
+            for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                if (gpuProfiler.collect((currentFrame + i) % MAX_FRAMES_IN_FLIGHT, gpuTiming)) {
+                    benchmark.addGpuTime(gpuTiming.frame, gpuTiming.gpuMilliseconds);
+                }
+            }
+            gpuProfiler.report(std::cout);
+
+            if (!options.gpuTrace.empty()) {
+                gpuProfiler.writeTrace(options.gpuTrace);
+                std::cout << "gpu trace written to " << options.gpuTrace << std::endl;
+            }
+        }
+
+        if (pipelineStatistics.enabled()) {
+            for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                pipelineStatistics.collect((currentFrame + i) % MAX_FRAMES_IN_FLIGHT);
+            }
+            pipelineStatistics.report(std::cout);
         }
 
-        vkDeviceWaitIdle(device);
+        // Before cleanup, so everything the scene needed is still live.
+        if (options.memoryReport) {
+            memoryTracker.report(std::cout);
+        }
+
+        if (benchmark.active()) {
+            writeBenchmarkSummary();
+        }
+    }
+
+    // Queues a buffer and its memory for destruction once frame lastFrame has completed.
+    void releaseBuffer(VkBuffer buffer, VkDeviceMemory memory, uint64_t lastFrame) {
+        deletionQueue.push(DeletionQueue::Kind::Buffer, buffer, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::Memory, memory, lastFrame);
     }
 
-    void cleanupSwapChain() {
-        vkDestroyImageView(device, depthImageView, nullptr);
-        vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+    void releaseImage(VkImage image, VkDeviceMemory memory, VkImageView view, uint64_t lastFrame) {
+        deletionQueue.push(DeletionQueue::Kind::ImageView, view, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::Image, image, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::Memory, memory, lastFrame);
+    }
 
-        vkDestroyImageView(device, colorImageView, nullptr);
-        vkDestroyImage(device, colorImage, nullptr);
-        vkFreeMemory(device, colorImageMemory, nullptr);
+    // Queues the swap chain and the size-dependent resources built on it. They stay alive until
+    // every frame submitted so far has finished. There is no fence for presentation, so the old
+    // swap chain also waits for the frames after it: once MAX_FRAMES_IN_FLIGHT more have finished,
+    // the semaphores its last presents waited on have been reused, so those presents are done.
+    void retireSwapChain() {
+        uint64_t lastFrame = submittedFrameCount;
 
         for (auto framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            deletionQueue.push(DeletionQueue::Kind::Framebuffer, framebuffer, lastFrame);
+        }
+
+        if (options.occlusionCulling) {
+            deletionQueue.push(DeletionQueue::Kind::DescriptorPool, hizDescriptorPool, lastFrame);
+            for (auto imageView : hizMipViews) {
+                deletionQueue.push(DeletionQueue::Kind::ImageView, imageView, lastFrame);
+            }
+            deletionQueue.push(DeletionQueue::Kind::ImageView, hizImageView, lastFrame);
+        }
+
+        deletionQueue.push(DeletionQueue::Kind::ImageView, depthImageView, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::ImageView, colorImageView, lastFrame);
+        if (options.dynamicResolution > 0.0f) {
+            deletionQueue.push(DeletionQueue::Kind::ImageView, sceneImageView, lastFrame);
         }
+        frameGraph.releaseTransients(lastFrame);
 
         for (auto imageView : swapChainImageViews) {
-            vkDestroyImageView(device, imageView, nullptr);
+            deletionQueue.push(DeletionQueue::Kind::ImageView, imageView, lastFrame);
+        }
+
+        for (size_t i = 0; i < offscreenImagesMemory.size(); i++) {
+            deletionQueue.push(DeletionQueue::Kind::Image, swapChainImages[i], lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::Memory, offscreenImagesMemory[i], lastFrame);
         }
+        offscreenImagesMemory.clear();
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        deletionQueue.push(DeletionQueue::Kind::Swapchain, swapChain, lastFrame + MAX_FRAMES_IN_FLIGHT);
     }
 
     void cleanup() {
-        cleanupSwapChain();
+        // mainLoop waited for the device to go idle, so everything can go at once.
+        uint64_t lastFrame = submittedFrameCount;
+        retireSwapChain();
+
+        deletionQueue.push(DeletionQueue::Kind::Pipeline, graphicsPipeline, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::PipelineLayout, pipelineLayout, lastFrame);
+        deletionQueue.push(DeletionQueue::Kind::RenderPass, renderPass, lastFrame);
+
+        if (options.occlusionCulling) {
+            deletionQueue.push(DeletionQueue::Kind::Pipeline, cullEarlyPipeline, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::Pipeline, cullLatePipeline, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::Pipeline, hizDepthPipeline, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::Pipeline, hizReducePipeline, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::PipelineLayout, hizPipelineLayout, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::DescriptorSetLayout, hizDescriptorSetLayout, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::Sampler, hizSampler, lastFrame);
+
+            deletionQueue.push(DeletionQueue::Kind::RenderPass, earlyRenderPass, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::RenderPass, lateRenderPass, lastFrame);
+
+            releaseBuffer(visibilityBuffer, visibilityBufferMemory, lastFrame);
+        }
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        vkDestroyRenderPass(device, renderPass, nullptr);
+        if (options.gpuDriven) {
+            deletionQueue.push(DeletionQueue::Kind::Pipeline, cullPipeline, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::PipelineLayout, cullPipelineLayout, lastFrame);
+            deletionQueue.push(DeletionQueue::Kind::DescriptorSetLayout, cullDescriptorSetLayout, lastFrame);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                releaseBuffer(drawCommandBuffers[i], drawCommandBuffersMemory[i], lastFrame);
+                releaseBuffer(drawCountBuffers[i], drawCountBuffersMemory[i], lastFrame);
+            }
+
+            releaseBuffer(objectRecordBuffer, objectRecordBufferMemory, lastFrame);
+        }
+
+        for (size_t i = 0; i < readbackBuffers.size(); i++) {
+            releaseBuffer(readbackBuffers[i], readbackBuffersMemory[i], lastFrame);
         }
 
-        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            releaseBuffer(uniformBuffers[i], uniformBuffersMemory[i], lastFrame);
+            releaseBuffer(objectBuffers[i], objectBuffersMemory[i], lastFrame);
+            releaseBuffer(instanceBuffers[i], instanceBuffersMemory[i], lastFrame);
+        }
 
-        vkDestroySampler(device, textureSampler, nullptr);
-        vkDestroyImageView(device, textureImageView, nullptr);
+        deletionQueue.push(DeletionQueue::Kind::DescriptorPool, descriptorPool, lastFrame);
 
-        vkDestroyImage(device, textureImage, nullptr);
-        vkFreeMemory(device, textureImageMemory, nullptr);
+        deletionQueue.push(DeletionQueue::Kind::Sampler, textureSampler, lastFrame);
+        releaseImage(textureImage, textureImageMemory, textureImageView, lastFrame);
 
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        deletionQueue.push(DeletionQueue::Kind::DescriptorSetLayout, descriptorSetLayout, lastFrame);
 
-        vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexBufferMemory, nullptr);
+        releaseBuffer(indexBuffer, indexBufferMemory, lastFrame);
+        releaseBuffer(vertexBuffer, vertexBufferMemory, lastFrame);
 
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        deletionQueue.flush();
+        deletionQueue.report(std::cout);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
+            dispatch.destroySemaphore(device, renderFinishedSemaphores[i], allocator);
+            dispatch.destroySemaphore(device, imageAvailableSemaphores[i], allocator);
+            dispatch.destroyFence(device, inFlightFences[i], allocator);
+        }
+
+        dispatch.destroyCommandPool(device, commandPool, allocator);
+        for (auto pool : frameCommandPools) {
+            dispatch.destroyCommandPool(device, pool, allocator);
         }
 
-        vkDestroyCommandPool(device, commandPool, nullptr);
+        gpuProfiler.destroy();
+        pipelineStatistics.destroy();
 
-        vkDestroyDevice(device, nullptr);
+        dispatch.destroyDevice(device, allocator);
 
         if (enableValidationLayers) {
-            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+            instanceDispatch.destroyDebugUtilsMessengerEXT(instance, debugMessenger, allocator);
         }
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-        vkDestroyInstance(instance, nullptr);
+        vkDestroySurfaceKHR(instance, surface, allocator);
+        vkDestroyInstance(instance, allocator);
+
+        // After the instance, so anything the driver still holds shows up as live.
+        hostAllocator.report(std::cout);
 
-        glfwDestroyWindow(window);
+        if (!options.headless) {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
+
+        workerPool.destroy();
     }
 
     void recreateSwapChain() {
@@ -341,15 +952,37 @@ private:
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device);
+        auto start = std::chrono::steady_clock::now();
 
-        cleanupSwapChain();
+        // The old swap chain is passed to its replacement and everything built on it is retired
+        // rather than destroyed, so frames still in flight keep running. --blocking-resize keeps
+        // the wait-idle-and-destroy behavior for comparison.
+        VkSwapchainKHR oldSwapChain = swapChain;
+        retireSwapChain();
+
+        if (options.blockingResize) {
+            dispatch.deviceWaitIdle(device);
+            completedFrameCount = submittedFrameCount;
+            // Idle covers presentation too, so the swap chain goes now despite its later frame.
+            deletionQueue.flush();
+            oldSwapChain = VK_NULL_HANDLE;
+        }
 
-        createSwapChain();
+        createSwapChain(oldSwapChain);
         createImageViews();
-        createColorResources();
-        createDepthResources();
+        createFrameGraph();
+        if (options.occlusionCulling) {
+            createHiZResources();
+
+            // Cull descriptor sets may be in use by frames in flight; each is rewritten before
+            // its frame is recorded again.
+            cullHiZDescriptorsStale.assign(MAX_FRAMES_IN_FLIGHT, true);
+        }
         createFramebuffers();
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "swap chain recreated (" << swapChainExtent.width << "x" << swapChainExtent.height << ") in " << milliseconds << " ms"
+            << (options.blockingResize ? ", blocking" : "") << std::endl;
     }
 
     void createInstance() {
@@ -363,7 +996,8 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // 1.1 for device UUIDs, which let HELLO_TRIANGLE_DEVICE pick one of several identical GPUs.
+        appInfo.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -387,9 +1021,11 @@ private:
             createInfo.pNext = nullptr;
         }
 
-        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+        if (vkCreateInstance(&createInfo, allocator, &instance) != VK_SUCCESS) {
             throw std::runtime_error("failed to create instance!");
         }
+
+        instanceDispatch.load(instance);
     }
 
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
@@ -406,13 +1042,14 @@ private:
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
 
-        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+        if (instanceDispatch.createDebugUtilsMessengerEXT == nullptr ||
+            instanceDispatch.createDebugUtilsMessengerEXT(instance, &createInfo, allocator, &debugMessenger) != VK_SUCCESS) {
             throw std::runtime_error("failed to set up debug messenger!");
         }
     }
 
     void createSurface() {
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+        if (glfwCreateWindowSurface(instance, window, allocator, &surface) != VK_SUCCESS) {
             throw std::runtime_error("failed to create window surface!");
         }
     }
@@ -428,24 +1065,34 @@ private:
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+        std::vector<DeviceProfile> profiles;
         for (const auto& device : devices) {
-            if (isDeviceSuitable(device)) {
-                physicalDevice = device;
-                msaaSamples = getMaxUsableSampleCount();
-                break;
-            }
+            DeviceProfile profile = DeviceProfile::query(device);
+            profile.suitable = isDeviceSuitable(device);
+            profiles.push_back(profile);
         }
 
-        if (physicalDevice == VK_NULL_HANDLE) {
-            throw std::runtime_error("failed to find a suitable GPU!");
+        // HELLO_TRIANGLE_DEVICE overrides the scores with a device UUID or part of a device name.
+        const char* selector = std::getenv("HELLO_TRIANGLE_DEVICE");
+        size_t chosen = chooseDevice(profiles, selector != nullptr ? selector : "");
+
+        for (size_t i = 0; i < profiles.size(); i++) {
+            std::cout << "GPU " << i << ": " << profiles[i].name << " (" << DeviceProfile::typeName(profiles[i].type) << "), score " << profiles[i].score()
+                << (profiles[i].suitable ? "" : ", unsuitable") << (i == chosen ? ", selected" : "") << std::endl;
         }
+
+        deviceProfile = profiles[chosen];
+        deviceProfile.write(std::cout);
+
+        physicalDevice = deviceProfile.device;
+        msaaSamples = std::min(getMaxUsableSampleCount(), deviceProfile.suggestedSamples());
     }
 
     void createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value_or(indices.graphicsFamily.value()) };
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -457,9 +1104,51 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+        std::vector<const char*> enabledExtensions;
+        if (!options.headless) {
+            enabledExtensions = deviceExtensions;
+        }
+
+        if (options.gpuDriven && !supportedFeatures.drawIndirectFirstInstance) {
+            std::cerr << "drawIndirectFirstInstance is not supported, falling back to CPU-driven rendering" << std::endl;
+            options.gpuDriven = false;
+            options.occlusionCulling = false;
+        }
+
+        if (options.pipelineStats && !supportedFeatures.pipelineStatisticsQuery) {
+            std::cerr << "pipelineStatisticsQuery is not supported, pipeline statistics disabled" << std::endl;
+            options.pipelineStats = false;
+        }
+        deviceFeatures.pipelineStatisticsQuery = options.pipelineStats ? VK_TRUE : VK_FALSE;
+
+        if (options.gpuDriven) {
+            deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+            deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+            multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+            for (const char* extension : optionalDeviceExtensions) {
+                if (isDeviceExtensionSupported(physicalDevice, extension)) {
+                    enabledExtensions.push_back(extension);
+                }
+            }
+        }
+
+        // Lines GPU scopes up with CPU ones in the trace; without it the offset is estimated.
+        if (!options.gpuTrace.empty() && isDeviceExtensionSupported(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+            enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            calibratedTimestampsEnabled = true;
+        }
+
+        bool drawIndirectCountEnabled = std::find_if(enabledExtensions.begin(), enabledExtensions.end(), [](const char* name) {
+            return strcmp(name, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+        }) != enabledExtensions.end();
+
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -468,8 +1157,8 @@ private:
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -479,15 +1168,25 @@ private:
             createInfo.enabledLayerCount = 0;
         }
 
-        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+        if (vkCreateDevice(physicalDevice, &createInfo, allocator, &device) != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
         }
 
-        vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        DeviceDispatch::Extensions dispatchExtensions;
+        dispatchExtensions.swapchain = !options.headless;
+        dispatchExtensions.drawIndirectCount = drawIndirectCountEnabled;
+        dispatchExtensions.debugUtils = enableValidationLayers;
+        dispatchExtensions.calibratedTimestamps = calibratedTimestampsEnabled;
+        dispatch.load(device, !options.loaderDispatch, dispatchExtensions);
+        if (sessionRecorder.isOpen() || (replayTrace && !replayTrace->setupCalls().stream.empty())) {
+            callCapture.install(dispatch);
+        }
+
+        dispatch.getDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+        dispatch.getDeviceQueue(device, indices.presentFamily.value_or(indices.graphicsFamily.value()), 0, &presentQueue);
     }
 
-    void createSwapChain() {
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -510,6 +1209,14 @@ private:
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+        // Dynamic resolution blits the scene into the swap chain image.
+        if (options.dynamicResolution > 0.0f) {
+            if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+                throw std::runtime_error("failed to create a swap chain that can be blitted to!");
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
+
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -526,19 +1233,35 @@ private:
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
+        createInfo.oldSwapchain = oldSwapChain;
 
-        if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+        if (dispatch.createSwapchainKHR(device, &createInfo, allocator, &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Swapchain);
 
-        vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
+        dispatch.getSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
         swapChainImages.resize(imageCount);
-        vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
+        dispatch.getSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
 
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
     }
 
+    // Stands in for the swap chain when running headless. The images use the swap chain's usual
+    // size and an sRGB format so the render pass and pipelines are built the same way.
+    void createOffscreenTargets() {
+        swapChainImageFormat = findSupportedFormat({ VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+        swapChainExtent = { WIDTH, HEIGHT };
+
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImagesMemory.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImagesMemory[i], DeviceMemoryTracker::Category::Attachment, "offscreen image " + std::to_string(i));
+        }
+    }
+
     void createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
 
@@ -548,35 +1271,49 @@ private:
     }
 
     void createRenderPass() {
+        renderPass = createScenePass(true, true);
+
+        // Occlusion culling splits the frame into an early and a late pass over the same
+        // attachments, so both stay compatible with renderPass, its framebuffers and pipeline.
+        if (options.occlusionCulling) {
+            earlyRenderPass = createScenePass(true, false);
+            lateRenderPass = createScenePass(false, true);
+        }
+    }
+
+    VkRenderPass createScenePass(bool firstPass, bool lastPass) {
         VkAttachmentDescription colorAttachment{};
         colorAttachment.format = swapChainImageFormat;
         colorAttachment.samples = msaaSamples;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = firstPass ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = msaaSamples;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = firstPass ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.storeOp = lastPass ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+        // Only the last pass's resolve is kept; earlier passes resolve into the swap chain image
+        // too but that result is discarded. Layout transitions before and after, and the waits
+        // that go with them, are left to the frame graph.
         VkAttachmentDescription colorAttachmentResolve{};
         colorAttachmentResolve.format = swapChainImageFormat;
         colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
         colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachmentResolve.storeOp = lastPass ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -597,14 +1334,6 @@ private:
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
         subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-        VkSubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
         std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -612,12 +1341,14 @@ private:
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        VkRenderPass scenePass;
+        if (dispatch.createRenderPass(device, &renderPassInfo, allocator, &scenePass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        deletionQueue.track(DeletionQueue::Kind::RenderPass);
+
+        return scenePass;
     }
 
     void createDescriptorSetLayout() {
@@ -635,20 +1366,28 @@ private:
         samplerLayoutBinding.pImmutableSamplers = nullptr;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 2;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        objectLayoutBinding.pImmutableSamplers = nullptr;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding };
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
         layoutInfo.pBindings = bindings.data();
 
-        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        if (dispatch.createDescriptorSetLayout(device, &layoutInfo, allocator, &descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
+        deletionQueue.track(DeletionQueue::Kind::DescriptorSetLayout);
     }
 
     void createGraphicsPipeline() {
-        auto vertShaderCode = readFile("shaders/vert.spv");
-        auto fragShaderCode = readFile("shaders/frag.spv");
+        auto vertShaderCode = readShader("shaders/vert.spv");
+        auto fragShaderCode = readShader("shaders/frag.spv");
 
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
         VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -670,12 +1409,17 @@ private:
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = { Vertex::getBindingDescription(), InstanceData::getBindingDescription() };
+
+        auto vertexAttributes = Vertex::getAttributeDescriptions();
+        auto instanceAttributes = InstanceData::getAttributeDescriptions();
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+        attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -740,9 +1484,10 @@ private:
         pipelineLayoutInfo.setLayoutCount = 1;
         pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        if (dispatch.createPipelineLayout(device, &pipelineLayoutInfo, allocator, &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
+        deletionQueue.track(DeletionQueue::Kind::PipelineLayout);
 
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -761,123 +1506,643 @@ private:
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+        if (dispatch.createGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &graphicsPipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Pipeline);
 
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        dispatch.destroyShaderModule(device, fragShaderModule, allocator);
+        dispatch.destroyShaderModule(device, vertShaderModule, allocator);
     }
 
-    void createFramebuffers() {
-        swapChainFramebuffers.resize(swapChainImageViews.size());
-
-        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            std::array<VkImageView, 3> attachments = {
-                colorImageView,
-                depthImageView,
-                swapChainImageViews[i]
-            };
+    void createCullPipeline() {
+        // Bindings 4-6 (visibility, depth pyramid, camera) are only used by the occlusion variant.
+        std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].pImmutableSamplers = nullptr;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
-            VkFramebufferCreateInfo framebufferInfo{};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-            framebufferInfo.pAttachments = attachments.data();
-            framebufferInfo.width = swapChainExtent.width;
-            framebufferInfo.height = swapChainExtent.height;
-            framebufferInfo.layers = 1;
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
 
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
-            }
+        if (dispatch.createDescriptorSetLayout(device, &layoutInfo, allocator, &cullDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull descriptor set layout!");
         }
-    }
+        deletionQueue.track(DeletionQueue::Kind::DescriptorSetLayout);
 
-    void createCommandPool() {
-        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstants);
 
-        VkCommandPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics command pool!");
+        if (dispatch.createPipelineLayout(device, &pipelineLayoutInfo, allocator, &cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull pipeline layout!");
         }
-    }
+        deletionQueue.track(DeletionQueue::Kind::PipelineLayout);
 
-    void createColorResources() {
-        VkFormat colorFormat = swapChainImageFormat;
+        cullPipeline = createComputePipeline("shaders/cull.spv", cullPipelineLayout, nullptr);
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
-        colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-    }
+        if (options.occlusionCulling) {
+            VkBool32 latePhase = VK_FALSE;
 
-    void createDepthResources() {
-        VkFormat depthFormat = findDepthFormat();
+            VkSpecializationMapEntry phaseEntry{};
+            phaseEntry.constantID = 0;
+            phaseEntry.offset = 0;
+            phaseEntry.size = sizeof(VkBool32);
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-        depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-    }
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = 1;
+            specializationInfo.pMapEntries = &phaseEntry;
+            specializationInfo.dataSize = sizeof(VkBool32);
+            specializationInfo.pData = &latePhase;
 
-    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-        for (VkFormat format : candidates) {
-            VkFormatProperties props;
-            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+            cullEarlyPipeline = createComputePipeline("shaders/cull_occlusion.spv", cullPipelineLayout, &specializationInfo);
 
-            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-                return format;
-            }
-            else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-                return format;
-            }
+            latePhase = VK_TRUE;
+            cullLatePipeline = createComputePipeline("shaders/cull_occlusion.spv", cullPipelineLayout, &specializationInfo);
         }
-
-        throw std::runtime_error("failed to find supported format!");
     }
 
-    VkFormat findDepthFormat() {
-        return findSupportedFormat(
-            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-        );
-    }
+    VkPipeline createComputePipeline(const std::string& shaderPath, VkPipelineLayout layout, const VkSpecializationInfo* specializationInfo) {
+        auto compShaderCode = readShader(shaderPath);
+        VkShaderModule compShaderModule = createShaderModule(compShaderCode);
+
+        VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+        compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        compShaderStageInfo.module = compShaderModule;
+        compShaderStageInfo.pName = "main";
+        compShaderStageInfo.pSpecializationInfo = specializationInfo;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = compShaderStageInfo;
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline;
+        if (dispatch.createComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        deletionQueue.track(DeletionQueue::Kind::Pipeline);
 
-    bool hasStencilComponent(VkFormat format) {
-        return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+        dispatch.destroyShaderModule(device, compShaderModule, allocator);
+
+        return pipeline;
     }
 
-    void createTextureImage() {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    // Occlusion culling needs a sampleable depth attachment, so the MSAA sample count is limited
+    // to what the device can sample from depth images.
+    void checkOcclusionCullingSupport() {
+        if (!options.gpuDriven) {
+            options.occlusionCulling = false;
+        }
+        if (!options.occlusionCulling) {
+            return;
+        }
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, findDepthFormat(), &formatProperties);
+
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            std::cerr << "depth format can't be sampled, occlusion culling disabled" << std::endl;
+            options.occlusionCulling = false;
+            return;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        while (msaaSamples > VK_SAMPLE_COUNT_1_BIT && !(properties.limits.sampledImageDepthSampleCounts & msaaSamples)) {
+            msaaSamples = static_cast<VkSampleCountFlagBits>(msaaSamples >> 1);
+        }
+    }
+
+    void createHiZPipelines() {
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+        bindings[0].binding = 0;
+        bindings[0].descriptorCount = 1;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        bindings[1].binding = 1;
+        bindings[1].descriptorCount = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (dispatch.createDescriptorSetLayout(device, &layoutInfo, allocator, &hizDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+        }
+        deletionQueue.track(DeletionQueue::Kind::DescriptorSetLayout);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(HiZPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &hizDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (dispatch.createPipelineLayout(device, &pipelineLayoutInfo, allocator, &hizPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+        }
+        deletionQueue.track(DeletionQueue::Kind::PipelineLayout);
+
+        if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+            hizDepthPipeline = createComputePipeline("shaders/hiz_depth.spv", hizPipelineLayout, nullptr);
+        }
+        else {
+            int32_t sampleCount = static_cast<int32_t>(msaaSamples);
+
+            VkSpecializationMapEntry sampleCountEntry{};
+            sampleCountEntry.constantID = 0;
+            sampleCountEntry.offset = 0;
+            sampleCountEntry.size = sizeof(int32_t);
+
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = 1;
+            specializationInfo.pMapEntries = &sampleCountEntry;
+            specializationInfo.dataSize = sizeof(int32_t);
+            specializationInfo.pData = &sampleCount;
+
+            hizDepthPipeline = createComputePipeline("shaders/hiz_depth_ms.spv", hizPipelineLayout, &specializationInfo);
+        }
+
+        hizReducePipeline = createComputePipeline("shaders/hiz_reduce.spv", hizPipelineLayout, nullptr);
+
+        // Pyramid reads use texelFetch, the sampler only has to be valid.
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (dispatch.createSampler(device, &samplerInfo, allocator, &hizSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+        }
+        deletionQueue.track(DeletionQueue::Kind::Sampler);
+    }
+
+    void createFramebuffers() {
+        swapChainFramebuffers.resize(swapChainImageViews.size());
+
+        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+            std::array<VkImageView, 3> attachments = {
+                colorImageView,
+                depthImageView,
+                options.dynamicResolution > 0.0f ? sceneImageView : swapChainImageViews[i]
+            };
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = swapChainExtent.width;
+            framebufferInfo.height = swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (dispatch.createFramebuffer(device, &framebufferInfo, allocator, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+            deletionQueue.track(DeletionQueue::Kind::Framebuffer);
+        }
+    }
+
+    void createCommandPool() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (dispatch.createCommandPool(device, &poolInfo, allocator, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics command pool!");
+        }
+
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        frameCommandPools.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (dispatch.createCommandPool(device, &poolInfo, allocator, &frameCommandPools[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create frame command pool!");
+            }
+        }
+    }
+
+    // Declares the frame as passes and what each of them reads and writes. The graph creates the
+    // color, depth and depth pyramid images and records every barrier between the passes; the
+    // record functions below only record their own work.
+    void createFrameGraph() {
+        using Access = RenderGraph::Access;
+        using PassType = RenderGraph::PassType;
+
+        // Every pass is a GPU profiler and pipeline statistics scope of the same name, barriers
+        // excluded.
+        auto addPass = [this](const std::string& name, PassType type, const std::vector<RenderGraph::ResourceAccess>& accesses, std::function<void(VkCommandBuffer)> record) {
+            frameGraph.addPass(name, type, accesses, [this, name, record](VkCommandBuffer commandBuffer) {
+                GpuProfiler::Scope scope(gpuProfiler, commandBuffer, name);
+                PipelineStatistics::Scope statistics(pipelineStatistics, commandBuffer, name);
+                record(commandBuffer);
+            });
+        };
+
+        frameGraph.reset();
+
+        VkFormat depthFormat = findDepthFormat();
+
+        RenderGraph::ImageDesc colorDesc;
+        colorDesc.format = swapChainImageFormat;
+        colorDesc.extent = swapChainExtent;
+        colorDesc.samples = msaaSamples;
+        colorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+        // The two occlusion-culling passes carry the color attachment across, so it can't be transient.
+        if (!options.occlusionCulling) {
+            colorDesc.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        colorTarget = frameGraph.createImage("color", colorDesc);
+
+        RenderGraph::ImageDesc depthDesc;
+        depthDesc.format = depthFormat;
+        depthDesc.extent = swapChainExtent;
+        depthDesc.samples = msaaSamples;
+        depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (options.occlusionCulling) {
+            depthDesc.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+        if (hasStencilComponent(depthFormat)) {
+            depthDesc.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        depthTarget = frameGraph.createImage("depth", depthDesc);
+
+        swapChainTarget = frameGraph.importImage("swap chain", VK_IMAGE_ASPECT_COLOR_BIT, true);
+        if (!options.headless) {
+            frameGraph.setFinalAccess(swapChainTarget, Access::Present);
+        }
+
+        RenderGraph::ResourceId resolveTarget = swapChainTarget;
+        if (options.dynamicResolution > 0.0f) {
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &formatProperties);
+
+            VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+            if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+                throw std::runtime_error("swap chain image format does not support blitting!");
+            }
+            upscaleFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+            RenderGraph::ImageDesc sceneDesc;
+            sceneDesc.format = swapChainImageFormat;
+            sceneDesc.extent = swapChainExtent;
+            sceneDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            sceneTarget = frameGraph.createImage("scene", sceneDesc);
+            resolveTarget = sceneTarget;
+        }
+
+        std::vector<RenderGraph::ResourceAccess> sceneAccesses = {
+            { colorTarget, Access::ColorAttachment },
+            { depthTarget, Access::DepthAttachment },
+            { resolveTarget, Access::ColorAttachment }
+        };
+
+        if (options.gpuDriven) {
+            drawCommandTarget = frameGraph.importBuffer("draw commands");
+            drawCountTarget = frameGraph.importBuffer("draw counts");
+
+            // The visible count is read on the host once the frame's fence has signaled.
+            frameGraph.setFinalAccess(drawCountTarget, Access::HostRead);
+
+            sceneAccesses.push_back({ drawCommandTarget, Access::IndirectRead });
+            sceneAccesses.push_back({ drawCountTarget, Access::IndirectRead });
+
+            addPass("reset counts", PassType::Transfer, { { drawCountTarget, Access::TransferWrite } }, [this](VkCommandBuffer commandBuffer) {
+                dispatch.cmdFillBuffer(commandBuffer, drawCountBuffers[currentFrame], 0, sizeof(DrawCounts), 0);
+            });
+        }
+
+        if (options.occlusionCulling) {
+            RenderGraph::ImageDesc hizDesc;
+            hizDesc.format = VK_FORMAT_R32_SFLOAT;
+            hizDesc.extent = swapChainExtent;
+            hizDesc.mipLevels = hizMipLevelCount();
+            hizDesc.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+            hizTarget = frameGraph.createImage("depth pyramid", hizDesc);
+
+            visibilityTarget = frameGraph.importBuffer("visibility");
+
+            // Draw what was visible last frame, build the depth pyramid from it, then test
+            // everything else against the pyramid and draw what turned out to be visible.
+            addPass("early cull", PassType::Compute, {
+                { drawCountTarget, Access::ShaderReadWrite },
+                { drawCommandTarget, Access::ShaderWrite },
+                { visibilityTarget, Access::ShaderRead }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordCullDispatch(commandBuffer, cullEarlyPipeline);
+            });
+
+            addPass("early scene", PassType::Graphics, sceneAccesses, [this](VkCommandBuffer commandBuffer) {
+                recordScenePass(commandBuffer, earlyRenderPass, recordingImageIndex, [&]() {
+                    bindSceneState(commandBuffer);
+                    recordIndirectDraws(commandBuffer, 0);
+                });
+            });
+
+            addPass("depth pyramid", PassType::Compute, {
+                { depthTarget, Access::ShaderSampled },
+                { hizTarget, Access::ShaderReadWrite }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordHiZBuild(commandBuffer);
+            });
+
+            addPass("late cull", PassType::Compute, {
+                { hizTarget, Access::ShaderRead },
+                { drawCountTarget, Access::ShaderReadWrite },
+                { drawCommandTarget, Access::ShaderWrite },
+                { visibilityTarget, Access::ShaderReadWrite }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordCullDispatch(commandBuffer, cullLatePipeline);
+            });
+
+            addPass("late scene", PassType::Graphics, sceneAccesses, [this](VkCommandBuffer commandBuffer) {
+                recordScenePass(commandBuffer, lateRenderPass, recordingImageIndex, [&]() {
+                    bindSceneState(commandBuffer);
+                    recordIndirectDraws(commandBuffer, 1);
+                });
+            });
+        }
+        else if (options.gpuDriven) {
+            addPass("cull", PassType::Compute, {
+                { drawCountTarget, Access::ShaderReadWrite },
+                { drawCommandTarget, Access::ShaderWrite }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordCullDispatch(commandBuffer, cullPipeline);
+            });
+
+            addPass("scene", PassType::Graphics, sceneAccesses, [this](VkCommandBuffer commandBuffer) {
+                recordScenePass(commandBuffer, renderPass, recordingImageIndex, [&]() {
+                    bindSceneState(commandBuffer);
+                    recordIndirectDraws(commandBuffer, 0);
+                });
+            });
+        }
+        else {
+            addPass("scene", PassType::Graphics, sceneAccesses, [this](VkCommandBuffer commandBuffer) {
+                recordScenePass(commandBuffer, renderPass, recordingImageIndex, [&]() {
+                    DrawRecorder recorder{ *this, commandBuffer };
+                    stateChanges = drawList.record(recorder);
+                    drawCallCount = stateChanges.draws;
+
+                    if (stateChanges.pipelineBinds != recorder.issued.pipelineBinds ||
+                        stateChanges.descriptorSetBinds != recorder.issued.descriptorSetBinds ||
+                        stateChanges.vertexBufferBinds != recorder.issued.vertexBufferBinds) {
+                        throw std::runtime_error("draw list bind counts don't match the binds recorded!");
+                    }
+                });
+            });
+        }
+
+        if (options.dynamicResolution > 0.0f) {
+            addPass("upscale", PassType::Transfer, {
+                { sceneTarget, Access::TransferRead },
+                { swapChainTarget, Access::TransferWrite }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordUpscale(commandBuffer, recordingImageIndex);
+            });
+        }
+
+        if (!options.outputTarget.empty()) {
+            readbackTarget = frameGraph.importBuffer("readback");
+            frameGraph.setFinalAccess(readbackTarget, Access::HostRead);
+
+            addPass("readback", PassType::Transfer, {
+                { swapChainTarget, Access::TransferRead },
+                { readbackTarget, Access::TransferWrite }
+            }, [this](VkCommandBuffer commandBuffer) {
+                recordReadback(commandBuffer, recordingImageIndex, frameReadbackSlots[currentFrame].value());
+            });
+        }
+
+        frameGraph.compile();
+
+        colorImage = frameGraph.image(colorTarget);
+        colorImageView = createImageView(colorImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+        depthImage = frameGraph.image(depthTarget);
+        depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+        if (options.dynamicResolution > 0.0f) {
+            sceneImage = frameGraph.image(sceneTarget);
+            sceneImageView = createImageView(sceneImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        }
+
+        if (options.occlusionCulling) {
+            hizImage = frameGraph.image(hizTarget);
+        }
+    }
+
+    uint32_t hizMipLevelCount() {
+        return static_cast<uint32_t>(std::floor(std::log2(std::max(swapChainExtent.width, swapChainExtent.height)))) + 1;
+    }
+
+    // Hierarchical depth: mip 0 holds the farthest depth of each pixel's samples at full
+    // resolution, every further mip the farthest of the 2x2 texels below it. The image itself
+    // belongs to the frame graph; this creates its views and the per-mip descriptor sets.
+    void createHiZResources() {
+        uint32_t mipLevels = hizMipLevelCount();
+
+        hizImageView = createImageView(hizImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+
+        hizMipViews.resize(mipLevels);
+        hizMipExtents.resize(mipLevels);
+        for (uint32_t i = 0; i < mipLevels; i++) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = hizImage;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R32_SFLOAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = i;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (dispatch.createImageView(device, &viewInfo, allocator, &hizMipViews[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid image view!");
+            }
+            deletionQueue.track(DeletionQueue::Kind::ImageView);
+
+            hizMipExtents[i].width = std::max(1u, swapChainExtent.width >> i);
+            hizMipExtents[i].height = std::max(1u, swapChainExtent.height >> i);
+        }
+
+        // The pyramid stays in the general layout; it is written and read by compute only.
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = mipLevels;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[1].descriptorCount = mipLevels;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = mipLevels;
+
+        if (dispatch.createDescriptorPool(device, &poolInfo, allocator, &hizDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+        }
+        deletionQueue.track(DeletionQueue::Kind::DescriptorPool);
+
+        std::vector<VkDescriptorSetLayout> layouts(mipLevels, hizDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = hizDescriptorPool;
+        allocInfo.descriptorSetCount = mipLevels;
+        allocInfo.pSetLayouts = layouts.data();
+
+        hizDescriptorSets.resize(mipLevels);
+        if (dispatch.allocateDescriptorSets(device, &allocInfo, hizDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+        }
+
+        // Mip 0 reads the depth attachment, every other mip the one above it.
+        for (uint32_t i = 0; i < mipLevels; i++) {
+            VkDescriptorImageInfo sourceInfo{};
+            sourceInfo.sampler = hizSampler;
+            sourceInfo.imageView = i == 0 ? depthImageView : hizMipViews[i - 1];
+            sourceInfo.imageLayout = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorImageInfo destinationInfo{};
+            destinationInfo.imageView = hizMipViews[i];
+            destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = hizDescriptorSets[i];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].dstArrayElement = 0;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].pImageInfo = &sourceInfo;
+
+            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[1].dstSet = hizDescriptorSets[i];
+            descriptorWrites[1].dstBinding = 1;
+            descriptorWrites[1].dstArrayElement = 0;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptorWrites[1].descriptorCount = 1;
+            descriptorWrites[1].pImageInfo = &destinationInfo;
+
+            dispatch.updateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+        for (VkFormat format : candidates) {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
 
-        if (!pixels) {
+            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+                return format;
+            }
+            else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+                return format;
+            }
+        }
+
+        throw std::runtime_error("failed to find supported format!");
+    }
+
+    VkFormat findDepthFormat() {
+        return findSupportedFormat(
+            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        );
+    }
+
+    bool hasStencilComponent(VkFormat format) {
+        return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+    }
+
+    void decodeTexture() {
+        // Allocated like a decoded image, so createTextureImage frees it the same way.
+        if (options.stressScene) {
+            textureWidth = textureHeight = static_cast<int>(stressScene.atlasSize());
+            texturePixels = static_cast<stbi_uc*>(STBI_MALLOC(static_cast<size_t>(textureWidth) * textureHeight * 4));
+            if (!texturePixels) {
+                throw std::runtime_error("failed to allocate the stress scene's texture atlas!");
+            }
+            stressScene.generateAtlas(texturePixels);
+            return;
+        }
+
+        int texChannels;
+        std::vector<char> textureFile = readAsset(TEXTURE_PATH);
+        texturePixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(textureFile.data()), static_cast<int>(textureFile.size()), &textureWidth, &textureHeight, &texChannels, STBI_rgb_alpha);
+
+        if (!texturePixels) {
             throw std::runtime_error("failed to load texture image!");
         }
+    }
+
+    void createTextureImage() {
+        int texWidth = textureWidth;
+        int texHeight = textureHeight;
+        stbi_uc* pixels = texturePixels;
+        VkDeviceSize imageSize = texWidth * texHeight * 4;
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, DeviceMemoryTracker::Category::Staging, "texture staging");
 
         void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+        dispatch.mapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
         memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+        dispatch.unmapMemory(device, stagingBufferMemory);
 
         stbi_image_free(pixels);
+        texturePixels = nullptr;
 
-        createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+        createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, DeviceMemoryTracker::Category::Texture, "texture");
 
         transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
         copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
         //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        releaseBuffer(stagingBuffer, stagingBufferMemory, submittedFrameCount);
 
         generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
     }
@@ -891,7 +2156,7 @@ private:
             throw std::runtime_error("texture image format does not support linear blitting!");
         }
 
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands("generate mipmaps");
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -913,7 +2178,7 @@ private:
             barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-            vkCmdPipelineBarrier(commandBuffer,
+            dispatch.cmdPipelineBarrier(commandBuffer,
                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
                 0, nullptr,
                 0, nullptr,
@@ -933,7 +2198,7 @@ private:
             blit.dstSubresource.baseArrayLayer = 0;
             blit.dstSubresource.layerCount = 1;
 
-            vkCmdBlitImage(commandBuffer,
+            dispatch.cmdBlitImage(commandBuffer,
                 image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
                 image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 1, &blit,
@@ -944,7 +2209,7 @@ private:
             barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
             barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-            vkCmdPipelineBarrier(commandBuffer,
+            dispatch.cmdPipelineBarrier(commandBuffer,
                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
                 0, nullptr,
                 0, nullptr,
@@ -960,7 +2225,7 @@ private:
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-        vkCmdPipelineBarrier(commandBuffer,
+        dispatch.cmdPipelineBarrier(commandBuffer,
             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
             0, nullptr,
             0, nullptr,
@@ -1010,9 +2275,10 @@ private:
         samplerInfo.maxLod = static_cast<float>(mipLevels);
         samplerInfo.mipLodBias = 0.0f;
 
-        if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+        if (dispatch.createSampler(device, &samplerInfo, allocator, &textureSampler) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture sampler!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Sampler);
     }
 
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
@@ -1028,14 +2294,15 @@ private:
         viewInfo.subresourceRange.layerCount = 1;
 
         VkImageView imageView;
-        if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        if (dispatch.createImageView(device, &viewInfo, allocator, &imageView) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture image view!");
         }
+        deletionQueue.track(DeletionQueue::Kind::ImageView);
 
         return imageView;
     }
 
-    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, DeviceMemoryTracker::Category category, const std::string& name) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1051,27 +2318,31 @@ private:
         imageInfo.samples = numSamples;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        if (dispatch.createImage(device, &imageInfo, allocator, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Image);
 
         VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        dispatch.getImageMemoryRequirements(device, image, &memRequirements);
 
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+        if (dispatch.allocateMemory(device, &allocInfo, allocator, &imageMemory) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate image memory!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Memory);
+        memoryTracker.allocated(imageMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category, name);
+        memoryTracker.nameObject(VK_OBJECT_TYPE_IMAGE, (uint64_t)image, name);
 
-        vkBindImageMemory(device, image, imageMemory, 0);
+        dispatch.bindImageMemory(device, image, imageMemory, 0);
     }
 
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands("layout transition");
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1107,7 +2378,7 @@ private:
             throw std::invalid_argument("unsupported layout transition!");
         }
 
-        vkCmdPipelineBarrier(
+        dispatch.cmdPipelineBarrier(
             commandBuffer,
             sourceStage, destinationStage,
             0,
@@ -1120,7 +2391,7 @@ private:
     }
 
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands("copy buffer to image");
 
         VkBufferImageCopy region{};
         region.bufferOffset = 0;
@@ -1137,48 +2408,370 @@ private:
             1
         };
 
-        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        dispatch.cmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
         endSingleTimeCommands(commandBuffer);
     }
 
     void loadModel() {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
+        if (options.stressScene) {
+            generateStressMeshes();
+            return;
+        }
+
+        // OBJ indices count from the first vertex of the whole buffer, which this is.
+        uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+        loadObj(readAsset(MODEL_PATH), vertices, indices);
+        const Mesh& mesh = addMesh(0, firstIndex);
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, MODEL_PATH.c_str())) {
-            throw std::runtime_error(warn + err);
+        for (uint32_t i = 0; i < mesh.lodCount; i++) {
+            std::cout << "LOD " << i << ": " << mesh.lods[i].indexCount / 3 << " triangles, error " << mesh.lods[i].error << std::endl;
         }
+    }
 
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    void generateStressMeshes() {
+        uint64_t triangles = 0;
+        uint64_t lodCount = 0;
+        for (uint32_t i = 0; i < stressScene.settings().meshCount; i++) {
+            int32_t vertexOffset = static_cast<int32_t>(vertices.size());
+            uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+            stressScene.generateMesh(i, vertices, indices);
+
+            const Mesh& mesh = addMesh(vertexOffset, firstIndex);
+            triangles += mesh.lods[0].indexCount / 3;
+            lodCount += mesh.lodCount;
+        }
 
-        for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                Vertex vertex{};
+        std::cout << "stress scene: " << meshes.size() << " meshes of " << triangles / meshes.size() << " triangles on average, "
+            << static_cast<double>(lodCount) / meshes.size() << " LODs each, " << vertices.size() << " vertices" << std::endl;
+    }
 
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
+    // Makes a mesh, and its LODs, of the vertices from vertexOffset on and the indices from
+    // firstIndex on, which are relative to vertexOffset.
+    const Mesh& addMesh(int32_t vertexOffset, uint32_t firstIndex) {
+        Mesh mesh{};
+        mesh.lods[0].firstIndex = firstIndex;
+        mesh.lods[0].indexCount = static_cast<uint32_t>(indices.size()) - firstIndex;
+        mesh.lods[0].error = 0.0f;
+        mesh.lodCount = 1;
+        mesh.vertexOffset = vertexOffset;
+        mesh.bounds = Aabb::empty();
+
+        for (size_t i = static_cast<size_t>(vertexOffset); i < vertices.size(); i++) {
+            mesh.bounds.expand(vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z);
+        }
 
-                vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                };
+        generateLods(mesh);
+        meshes.push_back(mesh);
+        return meshes.back();
+    }
 
-                vertex.color = { 1.0f, 1.0f, 1.0f };
+    // Appends simplified index ranges at 1/2, 1/4 and 1/8 of the triangles; every level is
+    // simplified from the full-resolution mesh so its error is relative to the original surface.
+    void generateLods(Mesh& mesh) {
+        const float ratios[MAX_LODS - 1] = { 0.5f, 0.25f, 0.125f };
+        const MeshLod base = mesh.lods[0];
 
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
+        std::vector<uint32_t> lodIndices;
+        for (float ratio : ratios) {
+            size_t targetIndexCount = static_cast<size_t>(base.indexCount * ratio) / 3 * 3;
+            float error = simplifyMesh(lodIndices, &indices[base.firstIndex], base.indexCount, &vertices[mesh.vertexOffset].pos.x, vertices.size() - mesh.vertexOffset, sizeof(Vertex), targetIndexCount, std::numeric_limits<float>::max());
 
-                indices.push_back(uniqueVertices[vertex]);
+            // Stop once simplification stalls, e.g. when the remaining vertices are all locked.
+            const MeshLod& previous = mesh.lods[mesh.lodCount - 1];
+            if (lodIndices.size() * 10 > previous.indexCount * 9) {
+                break;
             }
+
+            MeshLod& lod = mesh.lods[mesh.lodCount++];
+            lod.firstIndex = static_cast<uint32_t>(indices.size());
+            lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+            lod.error = error;
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+    }
+
+    void createScene() {
+        if (options.stressScene) {
+            createStressScene();
+            return;
+        }
+
+        roomNode = addSceneObject(0);
+
+        // Extra copies are laid out on a square grid around the room and rotate with it.
+        uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(options.copies))));
+        float spacing = 2.5f;
+        float gridOffset = 0.5f * spacing * (gridSize - 1);
+
+        for (uint32_t i = 1; i < options.copies; i++) {
+            uint32_t node = addSceneObject(0, roomNode, tintForCopy(i));
+            sceneTransforms.setPosition(node, spacing * (i % gridSize) - gridOffset, spacing * (i / gridSize) - gridOffset, 0.0f);
+        }
+
+        if (options.copies > 1) {
+            sceneRadius = gridOffset + spacing;
+        }
+    }
+
+    void createStressScene() {
+        roomNode = sceneTransforms.addNode();
+
+        uint32_t objectCount = stressScene.settings().objectCount;
+        sceneObjects.reserve(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            StressScene::Placement placement = stressScene.place(i);
+            uint32_t node = addSceneObject(placement.mesh, roomNode, placement.tint);
+            sceneTransforms.setPosition(node, placement.position[0], placement.position[1], placement.position[2]);
+            sceneTransforms.setScale(node, placement.scale, placement.scale, placement.scale);
+
+            glm::quat rotation = glm::angleAxis(placement.angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            sceneTransforms.setRotation(node, rotation.x, rotation.y, rotation.z, rotation.w);
+            if (placement.spin != 0.0f) {
+                spinningObjects.push_back({ node, placement.angle, placement.spin });
+            }
+        }
+
+        sceneRadius = stressScene.radius();
+        std::cout << "stress scene: " << objectCount << " objects, " << spinningObjects.size() << " spinning" << std::endl;
+    }
+
+    static uint32_t tintForCopy(uint32_t copy) {
+        uint32_t hash = copy * 2654435761u;
+        uint32_t r = 128 + (hash & 0x7f);
+        uint32_t g = 128 + ((hash >> 8) & 0x7f);
+        uint32_t b = 128 + ((hash >> 16) & 0x7f);
+        return r | (g << 8) | (b << 16) | (0xffu << 24);
+    }
+
+    uint32_t addSceneObject(uint32_t mesh, uint32_t parentNode = SceneTransforms::NO_PARENT, uint32_t tint = 0xffffffff) {
+        SceneObject object{};
+        object.node = sceneTransforms.addNode(parentNode);
+        object.mesh = mesh;
+        object.material = 0;
+        object.tint = tint;
+        object.bvhProxy = sceneBvh.insert(meshes[mesh].bounds, static_cast<uint32_t>(sceneObjects.size()));
+
+        sceneObjects.push_back(object);
+        return object.node;
+    }
+
+    void cullScene(const glm::mat4& viewProj) {
+        frameFrustum = Frustum(&viewProj[0][0]);
+
+        if (options.gpuDriven) {
+            // The compute pass culls on the GPU; stats come from the last completed frame.
+            return;
         }
+
+        for (const auto& object : sceneObjects) {
+            Aabb worldBounds = transformAabb(meshes[object.mesh].bounds, sceneTransforms.worldMatrix(object.node));
+            sceneBvh.move(object.bvhProxy, worldBounds);
+        }
+
+        visibleObjects.clear();
+        sceneBvh.cullFrustum(frameFrustum, visibleObjects, cullStats);
+    }
+
+    // Distance from the camera to the nearest point of the object's bounding sphere.
+    float cameraDistance(const SceneObject& object) {
+        Aabb bounds = transformAabb(meshes[object.mesh].bounds, sceneTransforms.worldMatrix(object.node));
+
+        glm::vec3 minimum(bounds.min[0], bounds.min[1], bounds.min[2]);
+        glm::vec3 maximum(bounds.max[0], bounds.max[1], bounds.max[2]);
+        return std::max(glm::length(0.5f * (minimum + maximum) - cameraPosition) - 0.5f * glm::length(maximum - minimum), 0.0f);
+    }
+
+    // Picks the coarsest LOD whose error projects to at most options.lodThreshold pixels.
+    uint32_t selectLod(const SceneObject& object, float distance) {
+        const Mesh& mesh = meshes[object.mesh];
+        if (!options.lod) {
+            return 0;
+        }
+
+        const float* world = sceneTransforms.worldMatrix(object.node);
+
+        float worldScale = std::max(glm::length(glm::vec3(world[0], world[1], world[2])), std::max(glm::length(glm::vec3(world[4], world[5], world[6])), glm::length(glm::vec3(world[8], world[9], world[10]))));
+
+        uint32_t lod = 0;
+        while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * worldScale * lodScale <= distance) {
+            lod++;
+        }
+        return lod;
+    }
+
+    uint32_t drawKey(const SceneObject& object, uint32_t lod) const {
+        return (object.mesh * MAX_LODS + lod) * materialCount + object.material;
+    }
+
+    const MeshLod& drawKeyLod(uint32_t key) const {
+        return meshes[key / (MAX_LODS * materialCount)].lods[(key / materialCount) % MAX_LODS];
+    }
+
+    // Front-to-back bucket of a camera distance, relative to the far plane.
+    uint32_t depthBucket(float distance) const {
+        float farPlane = 10.0f * sceneRadius;
+        return static_cast<uint32_t>(std::min(distance / farPlane, 1.0f) * 65535.0f);
+    }
+
+    // Orders the frame's draws by pipeline, material, mesh and then front to back, so recording
+    // only rebinds state that actually changes.
+    void buildDrawList() {
+        drawList.clear();
+        for (uint32_t i = 0; i < drawBatches.size(); i++) {
+            uint32_t key = drawBatches[i].key;
+            uint32_t mesh = key / (MAX_LODS * materialCount);
+            uint32_t material = key % materialCount;
+            drawList.add(DrawList::makeKey(0, 0, material, mesh, drawBatchDepths[i]), i);
+        }
+        drawList.sort(&workerPool);
+    }
+
+    // Writes the visible objects' instance data and the draws that consume it. With instancing,
+    // objects sharing a mesh LOD and material are grouped into one draw.
+    void writeInstances(uint32_t currentImage) {
+        InstanceData* instances = static_cast<InstanceData*>(instanceBuffersMapped[currentImage]);
+
+        drawBatches.clear();
+        drawBatchDepths.clear();
+        triangleCount = 0;
+
+        if (!options.instancing) {
+            for (uint32_t i = 0; i < visibleObjects.size(); i++) {
+                const SceneObject& object = sceneObjects[visibleObjects[i]];
+                float distance = cameraDistance(object);
+                uint32_t key = drawKey(object, selectLod(object, distance));
+
+                instances[i] = { sceneTransforms.worldIndex(object.node), object.tint };
+                drawBatches.push_back({ key, i, 1 });
+                drawBatchDepths.push_back(depthBucket(distance));
+                triangleCount += drawKeyLod(key).indexCount / 3;
+            }
+            buildDrawList();
+            return;
+        }
+
+        objectDepths.resize(sceneObjects.size());
+        instanceBatcher.reset(static_cast<uint32_t>(meshes.size()) * MAX_LODS * materialCount);
+        for (uint32_t objectIndex : visibleObjects) {
+            const SceneObject& object = sceneObjects[objectIndex];
+            float distance = cameraDistance(object);
+            objectDepths[objectIndex] = depthBucket(distance);
+            instanceBatcher.add(drawKey(object, selectLod(object, distance)), objectIndex);
+        }
+        instanceBatcher.build();
+
+        const std::vector<uint32_t>& order = instanceBatcher.order();
+        for (size_t i = 0; i < order.size(); i++) {
+            const SceneObject& object = sceneObjects[order[i]];
+            instances[i] = { sceneTransforms.worldIndex(object.node), object.tint };
+        }
+
+        // A batch sorts by its nearest instance.
+        drawBatches = instanceBatcher.batches();
+        for (const auto& batch : drawBatches) {
+            triangleCount += static_cast<uint64_t>(drawKeyLod(batch.key).indexCount / 3) * batch.instanceCount;
+
+            uint32_t nearest = UINT32_MAX;
+            for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; i++) {
+                nearest = std::min(nearest, objectDepths[order[i]]);
+            }
+            drawBatchDepths.push_back(nearest);
+        }
+        buildDrawList();
+    }
+
+    void reportFrameStats() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastStatsReport < std::chrono::seconds(1)) {
+            return;
+        }
+        lastStatsReport = now;
+
+        std::string title = "Vulkan - visible " + std::to_string(cullStats.visible) + ", culled " + std::to_string(cullStats.culled) + ", tested " + std::to_string(cullStats.tested) + ", triangles " + std::to_string(triangleCount);
+        if (options.occlusionCulling) {
+            title += ", occluded " + std::to_string(occludedCount);
+        }
+        if (options.headless) {
+            std::cout << title << std::endl;
+        }
+        else {
+            glfwSetWindowTitle(window, title.c_str());
+        }
+    }
+
+    const char* renderModeName() const {
+        return options.occlusionCulling ? "gpu-driven + occlusion" : options.gpuDriven ? "gpu-driven" : options.instancing ? "instanced" : "draw per object";
+    }
+
+    void createBenchmark() {
+        Benchmark::Settings settings;
+        settings.warmupFrames = options.warmupFrames;
+        settings.measuredFrames = options.benchmarkFrames;
+        settings.timestep = options.fixedTimestep;
+        benchmark.init(settings);
+
+        // Without a path the camera circles the scene once over the run, starting from the usual view.
+        if (cameraPath.empty()) {
+            float seconds = static_cast<float>((settings.warmupFrames + settings.measuredFrames) * settings.timestep);
+            cameraPath = CameraPath::orbit(2.0f * std::sqrt(2.0f), 2.0f, seconds);
+        }
+    }
+
+    void writeBenchmarkSummary() {
+        benchmark.setInfo("mode", renderModeName());
+        benchmark.setInfo("copies", options.copies);
+        benchmark.setInfo("scene", options.stressScene ? "stress" : MODEL_PATH);
+        if (options.stressScene) {
+            const StressScene::Settings& stress = stressScene.settings();
+            benchmark.setInfo("stress_meshes", stress.meshCount);
+            benchmark.setInfo("stress_triangles_per_mesh", stress.trianglesPerMesh);
+            benchmark.setInfo("stress_textures", stress.textureCount);
+            benchmark.setInfo("stress_texture_size", stress.textureSize);
+            benchmark.setInfo("stress_motion", stress.motion);
+        }
+        benchmark.setInfo("objects", static_cast<double>(sceneObjects.size()));
+        benchmark.setInfo("lod", options.lod ? "on" : "off");
+        benchmark.setInfo("triangles", triangleCount);
+        benchmark.setInfo("draw_calls", drawCallCount);
+        benchmark.setInfo("width", swapChainExtent.width);
+        benchmark.setInfo("height", swapChainExtent.height);
+        benchmark.setInfo("msaa", static_cast<uint32_t>(msaaSamples));
+        benchmark.setInfo("headless", options.headless ? "yes" : "no");
+        benchmark.setInfo("camera_path", options.cameraPath.empty() ? "orbit" : options.cameraPath);
+        benchmark.setInfo("device", deviceProfile.name);
+        benchmark.setInfo("dispatch", dispatch.direct ? "device" : "loader");
+        benchmark.setInfo("replay", options.replayPath.empty() ? "none" : options.replayPath);
+        for (const PipelineStatistics::Pass& pass : pipelineStatistics.passes()) {
+            if (pass.counters[PipelineStatistics::InputAssemblyPrimitives] == 0) {
+                continue;
+            }
+            benchmark.setInfo(pass.name + ".vs_per_triangle", PipelineStatistics::invocationsPerTriangle(pass));
+            benchmark.setInfo(pass.name + ".vertex_reuse", PipelineStatistics::vertexReuse(pass));
+            benchmark.setInfo(pass.name + ".overdraw", PipelineStatistics::overdraw(pass));
+        }
+        benchmark.setDevicePeakBytes(memoryTracker.total().peakBytes);
+        benchmark.writeSummary(options.benchmarkOutput);
+
+        std::cout << "benchmark summary written to " << options.benchmarkOutput << std::endl;
+    }
+
+    void printBenchmarkSummary() {
+        // The first frame is excluded, it pays for pipeline and driver warm-up.
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - firstTimedFrame).count();
+        double frameMs = totalFrames > 1 ? 1000.0 * seconds / (totalFrames - 1) : 0.0;
+
+        std::cout << "copies " << sceneObjects.size()
+            << ", " << renderModeName() << (dispatch.direct ? "" : " (loader dispatch)")
+            << ", " << totalFrames << " frames"
+            << ", " << frameMs << " ms/frame"
+            << ", " << drawCallCount << " draw calls"
+            << ", " << stateChanges.pipelineBinds << "/" << stateChanges.descriptorSetBinds << "/" << stateChanges.vertexBufferBinds << " pipeline/descriptor/vertex binds"
+            << ", " << triangleCount << " triangles" << (options.lod ? "" : " (LOD off)");
+        if (options.occlusionCulling) {
+            std::cout << ", " << occludedCount << " occluded";
+        }
+        std::cout << std::endl;
     }
 
     void createVertexBuffer() {
@@ -1186,19 +2779,18 @@ private:
 
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, DeviceMemoryTracker::Category::Staging, "vertex staging");
 
         void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        dispatch.mapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
         memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        dispatch.unmapMemory(device, stagingBufferMemory);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, DeviceMemoryTracker::Category::Vertex, "vertex buffer");
 
         copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        releaseBuffer(stagingBuffer, stagingBufferMemory, submittedFrameCount);
     }
 
     void createIndexBuffer() {
@@ -1206,19 +2798,18 @@ private:
 
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, DeviceMemoryTracker::Category::Staging, "index staging");
 
         void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        dispatch.mapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
         memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        dispatch.unmapMemory(device, stagingBufferMemory);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, DeviceMemoryTracker::Category::Index, "index buffer");
 
         copyBuffer(stagingBuffer, indexBuffer, bufferSize);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        releaseBuffer(stagingBuffer, stagingBufferMemory, submittedFrameCount);
     }
 
     void createUniformBuffers() {
@@ -1229,28 +2820,141 @@ private:
         uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], DeviceMemoryTracker::Category::Uniform, "uniform buffer " + std::to_string(i));
 
-            vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+            dispatch.mapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+        }
+    }
+
+    void createObjectBuffers() {
+        VkDeviceSize bufferSize = sizeof(glm::mat4) * sceneTransforms.size();
+
+        objectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        objectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        objectBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffers[i], objectBuffersMemory[i], DeviceMemoryTracker::Category::Storage, "object buffer " + std::to_string(i));
+
+            dispatch.mapMemory(device, objectBuffersMemory[i], 0, bufferSize, 0, &objectBuffersMapped[i]);
+        }
+    }
+
+    void createInstanceBuffers() {
+        VkDeviceSize bufferSize = sizeof(InstanceData) * sceneTransforms.size();
+
+        // The GPU-driven path draws with firstInstance = world index, so it gets a static table
+        // mapping each world index to itself and its object's tint.
+        std::vector<InstanceData> worldInstances(sceneTransforms.size());
+        for (uint32_t i = 0; i < worldInstances.size(); i++) {
+            worldInstances[i] = { i, 0xffffffff };
+        }
+        for (const auto& object : sceneObjects) {
+            worldInstances[sceneTransforms.worldIndex(object.node)].tint = object.tint;
+        }
+
+        instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBuffersMemory[i], DeviceMemoryTracker::Category::Vertex, "instance buffer " + std::to_string(i));
+
+            dispatch.mapMemory(device, instanceBuffersMemory[i], 0, bufferSize, 0, &instanceBuffersMapped[i]);
+            if (options.gpuDriven) {
+                memcpy(instanceBuffersMapped[i], worldInstances.data(), (size_t)bufferSize);
+            }
+        }
+    }
+
+    void createCullBuffers() {
+        std::vector<GpuObjectRecord> records(sceneObjects.size());
+        for (size_t i = 0; i < sceneObjects.size(); i++) {
+            const Mesh& mesh = meshes[sceneObjects[i].mesh];
+            const Aabb& bounds = mesh.bounds;
+
+            records[i].boundsCenter = glm::vec4(0.5f * (bounds.min[0] + bounds.max[0]), 0.5f * (bounds.min[1] + bounds.max[1]), 0.5f * (bounds.min[2] + bounds.max[2]), 0.0f);
+            records[i].boundsExtent = glm::vec4(0.5f * (bounds.max[0] - bounds.min[0]), 0.5f * (bounds.max[1] - bounds.min[1]), 0.5f * (bounds.max[2] - bounds.min[2]), 0.0f);
+            records[i].vertexOffset = mesh.vertexOffset;
+            records[i].worldIndex = sceneTransforms.worldIndex(sceneObjects[i].node);
+            records[i].lodCount = options.lod ? mesh.lodCount : 1;
+
+            for (uint32_t lod = 0; lod < MAX_LODS; lod++) {
+                const MeshLod& meshLod = mesh.lods[std::min(lod, mesh.lodCount - 1)];
+                records[i].lodFirstIndex[lod] = meshLod.firstIndex;
+                records[i].lodIndexCount[lod] = meshLod.indexCount;
+                records[i].lodError[lod] = meshLod.error;
+            }
+        }
+
+        VkDeviceSize recordsSize = sizeof(GpuObjectRecord) * records.size();
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(recordsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, DeviceMemoryTracker::Category::Staging, "object record staging");
+
+        void* data;
+        dispatch.mapMemory(device, stagingBufferMemory, 0, recordsSize, 0, &data);
+        memcpy(data, records.data(), (size_t)recordsSize);
+        dispatch.unmapMemory(device, stagingBufferMemory);
+
+        createBuffer(recordsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectRecordBuffer, objectRecordBufferMemory, DeviceMemoryTracker::Category::Storage, "object records");
+
+        copyBuffer(stagingBuffer, objectRecordBuffer, recordsSize);
+
+        releaseBuffer(stagingBuffer, stagingBufferMemory, submittedFrameCount);
+
+        // With occlusion culling the late phase writes its draws after the early phase's.
+        VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * records.size() * (options.occlusionCulling ? 2 : 1);
+
+        drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCountBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        drawCountBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(drawsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i], DeviceMemoryTracker::Category::Indirect, "draw commands " + std::to_string(i));
+
+            // Host visible so the visible count can be read back once the frame's fence has signaled.
+            createBuffer(sizeof(DrawCounts), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawCountBuffers[i], drawCountBuffersMemory[i], DeviceMemoryTracker::Category::Indirect, "draw counts " + std::to_string(i));
+
+            dispatch.mapMemory(device, drawCountBuffersMemory[i], 0, sizeof(DrawCounts), 0, &drawCountBuffersMapped[i]);
+            memset(drawCountBuffersMapped[i], 0, sizeof(DrawCounts));
+        }
+
+        if (options.occlusionCulling) {
+            // One flag per object: visible at the end of the previous frame. Shared by all frames in
+            // flight, since each frame's cull depends on the one before it.
+            VkDeviceSize visibilitySize = sizeof(uint32_t) * records.size();
+            createBuffer(visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibilityBuffer, visibilityBufferMemory, DeviceMemoryTracker::Category::Storage, "visibility");
+
+            VkCommandBuffer commandBuffer = beginSingleTimeCommands("clear visibility");
+            dispatch.cmdFillBuffer(commandBuffer, visibilityBuffer, 0, visibilitySize, 0);
+            endSingleTimeCommands(commandBuffer);
         }
     }
 
     void createDescriptorPool() {
-        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        std::array<VkDescriptorPoolSize, 3> poolSizes{};
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 6);
 
+        // One graphics set per frame, plus one cull set per frame for the GPU-driven path.
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        if (dispatch.createDescriptorPool(device, &poolInfo, allocator, &descriptorPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor pool!");
         }
+        deletionQueue.track(DeletionQueue::Kind::DescriptorPool);
     }
 
     void createDescriptorSets() {
@@ -1262,7 +2966,7 @@ private:
         allocInfo.pSetLayouts = layouts.data();
 
         descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        if (dispatch.allocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate descriptor sets!");
         }
 
@@ -1277,7 +2981,12 @@ private:
             imageInfo.imageView = textureImageView;
             imageInfo.sampler = textureSampler;
 
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            VkDescriptorBufferInfo objectBufferInfo{};
+            objectBufferInfo.buffer = objectBuffers[i];
+            objectBufferInfo.offset = 0;
+            objectBufferInfo.range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 
             descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptorWrites[0].dstSet = descriptorSets[i];
@@ -1295,37 +3004,147 @@ private:
             descriptorWrites[1].descriptorCount = 1;
             descriptorWrites[1].pImageInfo = &imageInfo;
 
-            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+            descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[2].dstSet = descriptorSets[i];
+            descriptorWrites[2].dstBinding = 2;
+            descriptorWrites[2].dstArrayElement = 0;
+            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[2].descriptorCount = 1;
+            descriptorWrites[2].pBufferInfo = &objectBufferInfo;
+
+            dispatch.updateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    void createCullDescriptorSets() {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, cullDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
+
+        cullDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (dispatch.allocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cull descriptor sets!");
+        }
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+            bufferInfos[0].buffer = objectRecordBuffer;
+            bufferInfos[1].buffer = objectBuffers[i];
+            bufferInfos[2].buffer = drawCommandBuffers[i];
+            bufferInfos[3].buffer = drawCountBuffers[i];
+
+            std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+                bufferInfos[binding].offset = 0;
+                bufferInfos[binding].range = VK_WHOLE_SIZE;
+
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = cullDescriptorSets[i];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
+
+            dispatch.updateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+            if (options.occlusionCulling) {
+                VkDescriptorBufferInfo visibilityInfo{};
+                visibilityInfo.buffer = visibilityBuffer;
+                visibilityInfo.offset = 0;
+                visibilityInfo.range = VK_WHOLE_SIZE;
+
+                VkDescriptorBufferInfo cameraInfo{};
+                cameraInfo.buffer = uniformBuffers[i];
+                cameraInfo.offset = 0;
+                cameraInfo.range = sizeof(UniformBufferObject);
+
+                std::array<VkWriteDescriptorSet, 2> occlusionWrites{};
+                occlusionWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                occlusionWrites[0].dstSet = cullDescriptorSets[i];
+                occlusionWrites[0].dstBinding = 4;
+                occlusionWrites[0].dstArrayElement = 0;
+                occlusionWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                occlusionWrites[0].descriptorCount = 1;
+                occlusionWrites[0].pBufferInfo = &visibilityInfo;
+
+                occlusionWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                occlusionWrites[1].dstSet = cullDescriptorSets[i];
+                occlusionWrites[1].dstBinding = 6;
+                occlusionWrites[1].dstArrayElement = 0;
+                occlusionWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                occlusionWrites[1].descriptorCount = 1;
+                occlusionWrites[1].pBufferInfo = &cameraInfo;
+
+                dispatch.updateDescriptorSets(device, static_cast<uint32_t>(occlusionWrites.size()), occlusionWrites.data(), 0, nullptr);
+            }
+        }
+
+        if (options.occlusionCulling) {
+            cullHiZDescriptorsStale.assign(MAX_FRAMES_IN_FLIGHT, false);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                writeCullHiZDescriptors(i);
+            }
         }
     }
 
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+    // The depth pyramid is recreated with the swap chain, so its binding is written separately.
+    void writeCullHiZDescriptors(size_t frame) {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = hizSampler;
+        imageInfo.imageView = hizImageView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = cullDescriptorSets[frame];
+        descriptorWrite.dstBinding = 5;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        dispatch.updateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+        cullHiZDescriptorsStale[frame] = false;
+    }
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, DeviceMemoryTracker::Category category, const std::string& name) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        if (dispatch.createBuffer(device, &bufferInfo, allocator, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create buffer!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Buffer);
 
         VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+        dispatch.getBufferMemoryRequirements(device, buffer, &memRequirements);
 
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        if (dispatch.allocateMemory(device, &allocInfo, allocator, &bufferMemory) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate buffer memory!");
         }
+        deletionQueue.track(DeletionQueue::Kind::Memory);
+        memoryTracker.allocated(bufferMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category, name);
+        memoryTracker.nameObject(VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer, name);
 
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        dispatch.bindBufferMemory(device, buffer, bufferMemory, 0);
     }
 
-    VkCommandBuffer beginSingleTimeCommands() {
+    // Each one-shot command buffer is timed as a scope called name.
+    VkCommandBuffer beginSingleTimeCommands(const std::string& name) {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -1333,37 +3152,42 @@ private:
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        dispatch.allocateCommandBuffers(device, &allocInfo, &commandBuffer);
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        dispatch.beginCommandBuffer(commandBuffer, &beginInfo);
+        gpuProfiler.beginFrame(commandBuffer, ONE_SHOT_PROFILER_SLOT, submittedFrameCount, name);
 
         return commandBuffer;
     }
 
     void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-        vkEndCommandBuffer(commandBuffer);
+        gpuProfiler.endFrame(commandBuffer);
+        dispatch.endCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
+        dispatch.queueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        dispatch.queueWaitIdle(graphicsQueue);
+
+        GpuProfiler::FrameTiming timing;
+        gpuProfiler.collect(ONE_SHOT_PROFILER_SLOT, timing);
 
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        dispatch.freeCommandBuffers(device, commandPool, 1, &commandBuffer);
     }
 
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands("copy buffer");
 
         VkBufferCopy copyRegion{};
         copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        dispatch.cmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
         endSingleTimeCommands(commandBuffer);
     }
@@ -1381,17 +3205,67 @@ private:
         throw std::runtime_error("failed to find suitable memory type!");
     }
 
+    // Host-visible buffers the finished frame is copied into for FrameWriter. Cached memory makes
+    // the writer thread's reads much faster where the device offers it.
+    void createReadbackBuffers() {
+        VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+
+        VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if (!hasMemoryType(properties)) {
+            properties &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        }
+
+        readbackBuffers.resize(READBACK_SLOTS);
+        readbackBuffersMemory.resize(READBACK_SLOTS);
+        readbackBuffersMapped.resize(READBACK_SLOTS);
+
+        for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+            createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, readbackBuffers[i], readbackBuffersMemory[i], DeviceMemoryTracker::Category::Readback, "readback " + std::to_string(i));
+            dispatch.mapMemory(device, readbackBuffersMemory[i], 0, size, 0, &readbackBuffersMapped[i]);
+        }
+
+        frameReadbackSlots.assign(MAX_FRAMES_IN_FLIGHT, std::nullopt);
+
+        FrameWriter::Format format = options.outputPipe ? FrameWriter::Format::Pipe : FrameWriter::formatForPath(options.outputTarget);
+        bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB;
+        frameWriter.start(options.outputTarget, format, swapChainExtent.width, swapChainExtent.height, bgra, READBACK_SLOTS);
+    }
+
+    bool hasMemoryType(VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Passes a completed frame's readback buffer to the writer thread. The frame's fence must
+    // have signaled.
+    void submitReadback(uint32_t frame) {
+        if (!frameReadbackSlots.empty() && frameReadbackSlots[frame].has_value()) {
+            uint32_t slot = frameReadbackSlots[frame].value();
+            frameWriter.submit(slot, readbackBuffersMapped[slot], frameNumbers[frame] - 1);
+            frameReadbackSlots[frame].reset();
+        }
+    }
+
     void createCommandBuffers() {
         commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = frameCommandPools[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (dispatch.allocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
         }
     }
 
@@ -1399,16 +3273,53 @@ private:
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        if (dispatch.beginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        drawCallCount = 0;
+        stateChanges = {};
+
+        renderExtent = swapChainExtent;
+        if (options.dynamicResolution > 0.0f) {
+            resolutionController.scaledExtent(swapChainExtent.width, swapChainExtent.height, renderExtent.width, renderExtent.height);
+        }
+
+        gpuProfiler.beginFrame(commandBuffer, currentFrame, submittedFrameCount, "frame");
+        pipelineStatistics.beginFrame(commandBuffer, currentFrame, static_cast<uint64_t>(renderExtent.width) * renderExtent.height);
+
+        // Bind this frame's images and buffers to the graph's passes.
+        recordingImageIndex = imageIndex;
+        frameGraph.setImage(swapChainTarget, swapChainImages[imageIndex]);
+        if (options.gpuDriven) {
+            frameGraph.setBuffer(drawCommandTarget, drawCommandBuffers[currentFrame]);
+            frameGraph.setBuffer(drawCountTarget, drawCountBuffers[currentFrame]);
+        }
+        if (options.occlusionCulling) {
+            frameGraph.setBuffer(visibilityTarget, visibilityBuffer);
+        }
+        if (!options.outputTarget.empty()) {
+            frameGraph.setBuffer(readbackTarget, readbackBuffers[frameReadbackSlots[currentFrame].value()]);
+        }
+
+        frameGraph.execute(commandBuffer);
+
+        pipelineStatistics.endFrame();
+        gpuProfiler.endFrame(commandBuffer);
+
+        if (dispatch.endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    template <typename DrawFunc>
+    void recordScenePass(VkCommandBuffer commandBuffer, VkRenderPass pass, uint32_t imageIndex, DrawFunc recordDraws) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.renderPass = pass;
         renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
         renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.renderArea.extent = renderExtent;
 
         std::array<VkClearValue, 2> clearValues{};
         clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
@@ -1417,38 +3328,193 @@ private:
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        dispatch.cmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
+        // Viewport and scissor are dynamic state and can be set before recordDraws binds the pipeline.
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
-        viewport.width = (float)swapChainExtent.width;
-        viewport.height = (float)swapChainExtent.height;
+        viewport.width = (float)renderExtent.width;
+        viewport.height = (float)renderExtent.height;
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        dispatch.cmdSetViewport(commandBuffer, 0, 1, &viewport);
 
         VkRect2D scissor{};
         scissor.offset = { 0, 0 };
-        scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        scissor.extent = renderExtent;
+        dispatch.cmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        recordDraws();
+
+        dispatch.cmdEndRenderPass(commandBuffer);
+    }
 
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    // Issues the binds and draws a sorted DrawList asks for. Every mesh shares the same vertex
+    // and index buffers, and there is a single pipeline and one descriptor set per frame.
+    struct DrawRecorder {
+        HelloTriangleApplication& app;
+        VkCommandBuffer commandBuffer;
+        DrawStateChanges issued{}; // binds actually recorded into commandBuffer
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        void bindPipeline(uint32_t pipeline) {
+            app.dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsPipeline);
+            issued.pipelineBinds++;
+        }
 
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+        void bindMaterial(uint32_t material) {
+            app.dispatch.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.pipelineLayout, 0, 1, &app.descriptorSets[app.currentFrame], 0, nullptr);
+            issued.descriptorSetBinds++;
+        }
 
-        vkCmdEndRenderPass(commandBuffer);
+        void bindMesh(uint32_t mesh) {
+            VkBuffer vertexBuffers[] = { app.vertexBuffer, app.instanceBuffers[app.currentFrame] };
+            VkDeviceSize offsets[] = { 0, 0 };
+            app.dispatch.cmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+            app.dispatch.cmdBindIndexBuffer(commandBuffer, app.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            issued.vertexBufferBinds++;
+        }
+
+        // firstInstance selects the draw's first entry in the instance buffer.
+        void draw(const DrawList::Entry& entry) {
+            const InstanceBatcher::Batch& batch = app.drawBatches[entry.item];
+            const Mesh& mesh = app.meshes[batch.key / (MAX_LODS * app.materialCount)];
+            const MeshLod& lod = app.drawKeyLod(batch.key);
+            app.dispatch.cmdDrawIndexed(commandBuffer, lod.indexCount, batch.instanceCount, lod.firstIndex, mesh.vertexOffset, batch.firstInstance);
+        }
+    };
+
+    // The GPU-driven path draws everything with one set of state.
+    void bindSceneState(VkCommandBuffer commandBuffer) {
+        DrawRecorder recorder{ *this, commandBuffer };
+        recorder.bindPipeline(0);
+        recorder.bindMaterial(0);
+        recorder.bindMesh(0);
+
+        stateChanges.pipelineBinds += recorder.issued.pipelineBinds;
+        stateChanges.descriptorSetBinds += recorder.issued.descriptorSetBinds;
+        stateChanges.vertexBufferBinds += recorder.issued.vertexBufferBinds;
+    }
+
+    void recordCullDispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline) {
+        CullPushConstants pushConstants{};
+        frameFrustum.copyPlanes(&pushConstants.planes[0][0]);
+        pushConstants.cameraLod = glm::vec4(cameraPosition, lodScale);
+        pushConstants.objectCount = static_cast<uint32_t>(sceneObjects.size());
+        pushConstants.compact = dispatch.cmdDrawIndexedIndirectCount != nullptr ? 1 : 0;
+
+        dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        dispatch.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+        dispatch.cmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        dispatch.cmdDispatch(commandBuffer, (pushConstants.objectCount + 63) / 64, 1, 1);
+    }
+
+    // Phase 0 draws the early (or only) cull's commands, phase 1 the late cull's, which follow
+    // them in the draw buffer and are counted by DrawCounts::lateDrawCount.
+    void recordIndirectDraws(VkCommandBuffer commandBuffer, uint32_t phase) {
+        uint32_t objectCount = static_cast<uint32_t>(sceneObjects.size());
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        VkDeviceSize drawOffset = static_cast<VkDeviceSize>(phase) * objectCount * stride;
+        VkDeviceSize countOffset = phase == 0 ? offsetof(DrawCounts, drawCount) : offsetof(DrawCounts, lateDrawCount);
+
+        if (dispatch.cmdDrawIndexedIndirectCount != nullptr) {
+            dispatch.cmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffers[currentFrame], drawOffset, drawCountBuffers[currentFrame], countOffset, objectCount, stride);
+            drawCallCount += 1;
+        }
+        else if (multiDrawIndirectSupported) {
+            dispatch.cmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], drawOffset, objectCount, stride);
+            drawCallCount += 1;
+        }
+        else {
+            for (uint32_t i = 0; i < objectCount; i++) {
+                dispatch.cmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], drawOffset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+            }
+            drawCallCount += objectCount;
+        }
+    }
+
+    // The depth attachment has been made readable and the pyramid writable; each mip is made
+    // visible to the dispatch that reduces it.
+    void recordHiZBuild(VkCommandBuffer commandBuffer) {
+        for (uint32_t i = 0; i < hizMipViews.size(); i++) {
+            HiZPushConstants pushConstants{};
+            VkExtent2D sourceExtent = i == 0 ? swapChainExtent : hizMipExtents[i - 1];
+            pushConstants.sourceSize = glm::ivec2(sourceExtent.width, sourceExtent.height);
+            pushConstants.destinationSize = glm::ivec2(hizMipExtents[i].width, hizMipExtents[i].height);
+
+            dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, i == 0 ? hizDepthPipeline : hizReducePipeline);
+            dispatch.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout, 0, 1, &hizDescriptorSets[i], 0, nullptr);
+            dispatch.cmdPushConstants(commandBuffer, hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+            dispatch.cmdDispatch(commandBuffer, (hizMipExtents[i].width + 7) / 8, (hizMipExtents[i].height + 7) / 8, 1);
+
+            VkImageMemoryBarrier mipBarrier{};
+            mipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            mipBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            mipBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            mipBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            mipBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            mipBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            mipBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            mipBarrier.image = hizImage;
+            mipBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            mipBarrier.subresourceRange.baseMipLevel = i;
+            mipBarrier.subresourceRange.levelCount = 1;
+            mipBarrier.subresourceRange.baseArrayLayer = 0;
+            mipBarrier.subresourceRange.layerCount = 1;
+
+            dispatch.cmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                0, nullptr,
+                0, nullptr,
+                1, &mipBarrier);
+        }
+    }
+
+    // Copies the finished image into a readback buffer; the frame graph transitions the image
+    // before and makes the copy visible to the host after.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t slot) {
+        VkBufferImageCopy region{};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+        dispatch.cmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffers[slot], 1, &region);
+    }
+
+    // Stretches the rendered part of the scene image over the whole swap chain image.
+    void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+
+        dispatch.cmdBlitImage(commandBuffer,
+            sceneImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, upscaleFilter);
+    }
+
+    void createProfiler() {
+        if (deviceProfile.timestampValidBits == 0) {
+            std::cerr << "graphics queue has no timestamps, GPU profiling and dynamic resolution disabled" << std::endl;
+            options.dynamicResolution = 0.0f;
+            options.gpuTrace.clear();
+            return;
+        }
+
+        GpuProfiler::Settings profilerSettings;
+        profilerSettings.slotCount = MAX_FRAMES_IN_FLIGHT + 1;
+        profilerSettings.trace = !options.gpuTrace.empty();
+        gpuProfiler.init(physicalDevice, device, instanceDispatch, dispatch, allocator, findQueueFamilies(physicalDevice).graphicsFamily.value(), profilerSettings);
+
+        if (options.dynamicResolution > 0.0f) {
+            ResolutionController::Settings settings;
+            settings.targetMilliseconds = options.dynamicResolution;
+            settings.minScale = options.minRenderScale;
+            resolutionController.init(settings);
+            resolutionController.openLog(options.resolutionLog);
         }
     }
 
@@ -1456,6 +3522,7 @@ private:
         imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        frameNumbers.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1465,56 +3532,158 @@ private:
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            if (dispatch.createSemaphore(device, &semaphoreInfo, allocator, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                dispatch.createSemaphore(device, &semaphoreInfo, allocator, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                dispatch.createFence(device, &fenceInfo, allocator, &inFlightFences[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
     }
 
     void updateUniformBuffer(uint32_t currentImage) {
-        static auto startTime = std::chrono::high_resolution_clock::now();
+        float time = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::steady_clock::now() - animationStart).count();
+
+        // A fixed timestep animates by frame number, so every run renders the same frames.
+        if (benchmark.active()) {
+            time = static_cast<float>(benchmark.time());
+        }
+        else if (options.fixedTimestep > 0.0f) {
+            time = totalFrames * options.fixedTimestep;
+        }
+        if (replayTrace) {
+            time = static_cast<float>(replayTrace->frames()[totalFrames].animationTime);
+        }
+        frameAnimationTime = time;
+
+        if (options.stressScene) {
+            for (const SpinningObject& object : spinningObjects) {
+                glm::quat rotation = glm::angleAxis(object.angle + time * object.spin, glm::vec3(0.0f, 0.0f, 1.0f));
+                sceneTransforms.setRotation(object.node, rotation.x, rotation.y, rotation.z, rotation.w);
+            }
+        }
+        else {
+            glm::quat roomRotation = glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+            sceneTransforms.setRotation(roomNode, roomRotation.x, roomRotation.y, roomRotation.z, roomRotation.w);
+        }
+        sceneTransforms.updateWorldMatrices(static_cast<float*>(objectBuffersMapped[currentImage]), &workerPool);
+
+        // The camera backs away so that larger copy grids stay in view.
+        float cameraDistance = 2.0f * sceneRadius;
+        float fovY = glm::radians(45.0f);
+
+        glm::vec3 cameraTarget(0.0f);
+        if (!cameraPath.empty()) {
+            float position[3], target[3];
+            cameraPath.evaluate(time, position, target);
+            cameraPosition = sceneRadius * glm::vec3(position[0], position[1], position[2]);
+            cameraTarget = sceneRadius * glm::vec3(target[0], target[1], target[2]);
+        }
+        else {
+            cameraPosition = glm::vec3(cameraDistance, cameraDistance, cameraDistance);
+        }
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+        // A world-space error e at distance d projects to e * lodScale / d times the LOD threshold in pixels.
+        lodScale = swapChainExtent.height / (2.0f * std::tan(0.5f * fovY) * options.lodThreshold);
 
         UniformBufferObject ubo{};
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+        ubo.view = glm::lookAt(cameraPosition, cameraTarget, glm::vec3(0.0f, 0.0f, 1.0f));
+        ubo.proj = glm::perspective(fovY, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f * sceneRadius);
         ubo.proj[1][1] *= -1;
 
         memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+
+        cullScene(ubo.proj * ubo.view);
+
+        if (!options.gpuDriven) {
+            writeInstances(currentImage);
+        }
     }
 
     void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        // CPU scopes only show up in the --gpu-trace output, next to the GPU work they feed; the
+        // phases below go there too.
+        GpuProfiler::CpuScope frameScope(gpuProfiler, "drawFrame");
+        hostAllocator.beginFrame();
+        frameStart = std::chrono::steady_clock::now();
+
+        {
+            PhaseTimer::Scope phase(phaseTimer, framePhases.fenceWait);
+            dispatch.waitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        }
 
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        completedFrameCount = std::max(completedFrameCount, frameNumbers[currentFrame]);
+        deletionQueue.collect(completedFrameCount);
+        submitReadback(currentFrame);
+        pipelineStatistics.collect(currentFrame);
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
-            return;
+        GpuProfiler::FrameTiming gpuTiming;
+        if (gpuProfiler.collect(currentFrame, gpuTiming)) {
+            if (options.dynamicResolution > 0.0f) {
+                resolutionController.update(gpuTiming.frame, gpuTiming.gpuMilliseconds);
+            }
+            benchmark.addGpuTime(gpuTiming.frame, gpuTiming.gpuMilliseconds);
+        }
+
+        if (options.gpuDriven) {
+            cullStats.tested = static_cast<uint32_t>(sceneObjects.size());
+            const DrawCounts& counts = *static_cast<const DrawCounts*>(drawCountBuffersMapped[currentFrame]);
+            cullStats.visible = counts.drawCount + counts.lateDrawCount;
+            cullStats.culled = cullStats.tested - cullStats.visible;
+            triangleCount = counts.triangleCount;
+            occludedCount = counts.occludedCount;
+        }
+
+        // Headless frames render into their own offscreen image, which the fence above has
+        // already made available.
+        uint32_t imageIndex = currentFrame;
+        if (!options.headless) {
+            VkResult result;
+            {
+                PhaseTimer::Scope phase(phaseTimer, framePhases.acquire);
+                result = dispatch.acquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+            }
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreateSwapChain();
+                return;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("failed to acquire swap chain image!");
+
+        // CPU time for the benchmark runs from here to the submit, leaving out the waits.
+        auto cpuStart = std::chrono::steady_clock::now();
+
+        {
+            PhaseTimer::Scope phase(phaseTimer, framePhases.update);
+            updateUniformBuffer(currentFrame);
         }
 
-        updateUniformBuffer(currentFrame);
+        dispatch.resetFences(device, 1, &inFlightFences[currentFrame]);
+
+        if (options.occlusionCulling && cullHiZDescriptorsStale[currentFrame]) {
+            writeCullHiZDescriptors(currentFrame);
+        }
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        // Blocks only when the writer thread has fallen behind by every readback buffer.
+        if (frameWriter.isActive()) {
+            frameReadbackSlots[currentFrame] = frameWriter.acquireSlot();
+        }
 
-        vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        {
+            PhaseTimer::Scope phase(phaseTimer, framePhases.record);
+            dispatch.resetCommandPool(device, frameCommandPools[currentFrame], 0);
+            recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        }
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        // The swap chain image is first written by the scene's resolve, or by the upscale blit.
+        VkPipelineStageFlags waitStages[] = { options.dynamicResolution > 0.0f ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        submitInfo.waitSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
@@ -1522,38 +3691,149 @@ private:
         submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = options.headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+        VkResult submitResult;
+        {
+            PhaseTimer::Scope phase(phaseTimer, framePhases.submit);
+            submitResult = dispatch.queueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+        }
+        if (submitResult != VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        frameNumbers[currentFrame] = ++submittedFrameCount;
+        double cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
 
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        if (!options.headless) {
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = signalSemaphores;
 
-        VkSwapchainKHR swapChains[] = { swapChain };
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = swapChains;
+            VkSwapchainKHR swapChains[] = { swapChain };
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = swapChains;
 
-        presentInfo.pImageIndices = &imageIndex;
+            presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+            VkResult result;
+            {
+                PhaseTimer::Scope phase(phaseTimer, framePhases.present);
+                result = dispatch.queuePresentKHR(presentQueue, &presentInfo);
+            }
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-            framebufferResized = false;
-            recreateSwapChain();
+            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+                framebufferResized = false;
+                recreateSwapChain();
+            }
+            else if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to present swap chain image!");
+            }
         }
-        else if (result != VK_SUCCESS) {
-            throw std::runtime_error("failed to present swap chain image!");
+
+        if (totalFrames++ == 0) {
+            firstTimedFrame = std::chrono::steady_clock::now();
+            std::cout << "time to first frame: " << std::chrono::duration<double, std::milli>(firstTimedFrame - startupStart).count() << " ms" << std::endl;
         }
+        benchmark.endFrame(cpuMilliseconds);
+        traceFrame(cpuMilliseconds);
 
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
 
+    // Records the frame just submitted into the capture, or checks it against the trace it replays.
+    void traceFrame(double cpuMilliseconds) {
+        SessionTrace::Frame frame;
+        frame.startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(frameStart - animationStart).count();
+        frame.animationTime = frameAnimationTime;
+        frame.width = swapChainExtent.width;
+        frame.height = swapChainExtent.height;
+        frame.drawCalls = drawCallCount;
+        frame.triangles = triangleCount;
+        frame.cpuMilliseconds = static_cast<float>(cpuMilliseconds);
+        traceCalls(totalFrames - 1);
+
+        if (!replayTrace) {
+            sessionRecorder.addFrame(frame);
+            return;
+        }
+
+        const SessionTrace::Frame& captured = replayTrace->frames()[totalFrames - 1];
+        capturedCpuMilliseconds += captured.cpuMilliseconds;
+        replayCpuMilliseconds += cpuMilliseconds;
+        if (captured.drawCalls != frame.drawCalls || captured.triangles != frame.triangles) {
+            if (replayMismatches++ == 0) {
+                firstMismatchedFrame = totalFrames - 1;
+            }
+        }
+    }
+
+    // Hands the device calls made since the last call to the capture under frame, or compares them
+    // with the ones captured for it.
+    void traceCalls(uint32_t frame) {
+        if (!callCapture.isInstalled()) {
+            return;
+        }
+        uint32_t count = callCapture.take(tracedCalls);
+
+        if (!replayTrace) {
+            sessionRecorder.addCalls(frame, count, tracedCalls);
+            return;
+        }
+
+        const SessionTrace::Calls* captured = frame == SessionTrace::SETUP_CALLS ? &replayTrace->setupCalls() : replayTrace->frameCalls(frame);
+        std::string difference;
+        if (!compareCalls(decodeCalls(captured ? captured->stream : std::vector<char>()), decodeCalls(tracedCalls), difference)) {
+            if (callMismatches++ == 0) {
+                firstCallMismatch = (frame == SessionTrace::SETUP_CALLS ? std::string("setup") : "frame " + std::to_string(frame)) + ", " + difference;
+            }
+        }
+    }
+
+    // Puts the window at the size the next captured frame had and, with captured timing, waits
+    // until that frame started. The resize takes effect through the usual swap chain recreation.
+    void paceReplay() {
+        const SessionTrace::Frame& frame = replayTrace->frames()[totalFrames];
+
+        if (!options.headless && (frame.width != replayWindowExtent.width || frame.height != replayWindowExtent.height)) {
+            replayWindowExtent = { frame.width, frame.height };
+            if (frame.width != swapChainExtent.width || frame.height != swapChainExtent.height) {
+                glfwSetWindowSize(window, static_cast<int>(frame.width), static_cast<int>(frame.height));
+            }
+        }
+
+        if (options.replayCapturedTiming) {
+            std::this_thread::sleep_until(animationStart + std::chrono::nanoseconds(frame.startNanoseconds));
+        }
+    }
+
+    void reportReplay() {
+        const SessionTrace::Device& captured = replayTrace->device();
+        uint32_t frames = std::max(1u, totalFrames);
+
+        std::cout << "replayed " << totalFrames << " of " << replayTrace->frames().size() << " frames from " << options.replayPath << std::endl;
+        std::cout << "  captured on " << captured.name << ", driver " << captured.driverVersion
+            << "; replayed on " << deviceProfile.name << ", driver " << deviceProfile.driverVersion << std::endl;
+        std::cout << "  cpu per frame: " << capturedCpuMilliseconds / frames << " ms captured, " << replayCpuMilliseconds / frames << " ms replayed" << std::endl;
+        if (replayMismatches > 0) {
+            std::cout << "  " << replayMismatches << " frames drew differently from the capture, the first at frame " << firstMismatchedFrame << std::endl;
+        }
+        else {
+            std::cout << "  every frame drew what the capture did" << std::endl;
+        }
+        if (callCapture.isInstalled()) {
+            if (callMismatches > 0) {
+                std::cout << "  " << callMismatches << " of " << totalFrames + 1 << " call streams (setup and each frame) differed from the capture, the first in "
+                    << firstCallMismatch << std::endl;
+            }
+            else {
+                std::cout << "  setup and every frame made the device calls the capture did" << std::endl;
+            }
+        }
+    }
+
     VkShaderModule createShaderModule(const std::vector<char>& code) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -1561,7 +3841,7 @@ private:
         createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
         VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        if (dispatch.createShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("failed to create shader module!");
         }
 
@@ -1637,8 +3917,9 @@ private:
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        // Headless runs never create a surface or swap chain, so there is nothing to check.
+        bool swapChainAdequate = options.headless;
+        if (extensionsSupported && !options.headless) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -1649,6 +3930,22 @@ private:
         return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
     }
 
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -1656,7 +3953,10 @@ private:
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::set<std::string> requiredExtensions;
+        if (!options.headless) {
+            requiredExtensions.insert(deviceExtensions.begin(), deviceExtensions.end());
+        }
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -1667,6 +3967,7 @@ private:
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
+        indices.presentRequired = !options.headless;
 
         uint32_t queueFamilyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -1676,12 +3977,15 @@ private:
 
         int i = 0;
         for (const auto& queueFamily : queueFamilies) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            // The graphics queue also runs the culling compute pass.
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
                 indices.graphicsFamily = i;
             }
 
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
 
             if (presentSupport) {
                 indices.presentFamily = i;
@@ -1698,11 +4002,16 @@ private:
     }
 
     std::vector<const char*> getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char*> extensions;
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        // GLFW isn't initialized when headless, and without a surface its extensions aren't needed.
+        if (!options.headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -1736,22 +4045,41 @@ private:
         return true;
     }
 
-    static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
+    // Reads every file that exists into shaderCode. Missing ones are skipped so that readShader
+    // reports them when the pipeline that needs them is created.
+    void preloadShaders(const std::vector<std::string>& paths) {
+        for (const auto& path : paths) {
+            try {
+                shaderCode[path] = readAsset(path);
+            }
+            catch (const std::runtime_error&) {
+            }
         }
+    }
 
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+    std::vector<char> readShader(const std::string& path) {
+        auto it = shaderCode.find(path);
+        if (it != shaderCode.end()) {
+            return it->second;
+        }
+        return readAsset(path);
+    }
 
-        file.close();
+    // Reads a file the session depends on. A capture keeps a copy in the trace; a replay reads
+    // that copy in place of the file, so the files needn't be on the replaying machine. Safe to
+    // call from the loading tasks.
+    std::vector<char> readAsset(const std::string& path) {
+        if (replayTrace) {
+            const std::vector<char>* blob = replayTrace->findBlob(path);
+            if (!blob) {
+                throw std::runtime_error("failed to find " + path + " in the session trace!");
+            }
+            return *blob;
+        }
 
-        return buffer;
+        std::vector<char> data = readFile(path);
+        sessionRecorder.addBlob(path, data);
+        return data;
     }
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
@@ -1761,10 +4089,196 @@ private:
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
+AppOptions parseOptions(const std::vector<std::string>& args) {
+    AppOptions options{};
+
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        size_t first = i;
+        bool recorded = true;
+
+        if (arg == "--gpu-driven") {
+            options.gpuDriven = true;
+        }
+        else if (arg == "--occlusion") {
+            options.gpuDriven = true;
+            options.occlusionCulling = true;
+        }
+        else if (arg == "--no-instancing") {
+            options.instancing = false;
+        }
+        else if (arg == "--copies" && i + 1 < args.size()) {
+            options.copies = std::max(1u, static_cast<uint32_t>(std::stoul(args[++i])));
+        }
+        else if (arg == "--no-lod") {
+            options.lod = false;
+        }
+        else if (arg == "--lod-threshold" && i + 1 < args.size()) {
+            options.lodThreshold = std::stof(args[++i]);
+        }
+        else if (arg == "--blocking-resize") {
+            options.blockingResize = true;
+        }
+        else if (arg == "--frames" && i + 1 < args.size()) {
+            options.benchmarkFrames = static_cast<uint32_t>(std::stoul(args[++i]));
+        }
+        else if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--fixed-timestep" && i + 1 < args.size()) {
+            options.fixedTimestep = std::stof(args[++i]);
+        }
+        else if (arg == "--output" && i + 1 < args.size()) {
+            options.outputTarget = args[++i];
+            options.outputPipe = false;
+        }
+        else if (arg == "--output-pipe" && i + 1 < args.size()) {
+            options.outputTarget = args[++i];
+            options.outputPipe = true;
+        }
+        else if (arg == "--dynamic-resolution" && i + 1 < args.size()) {
+            options.dynamicResolution = std::stof(args[++i]);
+        }
+        else if (arg == "--min-render-scale" && i + 1 < args.size()) {
+            options.minRenderScale = std::min(1.0f, std::max(0.1f, std::stof(args[++i])));
+        }
+        else if (arg == "--resolution-log" && i + 1 < args.size()) {
+            options.resolutionLog = args[++i];
+        }
+        else if (arg == "--gpu-trace" && i + 1 < args.size()) {
+            options.gpuTrace = args[++i];
+        }
+        else if (arg == "--phase-stats") {
+            options.phaseStats = true;
+        }
+        else if (arg == "--benchmark") {
+            options.benchmark = true;
+        }
+        else if (arg == "--warmup" && i + 1 < args.size()) {
+            options.warmupFrames = static_cast<uint32_t>(std::stoul(args[++i]));
+        }
+        else if (arg == "--camera-path" && i + 1 < args.size()) {
+            options.cameraPath = args[++i];
+        }
+        else if (arg == "--benchmark-output" && i + 1 < args.size()) {
+            options.benchmarkOutput = args[++i];
+        }
+        else if (arg == "--host-allocations") {
+            options.hostAllocations = true;
+        }
+        else if (arg == "--pipeline-stats") {
+            options.pipelineStats = true;
+        }
+        else if (arg == "--memory-report") {
+            options.memoryReport = true;
+        }
+        else if (arg == "--loader-dispatch") {
+            options.loaderDispatch = true;
+        }
+        else if (arg == "--stress" && i + 1 < args.size()) {
+            // A preset is the base the --stress-* options change, so it has to come first.
+            if (options.stressScene) {
+                throw std::invalid_argument("--stress must come before the --stress-* options");
+            }
+            options.stress = StressScene::preset(args[++i]);
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-objects" && i + 1 < args.size()) {
+            options.stress.objectCount = static_cast<uint32_t>(std::stoul(args[++i]));
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-meshes" && i + 1 < args.size()) {
+            options.stress.meshCount = static_cast<uint32_t>(std::stoul(args[++i]));
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-triangles" && i + 1 < args.size()) {
+            options.stress.trianglesPerMesh = static_cast<uint32_t>(std::stoul(args[++i]));
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-textures" && i + 1 < args.size()) {
+            options.stress.textureCount = static_cast<uint32_t>(std::stoul(args[++i]));
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-texture-size" && i + 1 < args.size()) {
+            options.stress.textureSize = static_cast<uint32_t>(std::stoul(args[++i]));
+            options.stressScene = true;
+        }
+        else if (arg == "--stress-motion" && i + 1 < args.size()) {
+            options.stress.motion = std::stof(args[++i]);
+            options.stressScene = true;
+        }
+        else if (arg == "--capture" && i + 1 < args.size()) {
+            options.capturePath = args[++i];
+            recorded = false;
+        }
+        else if (arg == "--replay" && i + 1 < args.size()) {
+            options.replayPath = args[++i];
+            recorded = false;
+        }
+        else if (arg == "--replay-timing" && i + 1 < args.size()) {
+            std::string timing = args[++i];
+            if (timing != "fast" && timing != "captured") {
+                throw std::invalid_argument("--replay-timing is fast or captured");
+            }
+            options.replayCapturedTiming = timing == "captured";
+            recorded = false;
+        }
+        else {
+            throw std::invalid_argument("unknown option: " + arg);
+        }
+
+        if (recorded) {
+            options.arguments.insert(options.arguments.end(), args.begin() + first, args.begin() + i + 1);
+        }
+    }
+
+    if (options.benchmark) {
+        if (options.benchmarkFrames == 0) {
+            options.benchmarkFrames = 600;
+        }
+        if (options.fixedTimestep <= 0.0f) {
+            options.fixedTimestep = 1.0f / 60.0f;
+        }
+    }
+    if (options.headless && options.benchmarkFrames == 0) {
+        throw std::invalid_argument("--headless needs --frames to know when to stop");
+    }
+    if (!options.outputTarget.empty() && !options.headless) {
+        throw std::invalid_argument("--output and --output-pipe need --headless");
+    }
+    if (options.stressScene && options.copies > 1) {
+        throw std::invalid_argument("--copies applies to the model; use --stress-objects with a stress scene");
+    }
+    if (!options.capturePath.empty() && !options.replayPath.empty()) {
+        throw std::invalid_argument("--capture and --replay can't be combined");
+    }
+    if (options.dynamicResolution > 0.0f && options.occlusionCulling) {
+        throw std::invalid_argument("--dynamic-resolution can't be combined with --occlusion, the depth pyramid assumes full resolution");
+    }
+
+    return options;
+}
 
+int main(int argc, char** argv) {
     try {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        AppOptions options = parseOptions(args);
+
+        // A replay runs with the captured session's options, then any given here, e.g. to turn on
+        // --gpu-trace or --pipeline-stats for it.
+        SessionTrace replayTrace;
+        if (!options.replayPath.empty()) {
+            replayTrace.load(options.replayPath);
+            if (replayTrace.frames().empty()) {
+                throw std::runtime_error(options.replayPath + " has no frames to replay");
+            }
+            std::vector<std::string> replayArgs = replayTrace.arguments();
+            replayArgs.insert(replayArgs.end(), args.begin(), args.end());
+            options = parseOptions(replayArgs);
+        }
+
+        HelloTriangleApplication app(options, options.replayPath.empty() ? nullptr : &replayTrace);
+
         app.run();
     }
     catch (const std::exception& e) {
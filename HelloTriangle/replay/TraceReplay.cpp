@@ -0,0 +1,212 @@
+// Replays the device calls of a session trace recorded with --capture into a decoder rather than a
+// device, so it runs anywhere: what the session called, how often, with which parameters, and
+// where two sessions' call streams part. Re-executing a trace on a GPU is the engine's --replay.
+//
+//   trace-replay session.trace                    summary and calls per command
+//   trace-replay session.trace --dump [--frames 10-20]
+//   trace-replay session.trace --compare other.trace
+
+#include "../core/CallTrace.h"
+#include "../core/SessionTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct Options
+{
+	std::string tracePath;
+	std::string comparePath;
+	bool dump = false;
+	uint32_t firstFrame = 0;
+	uint32_t lastFrame = UINT32_MAX;
+};
+
+static Options parseOptions(const std::vector<std::string>& args)
+{
+	Options options;
+	for (size_t i = 0; i < args.size(); i++) {
+		const std::string& arg = args[i];
+		if (arg == "--dump") {
+			options.dump = true;
+		}
+		else if (arg == "--frames" && i + 1 < args.size()) {
+			// A single frame or first-last, both inclusive.
+			std::string range = args[++i];
+			size_t dash = range.find('-');
+			options.firstFrame = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+			options.lastFrame = dash == std::string::npos ? options.firstFrame : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+		}
+		else if (arg == "--compare" && i + 1 < args.size()) {
+			options.comparePath = args[++i];
+		}
+		else if (options.tracePath.empty() && arg.compare(0, 2, "--") != 0) {
+			options.tracePath = arg;
+		}
+		else {
+			throw std::invalid_argument("unknown option: " + arg);
+		}
+	}
+
+	if (options.tracePath.empty()) {
+		throw std::invalid_argument("usage: trace-replay <trace> [--dump] [--frames first-last] [--compare other.trace]");
+	}
+	return options;
+}
+
+static std::string streamName(uint32_t frame)
+{
+	return frame == SessionTrace::SETUP_CALLS ? std::string("setup") : "frame " + std::to_string(frame);
+}
+
+// The setup stream followed by each frame's, null where a frame has no calls.
+static std::vector<std::pair<uint32_t, const SessionTrace::Calls*>> callStreams(const SessionTrace& trace)
+{
+	std::vector<std::pair<uint32_t, const SessionTrace::Calls*>> streams;
+	streams.emplace_back(SessionTrace::SETUP_CALLS, &trace.setupCalls());
+	for (uint32_t frame = 0; frame < trace.frames().size(); frame++)
+		streams.emplace_back(frame, trace.frameCalls(frame));
+	return streams;
+}
+
+static void summarize(const SessionTrace& trace, const Options& options)
+{
+	const SessionTrace::Device& device = trace.device();
+	std::cout << options.tracePath << ": " << trace.frames().size() << " frames captured on " << device.name << ", driver " << device.driverVersion << std::endl;
+	std::cout << "  arguments:";
+	for (const std::string& argument : trace.arguments())
+		std::cout << " " << argument;
+	std::cout << std::endl;
+
+	if (trace.setupCalls().stream.empty()) {
+		throw std::runtime_error(options.tracePath + " has no device calls, it was captured by a build that didn't record them");
+	}
+
+	struct CallTotals
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+	};
+	std::vector<CallTotals> totals(static_cast<size_t>(ApiCall::Count));
+	uint64_t setupCalls = 0;
+	uint64_t frameCalls = 0;
+	uint64_t streamBytes = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (const auto& [frame, calls] : callStreams(trace)) {
+		if (!calls)
+			continue;
+		bool dumped = options.dump && (frame == SessionTrace::SETUP_CALLS ? options.firstFrame == 0 : frame >= options.firstFrame && frame <= options.lastFrame);
+		if (dumped)
+			std::cout << streamName(frame) << ":" << std::endl;
+
+		for (const DecodedCall& call : decodeCalls(calls->stream)) {
+			CallTotals& total = totals[static_cast<size_t>(call.call)];
+			total.count++;
+			for (const DecodedCall::Value& value : call.values)
+				total.bytes += value.data.size();
+			if (dumped) {
+				std::cout << "  ";
+				printCall(std::cout, call);
+				std::cout << std::endl;
+			}
+		}
+
+		(frame == SessionTrace::SETUP_CALLS ? setupCalls : frameCalls) += calls->count;
+		streamBytes += calls->stream.size();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t frames = std::max<size_t>(1, trace.frames().size());
+	std::cout << "  " << setupCalls << " setup calls, " << frameCalls << " frame calls (" << frameCalls / frames << " per frame), " << streamBytes << " bytes" << std::endl;
+	if (!options.dump) {
+		std::cout << "  decoded in " << seconds * 1000.0 << " ms, " << (setupCalls + frameCalls) / std::max(seconds, 1e-9) / 1e6 << " M calls/s" << std::endl;
+	}
+
+	std::vector<ApiCall> order;
+	for (size_t i = 0; i < totals.size(); i++) {
+		if (totals[i].count > 0)
+			order.push_back(static_cast<ApiCall>(i));
+	}
+	std::sort(order.begin(), order.end(), [&](ApiCall a, ApiCall b) {
+		return totals[static_cast<size_t>(a)].count > totals[static_cast<size_t>(b)].count;
+	});
+
+	std::cout << "  calls per command (data is shader code, push constants, uploads and names):" << std::endl;
+	for (ApiCall call : order) {
+		const CallTotals& total = totals[static_cast<size_t>(call)];
+		std::cout << "    " << std::left << std::setw(36) << apiCallInfo(call).name << std::right << std::setw(10) << total.count;
+		if (total.bytes > 0)
+			std::cout << "  " << total.bytes << " bytes of data";
+		std::cout << std::endl;
+	}
+}
+
+// Returns the number of streams that differ. Frames past the shorter trace's end are counted as
+// differing.
+static uint32_t compare(const SessionTrace& trace, const SessionTrace& other, const Options& options)
+{
+	std::cout << "comparing the calls of " << options.tracePath << " with " << options.comparePath << std::endl;
+
+	std::vector<std::pair<uint32_t, const SessionTrace::Calls*>> expected = callStreams(trace);
+	std::vector<std::pair<uint32_t, const SessionTrace::Calls*>> actual = callStreams(other);
+	const uint32_t shownDifferences = 10;
+	uint32_t differences = 0;
+
+	for (size_t i = 0; i < std::min(expected.size(), actual.size()); i++) {
+		static const std::vector<char> none;
+		const std::vector<char>& a = expected[i].second ? expected[i].second->stream : none;
+		const std::vector<char>& b = actual[i].second ? actual[i].second->stream : none;
+
+		std::string difference;
+		if (!compareCalls(decodeCalls(a), decodeCalls(b), difference)) {
+			if (differences++ < shownDifferences)
+				std::cout << "  " << streamName(expected[i].first) << ": " << difference << std::endl;
+		}
+	}
+	if (differences > shownDifferences) {
+		std::cout << "  ..." << std::endl;
+	}
+	if (expected.size() != actual.size()) {
+		std::cout << "  " << other.frames().size() << " frames instead of " << trace.frames().size() << std::endl;
+		differences += static_cast<uint32_t>(std::max(expected.size(), actual.size()) - std::min(expected.size(), actual.size()));
+	}
+
+	if (differences == 0) {
+		std::cout << "  setup and all " << trace.frames().size() << " frames made the same calls" << std::endl;
+	}
+	else {
+		std::cout << "  " << differences << " of " << std::max(expected.size(), actual.size()) << " call streams differ" << std::endl;
+	}
+	return differences;
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		Options options = parseOptions(std::vector<std::string>(argv + 1, argv + argc));
+
+		SessionTrace trace;
+		trace.load(options.tracePath);
+
+		if (!options.comparePath.empty()) {
+			SessionTrace other;
+			other.load(options.comparePath);
+			return compare(trace, other, options) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		summarize(trace, options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
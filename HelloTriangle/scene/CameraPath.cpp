@@ -0,0 +1,89 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static float catmullRom(float p0, float p1, float p2, float p3, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+void CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error("failed to open camera path " + path + "!");
+
+	load(file, path);
+}
+
+void CameraPath::load(std::istream& in, const std::string& name)
+{
+	m_keys.clear();
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Key key;
+		if (!(fields >> key.time >> key.position[0] >> key.position[1] >> key.position[2] >> key.target[0] >> key.target[1] >> key.target[2]))
+			throw std::runtime_error("failed to parse camera path " + name + " at line " + std::to_string(lineNumber) + "!");
+		addKey(key);
+	}
+
+	if (m_keys.empty())
+		throw std::runtime_error("camera path " + name + " has no keys!");
+}
+
+CameraPath CameraPath::orbit(float distance, float height, float seconds)
+{
+	const uint32_t KEY_COUNT = 32;
+	const float PI = 3.14159265358979f;
+
+	CameraPath path;
+	for (uint32_t i = 0; i <= KEY_COUNT; i++) {
+		float angle = 0.25f * PI + 2.0f * PI * i / KEY_COUNT;
+		Key key = { seconds * i / KEY_COUNT, { distance * std::cos(angle), distance * std::sin(angle), height }, { 0.0f, 0.0f, 0.0f } };
+		path.addKey(key);
+	}
+	return path;
+}
+
+void CameraPath::addKey(const Key& key)
+{
+	if (!m_keys.empty() && key.time <= m_keys.back().time)
+		throw std::invalid_argument("CameraPath: keys must be in increasing time order!");
+	m_keys.push_back(key);
+}
+
+void CameraPath::evaluate(float time, float position[3], float target[3]) const
+{
+	if (m_keys.empty()) {
+		std::fill(position, position + 3, 0.0f);
+		std::fill(target, target + 3, 0.0f);
+		return;
+	}
+
+	// The segment [k1, k2] containing time, with its neighbors clamped at the ends.
+	auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](float value, const Key& key) { return value < key.time; });
+	size_t k2 = std::min(static_cast<size_t>(next - m_keys.begin()), m_keys.size() - 1);
+	size_t k1 = k2 > 0 ? k2 - 1 : 0;
+	size_t k0 = k1 > 0 ? k1 - 1 : 0;
+	size_t k3 = std::min(k2 + 1, m_keys.size() - 1);
+
+	float span = m_keys[k2].time - m_keys[k1].time;
+	float t = span > 0.0f ? std::min(1.0f, std::max(0.0f, (time - m_keys[k1].time) / span)) : 0.0f;
+
+	for (int axis = 0; axis < 3; axis++) {
+		position[axis] = catmullRom(m_keys[k0].position[axis], m_keys[k1].position[axis], m_keys[k2].position[axis], m_keys[k3].position[axis], t);
+		target[axis] = catmullRom(m_keys[k0].target[axis], m_keys[k1].target[axis], m_keys[k2].target[axis], m_keys[k3].target[axis], t);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// A scripted camera: position and look-at target keyed by time, in units of the scene radius so
+// one path fits every scene size. Between keys both follow a Catmull-Rom spline through the
+// keys; before the first key and after the last the camera holds still.
+//
+// Path files have one key per line, "time px py pz tx ty tz", with time in seconds. Blank lines
+// and lines starting with '#' are skipped. Keys must be in increasing time order.
+class CameraPath
+{
+public:
+	struct Key
+	{
+		float time;
+		float position[3];
+		float target[3];
+	};
+
+public:
+	CameraPath() = default;
+
+	// Throws if the file can't be read or a line doesn't parse.
+	void load(const std::string& path);
+	// The same from a stream, with name standing for it in errors.
+	void load(std::istream& in, const std::string& name);
+
+	// A full circle around the target at the origin, at the given horizontal distance and
+	// height, starting from +x+y and taking seconds to complete.
+	static CameraPath orbit(float distance, float height, float seconds);
+
+	void addKey(const Key& key);
+	bool empty() const { return m_keys.empty(); }
+	float duration() const { return m_keys.empty() ? 0.0f : m_keys.back().time - m_keys.front().time; }
+
+	void evaluate(float time, float position[3], float target[3]) const;
+
+private:
+	std::vector<Key> m_keys;
+};
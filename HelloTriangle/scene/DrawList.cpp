@@ -0,0 +1,98 @@
+#include "DrawList.h"
+
+#include "../core/WorkerPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr uint32_t RADIX_BITS = 8;
+static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+uint64_t DrawList::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket)
+{
+	if (pass > 0xf || pipeline > 0xfff || material > 0xffff || mesh > 0xffff || depthBucket > 0xffff)
+		throw std::out_of_range("DrawList: sort key field out of range!");
+
+	return static_cast<uint64_t>(pass) << 60 | static_cast<uint64_t>(pipeline) << 48 |
+		static_cast<uint64_t>(material) << 32 | static_cast<uint64_t>(mesh) << 16 | depthBucket;
+}
+
+void DrawList::clear()
+{
+	m_entries.clear();
+}
+
+void DrawList::add(uint64_t key, uint32_t item)
+{
+	m_entries.push_back({ key, item });
+}
+
+void DrawList::histogramRange(uint32_t shift, size_t begin, size_t end, uint32_t* counts) const
+{
+	std::fill(counts, counts + RADIX_SIZE, 0);
+	for (size_t i = begin; i < end; i++)
+		counts[(m_entries[i].key >> shift) & (RADIX_SIZE - 1)]++;
+}
+
+void DrawList::scatterRange(uint32_t shift, size_t begin, size_t end, uint32_t* offsets)
+{
+	for (size_t i = begin; i < end; i++)
+		m_scratch[offsets[(m_entries[i].key >> shift) & (RADIX_SIZE - 1)]++] = m_entries[i];
+}
+
+void DrawList::sort(WorkerPool* pool)
+{
+	size_t count = m_entries.size();
+	if (count < 2)
+		return;
+
+	// Bits that differ between any two keys; digits without any are already sorted.
+	uint64_t differing = 0;
+	for (const Entry& entry : m_entries)
+		differing |= entry.key ^ m_entries[0].key;
+	if (differing == 0)
+		return;
+
+	uint32_t threadCount = pool && count >= PARALLEL_MIN_ENTRIES ? pool->threadCount() : 1;
+	size_t chunk = (count + threadCount - 1) / threadCount;
+	threadCount = static_cast<uint32_t>((count + chunk - 1) / chunk);
+
+	m_scratch.resize(count);
+	std::vector<uint32_t> counts(static_cast<size_t>(threadCount) * RADIX_SIZE);
+
+	// Each chunk's histogram turns into its own scatter offsets: for every digit, the chunks
+	// follow each other in order, which keeps the sort stable.
+	auto runChunks = [&](auto&& work) {
+		if (threadCount == 1) {
+			work(0, 0, count);
+			return;
+		}
+		pool->run(threadCount, [&](uint32_t t) {
+			work(t, t * chunk, std::min((t + 1) * chunk, count));
+		});
+	};
+
+	for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+		if (((differing >> shift) & (RADIX_SIZE - 1)) == 0)
+			continue;
+
+		runChunks([&](uint32_t t, size_t begin, size_t end) {
+			histogramRange(shift, begin, end, &counts[t * RADIX_SIZE]);
+		});
+
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+			for (uint32_t t = 0; t < threadCount; t++) {
+				uint32_t digitCount = counts[t * RADIX_SIZE + digit];
+				counts[t * RADIX_SIZE + digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		runChunks([&](uint32_t t, size_t begin, size_t end) {
+			scatterRange(shift, begin, end, &counts[t * RADIX_SIZE]);
+		});
+
+		m_entries.swap(m_scratch);
+	}
+}
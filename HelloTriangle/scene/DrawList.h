@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+// Number of state binds and draws issued by DrawList::record().
+struct DrawStateChanges
+{
+	uint32_t pipelineBinds = 0;
+	uint32_t descriptorSetBinds = 0;
+	uint32_t vertexBufferBinds = 0;
+	uint32_t draws = 0;
+};
+
+// Draws ordered by a packed 64-bit sort key, most significant field first:
+//
+//   pass (4 bits) | pipeline (12) | material (16) | mesh (16) | depth bucket (16)
+//
+// so that draws sharing a pipeline, then a material's descriptor set, then a mesh's vertex
+// buffers end up next to each other. Sorting is an LSD radix sort over 8-bit digits; digits
+// that are equal across all keys are skipped.
+class DrawList
+{
+public:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t item;	// caller-defined, e.g. an index into a batch or object array
+	};
+
+	// Lists with at least this many entries are sorted on the worker pool, smaller ones on the
+	// calling thread where waking the workers would cost more than it saves.
+	static constexpr uint32_t PARALLEL_MIN_ENTRIES = 16384;
+
+	static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket);
+
+	static uint32_t keyPass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+	static uint32_t keyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> 48) & 0xfff; }
+	static uint32_t keyMaterial(uint64_t key) { return static_cast<uint32_t>(key >> 32) & 0xffff; }
+	static uint32_t keyMesh(uint64_t key) { return static_cast<uint32_t>(key >> 16) & 0xffff; }
+	static uint32_t keyDepth(uint64_t key) { return static_cast<uint32_t>(key) & 0xffff; }
+
+public:
+	void clear();
+	void add(uint64_t key, uint32_t item);
+	void sort(WorkerPool* pool = nullptr);
+
+	const std::vector<Entry>& entries() const { return m_entries; }
+	size_t size() const { return m_entries.size(); }
+
+	// Walks the sorted entries and calls the recorder's bindPipeline(pipeline),
+	// bindMaterial(material) and bindMesh(mesh) only when that state differs from the previous
+	// draw, followed by draw(entry) for every entry. The recorder starts with nothing bound.
+	template <typename Recorder>
+	DrawStateChanges record(Recorder& recorder) const;
+
+private:
+	void histogramRange(uint32_t shift, size_t begin, size_t end, uint32_t* counts) const;
+	void scatterRange(uint32_t shift, size_t begin, size_t end, uint32_t* offsets);
+
+private:
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch;
+};
+
+template <typename Recorder>
+DrawStateChanges DrawList::record(Recorder& recorder) const
+{
+	DrawStateChanges changes;
+
+	// A new pass counts as a pipeline change even when the pipeline index repeats.
+	bool first = true;
+	uint32_t pipeline = 0, material = 0, mesh = 0;
+
+	for (const Entry& entry : m_entries) {
+		uint32_t entryPipeline = keyPass(entry.key) << 12 | keyPipeline(entry.key);
+		uint32_t entryMaterial = keyMaterial(entry.key);
+		uint32_t entryMesh = keyMesh(entry.key);
+
+		if (first || entryPipeline != pipeline) {
+			recorder.bindPipeline(keyPipeline(entry.key));
+			pipeline = entryPipeline;
+			changes.pipelineBinds++;
+		}
+		if (first || entryMaterial != material) {
+			recorder.bindMaterial(entryMaterial);
+			material = entryMaterial;
+			changes.descriptorSetBinds++;
+		}
+		if (first || entryMesh != mesh) {
+			recorder.bindMesh(entryMesh);
+			mesh = entryMesh;
+			changes.vertexBufferBinds++;
+		}
+		first = false;
+
+		recorder.draw(entry);
+		changes.draws++;
+	}
+
+	return changes;
+}
@@ -0,0 +1,200 @@
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+Aabb Aabb::empty()
+{
+	return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+void Aabb::expand(float x, float y, float z)
+{
+	min[0] = std::min(min[0], x); max[0] = std::max(max[0], x);
+	min[1] = std::min(min[1], y); max[1] = std::max(max[1], y);
+	min[2] = std::min(min[2], z); max[2] = std::max(max[2], z);
+}
+
+void Aabb::expand(const Aabb& other)
+{
+	for (int i = 0; i < 3; i++) {
+		min[i] = std::min(min[i], other.min[i]);
+		max[i] = std::max(max[i], other.max[i]);
+	}
+}
+
+bool Aabb::contains(const Aabb& other) const
+{
+	for (int i = 0; i < 3; i++) {
+		if (other.min[i] < min[i] || other.max[i] > max[i])
+			return false;
+	}
+	return true;
+}
+
+float Aabb::surfaceArea() const
+{
+	float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+Aabb transformAabb(const Aabb& box, const float* m)
+{
+	float center[3], extent[3];
+	for (int i = 0; i < 3; i++) {
+		center[i] = 0.5f * (box.min[i] + box.max[i]);
+		extent[i] = 0.5f * (box.max[i] - box.min[i]);
+	}
+
+	Aabb result;
+	for (int r = 0; r < 3; r++) {
+		float c = m[12 + r] + m[r] * center[0] + m[4 + r] * center[1] + m[8 + r] * center[2];
+		float e = std::fabs(m[r]) * extent[0] + std::fabs(m[4 + r]) * extent[1] + std::fabs(m[8 + r]) * extent[2];
+		result.min[r] = c - e;
+		result.max[r] = c + e;
+	}
+	return result;
+}
+
+Frustum::Frustum()
+{
+	// Padding planes (and a default frustum) accept everything.
+	std::fill(m_planeX, m_planeX + 8, 0.0f);
+	std::fill(m_planeY, m_planeY + 8, 0.0f);
+	std::fill(m_planeZ, m_planeZ + 8, 0.0f);
+	std::fill(m_planeW, m_planeW + 8, 1.0f);
+}
+
+Frustum::Frustum(const float* m) : Frustum()
+{
+	// Rows of the clip matrix; m is column-major.
+	float rows[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++)
+			rows[r][c] = m[c * 4 + r];
+	}
+
+	// left, right, bottom, top, near (z >= 0), far (z <= w)
+	float planes[6][4];
+	for (int c = 0; c < 4; c++) {
+		planes[0][c] = rows[3][c] + rows[0][c];
+		planes[1][c] = rows[3][c] - rows[0][c];
+		planes[2][c] = rows[3][c] + rows[1][c];
+		planes[3][c] = rows[3][c] - rows[1][c];
+		planes[4][c] = rows[2][c];
+		planes[5][c] = rows[3][c] - rows[2][c];
+	}
+
+	for (int p = 0; p < 6; p++) {
+		float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		float scale = length > 0.0f ? 1.0f / length : 1.0f;
+
+		m_planeX[p] = planes[p][0] * scale;
+		m_planeY[p] = planes[p][1] * scale;
+		m_planeZ[p] = planes[p][2] * scale;
+		m_planeW[p] = planes[p][3] * scale;
+	}
+}
+
+void Frustum::copyPlanes(float* dst) const
+{
+	for (int p = 0; p < 6; p++) {
+		dst[p * 4 + 0] = m_planeX[p];
+		dst[p * 4 + 1] = m_planeY[p];
+		dst[p * 4 + 2] = m_planeZ[p];
+		dst[p * 4 + 3] = m_planeW[p];
+	}
+}
+
+#ifdef FRUSTUM_SSE
+Frustum::Result Frustum::test(const Aabb& box) const
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	__m128 cx = _mm_set1_ps(0.5f * (box.min[0] + box.max[0]));
+	__m128 cy = _mm_set1_ps(0.5f * (box.min[1] + box.max[1]));
+	__m128 cz = _mm_set1_ps(0.5f * (box.min[2] + box.max[2]));
+	__m128 ex = _mm_mul_ps(half, _mm_set1_ps(box.max[0] - box.min[0]));
+	__m128 ey = _mm_mul_ps(half, _mm_set1_ps(box.max[1] - box.min[1]));
+	__m128 ez = _mm_mul_ps(half, _mm_set1_ps(box.max[2] - box.min[2]));
+
+	int outside = 0, intersecting = 0;
+	for (int p = 0; p < 8; p += 4) {
+		__m128 px = _mm_load_ps(m_planeX + p), py = _mm_load_ps(m_planeY + p), pz = _mm_load_ps(m_planeZ + p);
+
+		__m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(m_planeW + p)));
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, absMask), ex), _mm_mul_ps(_mm_and_ps(py, absMask), ey)), _mm_mul_ps(_mm_and_ps(pz, absMask), ez));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(s, r), _mm_setzero_ps()));
+		intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(s, r), _mm_setzero_ps()));
+	}
+
+	if (outside)
+		return Result::Outside;
+	return intersecting ? Result::Intersecting : Result::Inside;
+}
+
+uint32_t Frustum::testVisible4(const Aabb* const boxes[4]) const
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128 mn[3], mx[3];
+	for (int i = 0; i < 3; i++) {
+		mn[i] = _mm_setr_ps(boxes[0]->min[i], boxes[1]->min[i], boxes[2]->min[i], boxes[3]->min[i]);
+		mx[i] = _mm_setr_ps(boxes[0]->max[i], boxes[1]->max[i], boxes[2]->max[i], boxes[3]->max[i]);
+	}
+
+	__m128 cx = _mm_mul_ps(half, _mm_add_ps(mn[0], mx[0])), ex = _mm_mul_ps(half, _mm_sub_ps(mx[0], mn[0]));
+	__m128 cy = _mm_mul_ps(half, _mm_add_ps(mn[1], mx[1])), ey = _mm_mul_ps(half, _mm_sub_ps(mx[1], mn[1]));
+	__m128 cz = _mm_mul_ps(half, _mm_add_ps(mn[2], mx[2])), ez = _mm_mul_ps(half, _mm_sub_ps(mx[2], mn[2]));
+
+	int outside = 0;
+	for (int p = 0; p < 6; p++) {
+		__m128 px = _mm_set1_ps(m_planeX[p]), py = _mm_set1_ps(m_planeY[p]), pz = _mm_set1_ps(m_planeZ[p]);
+
+		__m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_set1_ps(m_planeW[p])));
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(m_planeX[p])), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(m_planeY[p])), ey)), _mm_mul_ps(_mm_set1_ps(std::fabs(m_planeZ[p])), ez));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(s, r), _mm_setzero_ps()));
+	}
+
+	return ~static_cast<uint32_t>(outside) & 0xf;
+}
+#else
+Frustum::Result Frustum::test(const Aabb& box) const
+{
+	bool intersecting = false;
+	for (int p = 0; p < 6; p++) {
+		float s = 0.0f, r = 0.0f;
+		const float plane[3] = { m_planeX[p], m_planeY[p], m_planeZ[p] };
+		for (int i = 0; i < 3; i++) {
+			s += plane[i] * 0.5f * (box.min[i] + box.max[i]);
+			r += std::fabs(plane[i]) * 0.5f * (box.max[i] - box.min[i]);
+		}
+		s += m_planeW[p];
+
+		if (s + r < 0.0f)
+			return Result::Outside;
+		if (s - r < 0.0f)
+			intersecting = true;
+	}
+	return intersecting ? Result::Intersecting : Result::Inside;
+}
+
+uint32_t Frustum::testVisible4(const Aabb* const boxes[4]) const
+{
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < 4; i++) {
+		if (test(*boxes[i]) != Result::Outside)
+			mask |= 1u << i;
+	}
+	return mask;
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+struct Aabb
+{
+	float min[3];
+	float max[3];
+
+	static Aabb empty();
+
+	void expand(float x, float y, float z);
+	void expand(const Aabb& other);
+	bool contains(const Aabb& other) const;
+	float surfaceArea() const;
+};
+
+// Bounds of a local-space box after applying a column-major 4x4 affine matrix.
+Aabb transformAabb(const Aabb& box, const float* matrix);
+
+struct CullStats
+{
+	uint32_t tested = 0;	// bounding-volume tests performed, internal nodes included
+	uint32_t visible = 0;
+	uint32_t culled = 0;
+};
+
+// The six clip planes of a column-major view-projection matrix (glm layout, 0..1 depth range),
+// stored as structure-of-arrays and padded to eight so they can be tested four at a time.
+class Frustum
+{
+public:
+	enum class Result { Outside, Intersecting, Inside };
+
+public:
+	Frustum();
+	explicit Frustum(const float* viewProj);
+
+	Result test(const Aabb& box) const;
+
+	// Returns a mask with bit i set when boxes[i] is at least partially inside.
+	uint32_t testVisible4(const Aabb* const boxes[4]) const;
+
+	// Writes the six normalized planes as consecutive xyzw quadruples, e.g. for upload to a shader.
+	void copyPlanes(float* dst) const;
+
+private:
+	alignas(16) float m_planeX[8];
+	alignas(16) float m_planeY[8];
+	alignas(16) float m_planeZ[8];
+	alignas(16) float m_planeW[8];
+};
@@ -0,0 +1,40 @@
+#include "InstanceBatcher.h"
+
+#include <stdexcept>
+
+void InstanceBatcher::reset(uint32_t keyCount)
+{
+	m_keyCount = keyCount;
+	m_keys.clear();
+	m_items.clear();
+	m_batches.clear();
+}
+
+void InstanceBatcher::add(uint32_t key, uint32_t item)
+{
+	if (key >= m_keyCount)
+		throw std::out_of_range("InstanceBatcher: key out of range!");
+
+	m_keys.push_back(key);
+	m_items.push_back(item);
+}
+
+void InstanceBatcher::build()
+{
+	m_offsets.assign(m_keyCount + 1, 0);
+	for (uint32_t key : m_keys)
+		m_offsets[key + 1]++;
+
+	m_batches.clear();
+	for (uint32_t key = 0; key < m_keyCount; key++) {
+		uint32_t count = m_offsets[key + 1];
+		m_offsets[key + 1] = m_offsets[key] + count;
+
+		if (count > 0)
+			m_batches.push_back({ key, m_offsets[key], count });
+	}
+
+	m_order.resize(m_items.size());
+	for (size_t i = 0; i < m_items.size(); i++)
+		m_order[m_offsets[m_keys[i]]++] = m_items[i];
+}
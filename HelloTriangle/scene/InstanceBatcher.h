@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Groups items that share a key (e.g. a mesh/material pair) so each group can be issued as one
+// instanced draw. Grouping is a stable counting sort, linear in the number of items.
+class InstanceBatcher
+{
+public:
+	struct Batch
+	{
+		uint32_t key;
+		uint32_t firstInstance;	// offset of the batch's first item in order()
+		uint32_t instanceCount;
+	};
+
+public:
+	// Starts a new frame; keys passed to add() must be below keyCount.
+	void reset(uint32_t keyCount);
+	void add(uint32_t key, uint32_t item);
+	void build();
+
+	const std::vector<Batch>& batches() const { return m_batches; }
+
+	// Items in batch order, i.e. the per-instance data layout.
+	const std::vector<uint32_t>& order() const { return m_order; }
+
+private:
+	uint32_t m_keyCount = 0;
+	std::vector<uint32_t> m_keys;
+	std::vector<uint32_t> m_items;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_order;
+	std::vector<Batch> m_batches;
+};
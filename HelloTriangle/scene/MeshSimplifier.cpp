@@ -0,0 +1,429 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// Edges on open borders and UV seams are held in place by planes perpendicular to their
+	// triangles, weighted this much more than the surface itself.
+	constexpr float EDGE_WEIGHT = 10.0f;
+
+	struct Quadric
+	{
+		// Symmetric matrix, linear term and constant of a weighted sum of squared plane distances.
+		float a00, a11, a22, a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float weight;
+	};
+
+	void addPlane(Quadric& q, const float* n, float d, float weight)
+	{
+		q.a00 += weight * n[0] * n[0];
+		q.a11 += weight * n[1] * n[1];
+		q.a22 += weight * n[2] * n[2];
+		q.a10 += weight * n[1] * n[0];
+		q.a20 += weight * n[2] * n[0];
+		q.a21 += weight * n[2] * n[1];
+		q.b0 += weight * n[0] * d;
+		q.b1 += weight * n[1] * d;
+		q.b2 += weight * n[2] * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	void addQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+		q.a10 += other.a10; q.a20 += other.a20; q.a21 += other.a21;
+		q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// Weighted mean squared distance of v to the quadric's planes.
+	float evaluate(const Quadric& q, const float* v)
+	{
+		float x = v[0], y = v[1], z = v[2];
+		float r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+			+ 2.0f * (q.a10 * x * y + q.a20 * x * z + q.a21 * y * z)
+			+ 2.0f * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+		return std::fabs(r) / (q.weight > 0.0f ? q.weight : 1.0f);
+	}
+
+	void sub(float* r, const float* a, const float* b)
+	{
+		r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2];
+	}
+
+	void cross(float* r, const float* a, const float* b)
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	float normalize(float* v)
+	{
+		float length = std::sqrt(dot(v, v));
+		if (length > 0.0f) {
+			v[0] /= length; v[1] /= length; v[2] /= length;
+		}
+		return length;
+	}
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	struct PositionKey
+	{
+		uint32_t bits[3];
+
+		bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			uint32_t h = key.bits[0] * 73856093u ^ key.bits[1] * 19349663u ^ key.bits[2] * 83492791u;
+			return static_cast<size_t>(h);
+		}
+	};
+
+	struct DirectedEdge
+	{
+		uint32_t count;
+		uint32_t from;	// vertex indices of the first triangle using the edge
+		uint32_t to;
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float error;
+	};
+}
+
+float simplifyMesh(std::vector<uint32_t>& dst, const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t vertexCount, size_t positionStride,
+	size_t targetIndexCount, float targetError)
+{
+	dst.assign(indices, indices + indexCount);
+	if (indexCount <= targetIndexCount || vertexCount == 0)
+		return 0.0f;
+
+	auto vertexPosition = [&](size_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+	};
+
+	// Weld vertices by exact position and normalize into a unit cube to keep quadrics in range.
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	std::vector<uint32_t> positionOf(vertexCount);
+	std::vector<float> points;
+	std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positionIds;
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		const float* p = vertexPosition(v);
+
+		PositionKey key;
+		std::memcpy(key.bits, p, sizeof(key.bits));
+
+		auto inserted = positionIds.emplace(key, static_cast<uint32_t>(points.size() / 3));
+		if (inserted.second) {
+			points.insert(points.end(), p, p + 3);
+			for (int i = 0; i < 3; i++) {
+				minimum[i] = std::min(minimum[i], p[i]);
+				maximum[i] = std::max(maximum[i], p[i]);
+			}
+		}
+		positionOf[v] = inserted.first->second;
+	}
+
+	const uint32_t positionCount = static_cast<uint32_t>(points.size() / 3);
+	const float extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+	const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+	for (uint32_t p = 0; p < positionCount; p++) {
+		for (int i = 0; i < 3; i++)
+			points[p * 3 + i] = (points[p * 3 + i] - minimum[i]) * scale;
+	}
+
+	auto point = [&](uint32_t position) { return &points[position * 3]; };
+
+	std::unordered_map<uint64_t, DirectedEdge> edges;
+	auto buildEdges = [&]() {
+		edges.clear();
+		for (size_t i = 0; i < dst.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = dst[i + k], b = dst[i + (k + 1) % 3];
+				DirectedEdge& edge = edges[edgeKey(positionOf[a], positionOf[b])];
+				if (edge.count++ == 0) {
+					edge.from = a;
+					edge.to = b;
+				}
+			}
+		}
+	};
+
+	auto isBorderEdge = [&](uint32_t pa, uint32_t pb) {
+		bool forward = edges.count(edgeKey(pa, pb)) != 0;
+		bool backward = edges.count(edgeKey(pb, pa)) != 0;
+		return forward != backward;
+	};
+
+	// Classify positions: border vertices may only slide along their border, and vertices where
+	// the topology is too complex to reason about (non-manifold edges, border junctions) stay put.
+	buildEdges();
+
+	std::vector<uint8_t> locked(positionCount, 0);
+	std::vector<uint8_t> border(positionCount, 0);
+	std::vector<uint32_t> borderEdgeCount(positionCount, 0);
+
+	std::vector<Quadric> quadrics(positionCount, Quadric{});
+
+	for (const auto& entry : edges) {
+		uint32_t pa = static_cast<uint32_t>(entry.first >> 32);
+		uint32_t pb = static_cast<uint32_t>(entry.first & 0xffffffff);
+
+		if (entry.second.count > 1)
+			locked[pa] = locked[pb] = 1;
+
+		auto reverse = edges.find(edgeKey(pb, pa));
+		if (reverse == edges.end()) {
+			borderEdgeCount[pa]++;
+			borderEdgeCount[pb]++;
+		}
+	}
+
+	for (uint32_t p = 0; p < positionCount; p++) {
+		if (borderEdgeCount[p] == 2)
+			border[p] = 1;
+		else if (borderEdgeCount[p] != 0)
+			locked[p] = 1;
+	}
+
+	for (size_t i = 0; i < dst.size(); i += 3) {
+		uint32_t p[3] = { positionOf[dst[i]], positionOf[dst[i + 1]], positionOf[dst[i + 2]] };
+
+		float e1[3], e2[3], normal[3];
+		sub(e1, point(p[1]), point(p[0]));
+		sub(e2, point(p[2]), point(p[0]));
+		cross(normal, e1, e2);
+
+		float area = 0.5f * normalize(normal);
+		float d = -dot(normal, point(p[0]));
+
+		for (int k = 0; k < 3; k++)
+			addPlane(quadrics[p[k]], normal, d, area);
+
+		// Open borders and UV seams get an extra plane through the edge, perpendicular to the face.
+		for (int k = 0; k < 3; k++) {
+			uint32_t a = dst[i + k], b = dst[i + (k + 1) % 3];
+			uint32_t pa = positionOf[a], pb = positionOf[b];
+
+			auto reverse = edges.find(edgeKey(pb, pa));
+			bool constrained = reverse == edges.end() || reverse->second.from != b || reverse->second.to != a;
+			if (!constrained)
+				continue;
+
+			float edge[3], planeNormal[3];
+			sub(edge, point(pb), point(pa));
+			float length = normalize(edge);
+			cross(planeNormal, edge, normal);
+			normalize(planeNormal);
+
+			float planeD = -dot(planeNormal, point(pa));
+			addPlane(quadrics[pa], planeNormal, planeD, EDGE_WEIGHT * length * length);
+			addPlane(quadrics[pb], planeNormal, planeD, EDGE_WEIGHT * length * length);
+		}
+	}
+
+	const float errorLimit = (targetError * scale) * (targetError * scale);
+	float resultError = 0.0f;
+
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> vertexRemap(vertexCount);
+	std::vector<uint8_t> touched(positionCount);
+	std::vector<Collapse> collapses;
+	std::vector<std::pair<uint32_t, uint32_t>> vertexPairs;
+
+	auto canMove = [&](uint32_t from, uint32_t to) {
+		if (locked[from])
+			return false;
+		return !border[from] || isBorderEdge(from, to);
+	};
+
+	// Checks that the collapse keeps the surface oriented and that every vertex at `from` has a
+	// unique counterpart at `to`; fills vertexPairs with that mapping.
+	auto validateCollapse = [&](uint32_t from, uint32_t to) {
+		vertexPairs.clear();
+
+		for (uint32_t t = adjacencyOffsets[from]; t < adjacencyOffsets[from + 1]; t++) {
+			const uint32_t* triangle = &dst[adjacency[t] * 3];
+
+			int corner = -1, target = -1;
+			for (int k = 0; k < 3; k++) {
+				if (positionOf[triangle[k]] == from)
+					corner = k;
+				else if (positionOf[triangle[k]] == to)
+					target = k;
+			}
+
+			if (target >= 0) {
+				vertexPairs.emplace_back(triangle[corner], triangle[target]);
+				continue;
+			}
+
+			const float* a = point(positionOf[triangle[(corner + 1) % 3]]);
+			const float* b = point(positionOf[triangle[(corner + 2) % 3]]);
+
+			float e1[3], e2[3], before[3], after[3];
+			sub(e1, a, point(from));
+			sub(e2, b, point(from));
+			cross(before, e1, e2);
+			sub(e1, a, point(to));
+			sub(e2, b, point(to));
+			cross(after, e1, e2);
+
+			if (dot(before, after) <= 0.0f)
+				return false;
+		}
+
+		std::sort(vertexPairs.begin(), vertexPairs.end());
+		vertexPairs.erase(std::unique(vertexPairs.begin(), vertexPairs.end()), vertexPairs.end());
+
+		for (size_t i = 1; i < vertexPairs.size(); i++) {
+			if (vertexPairs[i].first == vertexPairs[i - 1].first)
+				return false;
+		}
+
+		for (uint32_t t = adjacencyOffsets[from]; t < adjacencyOffsets[from + 1]; t++) {
+			const uint32_t* triangle = &dst[adjacency[t] * 3];
+			for (int k = 0; k < 3; k++) {
+				if (positionOf[triangle[k]] != from)
+					continue;
+
+				auto pair = std::lower_bound(vertexPairs.begin(), vertexPairs.end(), std::make_pair(triangle[k], 0u));
+				if (pair == vertexPairs.end() || pair->first != triangle[k])
+					return false;
+			}
+		}
+
+		return !vertexPairs.empty();
+	};
+
+	while (dst.size() > targetIndexCount) {
+		const uint32_t triangleCount = static_cast<uint32_t>(dst.size() / 3);
+
+		adjacencyOffsets.assign(positionCount + 1, 0);
+		for (uint32_t index : dst)
+			adjacencyOffsets[positionOf[index] + 1]++;
+		for (uint32_t p = 0; p < positionCount; p++)
+			adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+
+		adjacency.resize(dst.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[positionOf[dst[t * 3 + k]]]++] = t;
+		}
+
+		buildEdges();
+
+		collapses.clear();
+		for (const auto& entry : edges) {
+			uint32_t pa = static_cast<uint32_t>(entry.first >> 32);
+			uint32_t pb = static_cast<uint32_t>(entry.first & 0xffffffff);
+
+			// Interior edges appear in both directions; consider each once.
+			if (pa > pb && edges.count(edgeKey(pb, pa)) != 0)
+				continue;
+
+			Quadric combined = quadrics[pa];
+			addQuadric(combined, quadrics[pb]);
+
+			float errorAB = canMove(pa, pb) ? evaluate(combined, point(pb)) : FLT_MAX;
+			float errorBA = canMove(pb, pa) ? evaluate(combined, point(pa)) : FLT_MAX;
+
+			if (errorAB == FLT_MAX && errorBA == FLT_MAX)
+				continue;
+
+			if (errorAB <= errorBA)
+				collapses.push_back({ pa, pb, errorAB });
+			else
+				collapses.push_back({ pb, pa, errorBA });
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		std::iota(vertexRemap.begin(), vertexRemap.end(), 0u);
+		std::fill(touched.begin(), touched.end(), 0);
+
+		uint32_t trianglesLeft = triangleCount;
+		uint32_t collapsed = 0;
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.error > errorLimit || trianglesLeft * 3 <= targetIndexCount)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			if (!validateCollapse(collapse.from, collapse.to))
+				continue;
+
+			for (const auto& pair : vertexPairs)
+				vertexRemap[pair.first] = pair.second;
+
+			// Neighbours keep their triangles unchanged until the next pass rebuilds adjacency.
+			for (uint32_t t = adjacencyOffsets[collapse.from]; t < adjacencyOffsets[collapse.from + 1]; t++) {
+				const uint32_t* triangle = &dst[adjacency[t] * 3];
+				bool removed = false;
+				for (int k = 0; k < 3; k++) {
+					touched[positionOf[triangle[k]]] = 1;
+					removed |= positionOf[triangle[k]] == collapse.to;
+				}
+				trianglesLeft -= removed ? 1 : 0;
+			}
+
+			addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			resultError = std::max(resultError, collapse.error);
+			collapsed++;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t i = 0; i < dst.size(); i += 3) {
+			uint32_t a = vertexRemap[dst[i]], b = vertexRemap[dst[i + 1]], c = vertexRemap[dst[i + 2]];
+			uint32_t pa = positionOf[a], pb = positionOf[b], pc = positionOf[c];
+			if (pa == pb || pb == pc || pc == pa)
+				continue;
+
+			dst[write++] = a;
+			dst[write++] = b;
+			dst[write++] = c;
+		}
+		dst.resize(write);
+	}
+
+	return std::sqrt(resultError) / scale;
+}
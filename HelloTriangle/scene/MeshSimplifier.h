@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadric-error mesh simplification (Garland & Heckbert) that only collapses edges onto existing
+// vertices, so the simplified index list references the same vertex buffer as the source.
+//
+// Vertices are grouped by position: a collapse moves every vertex at one position onto the
+// matching vertex at the other, which keeps UV seams and open borders from tearing.
+//
+// positions points at the first vertex's xyz floats, positionStride bytes apart. Simplification
+// stops once at most targetIndexCount indices remain or the next collapse would move the surface
+// further than targetError (in the same units as the positions). The result is written to dst
+// and the largest error introduced is returned.
+float simplifyMesh(std::vector<uint32_t>& dst, const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t vertexCount, size_t positionStride,
+	size_t targetIndexCount, float targetError);
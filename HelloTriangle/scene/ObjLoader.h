@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reads the triangles of every shape in an OBJ file, appending them to vertices and indices.
+// Identical vertices within the file are stored once; indices are absolute positions in
+// vertices. Texture coordinates are flipped to Vulkan's top-left origin and colors are white.
+// Throws with the loader's message if the file can't be read.
+void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// The same, from the file's contents already in memory. Material libraries it names aren't read.
+void loadObj(const std::vector<char>& data, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,331 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static Aabb combine(const Aabb& a, const Aabb& b)
+{
+	Aabb result = a;
+	result.expand(b);
+	return result;
+}
+
+SceneBvh::SceneBvh(float margin) : m_margin{ margin }
+{
+}
+
+uint32_t SceneBvh::allocateNode()
+{
+	uint32_t node;
+	if (m_freeList != NULL_NODE) {
+		node = m_freeList;
+		m_freeList = m_nodes[node].parent;
+	}
+	else {
+		node = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	m_nodes[node].parent = NULL_NODE;
+	m_nodes[node].child1 = NULL_NODE;
+	m_nodes[node].child2 = NULL_NODE;
+	m_nodes[node].height = 0;
+	m_nodes[node].userData = 0;
+	return node;
+}
+
+void SceneBvh::freeNode(uint32_t node)
+{
+	m_nodes[node].parent = m_freeList;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+}
+
+uint32_t SceneBvh::insert(const Aabb& bounds, uint32_t userData)
+{
+	uint32_t proxy = allocateNode();
+
+	Node& leaf = m_nodes[proxy];
+	for (int i = 0; i < 3; i++) {
+		leaf.box.min[i] = bounds.min[i] - m_margin;
+		leaf.box.max[i] = bounds.max[i] + m_margin;
+	}
+	leaf.userData = userData;
+
+	insertLeaf(proxy);
+	m_objectCount++;
+	return proxy;
+}
+
+void SceneBvh::remove(uint32_t proxy)
+{
+	if (proxy >= m_nodes.size() || !m_nodes[proxy].isLeaf() || m_nodes[proxy].height < 0)
+		throw std::invalid_argument("SceneBvh: invalid proxy!");
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+	m_objectCount--;
+}
+
+bool SceneBvh::move(uint32_t proxy, const Aabb& bounds)
+{
+	if (m_nodes[proxy].box.contains(bounds))
+		return false;
+
+	removeLeaf(proxy);
+
+	Node& leaf = m_nodes[proxy];
+	for (int i = 0; i < 3; i++) {
+		leaf.box.min[i] = bounds.min[i] - m_margin;
+		leaf.box.max[i] = bounds.max[i] + m_margin;
+	}
+
+	insertLeaf(proxy);
+	return true;
+}
+
+void SceneBvh::insertLeaf(uint32_t leaf)
+{
+	if (m_root == NULL_NODE) {
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// Descend towards the sibling that increases total surface area the least.
+	const Aabb leafBox = m_nodes[leaf].box;
+	uint32_t index = m_root;
+	while (!m_nodes[index].isLeaf()) {
+		const Node& node = m_nodes[index];
+
+		float area = node.box.surfaceArea();
+		float combinedArea = combine(node.box, leafBox).surfaceArea();
+
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](uint32_t child) {
+			const Node& c = m_nodes[child];
+			float newArea = combine(leafBox, c.box).surfaceArea();
+			return (c.isLeaf() ? newArea : newArea - c.box.surfaceArea()) + inheritanceCost;
+		};
+
+		float cost1 = descendCost(node.child1);
+		float cost2 = descendCost(node.child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = m_nodes[sibling].parent;
+	uint32_t newParent = allocateNode();
+
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].box = combine(leafBox, m_nodes[sibling].box);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_NODE) {
+		if (m_nodes[oldParent].child1 == sibling)
+			m_nodes[oldParent].child1 = newParent;
+		else
+			m_nodes[oldParent].child2 = newParent;
+	}
+	else {
+		m_root = newParent;
+	}
+
+	refitAncestors(newParent);
+}
+
+void SceneBvh::removeLeaf(uint32_t leaf)
+{
+	if (leaf == m_root) {
+		m_root = NULL_NODE;
+		return;
+	}
+
+	uint32_t parent = m_nodes[leaf].parent;
+	uint32_t grandParent = m_nodes[parent].parent;
+	uint32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != NULL_NODE) {
+		if (m_nodes[grandParent].child1 == parent)
+			m_nodes[grandParent].child1 = sibling;
+		else
+			m_nodes[grandParent].child2 = sibling;
+
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		refitAncestors(grandParent);
+	}
+	else {
+		m_root = sibling;
+		m_nodes[sibling].parent = NULL_NODE;
+		freeNode(parent);
+	}
+}
+
+void SceneBvh::refitAncestors(uint32_t index)
+{
+	while (index != NULL_NODE) {
+		index = balance(index);
+
+		Node& node = m_nodes[index];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.box = combine(child1.box, child2.box);
+
+		index = node.parent;
+	}
+}
+
+uint32_t SceneBvh::balance(uint32_t iA)
+{
+	Node& A = m_nodes[iA];
+	if (A.isLeaf() || A.height < 2)
+		return iA;
+
+	uint32_t iB = A.child1;
+	uint32_t iC = A.child2;
+	Node& B = m_nodes[iB];
+	Node& C = m_nodes[iC];
+
+	int32_t balance = C.height - B.height;
+	if (balance >= -1 && balance <= 1)
+		return iA;
+
+	// Promote the taller child: it takes A's place and A adopts one of its children.
+	uint32_t iUp = balance > 1 ? iC : iB;
+	Node& up = m_nodes[iUp];
+	Node& other = balance > 1 ? B : C;
+
+	uint32_t iF = up.child1;
+	uint32_t iG = up.child2;
+	Node& F = m_nodes[iF];
+	Node& G = m_nodes[iG];
+
+	up.child1 = iA;
+	up.parent = A.parent;
+	A.parent = iUp;
+
+	if (up.parent != NULL_NODE) {
+		if (m_nodes[up.parent].child1 == iA)
+			m_nodes[up.parent].child1 = iUp;
+		else
+			m_nodes[up.parent].child2 = iUp;
+	}
+	else {
+		m_root = iUp;
+	}
+
+	// The taller grandchild stays with the promoted node, the shorter one moves under A.
+	uint32_t iKeep = F.height > G.height ? iF : iG;
+	uint32_t iMove = F.height > G.height ? iG : iF;
+	Node& keep = m_nodes[iKeep];
+	Node& moved = m_nodes[iMove];
+
+	up.child2 = iKeep;
+	if (balance > 1)
+		A.child2 = iMove;
+	else
+		A.child1 = iMove;
+	moved.parent = iA;
+
+	A.box = combine(other.box, moved.box);
+	A.height = 1 + std::max(other.height, moved.height);
+	up.box = combine(A.box, keep.box);
+	up.height = 1 + std::max(A.height, keep.height);
+
+	return iUp;
+}
+
+void SceneBvh::collectSubtree(uint32_t root, std::vector<uint32_t>& visible, CullStats& stats) const
+{
+	size_t base = m_stack.size();
+	m_stack.push_back(root);
+
+	while (m_stack.size() > base) {
+		uint32_t index = m_stack.back();
+		m_stack.pop_back();
+
+		const Node& node = m_nodes[index];
+		if (node.isLeaf()) {
+			visible.push_back(node.userData);
+			stats.visible++;
+		}
+		else {
+			m_stack.push_back(node.child1);
+			m_stack.push_back(node.child2);
+		}
+	}
+}
+
+void SceneBvh::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible, CullStats& stats) const
+{
+	stats = {};
+	if (m_root == NULL_NODE)
+		return;
+
+	// Leaves reached through partially visible nodes are tested four at a time.
+	const Aabb* pending[4];
+	uint32_t pendingData[4];
+	uint32_t pendingCount = 0;
+
+	auto flush = [&]() {
+		for (uint32_t i = pendingCount; i < 4; i++)
+			pending[i] = pending[0];
+
+		uint32_t mask = frustum.testVisible4(pending) & ((1u << pendingCount) - 1);
+		for (uint32_t i = 0; i < pendingCount; i++) {
+			if (mask & (1u << i)) {
+				visible.push_back(pendingData[i]);
+				stats.visible++;
+			}
+		}
+
+		stats.tested += pendingCount;
+		pendingCount = 0;
+	};
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (!m_stack.empty()) {
+		uint32_t index = m_stack.back();
+		m_stack.pop_back();
+
+		const Node& node = m_nodes[index];
+		if (node.isLeaf()) {
+			pending[pendingCount] = &node.box;
+			pendingData[pendingCount] = node.userData;
+			if (++pendingCount == 4)
+				flush();
+			continue;
+		}
+
+		stats.tested++;
+		Frustum::Result result = frustum.test(node.box);
+
+		if (result == Frustum::Result::Inside) {
+			collectSubtree(index, visible, stats);
+		}
+		else if (result == Frustum::Result::Intersecting) {
+			m_stack.push_back(node.child1);
+			m_stack.push_back(node.child2);
+		}
+	}
+
+	if (pendingCount > 0)
+		flush();
+
+	stats.culled = m_objectCount - stats.visible;
+}
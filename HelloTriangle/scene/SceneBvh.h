@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Frustum.h"
+
+#include <cstdint>
+#include <vector>
+
+// Dynamic bounding-volume hierarchy over scene objects.
+//
+// Leaves hold bounds enlarged by a margin so that small movements don't touch the tree, and
+// insertions pick siblings by surface-area cost with AVL-style rotations to keep it balanced.
+class SceneBvh
+{
+public:
+	static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+public:
+	explicit SceneBvh(float margin = 0.05f);
+
+	// Returns a proxy handle identifying the object's leaf.
+	uint32_t insert(const Aabb& bounds, uint32_t userData);
+	void remove(uint32_t proxy);
+
+	// Updates the object's bounds, returns true if its leaf had to be reinserted.
+	bool move(uint32_t proxy, const Aabb& bounds);
+
+	uint32_t userData(uint32_t proxy) const { return m_nodes[proxy].userData; }
+	uint32_t objectCount() const { return m_objectCount; }
+	uint32_t height() const { return m_root == NULL_NODE ? 0 : static_cast<uint32_t>(m_nodes[m_root].height); }
+
+	// Appends the user data of every object that intersects the frustum to visible.
+	void cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible, CullStats& stats) const;
+
+private:
+	struct Node
+	{
+		Aabb box;
+		uint32_t parent;	// next free node while on the free list
+		uint32_t child1;
+		uint32_t child2;
+		int32_t height;		// -1 while on the free list
+		uint32_t userData;
+
+		bool isLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	std::vector<Node> m_nodes;
+	uint32_t m_root = NULL_NODE;
+	uint32_t m_freeList = NULL_NODE;
+	uint32_t m_objectCount = 0;
+	float m_margin;
+
+	mutable std::vector<uint32_t> m_stack;
+
+private:
+	uint32_t allocateNode();
+	void freeNode(uint32_t node);
+
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	void refitAncestors(uint32_t node);
+	uint32_t balance(uint32_t node);
+
+	void collectSubtree(uint32_t node, std::vector<uint32_t>& visible, CullStats& stats) const;
+};
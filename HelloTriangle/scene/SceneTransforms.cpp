@@ -0,0 +1,429 @@
+#include "SceneTransforms.h"
+
+#include "../core/WorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_TRANSFORMS_SSE 1
+#include <emmintrin.h>
+#endif
+
+// The AVX path is compiled into every x86 build and picked at run time, so the executable still
+// starts on CPUs without it. GCC and Clang need the target attribute to emit AVX in one function;
+// MSVC allows the intrinsics anywhere.
+#if defined(SCENE_TRANSFORMS_SSE) && (defined(_MSC_VER) || defined(__GNUC__))
+#define SCENE_TRANSFORMS_AVX 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SCENE_TRANSFORMS_TARGET_AVX
+#else
+#define SCENE_TRANSFORMS_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+static bool cpuHasAvx()
+{
+#if defined(_MSC_VER)
+	// AVX needs the instructions and the OS saving the YMM registers (XCR0 bits 1 and 2).
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx");
+#endif
+}
+
+static const bool s_useAvx = cpuHasAvx();
+#endif
+
+uint32_t SceneTransforms::addNode(uint32_t parent)
+{
+	uint32_t node = static_cast<uint32_t>(m_slotOfNode.size());
+	uint32_t slot = static_cast<uint32_t>(m_parents.size());
+
+	uint32_t parentSlot = NO_PARENT;
+	uint32_t depth = 0;
+	if (parent != NO_PARENT) {
+		if (parent >= node)
+			throw std::out_of_range("SceneTransforms: parent node does not exist!");
+
+		parentSlot = m_slotOfNode[parent];
+		depth = m_depths[parentSlot] + 1;
+	}
+
+	m_posX.push_back(0.0f); m_posY.push_back(0.0f); m_posZ.push_back(0.0f);
+	m_rotX.push_back(0.0f); m_rotY.push_back(0.0f); m_rotZ.push_back(0.0f); m_rotW.push_back(1.0f);
+	m_scaleX.push_back(1.0f); m_scaleY.push_back(1.0f); m_scaleZ.push_back(1.0f);
+	m_parents.push_back(parentSlot);
+	m_depths.push_back(depth);
+	m_nodeOfSlot.push_back(node);
+	m_slotOfNode.push_back(slot);
+
+	m_sorted = false;
+	return node;
+}
+
+void SceneTransforms::clear()
+{
+	m_posX.clear(); m_posY.clear(); m_posZ.clear();
+	m_rotX.clear(); m_rotY.clear(); m_rotZ.clear(); m_rotW.clear();
+	m_scaleX.clear(); m_scaleY.clear(); m_scaleZ.clear();
+	m_parents.clear();
+	m_depths.clear();
+	m_nodeOfSlot.clear();
+	m_slotOfNode.clear();
+	m_levelOffsets.clear();
+	m_world.clear();
+	m_sorted = true;
+}
+
+void SceneTransforms::setPosition(uint32_t node, float x, float y, float z)
+{
+	uint32_t slot = m_slotOfNode[node];
+	m_posX[slot] = x;
+	m_posY[slot] = y;
+	m_posZ[slot] = z;
+}
+
+void SceneTransforms::setRotation(uint32_t node, float x, float y, float z, float w)
+{
+	uint32_t slot = m_slotOfNode[node];
+	m_rotX[slot] = x;
+	m_rotY[slot] = y;
+	m_rotZ[slot] = z;
+	m_rotW[slot] = w;
+}
+
+void SceneTransforms::setScale(uint32_t node, float x, float y, float z)
+{
+	uint32_t slot = m_slotOfNode[node];
+	m_scaleX[slot] = x;
+	m_scaleY[slot] = y;
+	m_scaleZ[slot] = z;
+}
+
+uint32_t SceneTransforms::worldIndex(uint32_t node)
+{
+	if (!m_sorted)
+		sortByDepth();
+
+	return m_slotOfNode[node];
+}
+
+const float* SceneTransforms::worldMatrix(uint32_t node)
+{
+	return &m_world[16 * static_cast<size_t>(worldIndex(node))];
+}
+
+void SceneTransforms::sortByDepth()
+{
+	const uint32_t count = size();
+
+	uint32_t maxDepth = 0;
+	for (uint32_t depth : m_depths)
+		maxDepth = std::max(maxDepth, depth);
+
+	// Stable counting sort keeps siblings in insertion order.
+	m_levelOffsets.assign(count > 0 ? maxDepth + 2 : 0, 0);
+	for (uint32_t depth : m_depths)
+		m_levelOffsets[depth + 1]++;
+	for (size_t i = 1; i < m_levelOffsets.size(); i++)
+		m_levelOffsets[i] += m_levelOffsets[i - 1];
+
+	std::vector<uint32_t> newSlot(count);
+	std::vector<uint32_t> cursor(m_levelOffsets.begin(), m_levelOffsets.end());
+	for (uint32_t slot = 0; slot < count; slot++)
+		newSlot[slot] = cursor[m_depths[slot]]++;
+
+	auto permute = [&](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (uint32_t slot = 0; slot < count; slot++)
+			sorted[newSlot[slot]] = values[slot];
+		values.swap(sorted);
+	};
+
+	permute(m_posX); permute(m_posY); permute(m_posZ);
+	permute(m_rotX); permute(m_rotY); permute(m_rotZ); permute(m_rotW);
+	permute(m_scaleX); permute(m_scaleY); permute(m_scaleZ);
+	permute(m_depths);
+	permute(m_nodeOfSlot);
+	permute(m_parents);
+
+	for (uint32_t& parent : m_parents) {
+		if (parent != NO_PARENT)
+			parent = newSlot[parent];
+	}
+
+	for (uint32_t slot = 0; slot < count; slot++)
+		m_slotOfNode[m_nodeOfSlot[slot]] = slot;
+
+	m_world.assign(16 * static_cast<size_t>(count), 0.0f);
+	m_sorted = true;
+}
+
+void SceneTransforms::updateWorldMatrices(float* dst, WorkerPool* pool)
+{
+	if (!m_sorted)
+		sortByDepth();
+
+	uint32_t threadCount = pool ? pool->threadCount() : 1;
+
+	for (uint32_t level = 0; level + 1 < m_levelOffsets.size(); level++) {
+		uint32_t begin = m_levelOffsets[level];
+		uint32_t end = m_levelOffsets[level + 1];
+		uint32_t count = end - begin;
+
+		if (threadCount == 1 || count < PARALLEL_MIN_NODES) {
+			updateRange(dst, begin, end);
+			continue;
+		}
+
+		// Nodes within one level never depend on each other, so the level is split into
+		// 8-aligned chunks, one per thread.
+		uint32_t chunk = ((count + threadCount - 1) / threadCount + 7) & ~7u;
+		uint32_t chunkCount = (count + chunk - 1) / chunk;
+		pool->run(chunkCount, [&](uint32_t job) {
+			uint32_t chunkBegin = begin + job * chunk;
+			updateRange(dst, chunkBegin, std::min(chunkBegin + chunk, end));
+		});
+	}
+}
+
+void SceneTransforms::updateSingle(float* dst, uint32_t slot)
+{
+	float x = m_rotX[slot], y = m_rotY[slot], z = m_rotZ[slot], w = m_rotW[slot];
+	float sx = m_scaleX[slot], sy = m_scaleY[slot], sz = m_scaleZ[slot];
+
+	float local[16] = {
+		(1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f,
+		2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f,
+		2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f,
+		m_posX[slot], m_posY[slot], m_posZ[slot], 1.0f
+	};
+
+	float* world = &m_world[16 * static_cast<size_t>(slot)];
+	uint32_t parent = m_parents[slot];
+
+	if (parent == NO_PARENT) {
+		memcpy(world, local, sizeof(local));
+	}
+	else {
+		const float* p = &m_world[16 * static_cast<size_t>(parent)];
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				world[c * 4 + r] = p[r] * local[c * 4] + p[4 + r] * local[c * 4 + 1] + p[8 + r] * local[c * 4 + 2] + p[12 + r] * local[c * 4 + 3];
+			}
+		}
+	}
+
+	memcpy(dst + 16 * static_cast<size_t>(slot), world, sizeof(local));
+}
+
+#ifdef SCENE_TRANSFORMS_SSE
+void SceneTransforms::updateRange(float* dst, uint32_t begin, uint32_t end)
+{
+#ifdef SCENE_TRANSFORMS_AVX
+	if (s_useAvx) {
+		updateRangeAvx(dst, begin, end);
+		return;
+	}
+#endif
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// Mapped device memory is normally write-combined; streaming stores avoid polluting the cache.
+	const bool streamToDst = (reinterpret_cast<uintptr_t>(dst) & 15) == 0;
+
+	uint32_t slot = begin;
+	for (; slot + 4 <= end; slot += 4) {
+		__m128 x = _mm_loadu_ps(&m_rotX[slot]);
+		__m128 y = _mm_loadu_ps(&m_rotY[slot]);
+		__m128 z = _mm_loadu_ps(&m_rotZ[slot]);
+		__m128 w = _mm_loadu_ps(&m_rotW[slot]);
+		__m128 sx = _mm_loadu_ps(&m_scaleX[slot]);
+		__m128 sy = _mm_loadu_ps(&m_scaleY[slot]);
+		__m128 sz = _mm_loadu_ps(&m_scaleZ[slot]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// Each register holds one matrix element for four nodes: TRS with the scale folded in.
+		__m128 m[4][4];
+		m[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		m[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		m[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		m[0][3] = zero;
+		m[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		m[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		m[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		m[1][3] = zero;
+		m[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		m[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		m[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		m[2][3] = zero;
+		m[3][0] = _mm_loadu_ps(&m_posX[slot]);
+		m[3][1] = _mm_loadu_ps(&m_posY[slot]);
+		m[3][2] = _mm_loadu_ps(&m_posZ[slot]);
+		m[3][3] = one;
+
+		// Transpose back to one column per register and node.
+		for (int c = 0; c < 4; c++)
+			_MM_TRANSPOSE4_PS(m[c][0], m[c][1], m[c][2], m[c][3]);
+
+		for (uint32_t k = 0; k < 4; k++) {
+			float* world = &m_world[16 * static_cast<size_t>(slot + k)];
+			uint32_t parent = m_parents[slot + k];
+
+			__m128 col[4] = { m[0][k], m[1][k], m[2][k], m[3][k] };
+
+			if (parent != NO_PARENT) {
+				const float* p = &m_world[16 * static_cast<size_t>(parent)];
+				__m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8), p3 = _mm_loadu_ps(p + 12);
+
+				// Local matrices are affine, so the w row only contributes to the translation column.
+				for (int c = 0; c < 4; c++) {
+					__m128 v = col[c];
+					__m128 r = _mm_mul_ps(p0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+					r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+					r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+					col[c] = c == 3 ? _mm_add_ps(r, p3) : r;
+				}
+			}
+
+			float* out = dst + 16 * static_cast<size_t>(slot + k);
+			for (int c = 0; c < 4; c++) {
+				_mm_storeu_ps(world + 4 * c, col[c]);
+				if (streamToDst)
+					_mm_stream_ps(out + 4 * c, col[c]);
+				else
+					_mm_storeu_ps(out + 4 * c, col[c]);
+			}
+		}
+	}
+
+	for (; slot < end; slot++)
+		updateSingle(dst, slot);
+
+	// Streaming stores are weakly ordered and this may be a worker thread, so each range fences
+	// its own before the frame's submit can read them.
+	if (streamToDst)
+		_mm_sfence();
+}
+#else
+void SceneTransforms::updateRange(float* dst, uint32_t begin, uint32_t end)
+{
+	for (uint32_t slot = begin; slot < end; slot++)
+		updateSingle(dst, slot);
+}
+#endif
+
+#ifdef SCENE_TRANSFORMS_AVX
+// Same as the SSE path, eight nodes at a time. The parent multiply works on two columns per
+// register: _mm256_permute_ps broadcasts within each 128-bit half, so one shuffle splats an
+// element of both columns.
+SCENE_TRANSFORMS_TARGET_AVX void SceneTransforms::updateRangeAvx(float* dst, uint32_t begin, uint32_t end)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	// Every matrix is 64 bytes, so a 32-byte aligned destination keeps each column pair aligned.
+	const bool streamToDst = (reinterpret_cast<uintptr_t>(dst) & 31) == 0;
+
+	uint32_t slot = begin;
+	for (; slot + 8 <= end; slot += 8) {
+		__m256 x = _mm256_loadu_ps(&m_rotX[slot]);
+		__m256 y = _mm256_loadu_ps(&m_rotY[slot]);
+		__m256 z = _mm256_loadu_ps(&m_rotZ[slot]);
+		__m256 w = _mm256_loadu_ps(&m_rotW[slot]);
+		__m256 sx = _mm256_loadu_ps(&m_scaleX[slot]);
+		__m256 sy = _mm256_loadu_ps(&m_scaleY[slot]);
+		__m256 sz = _mm256_loadu_ps(&m_scaleZ[slot]);
+
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		__m256 m[4][4];
+		m[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+		m[0][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		m[0][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		m[0][3] = zero;
+		m[1][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		m[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+		m[1][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		m[1][3] = zero;
+		m[2][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		m[2][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		m[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+		m[2][3] = zero;
+		m[3][0] = _mm256_loadu_ps(&m_posX[slot]);
+		m[3][1] = _mm256_loadu_ps(&m_posY[slot]);
+		m[3][2] = _mm256_loadu_ps(&m_posZ[slot]);
+		m[3][3] = one;
+
+		for (uint32_t half = 0; half < 2; half++) {
+			// Lanes 0-3 hold nodes slot..slot+3, lanes 4-7 the next four.
+			__m128 q[4][4];
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++)
+					q[c][r] = half == 0 ? _mm256_castps256_ps128(m[c][r]) : _mm256_extractf128_ps(m[c][r], 1);
+				_MM_TRANSPOSE4_PS(q[c][0], q[c][1], q[c][2], q[c][3]);
+			}
+
+			for (uint32_t k = 0; k < 4; k++) {
+				uint32_t node = slot + 4 * half + k;
+				float* world = &m_world[16 * static_cast<size_t>(node)];
+				uint32_t parent = m_parents[node];
+
+				__m256 cols[2] = {
+					_mm256_insertf128_ps(_mm256_castps128_ps256(q[0][k]), q[1][k], 1),
+					_mm256_insertf128_ps(_mm256_castps128_ps256(q[2][k]), q[3][k], 1)
+				};
+
+				if (parent != NO_PARENT) {
+					const float* p = &m_world[16 * static_cast<size_t>(parent)];
+					__m256 p0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p));
+					__m256 p1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p + 4));
+					__m256 p2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(p + 8));
+					// Only the translation column picks up the parent's translation.
+					__m256 p3 = _mm256_insertf128_ps(_mm256_setzero_ps(), _mm_loadu_ps(p + 12), 1);
+
+					for (int pair = 0; pair < 2; pair++) {
+						__m256 v = cols[pair];
+						__m256 r = _mm256_mul_ps(p0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+						r = _mm256_add_ps(r, _mm256_mul_ps(p1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+						r = _mm256_add_ps(r, _mm256_mul_ps(p2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+						cols[pair] = pair == 1 ? _mm256_add_ps(r, p3) : r;
+					}
+				}
+
+				float* out = dst + 16 * static_cast<size_t>(node);
+				for (int pair = 0; pair < 2; pair++) {
+					_mm256_storeu_ps(world + 8 * pair, cols[pair]);
+					if (streamToDst)
+						_mm256_stream_ps(out + 8 * pair, cols[pair]);
+					else
+						_mm256_storeu_ps(out + 8 * pair, cols[pair]);
+				}
+			}
+		}
+	}
+
+	for (; slot < end; slot++)
+		updateSingle(dst, slot);
+
+	if (streamToDst)
+		_mm_sfence();
+}
+#endif
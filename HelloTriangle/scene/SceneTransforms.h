@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+// Structure-of-arrays transform storage for the scene hierarchy.
+//
+// Nodes are addressed by the handle returned from addNode(). Internally they are kept sorted
+// by hierarchy depth, so every parent's world matrix is finished before its children are
+// processed and each depth level can be updated in independent SIMD batches and chunks.
+class SceneTransforms
+{
+public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	// Levels with at least this many nodes are split across the worker pool.
+	static constexpr uint32_t PARALLEL_MIN_NODES = 16384;
+
+public:
+	uint32_t addNode(uint32_t parent = NO_PARENT);
+	void clear();
+
+	void setPosition(uint32_t node, float x, float y, float z);
+	void setRotation(uint32_t node, float x, float y, float z, float w);
+	void setScale(uint32_t node, float x, float y, float z);
+
+	// Computes every world matrix and writes them as column-major 4x4 floats (glm layout)
+	// into dst, one matrix per node in world-index order. dst may point at mapped device memory;
+	// it is only ever written to. Without a pool everything runs on the calling thread.
+	void updateWorldMatrices(float* dst, WorkerPool* pool = nullptr);
+
+	// Index of the node's matrix in the array written by updateWorldMatrices().
+	uint32_t worldIndex(uint32_t node);
+
+	// World matrix of the node as computed by the last update.
+	const float* worldMatrix(uint32_t node);
+
+	uint32_t size() const { return static_cast<uint32_t>(m_parents.size()); }
+	uint32_t depthCount() const { return static_cast<uint32_t>(m_levelOffsets.empty() ? 0 : m_levelOffsets.size() - 1); }
+
+private:
+	// Per-slot data, sorted by depth once m_sorted is set.
+	std::vector<float> m_posX, m_posY, m_posZ;
+	std::vector<float> m_rotX, m_rotY, m_rotZ, m_rotW;
+	std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_depths;
+	std::vector<uint32_t> m_nodeOfSlot;
+
+	std::vector<uint32_t> m_slotOfNode;
+	std::vector<uint32_t> m_levelOffsets;
+	std::vector<float> m_world;
+
+	bool m_sorted = true;
+
+private:
+	void sortByDepth();
+	void updateRange(float* dst, uint32_t begin, uint32_t end);
+	void updateRangeAvx(float* dst, uint32_t begin, uint32_t end);
+	void updateSingle(float* dst, uint32_t slot);
+};
@@ -0,0 +1,188 @@
+#include "StressScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static const float PI = 3.14159265358979f;
+static const float GRID_SPACING = 2.0f;	// meshes are about one unit across
+
+static uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// Uniform in [0, 1).
+static float unit(uint32_t h)
+{
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+StressScene::Settings StressScene::preset(const std::string& name)
+{
+	Settings settings;
+	if (name == "small") {
+		settings.objectCount = 1000;
+		settings.meshCount = 16;
+		settings.trianglesPerMesh = 1000;
+		settings.textureCount = 4;
+		settings.textureSize = 256;
+		settings.motion = 0.1f;
+	}
+	else if (name == "medium") {
+		settings.objectCount = 50000;
+		settings.meshCount = 64;
+		settings.trianglesPerMesh = 2000;
+		settings.textureCount = 16;
+		settings.textureSize = 512;
+		settings.motion = 0.1f;
+	}
+	else if (name == "huge") {
+		settings.objectCount = 1000000;
+		settings.meshCount = 256;
+		settings.trianglesPerMesh = 500;
+		settings.textureCount = 64;
+		settings.textureSize = 512;
+		settings.motion = 0.01f;
+	}
+	else {
+		throw std::invalid_argument("unknown stress scene preset: " + name);
+	}
+	return settings;
+}
+
+void StressScene::init(const Settings& settings)
+{
+	if (settings.objectCount == 0 || settings.meshCount == 0 || settings.textureCount == 0)
+		throw std::invalid_argument("StressScene: needs at least one object, mesh and texture!");
+	if (settings.trianglesPerMesh < 8 || settings.textureSize < 4)
+		throw std::invalid_argument("StressScene: needs at least 8 triangles per mesh and 4 pixel textures!");
+	if (!(settings.motion >= 0.0f && settings.motion <= 1.0f))
+		throw std::invalid_argument("StressScene: motion is a share of objects, from 0 to 1!");
+
+	uint32_t tilesPerSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.textureCount))));
+	if (static_cast<uint64_t>(tilesPerSide) * settings.textureSize > MAX_ATLAS_SIZE)
+		throw std::invalid_argument("StressScene: the texture atlas would exceed " + std::to_string(MAX_ATLAS_SIZE) + " pixels!");
+
+	m_settings = settings;
+	m_tilesPerSide = tilesPerSide;
+	m_gridSize = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(settings.objectCount))));
+	while (static_cast<uint64_t>(m_gridSize) * m_gridSize * m_gridSize < settings.objectCount)
+		m_gridSize++;
+}
+
+void StressScene::generateMesh(uint32_t mesh, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const
+{
+	// rings * 2 segments give 4 * rings * (rings - 1) triangles, the poles having one per segment.
+	uint32_t rings = std::max(2u, static_cast<uint32_t>(std::lround(0.5 + 0.5 * std::sqrt(1.0 + m_settings.trianglesPerMesh))));
+	uint32_t segments = 2 * rings;
+
+	uint32_t h = hash(m_settings.seed * 0x9e3779b9u + mesh);
+	float amplitude = 0.05f + 0.2f * unit(h);
+	float ringWaves = static_cast<float>(2 + hash(h + 1) % 5);
+	float segmentWaves = static_cast<float>(2 + hash(h + 2) % 7);
+	float phase = 2.0f * PI * unit(hash(h + 3));
+
+	// Half a texel in from the tile's edges, so bilinear filtering stays inside it.
+	uint32_t tile = mesh % m_settings.textureCount;
+	float inset = 0.5f / m_settings.textureSize;
+	float tileU = static_cast<float>(tile % m_tilesPerSide);
+	float tileV = static_cast<float>(tile / m_tilesPerSide);
+
+	vertices.reserve(vertices.size() + (rings + 1) * (segments + 1));
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		float theta = PI * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			float phi = 2.0f * PI * segment / segments;
+
+			// The ripple fades out towards the poles, where all of a ring's vertices meet.
+			float radius = 0.5f * (1.0f + amplitude * std::sin(theta) * std::sin(ringWaves * theta + phase) * std::sin(segmentWaves * phi));
+
+			Vertex vertex{};
+			vertex.pos = { radius * std::sin(theta) * std::cos(phi), radius * std::sin(theta) * std::sin(phi), radius * std::cos(theta) };
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+			vertex.texCoord = {
+				(tileU + inset + (1.0f - 2.0f * inset) * segment / segments) / m_tilesPerSide,
+				(tileV + inset + (1.0f - 2.0f * inset) * ring / rings) / m_tilesPerSide
+			};
+			vertices.push_back(vertex);
+		}
+	}
+
+	// Counter-clockwise seen from outside.
+	indices.reserve(indices.size() + 6 * rings * segments);
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			uint32_t a = ring * (segments + 1) + segment;
+			uint32_t b = a + segments + 1;
+			if (ring > 0)
+				indices.insert(indices.end(), { a, b + 1, a + 1 });
+			if (ring + 1 < rings)
+				indices.insert(indices.end(), { a, b, b + 1 });
+		}
+	}
+}
+
+void StressScene::generateAtlas(unsigned char* pixels) const
+{
+	uint32_t size = atlasSize();
+	uint32_t tileSize = m_settings.textureSize;
+	uint32_t cellSize = std::max(1u, tileSize / 8);
+
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint32_t tile = (y / tileSize) * m_tilesPerSide + x / tileSize;
+
+			// A checkerboard in two shades of a hue of its own, spread by the golden ratio.
+			float hue = std::fmod(0.618034f * tile, 1.0f) * 6.0f;
+			float rgb[3] = {
+				std::clamp(std::fabs(hue - 3.0f) - 1.0f, 0.0f, 1.0f),
+				std::clamp(2.0f - std::fabs(hue - 2.0f), 0.0f, 1.0f),
+				std::clamp(2.0f - std::fabs(hue - 4.0f), 0.0f, 1.0f)
+			};
+			bool dark = ((x % tileSize) / cellSize + (y % tileSize) / cellSize) % 2 != 0;
+			float shade = dark ? 0.35f : 0.9f;
+
+			unsigned char* pixel = pixels + (static_cast<size_t>(y) * size + x) * 4;
+			for (int channel = 0; channel < 3; channel++)
+				pixel[channel] = static_cast<unsigned char>(255.0f * shade * (0.3f + 0.7f * rgb[channel]));
+			pixel[3] = 255;
+		}
+	}
+}
+
+StressScene::Placement StressScene::place(uint32_t object) const
+{
+	uint32_t h = hash(hash(m_settings.seed) + object);
+	float center = 0.5f * (m_gridSize - 1);
+
+	Placement placement;
+	placement.position[0] = GRID_SPACING * (object % m_gridSize - center + 0.3f * (unit(hash(h + 1)) - 0.5f));
+	placement.position[1] = GRID_SPACING * ((object / m_gridSize) % m_gridSize - center + 0.3f * (unit(hash(h + 2)) - 0.5f));
+	placement.position[2] = GRID_SPACING * (object / (m_gridSize * m_gridSize) - center + 0.3f * (unit(hash(h + 3)) - 0.5f));
+	placement.scale = 0.6f + 0.4f * unit(hash(h + 4));
+	placement.angle = 2.0f * PI * unit(hash(h + 5));
+
+	// Half a radian to two radians a second, either way.
+	placement.spin = 0.0f;
+	if (unit(hash(h + 6)) < m_settings.motion) {
+		uint32_t spin = hash(h + 7);
+		placement.spin = (0.5f + 1.5f * unit(spin)) * ((spin & 1) ? 1.0f : -1.0f);
+	}
+
+	placement.mesh = hash(h + 8) % m_settings.meshCount;
+
+	uint32_t color = hash(h + 9);
+	placement.tint = (128 + (color & 0x7f)) | ((128 + ((color >> 8) & 0x7f)) << 8) | ((128 + ((color >> 16) & 0x7f)) << 16) | (0xffu << 24);
+	return placement;
+}
+
+float StressScene::radius() const
+{
+	return GRID_SPACING * (0.5f * (m_gridSize - 1) * std::sqrt(3.0f) + 1.0f);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Procedural content for scaling tests, in place of the model and texture files: a number of
+// objects placed in a cube around the origin, each drawing one of a set of generated meshes,
+// with a share of them spinning. The meshes and the texture go through the same loading path
+// as the files would, LODs included.
+//
+// Meshes are UV spheres with a different ripple each, subdivided to about the requested
+// triangle count. The renderer binds a single texture, so the textures are tiles of one atlas,
+// with every mesh's texture coordinates mapped into the tile of texture mesh % textureCount.
+// Mip levels of the atlas blend neighbouring tiles at the coarsest levels.
+//
+// Everything is derived from the settings and the seed, so the same settings always give the
+// same scene.
+class StressScene
+{
+public:
+	struct Settings
+	{
+		uint32_t objectCount = 1000;
+		uint32_t meshCount = 16;
+		uint32_t trianglesPerMesh = 1000;
+		uint32_t textureCount = 4;
+		uint32_t textureSize = 256;	// pixels on each side
+		float motion = 0.1f;		// share of objects that spin
+		uint32_t seed = 1;
+	};
+
+	struct Placement
+	{
+		float position[3];
+		float scale;
+		float angle;	// about z, in radians
+		float spin;		// radians per second, 0 for static objects
+		uint32_t mesh;
+		uint32_t tint;	// RGBA8
+	};
+
+	static const uint32_t MAX_ATLAS_SIZE = 8192;
+
+public:
+	StressScene() = default;
+
+	// "small" (1K objects), "medium" (50K) or "huge" (1M). Throws for anything else.
+	static Settings preset(const std::string& name);
+
+	// Throws if the settings are out of range, e.g. when the atlas would exceed MAX_ATLAS_SIZE.
+	void init(const Settings& settings);
+	const Settings& settings() const { return m_settings; }
+
+	// Appends mesh's vertices and triangles. Indices are relative to the mesh's first vertex.
+	void generateMesh(uint32_t mesh, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const;
+
+	// Writes atlasSize() * atlasSize() RGBA8 pixels.
+	void generateAtlas(unsigned char* pixels) const;
+	uint32_t atlasSize() const { return m_tilesPerSide * m_settings.textureSize; }
+
+	Placement place(uint32_t object) const;
+
+	// Of a sphere around the origin that holds every object.
+	float radius() const;
+
+private:
+	Settings m_settings;
+	uint32_t m_tilesPerSide = 1;
+	uint32_t m_gridSize = 1;	// objects on each side of the cube
+};
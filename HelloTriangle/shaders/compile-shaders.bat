@@ -1,5 +1,10 @@
 @echo off
 glslc shader.vert -o vert.spv
 glslc shader.frag -o frag.spv
-echo Successfully compiled shader.vert and shader.frag
+glslc cull.comp -o cull.spv
+glslc -DOCCLUSION cull.comp -o cull_occlusion.spv
+glslc -DFROM_DEPTH hiz.comp -o hiz_depth.spv
+glslc -DFROM_DEPTH -DMULTISAMPLED hiz.comp -o hiz_depth_ms.spv
+glslc hiz.comp -o hiz_reduce.spv
+echo Successfully compiled shader.vert, shader.frag, cull.comp and hiz.comp
 pause
\ No newline at end of file
@@ -0,0 +1,242 @@
+// Checks that call streams read back what CallWriter wrote, that compareCalls tells apart what it
+// should and no more, and that the streams survive a session trace round trip.
+
+#include "../core/CallTrace.h"
+#include "../core/SessionTrace.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+struct Frame
+{
+	uint64_t commandBuffer = 0x10;
+	uint64_t pipeline = 0x20;
+	uint32_t indexCount = 36;
+	uint32_t imageIndex = 0;
+	std::vector<uint64_t> descriptorSets = { 0x30, 0x31 };
+	std::vector<float> pushConstants = { 1.0f, 2.0f };
+};
+
+// A short frame: acquire, bind, push, draw.
+static std::vector<char> writeFrame(const Frame& frame, uint32_t* callCount = nullptr)
+{
+	CallWriter writer;
+
+	writer.begin(ApiCall::AcquireNextImageKHR);
+	writer.handle(0x1);
+	writer.handle(0x2);
+	writer.u64(UINT64_MAX);
+	writer.handle(0x3);
+	writer.handle(0);
+	writer.u32(frame.imageIndex);
+	writer.i32(0);
+	writer.end();
+
+	writer.begin(ApiCall::CmdBindPipeline);
+	writer.handle(frame.commandBuffer);
+	writer.u32(0);
+	writer.handle(frame.pipeline);
+	writer.end();
+
+	writer.begin(ApiCall::CmdBindDescriptorSets);
+	writer.handle(frame.commandBuffer);
+	writer.u32(0);
+	writer.handle(0x40);
+	writer.u32(0);
+	writer.count(frame.descriptorSets.size());
+	for (uint64_t set : frame.descriptorSets)
+		writer.handle(set);
+	writer.count(0);
+	writer.end();
+
+	writer.begin(ApiCall::CmdPushConstants);
+	writer.handle(frame.commandBuffer);
+	writer.handle(0x40);
+	writer.u32(1);
+	writer.u32(0);
+	writer.bytes(frame.pushConstants.data(), frame.pushConstants.size() * sizeof(float));
+	writer.end();
+
+	writer.begin(ApiCall::CmdDrawIndexed);
+	writer.handle(frame.commandBuffer);
+	writer.u32(frame.indexCount);
+	writer.u32(1);
+	writer.u32(0);
+	writer.i32(-4);
+	writer.u32(0);
+	writer.end();
+
+	if (callCount)
+		*callCount = writer.callCount();
+	return writer.data();
+}
+
+static bool same(const Frame& a, const Frame& b, std::string& difference)
+{
+	return compareCalls(decodeCalls(writeFrame(a)), decodeCalls(writeFrame(b)), difference);
+}
+
+static void checkRoundTrip()
+{
+	uint32_t count = 0;
+	std::vector<DecodedCall> calls = decodeCalls(writeFrame(Frame{}, &count));
+	check(count == 5 && calls.size() == 5, "five calls written and read back");
+	if (calls.size() != 5)
+		return;
+
+	std::ostringstream printed;
+	printCall(printed, calls[2]);
+	check(printed.str() == "vkCmdBindDescriptorSets(commandBuffer=0x10, pipelineBindPoint=0, layout=0x40, firstSet=0, descriptorSets=[0x30, 0x31], dynamicOffsets=[])",
+		"descriptor set binding prints as " + printed.str());
+
+	printed.str("");
+	printCall(printed, calls[4]);
+	check(printed.str() == "vkCmdDrawIndexed(commandBuffer=0x10, indexCount=36, instanceCount=1, firstIndex=0, vertexOffset=-4, firstInstance=0)",
+		"draw prints as " + printed.str());
+
+	printed.str("");
+	printCall(printed, calls[3]);
+	check(printed.str() == "vkCmdPushConstants(commandBuffer=0x10, layout=0x40, stageFlags=0x1, offset=0, values=<8 bytes>)",
+		"push constants print as " + printed.str());
+}
+
+static void checkCompare()
+{
+	std::string difference;
+	Frame base;
+
+	check(same(base, base, difference), "a stream matches itself");
+
+	Frame renamed;
+	renamed.commandBuffer = 0x99;
+	renamed.pipeline = 0x98;
+	renamed.descriptorSets = { 0x97, 0x96 };
+	check(same(base, renamed, difference), "handles from another run still match");
+
+	Frame acquiredOther;
+	acquiredOther.imageIndex = 2;
+	check(same(base, acquiredOther, difference), "the acquired image isn't compared");
+
+	Frame drawsLess;
+	drawsLess.indexCount = 30;
+	check(!same(base, drawsLess, difference) && difference == "call 4 (vkCmdDrawIndexed): indexCount is 30 instead of 36",
+		"a different draw is found, got: " + difference);
+
+	Frame nullPipeline;
+	nullPipeline.pipeline = 0;
+	check(!same(base, nullPipeline, difference) && difference == "call 1 (vkCmdBindPipeline): pipeline is null instead of set",
+		"a null handle is found, got: " + difference);
+
+	Frame fewerSets;
+	fewerSets.descriptorSets = { 0x30 };
+	check(!same(base, fewerSets, difference) && difference == "call 2 (vkCmdBindDescriptorSets): descriptorSets has 1 elements instead of 2",
+		"a shorter array is found, got: " + difference);
+
+	Frame otherConstants;
+	otherConstants.pushConstants[1] = 3.0f;
+	check(!same(base, otherConstants, difference) && difference == "call 3 (vkCmdPushConstants): values differs",
+		"different bytes are found, got: " + difference);
+
+	std::vector<DecodedCall> calls = decodeCalls(writeFrame(base));
+	std::vector<DecodedCall> fewer(calls.begin(), calls.end() - 1);
+	check(!compareCalls(calls, fewer, difference) && difference == "4 calls instead of 5", "a missing call is found, got: " + difference);
+}
+
+static void checkMalformed()
+{
+	std::vector<char> stream = writeFrame(Frame{});
+
+	bool threw = false;
+	try {
+		decodeCalls(std::vector<char>(stream.begin(), stream.end() - 3));
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	check(threw, "a truncated stream throws");
+
+	// A call from a newer build is skipped by its size.
+	CallWriter writer;
+	writer.begin(static_cast<ApiCall>(0x7fff));
+	writer.u64(42);
+	writer.end();
+	std::vector<char> unknown = writer.data();
+	unknown.insert(unknown.end(), stream.begin(), stream.end());
+	check(decodeCalls(unknown).size() == 5, "an unknown call is skipped");
+
+	// A payload longer than the signature says doesn't line up.
+	writer.clear();
+	writer.begin(ApiCall::CmdEndRenderPass);
+	writer.handle(0x10);
+	writer.u32(0);
+	writer.end();
+	threw = false;
+	try {
+		decodeCalls(writer.data());
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	check(threw, "a call that doesn't match its signature throws");
+}
+
+static void checkSessionTrace()
+{
+	const std::string path = "call-trace-test.trace";
+
+	uint32_t setupCount = 0;
+	uint32_t frameCount = 0;
+	Frame second;
+	second.indexCount = 12;
+	std::vector<char> setup = writeFrame(Frame{}, &setupCount);
+	std::vector<char> frame = writeFrame(second, &frameCount);
+	{
+		SessionRecorder recorder;
+		recorder.open(path, { "--frames", "2" });
+		recorder.addCalls(SessionTrace::SETUP_CALLS, setupCount, setup);
+		recorder.addFrame(SessionTrace::Frame{});
+		recorder.addFrame(SessionTrace::Frame{});
+		recorder.addCalls(1, frameCount, frame);
+		recorder.close();
+	}
+
+	SessionTrace trace;
+	trace.load(path);
+	std::remove(path.c_str());
+
+	check(trace.frames().size() == 2, "both frames load");
+	check(trace.setupCalls().count == setupCount && trace.setupCalls().stream == setup, "setup calls load");
+	check(trace.frameCalls(0) == nullptr, "a frame without calls has none");
+	check(trace.frameCalls(1) && trace.frameCalls(1)->count == frameCount && trace.frameCalls(1)->stream == frame, "frame calls load");
+	check(trace.frameCalls(2) == nullptr, "frames past the end have no calls");
+}
+
+int main()
+{
+	checkRoundTrip();
+	checkCompare();
+	checkMalformed();
+	checkSessionTrace();
+
+	if (failures > 0) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
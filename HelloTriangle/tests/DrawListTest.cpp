@@ -0,0 +1,141 @@
+// Checks DrawList's radix sort against std::stable_sort, on the calling thread and on a worker
+// pool, and that record() binds each piece of state only when it changes.
+
+#include "../scene/DrawList.h"
+#include "../core/WorkerPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+// Records the calls record() makes and checks each draw sees the state its key asks for.
+struct CheckingRecorder
+{
+	bool pipelineBound = false, materialBound = false, meshBound = false;
+	uint32_t pipeline = 0, material = 0, mesh = 0;
+	uint32_t wrongState = 0;
+	DrawStateChanges issued;	// bind calls actually received
+	std::vector<uint32_t> items;
+
+	void bindPipeline(uint32_t value) { pipeline = value; pipelineBound = true; issued.pipelineBinds++; }
+	void bindMaterial(uint32_t value) { material = value; materialBound = true; issued.descriptorSetBinds++; }
+	void bindMesh(uint32_t value) { mesh = value; meshBound = true; issued.vertexBufferBinds++; }
+
+	void draw(const DrawList::Entry& entry)
+	{
+		if (!pipelineBound || !materialBound || !meshBound ||
+			pipeline != DrawList::keyPipeline(entry.key) || material != DrawList::keyMaterial(entry.key) || mesh != DrawList::keyMesh(entry.key))
+			wrongState++;
+		items.push_back(entry.item);
+	}
+};
+
+static void checkSort(const std::string& name, uint32_t count, WorkerPool* pool)
+{
+	std::mt19937 rng(count);
+	DrawList list;
+	std::vector<DrawList::Entry> expected;
+
+	// Few distinct values per field, so many keys tie and stability matters. The mesh digit
+	// never varies, which exercises skipping digits.
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t key = DrawList::makeKey(rng() % 2, rng() % 5, rng() % 40, 7, rng() % 300);
+		list.add(key, i);
+		expected.push_back({ key, i });
+	}
+
+	list.sort(pool);
+	std::stable_sort(expected.begin(), expected.end(), [](const DrawList::Entry& a, const DrawList::Entry& b) { return a.key < b.key; });
+
+	bool same = list.size() == expected.size();
+	for (size_t i = 0; same && i < expected.size(); i++)
+		same = list.entries()[i].key == expected[i].key && list.entries()[i].item == expected[i].item;
+	check(same, name + ": matches std::stable_sort");
+
+	// Binds expected from walking the sorted keys directly.
+	DrawStateChanges counted;
+	for (size_t i = 0; i < expected.size(); i++) {
+		uint64_t key = expected[i].key;
+		uint64_t previous = i > 0 ? expected[i - 1].key : 0;
+		bool first = i == 0;
+		counted.pipelineBinds += first || DrawList::keyPass(key) != DrawList::keyPass(previous) || DrawList::keyPipeline(key) != DrawList::keyPipeline(previous);
+		counted.descriptorSetBinds += first || DrawList::keyMaterial(key) != DrawList::keyMaterial(previous);
+		counted.vertexBufferBinds += first || DrawList::keyMesh(key) != DrawList::keyMesh(previous);
+		counted.draws++;
+	}
+
+	CheckingRecorder recorder;
+	DrawStateChanges changes = list.record(recorder);
+	check(recorder.wrongState == 0, name + ": " + std::to_string(recorder.wrongState) + " draws recorded with the wrong state bound");
+	check(recorder.items.size() == count, name + ": every entry drawn once");
+	check(changes.pipelineBinds == counted.pipelineBinds, name + ": pipeline binds");
+	check(changes.descriptorSetBinds == counted.descriptorSetBinds, name + ": descriptor set binds");
+	check(changes.vertexBufferBinds == counted.vertexBufferBinds, name + ": vertex buffer binds");
+	check(changes.draws == count, name + ": draw count");
+	check(changes.pipelineBinds == recorder.issued.pipelineBinds, name + ": pipeline binds counted as issued");
+	check(changes.descriptorSetBinds == recorder.issued.descriptorSetBinds, name + ": descriptor set binds counted as issued");
+	check(changes.vertexBufferBinds == recorder.issued.vertexBufferBinds, name + ": vertex buffer binds counted as issued");
+
+	std::cout << name << ": " << count << " draws, " << changes.pipelineBinds << " pipeline, "
+		<< changes.descriptorSetBinds << " descriptor set and " << changes.vertexBufferBinds << " vertex buffer binds" << std::endl;
+}
+
+// A small list whose bind counts are worked out by hand.
+static void checkKnownCounts()
+{
+	DrawList list;
+	list.add(DrawList::makeKey(0, 1, 2, 3, 0), 0);
+	list.add(DrawList::makeKey(0, 0, 1, 1, 5), 1);
+	list.add(DrawList::makeKey(0, 1, 2, 4, 0), 2);
+	list.add(DrawList::makeKey(0, 0, 1, 1, 2), 3);
+	list.add(DrawList::makeKey(1, 0, 1, 1, 0), 4);
+	list.add(DrawList::makeKey(0, 1, 2, 3, 0), 5);
+	list.sort();
+
+	// Pass 0 pipeline 0: items 3, 1 (depth 2 before 5), one of each bind.
+	// Pass 0 pipeline 1: items 0, 5 share mesh 3, then 2 switches to mesh 4.
+	// Pass 1 pipeline 0: the same pipeline again, but a new pass still rebinds it.
+	CheckingRecorder recorder;
+	DrawStateChanges changes = list.record(recorder);
+	check(recorder.items == std::vector<uint32_t>({ 3, 1, 0, 5, 2, 4 }), "known list: draw order");
+	check(changes.pipelineBinds == 3, "known list: pipeline binds");
+	check(changes.descriptorSetBinds == 3, "known list: descriptor set binds");
+	check(changes.vertexBufferBinds == 4, "known list: vertex buffer binds");
+	check(changes.draws == 6, "known list: draws");
+	check(recorder.wrongState == 0, "known list: draws recorded with the right state");
+	check(recorder.issued.pipelineBinds == 3, "known list: pipeline binds issued");
+}
+
+int main()
+{
+	checkKnownCounts();
+
+	WorkerPool pool;
+	pool.init(3);
+
+	checkSort("small", 1000, nullptr);
+	checkSort("small on the pool", 1000, &pool);
+	checkSort("large", 100000, nullptr);
+	checkSort("large on the pool", 100000, &pool);
+	checkSort("uneven chunks on the pool", DrawList::PARALLEL_MIN_ENTRIES + 3, &pool);
+
+	if (failures > 0) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+// Checks SceneBvh::cullFrustum against testing every object on its own. Objects are inserted,
+// moved and removed at random first, so the tree has been rebalanced and refitted many times.
+//
+// With no margin the leaves hold the exact bounds and both must find the same objects. With a
+// margin the leaves are larger, so the tree may report objects just outside the frustum but must
+// never miss one that is inside.
+
+#include "../scene/SceneBvh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+// Column-major 0..1 depth projections, as glm builds them with GLM_FORCE_DEPTH_ZERO_TO_ONE.
+static std::vector<float> perspective(float fovY, float aspect, float nearPlane, float farPlane)
+{
+	float f = 1.0f / std::tan(fovY / 2.0f);
+	std::vector<float> m(16, 0.0f);
+	m[0] = f / aspect;
+	m[5] = f;
+	m[10] = farPlane / (nearPlane - farPlane);
+	m[11] = -1.0f;
+	m[14] = nearPlane * farPlane / (nearPlane - farPlane);
+	return m;
+}
+
+static std::vector<float> orthographic(float halfWidth, float halfHeight, float nearPlane, float farPlane)
+{
+	std::vector<float> m(16, 0.0f);
+	m[0] = 1.0f / halfWidth;
+	m[5] = 1.0f / halfHeight;
+	m[10] = 1.0f / (nearPlane - farPlane);
+	m[14] = nearPlane / (nearPlane - farPlane);
+	m[15] = 1.0f;
+	return m;
+}
+
+static void runCase(const std::string& name, float margin, const std::vector<float>& viewProj)
+{
+	const uint32_t objectCount = 20000;
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+	auto randomBox = [&]() {
+		float x = position(rng), y = position(rng), z = position(rng);
+		return Aabb{ { x, y, z }, { x + extent(rng), y + extent(rng), z + extent(rng) } };
+	};
+
+	SceneBvh bvh(margin);
+	std::vector<Aabb> boxes(objectCount);
+	std::vector<uint32_t> proxies(objectCount);
+	std::vector<bool> alive(objectCount, true);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		boxes[i] = randomBox();
+		proxies[i] = bvh.insert(boxes[i], i);
+	}
+
+	// Small moves mostly stay inside the enlarged leaves, large ones force reinsertion.
+	std::uniform_real_distribution<float> nudge(-0.04f, 0.04f);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		uint32_t object = rng() % objectCount;
+		if (i % 2 == 0) {
+			boxes[object] = randomBox();
+		}
+		else {
+			float dx = nudge(rng), dy = nudge(rng), dz = nudge(rng);
+			boxes[object] = Aabb{
+				{ boxes[object].min[0] + dx, boxes[object].min[1] + dy, boxes[object].min[2] + dz },
+				{ boxes[object].max[0] + dx, boxes[object].max[1] + dy, boxes[object].max[2] + dz } };
+		}
+		bvh.move(proxies[object], boxes[object]);
+	}
+
+	uint32_t removed = 0;
+	for (uint32_t i = 0; i < objectCount; i += 9) {
+		bvh.remove(proxies[i]);
+		alive[i] = false;
+		removed++;
+	}
+	check(bvh.objectCount() == objectCount - removed, name + ": object count after removals");
+
+	Frustum frustum(viewProj.data());
+	std::vector<uint32_t> visible;
+	CullStats stats;
+	bvh.cullFrustum(frustum, visible, stats);
+	check(stats.visible == visible.size(), name + ": visible count matches the list");
+
+	std::vector<uint32_t> reported(objectCount, 0);
+	for (uint32_t object : visible) {
+		if (object >= objectCount) {
+			check(false, name + ": unknown object " + std::to_string(object));
+			continue;
+		}
+		reported[object]++;
+	}
+
+	uint32_t expected = 0, missing = 0, extra = 0, duplicates = 0, dead = 0;
+	for (uint32_t i = 0; i < objectCount; i++) {
+		if (reported[i] > 1)
+			duplicates++;
+		if (!alive[i]) {
+			dead += reported[i] > 0;
+			continue;
+		}
+
+		bool inside = frustum.test(boxes[i]) != Frustum::Result::Outside;
+		expected += inside;
+		if (inside && reported[i] == 0)
+			missing++;
+		if (!inside && reported[i] > 0)
+			extra++;
+	}
+
+	check(missing == 0, name + ": " + std::to_string(missing) + " visible objects missed");
+	check(duplicates == 0, name + ": " + std::to_string(duplicates) + " objects reported twice");
+	check(dead == 0, name + ": " + std::to_string(dead) + " removed objects reported");
+	if (margin == 0.0f)
+		check(extra == 0, name + ": " + std::to_string(extra) + " objects outside the frustum reported");
+	check(expected > 0 && expected < objectCount - removed, name + ": frustum sees part of the scene");
+
+	std::cout << name << ": " << expected << " of " << objectCount - removed << " objects visible, "
+		<< extra << " more from the margin, " << stats.tested << " tests, height " << bvh.height() << std::endl;
+}
+
+int main()
+{
+	const float pi = 3.14159265f;
+
+	runCase("perspective", 0.0f, perspective(pi / 4.0f, 16.0f / 9.0f, 0.1f, 100.0f));
+	runCase("perspective with margin", 0.05f, perspective(pi / 4.0f, 16.0f / 9.0f, 0.1f, 100.0f));
+	runCase("orthographic", 0.0f, orthographic(20.0f, 20.0f, -50.0f, 50.0f));
+	runCase("orthographic with margin", 0.5f, orthographic(20.0f, 20.0f, -50.0f, 50.0f));
+
+	if (failures > 0) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}